@@ -22,6 +22,7 @@ APP_SOURCES = \
     $$MAIN_PATH/FileOpenEventFilter.cpp \
     $$MAIN_PATH/HelpCatalog.cpp \
     $$MAIN_PATH/UniverseView.cpp \
+    $$MAIN_PATH/VideoCapture.cpp \
     $$MAIN_PATH/Viewpoint.cpp \
     $$MAIN_PATH/NetworkTextureLoader.cpp \
     $$MAIN_PATH/LocalImageLoader.cpp \
@@ -39,6 +40,7 @@ APP_SOURCES = \
     $$MAIN_PATH/NumberFormat.cpp \
     $$MAIN_PATH/ObserverAction.cpp \
     $$MAIN_PATH/SkyLabelLayer.cpp \
+    $$MAIN_PATH/TileDiskCache.cpp \
     $$MAIN_PATH/TleTrajectory.cpp \
     $$MAIN_PATH/TwoVectorFrame.cpp \
     $$MAIN_PATH/UnitConversion.cpp \
@@ -56,7 +58,9 @@ APP_SOURCES = \
     $$MAIN_PATH/astro/TASS17.cpp \
     $$MAIN_PATH/catalog/AstorbLoader.cpp \
     $$MAIN_PATH/catalog/BodyInfo.cpp \
+    $$MAIN_PATH/catalog/BuiltinModels.cpp \
     $$MAIN_PATH/catalog/ChebyshevPolyFileLoader.cpp \
+    $$MAIN_PATH/catalog/MeshCache.cpp \
     $$MAIN_PATH/catalog/UniverseCatalog.cpp \
     $$MAIN_PATH/catalog/UniverseLoader.cpp \
     $$MAIN_PATH/geometry/FeatureLabelSetGeometry.cpp \
@@ -70,9 +74,11 @@ APP_SOURCES = \
     $$MAIN_PATH/vext/NameTemplateTiledMap.cpp \
     $$MAIN_PATH/vext/PathRelativeTextureLoader.cpp \
     $$MAIN_PATH/vext/SimpleRotationModel.cpp \
+    $$MAIN_PATH/vext/TilePackTiledMap.cpp \
     $$MAIN_PATH/compatibility/CatalogParser.cpp \
     $$MAIN_PATH/compatibility/CelBodyFixedFrame.cpp \
     $$MAIN_PATH/compatibility/CmodLoader.cpp \
+    $$MAIN_PATH/compatibility/ObjFileLoader.cpp \
     $$MAIN_PATH/compatibility/Scanner.cpp \
     $$MAIN_PATH/compatibility/TransformCatalog.cpp \
     $$MAIN_PATH/qtwrapper/BodyObject.cpp \
@@ -87,6 +93,7 @@ APP_HEADERS = \
     $$MAIN_PATH/FileOpenEventFilter.h \
     $$MAIN_PATH/HelpCatalog.h \
     $$MAIN_PATH/UniverseView.h \
+    $$MAIN_PATH/VideoCapture.h \
     $$MAIN_PATH/Viewpoint.h \
     $$MAIN_PATH/NetworkTextureLoader.h \
     $$MAIN_PATH/LocalImageLoader.h \
@@ -104,6 +111,7 @@ APP_HEADERS = \
     $$MAIN_PATH/NumberFormat.h \
     $$MAIN_PATH/ObserverAction.h \
     $$MAIN_PATH/SkyLabelLayer.h \
+    $$MAIN_PATH/TileDiskCache.h \
     $$MAIN_PATH/TleTrajectory.h \
     $$MAIN_PATH/TwoVectorFrame.h \
     $$MAIN_PATH/UnitConversion.h \
@@ -122,7 +130,9 @@ APP_HEADERS = \
     $$MAIN_PATH/astro/TASS17.h \
     $$MAIN_PATH/catalog/AstorbLoader.h \
     $$MAIN_PATH/catalog/BodyInfo.h \
+    $$MAIN_PATH/catalog/BuiltinModels.h \
     $$MAIN_PATH/catalog/ChebyshevPolyFileLoader.h \
+    $$MAIN_PATH/catalog/MeshCache.h \
     $$MAIN_PATH/catalog/UniverseCatalog.h \
     $$MAIN_PATH/catalog/UniverseLoader.h \
     $$MAIN_PATH/geometry/FeatureLabelSetGeometry.h \
@@ -138,9 +148,11 @@ APP_HEADERS = \
     $$MAIN_PATH/vext/PathRelativeTextureLoader.h \
     $$MAIN_PATH/vext/SimpleRotationModel.h \
     $$MAIN_PATH/vext/StripParticleGenerator.h \
+    $$MAIN_PATH/vext/TilePackTiledMap.h \
     $$MAIN_PATH/compatibility/CatalogParser.h \
     $$MAIN_PATH/compatibility/CelBodyFixedFrame.h \
     $$MAIN_PATH/compatibility/CmodLoader.h \
+    $$MAIN_PATH/compatibility/ObjFileLoader.h \
     $$MAIN_PATH/compatibility/Scanner.h \
     $$MAIN_PATH/compatibility/TransformCatalog.h \
     $$MAIN_PATH/qtwrapper/BodyObject.h \
@@ -187,6 +199,7 @@ VESTA_SOURCES = \
     $$VESTA_PATH/InertialFrame.cpp \
     $$VESTA_PATH/KeplerianTrajectory.cpp \
     $$VESTA_PATH/LabelGeometry.cpp \
+    $$VESTA_PATH/LabelPlacement.cpp \
     $$VESTA_PATH/LabelVisualizer.cpp \
     $$VESTA_PATH/LightSource.cpp \
     $$VESTA_PATH/LocalVisualizer.cpp \
@@ -203,9 +216,12 @@ VESTA_SOURCES = \
     $$VESTA_PATH/PlanetGridLayer.cpp \
     $$VESTA_PATH/PlaneVisualizer.cpp \
     $$VESTA_PATH/PrimitiveBatch.cpp \
+    $$VESTA_PATH/Profiler.cpp \
     $$VESTA_PATH/QuadtreeTile.cpp \
     $$VESTA_PATH/RenderContext.cpp \
     $$VESTA_PATH/LightingEnvironment.cpp \
+    $$VESTA_PATH/SensorCoverage.cpp \
+    $$VESTA_PATH/SensorCoverageLayer.cpp \
     $$VESTA_PATH/SensorFrustumGeometry.cpp \
     $$VESTA_PATH/SensorVisualizer.cpp \
     $$VESTA_PATH/ShaderBuilder.cpp \
@@ -213,7 +229,9 @@ VESTA_SOURCES = \
     $$VESTA_PATH/Spectrum.cpp \
     $$VESTA_PATH/StarCatalog.cpp \
     $$VESTA_PATH/StarsLayer.cpp \
+    $$VESTA_PATH/Stopwatch.cpp \
     $$VESTA_PATH/Submesh.cpp \
+    $$VESTA_PATH/TextLayoutCache.cpp \
     $$VESTA_PATH/TextureFont.cpp \
     $$VESTA_PATH/TextureMap.cpp \
     $$VESTA_PATH/TextureMapLoader.cpp \
@@ -234,7 +252,10 @@ VESTA_SOURCES = \
     $$VESTA_PATH/internal/EclipseShadowVolumeSet.cpp \
     $$VESTA_PATH/internal/InputDataStream.cpp \
     $$VESTA_PATH/internal/OutputDataStream.cpp \
-    $$VESTA_PATH/internal/ObjLoader.cpp
+    $$VESTA_PATH/internal/MeshSimplifier.cpp \
+    $$VESTA_PATH/internal/ObjLoader.cpp \
+    $$VESTA_PATH/internal/ParallelFor.cpp \
+    $$VESTA_PATH/internal/VertexCacheOptimizer.cpp
 
 VESTA_HEADERS = \
     $$VESTA_PATH/AlignedEllipsoid.h \
@@ -276,6 +297,7 @@ VESTA_HEADERS = \
     $$VESTA_PATH/JavaCallbackTrajectory.h \
     $$VESTA_PATH/KeplerianTrajectory.h \
     $$VESTA_PATH/LabelGeometry.h \
+    $$VESTA_PATH/LabelPlacement.h \
     $$VESTA_PATH/LabelVisualizer.h \
     $$VESTA_PATH/LightSource.h \
     $$VESTA_PATH/LocalVisualizer.h \
@@ -297,10 +319,13 @@ VESTA_HEADERS = \
     $$VESTA_PATH/PlanetographicCoord.h \
     $$VESTA_PATH/PlaneVisualizer.h \
     $$VESTA_PATH/PrimitiveBatch.h \
+    $$VESTA_PATH/Profiler.h \
     $$VESTA_PATH/QuadtreeTile.h \
     $$VESTA_PATH/RenderContext.h \
     $$VESTA_PATH/LightingEnvironment.h \
     $$VESTA_PATH/RotationModel.h \
+    $$VESTA_PATH/SensorCoverage.h \
+    $$VESTA_PATH/SensorCoverageLayer.h \
     $$VESTA_PATH/SensorFrustumGeometry.h \
     $$VESTA_PATH/SensorVisualizer.h \
     $$VESTA_PATH/ShaderBuilder.h \
@@ -312,7 +337,9 @@ VESTA_HEADERS = \
     $$VESTA_PATH/StarCatalog.h \
     $$VESTA_PATH/StarsLayer.h \
     $$VESTA_PATH/StateVector.h \
+    $$VESTA_PATH/Stopwatch.h \
     $$VESTA_PATH/Submesh.h \
+    $$VESTA_PATH/TextLayoutCache.h \
     $$VESTA_PATH/TextureFont.h \
     $$VESTA_PATH/TextureMap.h \
     $$VESTA_PATH/TextureMapLoader.h \
@@ -339,7 +366,10 @@ VESTA_HEADERS = \
     $$VESTA_PATH/internal/EclipseShadowVolumeSet.h \
     $$VESTA_PATH/internal/InputDataStream.h \
     $$VESTA_PATH/internal/OutputDataStream.h \
-    $$VESTA_PATH/internal/ObjLoader.h
+    $$VESTA_PATH/internal/MeshSimplifier.h \
+    $$VESTA_PATH/internal/ObjLoader.h \
+    $$VESTA_PATH/internal/ParallelFor.h \
+    $$VESTA_PATH/internal/VertexCacheOptimizer.h
 
 
 ### particle system module ###
@@ -365,6 +395,7 @@ VESTA_SOURCES += \
     $$VESTA_PATH/glhelp/GLShaderProgram.cpp \
     $$VESTA_PATH/glhelp/GLBufferObject.cpp \
     $$VESTA_PATH/glhelp/GLElementBuffer.cpp \
+    $$VESTA_PATH/glhelp/GLPixelBuffer.cpp \
     $$VESTA_PATH/glhelp/GLVertexBuffer.cpp
 
 VESTA_HEADERS += \
@@ -373,6 +404,7 @@ VESTA_HEADERS += \
     $$VESTA_PATH/glhelp/GLShaderProgram.h \
     $$VESTA_PATH/glhelp/GLBufferObject.h \
     $$VESTA_PATH/glhelp/GLElementBuffer.h \
+    $$VESTA_PATH/glhelp/GLPixelBuffer.h \
     $$VESTA_PATH/glhelp/GLVertexBuffer.h
 
 
@@ -534,6 +566,38 @@ INCLUDEPATH += thirdparty/glew thirdparty/curveplot thirdparty/eigen thirdparty
 #CONFIG += storedeploy
 #CONFIG += lua
 #CONFIG += spice
+#CONFIG += avx2
+#CONFIG += neon
+#CONFIG += renderbench
+#CONFIG += rendersequence
+#CONFIG += meshbench
+#CONFIG += framebench
+#CONFIG += shadowbench
+#CONFIG += intersectbench
+#CONFIG += catalogbench
+#CONFIG += tilesoak
+#CONFIG += wmscachetest
+
+avx2 {
+    # Allow Eigen to use AVX2 and FMA instructions for vectorized code such as
+    # the batch ray intersection kernels in vesta/Intersect.h. The executable
+    # will only run on processors with AVX2 support.
+    message("Building with AVX2 and FMA instructions")
+    win32-msvc* {
+        QMAKE_CXXFLAGS += /arch:AVX2
+    } else {
+        QMAKE_CXXFLAGS += -mavx2 -mfma
+    }
+}
+
+neon {
+    # NEON is always available on 64-bit ARM, but must be enabled explicitly
+    # for 32-bit ARM builds.
+    message("Building with NEON instructions")
+    !contains(QT_ARCH, arm64) {
+        QMAKE_CXXFLAGS += -mfpu=neon
+    }
+}
 
 lua {
     message("Building with Lua scripting support")
@@ -578,6 +642,53 @@ nomenu {
     DEFINES += NOMENUBAR=1
 }
 
+# Headless benchmarks and tools. Adding the name of one to CONFIG (see the list
+# above) builds it in place of the application. Each tool lists only its own
+# sources and headers here; the rest of the application sources are shared.
+HEADLESS_TOOLS = renderbench rendersequence meshbench framebench shadowbench intersectbench catalogbench tilesoak wmscachetest
+
+# Headless rendering benchmark
+renderbench.sources = src/benchmark/RenderBenchmark.cpp src/offline/OfflineScene.cpp
+renderbench.headers = src/offline/OfflineScene.h
+
+# Headless image sequence rendering
+rendersequence.sources = src/offline/RenderSequence.cpp src/offline/OfflineScene.cpp
+rendersequence.headers = src/offline/OfflineScene.h
+
+# Mesh file decoding benchmark
+meshbench.sources = src/benchmark/MeshLoadBenchmark.cpp
+
+# Two-vector frame evaluation benchmark
+framebench.sources = src/benchmark/FrameBenchmark.cpp
+
+# Eclipse shadow volume culling and lookup benchmark
+shadowbench.sources = src/benchmark/ShadowVolumeBenchmark.cpp
+
+# Batch ray intersection kernel benchmark
+intersectbench.sources = src/benchmark/IntersectBenchmark.cpp
+
+# Catalog name lookup and completion benchmark
+catalogbench.sources = src/benchmark/CatalogBenchmark.cpp
+
+# Tile cache soak test
+tilesoak.sources = src/benchmark/TileCacheSoak.cpp
+
+# WMS tile requests and cache against a local HTTP server
+wmscachetest.sources = src/benchmark/WMSCacheTest.cpp
+wmscachetest.headers = src/benchmark/WMSCacheTest.h
+
+for(tool, HEADLESS_TOOLS) {
+    CONFIG($$tool) {
+        message("Building $$tool instead of the application")
+        TARGET = $$tool
+        OBJECTS_DIR = obj-$$tool
+        CONFIG -= app_bundle
+        SOURCES -= $$MAIN_PATH/main.cpp
+        SOURCES += $$eval($${tool}.sources)
+        HEADERS += $$eval($${tool}.headers)
+    }
+}
+
 ffmpeg {
     message("Building with FFMPEG for video")
 
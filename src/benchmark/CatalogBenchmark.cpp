@@ -0,0 +1,322 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// catalogbench: compare the indexed name lookup and completion functions in
+// UniverseCatalog with the linear scans that they replaced.
+//
+// usage: catalogbench [-bodies <count>] [-queries <count>] [-completions <count>]
+//
+// The test catalog contains a number of synthetic body names, similar to a
+// loaded minor planet catalog. Case insensitive lookups are timed against a
+// scan of all names, as the search box used to do, and prefix completions are
+// timed against matchingNames() with a prefix regular expression, as the
+// completion list used to do. Every indexed result is checked against the
+// scan. Lookups through aliases and of names that differ only in case are
+// checked as well.
+
+#include "../main/catalog/UniverseCatalog.h"
+#include <vesta/Body.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRegExp>
+#include <QSet>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <vector>
+
+using namespace vesta;
+
+
+static unsigned int randomSeed = 12345;
+
+static unsigned int
+randomInt(unsigned int n)
+{
+    randomSeed = randomSeed * 1664525u + 1013904223u;
+    return (randomSeed >> 8) % n;
+}
+
+
+// Generate a name like "Kelomira" or "2012 TK41"
+static QString
+randomName()
+{
+    static const char* syllables[] = { "ka", "lo", "mi", "ra", "the", "os", "ni", "ve", "sta", "ur", "an", "dor" };
+    const unsigned int syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+
+    QString name;
+    if (randomInt(3) == 0)
+    {
+        name = QString("%1 %2%3%4").arg(1990 + randomInt(25))
+                                   .arg(QChar('A' + randomInt(26)))
+                                   .arg(QChar('A' + randomInt(26)))
+                                   .arg(randomInt(200));
+    }
+    else
+    {
+        unsigned int length = 2 + randomInt(3);
+        for (unsigned int i = 0; i < length; ++i)
+        {
+            name += syllables[randomInt(syllableCount)];
+        }
+        name[0] = name[0].toUpper();
+    }
+
+    return name;
+}
+
+
+// Change the case of some of the letters in a name
+static QString
+scrambleCase(const QString& name)
+{
+    QString s = name;
+    for (int i = 0; i < s.length(); ++i)
+    {
+        if (randomInt(2) == 0)
+        {
+            s[i] = s[i].isUpper() ? s[i].toLower() : s[i].toUpper();
+        }
+    }
+
+    return s;
+}
+
+
+// Case insensitive lookup by scanning all names
+static Entity*
+scanFind(const UniverseCatalog& catalog, const QString& name)
+{
+    foreach (QString s, catalog.names())
+    {
+        if (name.compare(s, Qt::CaseInsensitive) == 0)
+        {
+            return catalog.find(s);
+        }
+    }
+
+    return NULL;
+}
+
+
+// Prefix completion with a regular expression match against all names
+static QStringList
+scanComplete(const UniverseCatalog& catalog, const QString& prefix, int maxNames)
+{
+    QStringList matches = catalog.matchingNames(QRegExp::escape(prefix) + ".*");
+    return matches.mid(0, maxNames);
+}
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    unsigned int bodyCount = 20000;
+    unsigned int queryCount = 2000;
+    int completionCount = 10;
+
+    const char* usage = "usage: catalogbench [-bodies <count>] [-queries <count>] [-completions <count>]";
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-bodies" && i + 1 < args.size())
+        {
+            bodyCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-queries" && i + 1 < args.size())
+        {
+            queryCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-completions" && i + 1 < args.size())
+        {
+            completionCount = qMax(1, args[++i].toInt());
+        }
+        else
+        {
+            err << "Unknown option " << args[i] << endl;
+            err << usage << endl;
+            return 1;
+        }
+    }
+
+    // Names that differ only in case are left out, since the scan and the
+    // index are free to choose different bodies for them.
+    UniverseCatalog catalog;
+    QStringList bodyNames;
+    QSet<QString> foldedNames;
+    while ((unsigned int) bodyNames.size() < bodyCount)
+    {
+        QString name = randomName();
+        if (!foldedNames.contains(name.toCaseFolded()))
+        {
+            foldedNames.insert(name.toCaseFolded());
+            bodyNames << name;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    foreach (QString name, bodyNames)
+    {
+        Body* body = new Body();
+        body->setName(name.toUtf8().data());
+        catalog.addBody(name, body);
+    }
+    qint64 addTime = timer.nsecsElapsed();
+
+    // One query in eight is for a name that isn't in the catalog
+    QStringList lookups;
+    QStringList prefixes;
+    for (unsigned int i = 0; i < queryCount; ++i)
+    {
+        QString name = bodyNames[randomInt(bodyNames.size())];
+        lookups << (randomInt(8) == 0 ? name + "x" : scrambleCase(name));
+        prefixes << scrambleCase(name.left(1 + randomInt(4)));
+    }
+
+    out << bodyCount << " bodies, " << queryCount << " queries" << endl;
+    out << "add bodies: " << addTime / double(bodyCount) / 1000.0 << " us per body" << endl;
+
+    bool ok = true;
+
+    std::vector<Entity*> scanResults(queryCount);
+    std::vector<Entity*> indexResults(queryCount);
+
+    timer.start();
+    for (unsigned int i = 0; i < queryCount; ++i)
+    {
+        scanResults[i] = scanFind(catalog, lookups[i]);
+    }
+    qint64 scanFindTime = timer.nsecsElapsed();
+
+    timer.start();
+    for (unsigned int i = 0; i < queryCount; ++i)
+    {
+        indexResults[i] = catalog.find(lookups[i], Qt::CaseInsensitive);
+    }
+    qint64 indexFindTime = timer.nsecsElapsed();
+
+    unsigned int foundCount = 0;
+    unsigned int findMismatchCount = 0;
+    for (unsigned int i = 0; i < queryCount; ++i)
+    {
+        if (indexResults[i])
+        {
+            foundCount++;
+        }
+        if (indexResults[i] != scanResults[i])
+        {
+            findMismatchCount++;
+        }
+    }
+
+    out << "case insensitive find: " << foundCount << " of " << queryCount << " found" << endl;
+    out << "    scan: " << scanFindTime / double(queryCount) / 1000.0 << " us, index: "
+        << indexFindTime / double(queryCount) / 1000.0 << " us per query ("
+        << double(scanFindTime) / double(std::max(indexFindTime, qint64(1))) << "x)" << endl;
+    out << "    mismatched results: " << findMismatchCount << endl;
+    ok = ok && findMismatchCount == 0;
+
+    QList<QStringList> scanCompletions;
+    QList<QStringList> indexCompletions;
+
+    timer.start();
+    foreach (QString prefix, prefixes)
+    {
+        scanCompletions << scanComplete(catalog, prefix, completionCount);
+    }
+    qint64 scanCompleteTime = timer.nsecsElapsed();
+
+    timer.start();
+    foreach (QString prefix, prefixes)
+    {
+        indexCompletions << catalog.completeName(prefix, completionCount);
+    }
+    qint64 indexCompleteTime = timer.nsecsElapsed();
+
+    // The two methods return names in different orders, so the truncated
+    // lists can't be compared directly. Check instead that both find the same
+    // number of names, and that the complete lists of matches are identical.
+    unsigned int completionMismatchCount = 0;
+    for (unsigned int i = 0; i < queryCount; ++i)
+    {
+        QStringList scanAll = catalog.matchingNames(QRegExp::escape(prefixes[i]) + ".*");
+        QStringList indexAll = catalog.completeName(prefixes[i], int(bodyCount));
+        scanAll.sort();
+        indexAll.sort();
+        if (scanAll != indexAll || scanCompletions[i].size() != indexCompletions[i].size())
+        {
+            completionMismatchCount++;
+        }
+    }
+
+    out << "prefix completion, up to " << completionCount << " names" << endl;
+    out << "    regex scan: " << scanCompleteTime / double(queryCount) / 1000.0 << " us, index: "
+        << indexCompleteTime / double(queryCount) / 1000.0 << " us per query ("
+        << double(scanCompleteTime) / double(std::max(indexCompleteTime, qint64(1))) << "x)" << endl;
+    out << "    mismatched results: " << completionMismatchCount << endl;
+    ok = ok && completionMismatchCount == 0;
+
+    // Check aliases and names that differ only in case. A case insensitive
+    // lookup must prefer an exact match and must not pick one of several
+    // bodies arbitrarily.
+    unsigned int aliasFailureCount = 0;
+    for (int i = 0; i < 100 && i < bodyNames.size(); ++i)
+    {
+        QString alias = QString("Alias %1").arg(i);
+        catalog.addAlias(alias, bodyNames[i]);
+        Entity* body = catalog.find(bodyNames[i]);
+        if (catalog.find(alias) != body ||
+            catalog.find(alias.toUpper(), Qt::CaseInsensitive) != body ||
+            !catalog.completeName("alias " + QString::number(i), bodyCount).contains(alias))
+        {
+            aliasFailureCount++;
+        }
+    }
+
+    catalog.removeBody(bodyNames[0]);
+    if (catalog.find("Alias 0") || catalog.completeName("Alias 0", 1).contains("Alias 0"))
+    {
+        aliasFailureCount++;
+    }
+
+    Body* twin0 = new Body();
+    Body* twin1 = new Body();
+    catalog.addBody("Twin", twin0);
+    catalog.addBody("TWIN", twin1);
+    if (catalog.find("Twin", Qt::CaseInsensitive) != twin0 ||
+        catalog.find("TWIN", Qt::CaseInsensitive) != twin1 ||
+        catalog.find("twin", Qt::CaseInsensitive) != NULL)
+    {
+        aliasFailureCount++;
+    }
+
+    out << "alias and ambiguous name checks failed: " << aliasFailureCount << endl;
+    ok = ok && aliasFailureCount == 0;
+
+    if (!ok)
+    {
+        err << "Indexed and scanned results differ" << endl;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// framebench: measure the cost of evaluating entities in two-vector frames.
+//
+// usage: framebench [-steps <count>] [-children <count>] [-queries <count>]
+//
+// The test scene is a spacecraft in low Earth orbit with a local vertical,
+// local horizontal frame (nadir and velocity directions). An instrument is
+// attached to the spacecraft with a second two-vector frame that points
+// along the spacecraft nadir axis and tracks the Sun, so that evaluating it
+// requires evaluating the first frame. A number of child parts are placed in
+// the instrument frame.
+//
+// Each time step evaluates the state and orientation of every part the
+// given number of times, as the renderer does when several passes query the
+// same object. Timings are reported both for the first query at a new time
+// and for the repeated queries. Finally, the analytic angular velocities of
+// the frames and the velocities of the parts are compared against numerical
+// derivatives of the orientations and positions.
+
+#include "../main/TwoVectorFrame.h"
+#include <vesta/Arc.h>
+#include <vesta/Body.h>
+#include <vesta/Chronology.h>
+#include <vesta/FixedPointTrajectory.h>
+#include <vesta/FixedRotationModel.h>
+#include <vesta/InertialFrame.h>
+#include <vesta/KeplerianTrajectory.h>
+#include <vesta/OrbitalElements.h>
+#include <vesta/Units.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <vector>
+
+using namespace vesta;
+using namespace Eigen;
+
+
+static Body*
+createBody(Entity* center, Trajectory* trajectory, Frame* trajectoryFrame, Frame* bodyFrame)
+{
+    Arc* arc = new Arc();
+    arc->setCenter(center);
+    arc->setTrajectory(trajectory);
+    arc->setRotationModel(new FixedRotationModel(Quaterniond::Identity()));
+    arc->setDuration(daysToSeconds(365.25 * 100.0));
+    if (trajectoryFrame)
+    {
+        arc->setTrajectoryFrame(trajectoryFrame);
+    }
+    if (bodyFrame)
+    {
+        arc->setBodyFrame(bodyFrame);
+    }
+
+    Body* body = new Body();
+    body->chronology()->setBeginning(-daysToSeconds(365.25 * 50.0));
+    body->chronology()->addArc(arc);
+    body->addRef();
+
+    return body;
+}
+
+
+static KeplerianTrajectory*
+circularOrbit(double radius, double period, double inclination)
+{
+    OrbitalElements elements;
+    elements.periapsisDistance = radius;
+    elements.eccentricity = 0.0;
+    elements.inclination = inclination;
+    elements.meanMotion = 2.0 * PI / period;
+
+    return new KeplerianTrajectory(elements);
+}
+
+
+// Angle in radians between the angular velocity reported by a frame and
+// the rotation of the frame over a short time interval.
+static double
+angularVelocityError(const Frame* frame, double t, double h)
+{
+    Quaterniond dq = frame->orientation(t + h) * frame->orientation(t - h).conjugate();
+    AngleAxisd aa(dq);
+    Vector3d numeric = aa.axis() * aa.angle() / (2.0 * h);
+    Vector3d analytic = frame->angularVelocity(t);
+
+    return (analytic - numeric).norm() / std::max(numeric.norm(), 1.0e-12);
+}
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    unsigned int stepCount = 10000;
+    unsigned int childCount = 8;
+    unsigned int queryCount = 4;
+
+    const char* usage = "usage: framebench [-steps <count>] [-children <count>] [-queries <count>]";
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-steps" && i + 1 < args.size())
+        {
+            stepCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-children" && i + 1 < args.size())
+        {
+            childCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-queries" && i + 1 < args.size())
+        {
+            queryCount = qMax(1, args[++i].toInt());
+        }
+        else
+        {
+            err << "Unknown option " << args[i] << endl;
+            err << usage << endl;
+            return 1;
+        }
+    }
+
+    const double spacecraftPeriod = 5560.0;
+
+    Body* sun = createBody(NULL, new FixedPointTrajectory(Vector3d::Zero()), NULL, NULL);
+    Body* earth = createBody(sun, circularOrbit(1.496e8, daysToSeconds(365.25), toRadians(23.44)), NULL, NULL);
+
+    // Local vertical, local horizontal frame: +z toward Earth, +x along the velocity
+    Body* spacecraft = createBody(earth, circularOrbit(6778.0, spacecraftPeriod, toRadians(51.6)), NULL, NULL);
+    TwoVectorFrame* lvlhFrame = new TwoVectorFrame(new RelativePositionVector(spacecraft, earth), TwoVectorFrame::PositiveZ,
+                                                   new RelativeVelocityVector(earth, spacecraft), TwoVectorFrame::PositiveX);
+    lvlhFrame->addRef();
+    spacecraft->chronology()->firstArc()->setBodyFrame(lvlhFrame);
+
+    // Instrument frame: +z along the spacecraft nadir axis, +y toward the Sun
+    Body* instrument = createBody(spacecraft, new FixedPointTrajectory(Vector3d(0.002, 0.0, 0.001)), lvlhFrame, NULL);
+    TwoVectorFrame* instrumentFrame = new TwoVectorFrame(new ConstantFrameDirection(lvlhFrame, Vector3d::UnitZ()), TwoVectorFrame::PositiveZ,
+                                                         new RelativePositionVector(instrument, sun), TwoVectorFrame::PositiveY);
+    instrumentFrame->addRef();
+    instrument->chronology()->firstArc()->setBodyFrame(instrumentFrame);
+
+    std::vector<Body*> parts;
+    for (unsigned int i = 0; i < childCount; ++i)
+    {
+        double angle = 2.0 * PI * i / childCount;
+        Vector3d offset(0.001 * cos(angle), 0.001 * sin(angle), 0.0005);
+        parts.push_back(createBody(instrument, new FixedPointTrajectory(offset), instrumentFrame, instrumentFrame));
+    }
+
+    out << "spacecraft with " << childCount << " parts in nested two-vector frames, "
+        << stepCount << " steps, " << queryCount << " queries per step" << endl;
+
+    // Evaluate at a sequence of times spread over one orbit
+    const double t0 = daysToSeconds(4000.0);
+    const double dt = spacecraftPeriod / stepCount;
+
+    QElapsedTimer timer;
+    qint64 firstQueryTime = 0;
+    qint64 repeatQueryTime = 0;
+    Vector3d sum = Vector3d::Zero();
+
+    for (unsigned int step = 0; step < stepCount; ++step)
+    {
+        double t = t0 + step * dt;
+        for (unsigned int query = 0; query < queryCount; ++query)
+        {
+            timer.start();
+            for (unsigned int i = 0; i < parts.size(); ++i)
+            {
+                sum += parts[i]->state(t).position();
+                sum += parts[i]->orientation(t) * Vector3d::UnitX();
+            }
+
+            if (query == 0)
+            {
+                firstQueryTime += timer.nsecsElapsed();
+            }
+            else
+            {
+                repeatQueryTime += timer.nsecsElapsed();
+            }
+        }
+    }
+
+    double evaluationCount = double(stepCount) * childCount;
+    out << "    first query at a new time: " << firstQueryTime / evaluationCount << " ns per part" << endl;
+    if (queryCount > 1)
+    {
+        out << "    repeated query: " << repeatQueryTime / (evaluationCount * (queryCount - 1)) << " ns per part" << endl;
+    }
+
+    // Check the analytic derivatives against numerical differentiation
+    const double h = 0.01;
+    double maxFrameError = 0.0;
+    double maxVelocityError = 0.0;
+    for (unsigned int step = 0; step < 100; ++step)
+    {
+        double t = t0 + step * spacecraftPeriod / 100.0;
+        maxFrameError = std::max(maxFrameError, angularVelocityError(lvlhFrame, t, h));
+        maxFrameError = std::max(maxFrameError, angularVelocityError(instrumentFrame, t, h));
+
+        for (unsigned int i = 0; i < parts.size(); ++i)
+        {
+            Vector3d numeric = (parts[i]->position(t + h) - parts[i]->position(t - h)) / (2.0 * h);
+            Vector3d analytic = parts[i]->state(t).velocity();
+            maxVelocityError = std::max(maxVelocityError, (analytic - numeric).norm() / numeric.norm());
+        }
+    }
+
+    out << "    max relative angular velocity error: " << maxFrameError << endl;
+    out << "    max relative velocity error: " << maxVelocityError << endl;
+
+    // Print the checksum so that the evaluation loop isn't optimized away
+    out << "    (checksum " << sum.norm() << ")" << endl;
+
+    return 0;
+}
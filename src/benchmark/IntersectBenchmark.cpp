@@ -0,0 +1,283 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// intersectbench: compare the batch ray intersection functions in
+// vesta/Intersect.h with the single ray versions.
+//
+// usage: intersectbench [-rays <count>] [-spheres <count>] [-iterations <count>]
+//
+// The ellipsoid tests intersect a fan of rays with a planet, once from a
+// sensor outside the planet (as for sensor footprints and feature label
+// occlusion) and once from inside. They are run in double precision and in
+// single precision. The sphere test intersects one pick ray with the bounding
+// spheres of a field of objects. Every batch result is checked against the
+// single ray function.
+
+#include <vesta/Intersect.h>
+#include <vesta/Units.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace vesta;
+using namespace Eigen;
+
+
+static double
+randomValue()
+{
+    return rand() / double(RAND_MAX);
+}
+
+
+struct Comparison
+{
+    qint64 singleTime;
+    qint64 batchTime;
+    unsigned int hitCount;
+    unsigned int mismatchCount;
+    double maxError;
+};
+
+
+template<typename SCALAR> static Comparison
+compareEllipsoid(const Matrix<SCALAR, 3, 1>& origin,
+                 const Matrix<SCALAR, 3, 1>& semiAxes,
+                 const std::vector<Matrix<SCALAR, 3, 1> >& directions,
+                 unsigned int iterationCount)
+{
+    unsigned int rayCount = directions.size();
+    std::vector<SCALAR> x(rayCount);
+    std::vector<SCALAR> y(rayCount);
+    std::vector<SCALAR> z(rayCount);
+    for (unsigned int i = 0; i < rayCount; ++i)
+    {
+        x[i] = directions[i].x();
+        y[i] = directions[i].y();
+        z[i] = directions[i].z();
+    }
+
+    std::vector<double> singleDistances(rayCount);
+    std::vector<bool> singleHits(rayCount);
+    std::vector<SCALAR> batchDistances(rayCount);
+
+    Comparison result;
+    result.hitCount = 0;
+    result.mismatchCount = 0;
+    result.maxError = 0.0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (unsigned int iteration = 0; iteration < iterationCount; ++iteration)
+    {
+        for (unsigned int i = 0; i < rayCount; ++i)
+        {
+            singleHits[i] = TestRayEllipsoidIntersection(origin, directions[i], semiAxes, &singleDistances[i]);
+        }
+    }
+    result.singleTime = timer.nsecsElapsed();
+
+    timer.start();
+    for (unsigned int iteration = 0; iteration < iterationCount; ++iteration)
+    {
+        result.hitCount = TestRayBatchEllipsoidIntersection(origin, &x[0], &y[0], &z[0], rayCount, semiAxes, &batchDistances[0]);
+    }
+    result.batchTime = timer.nsecsElapsed();
+
+    for (unsigned int i = 0; i < rayCount; ++i)
+    {
+        bool batchHit = batchDistances[i] >= SCALAR(0);
+        if (batchHit != singleHits[i])
+        {
+            result.mismatchCount++;
+        }
+        else if (batchHit)
+        {
+            double error = std::abs(batchDistances[i] - singleDistances[i]) / singleDistances[i];
+            result.maxError = std::max(result.maxError, error);
+        }
+    }
+
+    return result;
+}
+
+
+static Comparison
+compareSpheres(const Vector3d& origin,
+               const Vector3d& direction,
+               const std::vector<Vector3d>& centers,
+               const std::vector<double>& radii,
+               unsigned int iterationCount)
+{
+    unsigned int sphereCount = centers.size();
+    std::vector<double> x(sphereCount);
+    std::vector<double> y(sphereCount);
+    std::vector<double> z(sphereCount);
+    for (unsigned int i = 0; i < sphereCount; ++i)
+    {
+        x[i] = centers[i].x();
+        y[i] = centers[i].y();
+        z[i] = centers[i].z();
+    }
+
+    std::vector<double> singleDistances(sphereCount);
+    std::vector<bool> singleHits(sphereCount);
+    std::vector<double> batchDistances(sphereCount);
+
+    Comparison result;
+    result.hitCount = 0;
+    result.mismatchCount = 0;
+    result.maxError = 0.0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (unsigned int iteration = 0; iteration < iterationCount; ++iteration)
+    {
+        for (unsigned int i = 0; i < sphereCount; ++i)
+        {
+            singleHits[i] = TestRaySphereIntersection(origin, direction, centers[i], radii[i], &singleDistances[i]);
+        }
+    }
+    result.singleTime = timer.nsecsElapsed();
+
+    timer.start();
+    for (unsigned int iteration = 0; iteration < iterationCount; ++iteration)
+    {
+        result.hitCount = TestRayBatchSphereIntersection(origin, direction, &x[0], &y[0], &z[0], &radii[0], sphereCount, &batchDistances[0]);
+    }
+    result.batchTime = timer.nsecsElapsed();
+
+    for (unsigned int i = 0; i < sphereCount; ++i)
+    {
+        bool batchHit = batchDistances[i] >= 0.0;
+        if (batchHit != singleHits[i])
+        {
+            result.mismatchCount++;
+        }
+        else if (batchHit)
+        {
+            result.maxError = std::max(result.maxError, std::abs(batchDistances[i] - singleDistances[i]) / singleDistances[i]);
+        }
+    }
+
+    return result;
+}
+
+
+static bool
+report(QTextStream& out, const char* name, const Comparison& result, unsigned int count, unsigned int iterationCount)
+{
+    double n = double(count) * iterationCount;
+    out << name << ": " << result.hitCount << " of " << count << " hit" << endl;
+    out << "    single: " << result.singleTime / n << " ns, batch: " << result.batchTime / n << " ns per test ("
+        << double(result.singleTime) / double(std::max(result.batchTime, qint64(1))) << "x)" << endl;
+    out << "    max relative difference: " << result.maxError << ", mismatched hits: " << result.mismatchCount << endl;
+
+    return result.mismatchCount == 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    unsigned int rayCount = 48;
+    unsigned int sphereCount = 500;
+    unsigned int iterationCount = 100000;
+
+    const char* usage = "usage: intersectbench [-rays <count>] [-spheres <count>] [-iterations <count>]";
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-rays" && i + 1 < args.size())
+        {
+            rayCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-spheres" && i + 1 < args.size())
+        {
+            sphereCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-iterations" && i + 1 < args.size())
+        {
+            iterationCount = qMax(1, args[++i].toInt());
+        }
+        else
+        {
+            err << "Unknown option " << args[i] << endl;
+            err << usage << endl;
+            return 1;
+        }
+    }
+
+    srand(1);
+
+    // A fan of rays from a sensor 1000 km above an oblate planet, wide enough
+    // that some of the rays miss the planet.
+    Vector3d semiAxes(6378.0, 6378.0, 6357.0);
+    Vector3d sensorPosition(0.0, 0.0, 7378.0);
+    std::vector<Vector3d> sensorRays;
+    std::vector<Vector3f> sensorRaysf;
+    for (unsigned int i = 0; i < rayCount; ++i)
+    {
+        double theta = 2.0 * PI * i / rayCount;
+        double tilt = toRadians(60.0) * (0.5 + 0.5 * randomValue());
+        Vector3d r = Vector3d(sin(tilt) * cos(theta), sin(tilt) * sin(theta), -cos(tilt));
+        sensorRays.push_back(r);
+        sensorRaysf.push_back(r.cast<float>());
+    }
+
+    // Rays in random directions from a point inside the planet
+    Vector3d insidePosition(1000.0, -2000.0, 500.0);
+    std::vector<Vector3d> insideRays;
+    for (unsigned int i = 0; i < rayCount; ++i)
+    {
+        insideRays.push_back(Vector3d(randomValue() - 0.5, randomValue() - 0.5, randomValue() - 0.5).normalized());
+    }
+
+    // A pick ray through a field of objects
+    Vector3d pickOrigin(0.0, 0.0, -100.0);
+    Vector3d pickDirection = Vector3d(0.05, 0.02, 1.0).normalized();
+    std::vector<Vector3d> centers;
+    std::vector<double> radii;
+    for (unsigned int i = 0; i < sphereCount; ++i)
+    {
+        centers.push_back(Vector3d(randomValue() - 0.5, randomValue() - 0.5, randomValue() - 0.5) * 100.0);
+        radii.push_back(0.5 + 4.0 * randomValue());
+    }
+
+    out << iterationCount << " iterations" << endl;
+
+    bool ok = true;
+    ok = report(out, "ellipsoid, outside origin", compareEllipsoid(sensorPosition, semiAxes, sensorRays, iterationCount), rayCount, iterationCount) && ok;
+    ok = report(out, "ellipsoid, inside origin", compareEllipsoid(insidePosition, semiAxes, insideRays, iterationCount), rayCount, iterationCount) && ok;
+    ok = report(out, "ellipsoid, single precision", compareEllipsoid(Vector3f(sensorPosition.cast<float>()), Vector3f(semiAxes.cast<float>()), sensorRaysf, iterationCount), rayCount, iterationCount) && ok;
+    ok = report(out, "spheres", compareSpheres(pickOrigin, pickDirection, centers, radii, iterationCount / 10), sphereCount, iterationCount / 10) && ok;
+
+    if (!ok)
+    {
+        err << "Batch and single ray results differ" << endl;
+    }
+
+    return ok ? 0 : 1;
+}
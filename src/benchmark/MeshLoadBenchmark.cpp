@@ -0,0 +1,546 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// meshbench: measure how quickly mesh files are decoded.
+//
+// usage: meshbench [-repeat <count>] [-threads <count>] [-optimize] [-cache] <mesh files...>
+//
+// Each file is read into memory once, so that the timings measure decoding
+// rather than disk bandwidth. CMOD files are loaded with both the block and
+// value-at-a-time readers. OBJ files are loaded with the stream parser and
+// with the chunked parser on one thread and on several threads. The results
+// of each reader are compared to verify that they produce identical
+// geometry. Throughput is reported in MB/s of file data.
+//
+// With -optimize, the load-time optimization steps are also timed. The
+// average cache miss ratio (ACMR) of each submesh is reported before and
+// after vertex cache optimization, along with the triangle count and
+// geometric error of each generated level of detail. Finally, the vertices
+// are quantized and the vertex memory before and after is reported.
+//
+// With -cache, the time to decode and optimize each mesh the way that
+// UniverseLoader does is compared with the time to load the optimized mesh
+// from the mesh cache. The cache is kept in a meshbench-cache directory under
+// the system temporary directory, and the cached mesh is checked against the
+// freshly optimized one.
+
+#include "../main/compatibility/CmodLoader.h"
+#include "../main/compatibility/ObjFileLoader.h"
+#include "../main/catalog/MeshCache.h"
+#include <vesta/internal/ObjLoader.h>
+#include <vesta/MeshGeometry.h>
+#include <vesta/Submesh.h>
+#include <vesta/PrimitiveBatch.h>
+#include <QCoreApplication>
+#include <QBuffer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <cstring>
+#include <sstream>
+
+using namespace vesta;
+
+
+static MeshGeometry*
+loadCmod(const QByteArray& data, bool blockReads, QString* errorMessage)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    CmodLoader loader(&buffer, NULL);
+    loader.setBlockReadsEnabled(blockReads);
+    MeshGeometry* mesh = loader.loadMesh();
+    if (!mesh && errorMessage)
+    {
+        *errorMessage = loader.errorMessage();
+    }
+
+    return mesh;
+}
+
+
+static unsigned int
+indexBytes(const PrimitiveBatch* batch)
+{
+    if (!batch->isIndexed())
+    {
+        return 0;
+    }
+
+    return batch->indexCount() * (batch->indexSize() == PrimitiveBatch::Index16 ? 2 : 4);
+}
+
+
+// Return true if two meshes have identical vertex and index data
+static bool
+sameGeometry(const MeshGeometry* a, const MeshGeometry* b)
+{
+    if (a->submeshCount() != b->submeshCount())
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < a->submeshCount(); ++i)
+    {
+        const Submesh* sa = a->submesh(i);
+        const Submesh* sb = b->submesh(i);
+
+        const VertexArray* va = sa->vertices();
+        const VertexArray* vb = sb->vertices();
+        if (va->count() != vb->count() || va->stride() != vb->stride() ||
+            memcmp(va->data(), vb->data(), va->count() * va->stride()) != 0)
+        {
+            return false;
+        }
+
+        if (sa->primitiveBatches().size() != sb->primitiveBatches().size())
+        {
+            return false;
+        }
+
+        for (unsigned int j = 0; j < sa->primitiveBatches().size(); ++j)
+        {
+            const PrimitiveBatch* ba = sa->primitiveBatches()[j];
+            const PrimitiveBatch* bb = sb->primitiveBatches()[j];
+            if (indexBytes(ba) != indexBytes(bb) ||
+                memcmp(ba->indexData(), bb->indexData(), indexBytes(ba)) != 0)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+// OBJ readers: 0 is the stream parser; otherwise, the chunked parser with
+// the specified number of threads.
+static MeshGeometry*
+loadObj(const QByteArray& data, unsigned int threadCount, QString* errorMessage)
+{
+    if (threadCount == 0)
+    {
+        std::istringstream in(std::string(data.constData(), data.size()));
+        ObjLoader loader;
+        MeshGeometry* mesh = loader.loadModel(in);
+        if (!mesh && errorMessage)
+        {
+            *errorMessage = QString::fromUtf8(loader.errorMessage().c_str());
+        }
+        return mesh;
+    }
+    else
+    {
+        ObjFileLoader loader(NULL);
+        loader.setThreadCount(threadCount);
+        MeshGeometry* mesh = loader.loadMesh(data.constData(), data.size(), QString());
+        if (!mesh && errorMessage)
+        {
+            *errorMessage = loader.errorMessage();
+        }
+        return mesh;
+    }
+}
+
+
+enum MeshFormat
+{
+    CmodFormat,
+    ObjFormat
+};
+
+
+// Load a mesh in the given format. For CMOD files, mode selects block (1) or
+// value (0) reads; for OBJ files, it is the loadObj thread count.
+static MeshGeometry*
+loadMesh(MeshFormat format, const QByteArray& data, unsigned int mode, QString* errorMessage)
+{
+    if (format == CmodFormat)
+    {
+        return loadCmod(data, mode != 0, errorMessage);
+    }
+    else
+    {
+        return loadObj(data, mode, errorMessage);
+    }
+}
+
+
+// Load the mesh repeatCount times and return the throughput in MB/s, or a
+// negative value if loading failed.
+static double
+throughput(MeshFormat format, const QByteArray& data, unsigned int mode, unsigned int repeatCount)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (unsigned int i = 0; i < repeatCount; ++i)
+    {
+        MeshGeometry* mesh = loadMesh(format, data, mode, NULL);
+        if (!mesh)
+        {
+            return -1.0;
+        }
+        delete mesh;
+    }
+
+    double seconds = timer.nsecsElapsed() * 1.0e-9;
+    return (double(data.size()) * repeatCount / (1024.0 * 1024.0)) / seconds;
+}
+
+
+// Run the optimization steps of UniverseLoader, without vertex quantization
+static void
+prepareMesh(MeshGeometry* mesh)
+{
+    mesh->mergeSubmeshes();
+    mesh->uniquifyVertices();
+    mesh->mergeMaterials();
+    mesh->optimizeVertexCache();
+    mesh->buildLevelsOfDetail();
+    mesh->compressIndices();
+}
+
+
+// Compare the time to decode and optimize a mesh with the time to load the
+// optimized mesh from the cache. Returns false if the mesh couldn't be
+// cached or the cached copy differs.
+static bool
+compareMeshCache(MeshFormat format, const QByteArray& data, unsigned int mode, const QString& fileName,
+                 unsigned int repeatCount, QTextStream& out)
+{
+    QElapsedTimer timer;
+    timer.start();
+    MeshGeometry* mesh = NULL;
+    for (unsigned int i = 0; i < repeatCount; ++i)
+    {
+        delete mesh;
+        mesh = loadMesh(format, data, mode, NULL);
+        if (!mesh)
+        {
+            return false;
+        }
+        prepareMesh(mesh);
+    }
+    double uncachedTime = timer.nsecsElapsed() * 1.0e-6 / repeatCount;
+
+    MeshCache cache(QDir::tempPath() + "/meshbench-cache");
+    if (!cache.store(fileName, mesh, "", false))
+    {
+        out << "    mesh cache: ERROR: couldn't write " << cache.cacheFileName(fileName, false) << endl;
+        delete mesh;
+        return false;
+    }
+
+    timer.start();
+    MeshGeometry* cached = NULL;
+    for (unsigned int i = 0; i < repeatCount; ++i)
+    {
+        delete cached;
+        cached = cache.load(fileName, NULL, false);
+        if (!cached)
+        {
+            break;
+        }
+    }
+    double cachedTime = timer.nsecsElapsed() * 1.0e-6 / repeatCount;
+
+    bool ok = cached && sameGeometry(mesh, cached);
+    if (ok)
+    {
+        out << "    load and optimize: " << QString::number(uncachedTime, 'f', 2) << " ms" << endl;
+        out << "    mesh cache load: " << QString::number(cachedTime, 'f', 2) << " ms ("
+            << QString::number(uncachedTime / cachedTime, 'f', 1) << "x, "
+            << QString::number(QFileInfo(cache.cacheFileName(fileName, false)).size() / 1024.0, 'f', 1) << " KB)" << endl;
+    }
+    else
+    {
+        out << "    mesh cache load: ERROR: cached mesh differs from the optimized mesh" << endl;
+    }
+
+    delete mesh;
+    delete cached;
+    return ok;
+}
+
+
+// Run the same optimization steps as UniverseLoader and report the time
+// taken by each.
+static void
+optimizeMesh(MeshGeometry* mesh, QTextStream& out)
+{
+    QElapsedTimer timer;
+
+    timer.start();
+    mesh->mergeSubmeshes();
+    out << "    merge submeshes: " << timer.nsecsElapsed() * 1.0e-6 << " ms" << endl;
+
+    unsigned int vertexCount = 0;
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        vertexCount += mesh->submesh(i)->vertices()->count();
+    }
+
+    timer.start();
+    mesh->uniquifyVertices();
+    out << "    weld vertices: " << timer.nsecsElapsed() * 1.0e-6 << " ms (" << vertexCount << " -> ";
+    vertexCount = 0;
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        vertexCount += mesh->submesh(i)->vertices()->count();
+    }
+    out << vertexCount << " vertices)" << endl;
+
+    timer.start();
+    mesh->mergeMaterials();
+    out << "    merge materials: " << timer.nsecsElapsed() * 1.0e-6 << " ms" << endl;
+
+    QList<float> acmrBefore;
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        acmrBefore << mesh->submesh(i)->averageCacheMissRatio();
+    }
+
+    timer.start();
+    mesh->optimizeVertexCache();
+    out << "    vertex cache optimization: " << timer.nsecsElapsed() * 1.0e-6 << " ms" << endl;
+
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        out << "        submesh " << i << ": ACMR "
+            << QString::number(acmrBefore[i], 'f', 3) << " -> "
+            << QString::number(mesh->submesh(i)->averageCacheMissRatio(), 'f', 3) << endl;
+    }
+
+    timer.start();
+    mesh->buildLevelsOfDetail();
+    out << "    level of detail generation: " << timer.nsecsElapsed() * 1.0e-6 << " ms" << endl;
+
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        const Submesh* submesh = mesh->submesh(i);
+        for (unsigned int level = 1; level < submesh->levelOfDetailCount(); ++level)
+        {
+            unsigned int triangleCount = 0;
+            for (unsigned int j = 0; j < submesh->primitiveBatchCount(); ++j)
+            {
+                const PrimitiveBatch* batch = submesh->levelOfDetailBatch(level, j);
+                if (batch->primitiveType() == PrimitiveBatch::Triangles)
+                {
+                    triangleCount += batch->primitiveCount();
+                }
+            }
+
+            out << "        submesh " << i << " level " << level << ": " << triangleCount << " triangles, error "
+                << submesh->levelOfDetailError(level) << endl;
+        }
+    }
+
+    mesh->compressIndices();
+
+    // Quantization is optional in UniverseLoader; measure it anyway
+    unsigned int vertexBytes = 0;
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        vertexBytes += mesh->submesh(i)->vertices()->count() * mesh->submesh(i)->vertices()->stride();
+    }
+
+    timer.start();
+    mesh->quantizeVertices();
+    out << "    vertex quantization: " << timer.nsecsElapsed() * 1.0e-6 << " ms (" << vertexBytes << " -> ";
+    vertexBytes = 0;
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        vertexBytes += mesh->submesh(i)->vertices()->count() * mesh->submesh(i)->vertices()->stride();
+    }
+    out << vertexBytes << " bytes)" << endl;
+
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        const VertexArray* vertices = mesh->submesh(i)->vertices();
+        out << "        submesh " << i << ": " << vertices->stride() << " bytes/vertex, position step "
+            << vertices->positionScale() << endl;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    unsigned int repeatCount = 5;
+    unsigned int threadCount = (unsigned int) qMax(1, QThread::idealThreadCount());
+    QStringList fileNames;
+
+    bool optimize = false;
+    bool compareCache = false;
+
+    const char* usage = "usage: meshbench [-repeat <count>] [-threads <count>] [-optimize] [-cache] <mesh files...>";
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-repeat" && i + 1 < args.size())
+        {
+            repeatCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-threads" && i + 1 < args.size())
+        {
+            threadCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-optimize")
+        {
+            optimize = true;
+        }
+        else if (args[i] == "-cache")
+        {
+            compareCache = true;
+        }
+        else if (args[i].startsWith("-"))
+        {
+            err << "Unknown option " << args[i] << endl;
+            err << usage << endl;
+            return 1;
+        }
+        else
+        {
+            fileNames << args[i];
+        }
+    }
+
+    if (fileNames.isEmpty())
+    {
+        err << usage << endl;
+        return 1;
+    }
+
+    bool ok = true;
+    foreach (QString fileName, fileNames)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            err << "Can't open " << fileName << endl;
+            ok = false;
+            continue;
+        }
+        QByteArray data = file.readAll();
+        file.close();
+
+        QString baseName = QFileInfo(fileName).fileName();
+        QString suffix = QFileInfo(fileName).suffix().toLower();
+
+        // Readers to compare; the first one is the baseline
+        MeshFormat format;
+        QList<unsigned int> modes;
+        QStringList modeNames;
+        if (suffix == "cmod")
+        {
+            format = CmodFormat;
+            modes << 0 << 1;
+            modeNames << "value reads" << "block reads";
+        }
+        else if (suffix == "obj")
+        {
+            format = ObjFormat;
+            modes << 0 << 1;
+            modeNames << "stream parser" << "chunked, 1 thread";
+            if (threadCount > 1)
+            {
+                modes << threadCount;
+                modeNames << QString("chunked, %1 threads").arg(threadCount);
+            }
+        }
+        else
+        {
+            err << baseName << ": unsupported mesh format" << endl;
+            ok = false;
+            continue;
+        }
+
+        out << baseName << ": " << QString::number(data.size() / 1024.0, 'f', 1) << " KB" << endl;
+
+        QString errorMessage;
+        MeshGeometry* baseline = loadMesh(format, data, modes[0], &errorMessage);
+        if (!baseline)
+        {
+            err << baseName << ": " << errorMessage << endl;
+            ok = false;
+            continue;
+        }
+
+        double baselineRate = 0.0;
+        for (int i = 0; i < modes.size(); ++i)
+        {
+            if (i > 0)
+            {
+                MeshGeometry* mesh = loadMesh(format, data, modes[i], &errorMessage);
+                if (!mesh)
+                {
+                    out << "    " << modeNames[i] << ": ERROR: " << errorMessage << endl;
+                    ok = false;
+                    continue;
+                }
+
+                bool match = sameGeometry(baseline, mesh);
+                delete mesh;
+                if (!match)
+                {
+                    out << "    " << modeNames[i] << ": ERROR: geometry differs from " << modeNames[0] << endl;
+                    ok = false;
+                    continue;
+                }
+            }
+
+            double rate = throughput(format, data, modes[i], repeatCount);
+            out << "    " << modeNames[i] << ": " << QString::number(rate, 'f', 1) << " MB/s";
+            if (i == 0)
+            {
+                baselineRate = rate;
+            }
+            else
+            {
+                out << " (" << QString::number(rate / baselineRate, 'f', 1) << "x)";
+            }
+            out << endl;
+        }
+
+        // The cache is compared with the fastest reader, which is the one
+        // that UniverseLoader uses.
+        if (compareCache && !compareMeshCache(format, data, modes.last(), fileName, repeatCount, out))
+        {
+            ok = false;
+        }
+
+        if (optimize)
+        {
+            optimizeMesh(baseline, out);
+        }
+
+        delete baseline;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,405 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// renderbench: draw a scripted camera flight through the loaded catalogs
+// without a window and report how long each stage of every frame took.
+//
+// usage: renderbench [-data <dir>] [-path <camera path>] [-o <output file>]
+//                    [-trace <trace file>] [-sync] [-logdepth] [catalog files...]
+//
+// The camera path format is described in src/offline/OfflineScene.h. Timings
+// are written as JSON: one record per frame with times in milliseconds,
+// followed by a summary of each stage. With -trace, a Chrome trace of the
+// instrumented scopes is also written.
+
+#include "../offline/OfflineScene.h"
+#include "../main/NetworkTextureLoader.h"
+#include "../main/catalog/UniverseCatalog.h"
+#include "../main/catalog/UniverseLoader.h"
+#include "../main/catalog/BuiltinModels.h"
+#include <vesta/OGLHeaders.h>
+#include <vesta/Universe.h>
+#include <vesta/UniverseRenderer.h>
+#include <vesta/LabelPlacement.h>
+#include <vesta/LightingEnvironment.h>
+#include <vesta/PlanarProjection.h>
+#include <vesta/TextureFont.h>
+#include <vesta/DataChunk.h>
+#include <vesta/Units.h>
+#include <vesta/Stopwatch.h>
+#include <vesta/Profiler.h>
+#include <qjson/serializer.h>
+#include <QApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Names of the per-frame stages, in the order that they're reported
+static const char* StageNames[] =
+{
+    "textureUpload",
+    "viewSetSetup",
+    "visibleItemScan",
+    "depthSplitting",
+    "drawing",
+    "labelPlacement",
+    "gpuFinish",
+    "total"
+};
+static const unsigned int StageCount = sizeof(StageNames) / sizeof(StageNames[0]);
+
+
+static void
+printUsage()
+{
+    QTextStream err(stderr);
+    err << "usage: renderbench [-data <dir>] [-path <camera path>] [-o <output file>] [-trace <trace file>] [-sync] [-logdepth] [catalog files...]\n";
+}
+
+
+static QVariantMap
+summarize(vector<double> samples)
+{
+    QVariantMap summary;
+    if (samples.empty())
+    {
+        return summary;
+    }
+
+    sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for (vector<double>::const_iterator iter = samples.begin(); iter != samples.end(); ++iter)
+    {
+        sum += *iter;
+    }
+
+    unsigned int n = samples.size();
+    summary["mean"] = sum / n;
+    summary["median"] = samples[n / 2];
+    summary["p95"] = samples[min(n - 1, (unsigned int) ceil(n * 0.95) - 1)];
+    summary["max"] = samples.back();
+
+    return summary;
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Don't require a window system
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+
+    QString dataPath = "data";
+    QString pathFileName;
+    QString outputFileName;
+    QString traceFileName;
+    bool synchronousTextures = false;
+    bool logDepth = false;
+    QStringList catalogFiles;
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-data" && i + 1 < args.size())
+        {
+            dataPath = args[++i];
+        }
+        else if (args[i] == "-path" && i + 1 < args.size())
+        {
+            pathFileName = QFileInfo(args[++i]).absoluteFilePath();
+        }
+        else if (args[i] == "-o" && i + 1 < args.size())
+        {
+            outputFileName = QFileInfo(args[++i]).absoluteFilePath();
+        }
+        else if (args[i] == "-trace" && i + 1 < args.size())
+        {
+            traceFileName = QFileInfo(args[++i]).absoluteFilePath();
+        }
+        else if (args[i] == "-sync")
+        {
+            synchronousTextures = true;
+        }
+        else if (args[i] == "-logdepth")
+        {
+            logDepth = true;
+        }
+        else if (args[i].startsWith("-"))
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            catalogFiles << QFileInfo(args[i]).absoluteFilePath();
+        }
+    }
+
+    CameraPath path;
+    if (pathFileName.isEmpty())
+    {
+        CameraKeyframe key;
+        key.center = "Earth";
+        key.distance = 50000.0;
+        key.longitude = 0.0;
+        key.latitude = 20.0;
+        path.keyframes << key;
+        key.longitude = 360.0;
+        path.keyframes << key;
+    }
+    else if (!LoadCameraPath(pathFileName, &path))
+    {
+        return 1;
+    }
+
+    if (!QDir::setCurrent(dataPath))
+    {
+        qWarning() << "Data directory " << dataPath << " not found.";
+        return 1;
+    }
+
+    if (catalogFiles.isEmpty())
+    {
+        catalogFiles << QFileInfo("solarsys.json").absoluteFilePath();
+    }
+
+    // Set up an offscreen OpenGL context. The renderer still relies on fixed
+    // function state, so request a compatibility profile.
+    QSurfaceFormat format;
+    format.setDepthBufferSize(24);
+    format.setProfile(QSurfaceFormat::CompatibilityProfile);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    if (!context.create() || !context.makeCurrent(&surface))
+    {
+        qCritical("Couldn't create an OpenGL context.");
+        return 1;
+    }
+
+    QOpenGLFramebufferObject fbo(path.width, path.height, QOpenGLFramebufferObject::CombinedDepthStencil);
+    fbo.bind();
+
+    UniverseRenderer* renderer = new UniverseRenderer();
+    renderer->setDefaultSunEnabled(false);
+    renderer->setLabelPlacement(new LabelPlacement());
+    if (!renderer->initializeGraphics())
+    {
+        qCritical("Creating renderer failed because OpenGL couldn't be initialized.");
+        return 1;
+    }
+
+    if (logDepth)
+    {
+        if (!renderer->logarithmicDepthSupported())
+        {
+            qWarning("Logarithmic depth isn't supported; using depth spans.");
+        }
+        renderer->setDepthStrategy(UniverseRenderer::LogarithmicDepth);
+    }
+
+    counted_ptr<TextureFont> labelFont(new TextureFont());
+    QFile labelFontFile("csans-14.txf");
+    if (labelFontFile.open(QIODevice::ReadOnly))
+    {
+        QByteArray data = labelFontFile.readAll();
+        DataChunk chunk(data.data(), data.size());
+        labelFont->loadTxf(&chunk);
+        renderer->setDefaultFont(labelFont.ptr());
+    }
+
+    // Load catalogs
+    NetworkTextureLoader* textureLoader = new NetworkTextureLoader(NULL, !synchronousTextures);
+    UniverseCatalog* catalog = new UniverseCatalog();
+    UniverseLoader* loader = new UniverseLoader();
+    loader->setTextureLoader(textureLoader);
+    AddBuiltinModels(loader);
+
+    if (!traceFileName.isEmpty())
+    {
+        Profiler::instance()->setTracingEnabled(true);
+    }
+
+    counted_ptr<Universe> universe(new Universe());
+
+    Stopwatch loadTimer;
+    foreach (QString fileName, catalogFiles)
+    {
+        LoadSceneCatalog(fileName, loader, catalog, universe.ptr(), labelFont.ptr());
+    }
+    double catalogLoadTime = loadTimer.elapsed();
+
+    Viewport viewport(path.width, path.height);
+    PlanarProjection projection = PlanarProjection::CreatePerspective(float(toRadians(path.fieldOfView)),
+                                                                      viewport.aspectRatio(),
+                                                                      UniverseRenderer::MinimumNearDistance,
+                                                                      UniverseRenderer::MaximumFarDistance);
+    LightingEnvironment lighting;
+
+    vector<double> stageSamples[StageCount];
+    QVariantList frames;
+
+    int totalFrames = path.warmupFrames + path.frameCount;
+    for (int frame = 0; frame < totalFrames; ++frame)
+    {
+        // The warm up frames are all drawn at the start of the path so that
+        // textures for the first view have a chance to load.
+        int pathFrame = max(0, frame - path.warmupFrames);
+        double t = path.frameTime(pathFrame);
+
+        // Deliver textures loaded by worker threads
+        app.processEvents();
+
+        Profiler::instance()->beginFrame();
+        Stopwatch frameTimer;
+
+        textureLoader->incrementFrameCount();
+        textureLoader->evictTextures();
+        textureLoader->realizeLoadedTextures();
+        double uploadTime = frameTimer.elapsed();
+
+        Vector3d cameraPosition;
+        Quaterniond cameraOrientation;
+        CameraPathState(universe.ptr(), path, pathFrame, &cameraPosition, &cameraOrientation);
+
+        glDepthMask(GL_TRUE);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+        renderer->beginViewSet(universe.ptr(), t);
+        renderer->renderView(&lighting, cameraPosition, cameraOrientation, projection, viewport);
+        renderer->endViewSet();
+
+        Stopwatch finishTimer;
+        glFinish();
+        double finishTime = finishTimer.elapsed();
+        double totalTime = frameTimer.elapsed();
+        Profiler::instance()->endFrame();
+
+        if (frame < path.warmupFrames)
+        {
+            continue;
+        }
+
+        const UniverseRenderer::RenderTimings& timings = renderer->viewSetTimings();
+        double stageTimes[StageCount] =
+        {
+            uploadTime,
+            timings.viewSetSetup,
+            timings.visibleItemScan,
+            timings.depthSplitting,
+            timings.drawing,
+            timings.labelPlacement,
+            finishTime,
+            totalTime
+        };
+
+        QVariantMap frameRecord;
+        frameRecord["frame"] = pathFrame;
+        frameRecord["time"] = t;
+        for (unsigned int i = 0; i < StageCount; ++i)
+        {
+            frameRecord[StageNames[i]] = stageTimes[i] * 1000.0;
+            stageSamples[i].push_back(stageTimes[i] * 1000.0);
+        }
+        frameRecord["entities"] = timings.entityCount;
+        frameRecord["visibleItems"] = timings.visibleItemCount;
+        frameRecord["depthSpans"] = timings.depthSpanCount;
+        frameRecord["depthPasses"] = timings.depthPassCount;
+        frameRecord["drawCalls"] = timings.drawCalls;
+        frameRecord["shaderSwitches"] = timings.shaderSwitches;
+        frameRecord["uniformUploads"] = timings.uniformUploads;
+        frameRecord["redundantUniforms"] = timings.redundantUniforms;
+        frameRecord["texturesUploaded"] = textureLoader->lastUploadCount();
+        frameRecord["textureUploadBytes"] = textureLoader->lastUploadBytes();
+        frameRecord["textureUploadTime"] = textureLoader->lastUploadTime();
+        frameRecord["textureUploadsPending"] = textureLoader->pendingUploadCount();
+        frames << frameRecord;
+    }
+
+    QVariantMap summary;
+    for (unsigned int i = 0; i < StageCount; ++i)
+    {
+        summary[StageNames[i]] = summarize(stageSamples[i]);
+    }
+
+    QVariantMap results;
+    results["width"] = path.width;
+    results["height"] = path.height;
+    results["frameCount"] = path.frameCount;
+    results["catalogLoadTime"] = catalogLoadTime * 1000.0;
+    results["renderer"] = QString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    results["logarithmicDepth"] = logDepth && renderer->logarithmicDepthSupported();
+    results["frames"] = frames;
+    results["summary"] = summary;
+
+    QJson::Serializer serializer;
+    serializer.setIndentMode(QJson::IndentMinimum);
+    QByteArray json = serializer.serialize(results);
+
+    if (outputFileName.isEmpty())
+    {
+        QTextStream out(stdout);
+        out << json << "\n";
+    }
+    else
+    {
+        QFile outputFile(outputFileName);
+        if (!outputFile.open(QIODevice::WriteOnly))
+        {
+            qCritical() << "Could not write to " << outputFileName;
+            return 1;
+        }
+        outputFile.write(json);
+    }
+
+    if (!traceFileName.isEmpty())
+    {
+        std::ofstream traceFile(QFile::encodeName(traceFileName).constData());
+        if (!Profiler::instance()->writeChromeTrace(traceFile))
+        {
+            qCritical() << "Could not write trace to " << traceFileName;
+        }
+    }
+
+    textureLoader->stop();
+    fbo.release();
+
+    return 0;
+}
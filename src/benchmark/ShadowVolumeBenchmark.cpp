@@ -0,0 +1,361 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// shadowbench: measure the cost of finding the eclipse shadows that affect
+// each visible object.
+//
+// usage: shadowbench [-asteroids <count>] [-moons <count>] [-frames <count>]
+//
+// The test scene is a solar system with eight planets, a number of moons
+// around each planet and a belt of asteroids, all of them ellipsoidal shadow
+// casters. For each of several camera views, the shadow volume set is built
+// and culled to the view frustum, and then every object inside the frustum is
+// tested for shadows, as the renderer does each frame. Timings are reported
+// with the shadow volume index enabled and disabled; both must find exactly
+// the same shadows.
+
+#include <vesta/internal/EclipseShadowVolumeSet.h>
+#include <vesta/Body.h>
+#include <vesta/Geometry.h>
+#include <vesta/PlanarProjection.h>
+#include <vesta/Units.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <vector>
+
+using namespace vesta;
+using namespace Eigen;
+
+
+// Minimal ellipsoidal geometry; the benchmark never renders anything.
+class EllipsoidShape : public Geometry
+{
+public:
+    EllipsoidShape(const Vector3d& semiAxes) :
+        m_semiAxes(semiAxes)
+    {
+        setShadowCaster(true);
+        setShadowReceiver(true);
+    }
+
+    void render(RenderContext& /* rc */, double /* clock */) const {}
+
+    float boundingSphereRadius() const
+    {
+        return float(m_semiAxes.maxCoeff());
+    }
+
+    bool isEllipsoidal() const
+    {
+        return true;
+    }
+
+    AlignedEllipsoid ellipsoid() const
+    {
+        return AlignedEllipsoid(m_semiAxes);
+    }
+
+private:
+    Vector3d m_semiAxes;
+};
+
+
+struct SceneObject
+{
+    Body* body;
+    Vector3d position;
+    double radius;
+};
+
+
+struct CameraView
+{
+    const char* name;
+    Vector3d position;
+    Quaterniond orientation;
+    double fovY;
+};
+
+
+static unsigned int randomSeed = 12345;
+
+static double
+randomValue()
+{
+    randomSeed = randomSeed * 1664525u + 1013904223u;
+    return (randomSeed >> 8) / double(1 << 24);
+}
+
+
+static double
+randomRange(double low, double high)
+{
+    return low + (high - low) * randomValue();
+}
+
+
+static void
+addObject(std::vector<SceneObject>& scene, const Vector3d& position, double radius)
+{
+    Body* body = new Body();
+    body->setGeometry(new EllipsoidShape(Vector3d(radius, radius, radius * 0.98)));
+    body->addRef();
+
+    SceneObject object;
+    object.body = body;
+    object.position = position;
+    object.radius = radius;
+    scene.push_back(object);
+}
+
+
+static Vector3d
+randomOrbitPosition(double distance, double maxInclination)
+{
+    double longitude = randomRange(0.0, 2.0 * PI);
+    double latitude = randomRange(-maxInclination, maxInclination);
+    return distance * Vector3d(cos(latitude) * cos(longitude), cos(latitude) * sin(longitude), sin(latitude));
+}
+
+
+// Orientation of a camera at the given position looking at a target. The
+// camera looks along its -z axis with +y toward the ecliptic north pole.
+static Quaterniond
+lookAt(const Vector3d& from, const Vector3d& target)
+{
+    Vector3d back = (from - target).normalized();
+    Vector3d right = Vector3d::UnitZ().cross(back).normalized();
+    Vector3d up = back.cross(right);
+
+    Matrix3d m;
+    m << right, up, back;
+    return Quaterniond(m);
+}
+
+
+struct ViewResult
+{
+    unsigned int receiverCount;
+    unsigned int shadowedCount;
+    unsigned int shadowCount;
+    double checksum;
+    qint64 buildTime;
+    qint64 cullTime;
+    qint64 queryTime;
+};
+
+
+static ViewResult
+runView(EclipseShadowVolumeSet* shadows,
+        const std::vector<SceneObject>& scene,
+        const CameraView& view,
+        double sunRadius,
+        unsigned int frameCount)
+{
+    PlanarProjection projection = PlanarProjection::CreatePerspective(float(view.fovY), 16.0f / 9.0f, 1.0f, 1.0e12f);
+    Frustum frustum = projection.frustum();
+    Matrix3d toCamera = view.orientation.conjugate().toRotationMatrix();
+
+    ViewResult result;
+    result.receiverCount = 0;
+    result.shadowedCount = 0;
+    result.shadowCount = 0;
+    result.checksum = 0.0;
+    result.buildTime = 0;
+    result.cullTime = 0;
+    result.queryTime = 0;
+
+    QElapsedTimer timer;
+    for (unsigned int frame = 0; frame < frameCount; ++frame)
+    {
+        timer.start();
+        shadows->clear();
+        for (unsigned int i = 0; i < scene.size(); ++i)
+        {
+            shadows->addShadow(scene[i].body, scene[i].position, Quaternionf::Identity(), Vector3d::Zero(), sunRadius);
+        }
+        result.buildTime += timer.nsecsElapsed();
+
+        timer.start();
+        shadows->frustumCull(projection, view.position, view.orientation);
+        result.cullTime += timer.nsecsElapsed();
+
+        for (unsigned int i = 0; i < scene.size(); ++i)
+        {
+            Vector3f cameraSpacePosition = (toCamera * (scene[i].position - view.position)).cast<float>();
+            if (!frustum.intersects(BoundingSphere<float>(cameraSpacePosition, float(scene[i].radius))))
+            {
+                continue;
+            }
+
+            timer.start();
+            bool shadowed = shadows->findIntersectingShadows(scene[i].body, scene[i].position, scene[i].radius);
+            result.queryTime += timer.nsecsElapsed();
+
+            if (frame == 0)
+            {
+                result.receiverCount++;
+                if (shadowed)
+                {
+                    result.shadowedCount++;
+                    const EclipseShadowVolumeSet::EclipseShadowVector& found = shadows->intersectingShadows();
+                    result.shadowCount += (unsigned int) found.size();
+                    for (unsigned int j = 0; j < found.size(); ++j)
+                    {
+                        result.checksum += (i + 1) * (j + 1) * found[j].position.norm();
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    unsigned int asteroidCount = 400;
+    unsigned int moonCount = 8;
+    unsigned int frameCount = 200;
+
+    const char* usage = "usage: shadowbench [-asteroids <count>] [-moons <count>] [-frames <count>]";
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-asteroids" && i + 1 < args.size())
+        {
+            asteroidCount = qMax(0, args[++i].toInt());
+        }
+        else if (args[i] == "-moons" && i + 1 < args.size())
+        {
+            moonCount = qMax(0, args[++i].toInt());
+        }
+        else if (args[i] == "-frames" && i + 1 < args.size())
+        {
+            frameCount = qMax(1, args[++i].toInt());
+        }
+        else
+        {
+            err << "Unknown option " << args[i] << endl;
+            err << usage << endl;
+            return 1;
+        }
+    }
+
+    const double au = 1.496e8;
+    const double sunRadius = 695500.0;
+    const double planetDistances[] = { 0.39, 0.72, 1.0, 1.52, 5.2, 9.54, 19.2, 30.1 };
+    const double planetRadii[] = { 2440.0, 6052.0, 6378.0, 3396.0, 71492.0, 60268.0, 25559.0, 24764.0 };
+
+    std::vector<SceneObject> scene;
+    std::vector<Vector3d> planetPositions;
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        Vector3d planetPosition = randomOrbitPosition(planetDistances[i] * au, toRadians(3.0));
+        planetPositions.push_back(planetPosition);
+        addObject(scene, planetPosition, planetRadii[i]);
+
+        // Every fourth moon is placed behind its planet so that some objects
+        // are actually eclipsed.
+        for (unsigned int j = 0; j < moonCount; ++j)
+        {
+            double moonDistance = planetRadii[i] * randomRange(3.0, 60.0);
+            Vector3d moonPosition;
+            if (j % 4 == 0)
+            {
+                Vector3d offset = Vector3d(randomRange(-0.5, 0.5), randomRange(-0.5, 0.5), randomRange(-0.5, 0.5)) * planetRadii[i];
+                moonPosition = planetPosition + planetPosition.normalized() * moonDistance + offset;
+            }
+            else
+            {
+                moonPosition = planetPosition + randomOrbitPosition(moonDistance, toRadians(10.0));
+            }
+            addObject(scene, moonPosition, randomRange(5.0, 0.3 * planetRadii[i]));
+        }
+    }
+
+    for (unsigned int i = 0; i < asteroidCount; ++i)
+    {
+        addObject(scene, randomOrbitPosition(randomRange(2.2, 3.3) * au, toRadians(15.0)), randomRange(1.0, 500.0));
+    }
+
+    // Camera close to Jupiter looking at the planet from the side, so that the
+    // view contains its shadow and some of its moons but not the Sun.
+    Vector3d jupiter = planetPositions[4];
+    Vector3d jupiterCamera = jupiter + Vector3d::UnitZ().cross(jupiter).normalized() * (120.0 * planetRadii[4]);
+
+    // Camera in the asteroid belt looking along the orbit
+    Vector3d beltCamera = randomOrbitPosition(2.7 * au, 0.0);
+    Vector3d beltTarget = AngleAxisd(toRadians(30.0), Vector3d::UnitZ()) * beltCamera;
+
+    CameraView views[3];
+    views[0].name = "Jupiter close-up";
+    views[0].position = jupiterCamera;
+    views[0].orientation = lookAt(jupiterCamera, jupiter);
+    views[0].fovY = toRadians(50.0);
+    views[1].name = "asteroid belt";
+    views[1].position = beltCamera;
+    views[1].orientation = lookAt(beltCamera, beltTarget);
+    views[1].fovY = toRadians(40.0);
+    views[2].name = "whole system";
+    views[2].position = Vector3d(0.0, -3.0 * au, 40.0 * au);
+    views[2].orientation = lookAt(views[2].position, Vector3d::Zero());
+    views[2].fovY = toRadians(90.0);
+
+    out << scene.size() << " shadow casters, " << frameCount << " frames per view" << endl;
+
+    counted_ptr<EclipseShadowVolumeSet> shadows(new EclipseShadowVolumeSet());
+
+    bool mismatch = false;
+    for (unsigned int v = 0; v < sizeof(views) / sizeof(views[0]); ++v)
+    {
+        shadows->setIndexEnabled(false);
+        ViewResult linear = runView(shadows.ptr(), scene, views[v], sunRadius, frameCount);
+        shadows->setIndexEnabled(true);
+        ViewResult indexed = runView(shadows.ptr(), scene, views[v], sunRadius, frameCount);
+
+        out << views[v].name << ": " << shadows->frustumShadowCount() << " of " << shadows->shadowCount()
+            << " shadow volumes in frustum, " << indexed.receiverCount << " receivers, "
+            << indexed.shadowedCount << " shadowed, " << indexed.shadowCount << " shadows found" << endl;
+
+        double frames = double(frameCount);
+        out << "    add shadows: " << indexed.buildTime / frames / 1000.0 << " us per frame" << endl;
+        out << "    frustum cull: " << linear.cullTime / frames / 1000.0 << " us per frame without index, "
+            << indexed.cullTime / frames / 1000.0 << " us with index" << endl;
+        out << "    shadow queries: " << linear.queryTime / frames / 1000.0 << " us per frame without index, "
+            << indexed.queryTime / frames / 1000.0 << " us with index" << endl;
+
+        if (linear.receiverCount != indexed.receiverCount ||
+            linear.shadowedCount != indexed.shadowedCount ||
+            linear.shadowCount != indexed.shadowCount ||
+            linear.checksum != indexed.checksum)
+        {
+            err << "    indexed and linear results differ" << endl;
+            mismatch = true;
+        }
+    }
+
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,343 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// tilesoak: pan over a synthetic tile pyramid for many frames and check that
+// the tile cache and texture loader stay bounded.
+//
+// usage: tilesoak [-frames <count>] [-levels <count>] [-view <tiles>] [-tilesize <pixels>]
+//                 [-memory <MB>] [-maxtiles <count>] [-missinglifetime <frames>]
+//
+// Each frame requests a square window of tiles from a HierarchicalTiledMap,
+// moving the window east and slowly zooming in and out, and then evicts
+// textures the way NetworkTextureLoader does. About one tile in eight
+// doesn't exist, so the missing tile entries are exercised as well. Tiles are
+// uploaded as real textures in an offscreen OpenGL context.
+//
+// After every frame the following are checked:
+//   - the tile cache and missing tile counts are within their limits
+//   - the loader's texture table contains only cached or resident textures
+//   - the tracked texture memory total matches the resident textures
+//   - every tile request returned a texture
+// The frame times of the first and last quarters of the run are reported so
+// that growth in per-frame cost can be seen.
+
+#include <vesta/OGLHeaders.h>
+#include <vesta/HierarchicalTiledMap.h>
+#include <vesta/TextureMapLoader.h>
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+using namespace vesta;
+using namespace std;
+
+
+// Loader that creates each tile texture immediately from a fixed image
+class SoakTextureLoader : public TextureMapLoader
+{
+public:
+    SoakTextureLoader(unsigned int tileSize) :
+        m_tileSize(tileSize),
+        m_image(tileSize * tileSize * 4, 0x80),
+        m_loadCount(0)
+    {
+    }
+
+    bool handleMakeResident(TextureMap* texture)
+    {
+        ++m_loadCount;
+        return texture->generate(&m_image[0], m_image.size(), m_tileSize, m_tileSize, TextureMap::R8G8B8A8);
+    }
+
+    unsigned int loadCount() const
+    {
+        return m_loadCount;
+    }
+
+private:
+    unsigned int m_tileSize;
+    vector<unsigned char> m_image;
+    unsigned int m_loadCount;
+};
+
+
+// Tile pyramid with a pseudorandom eighth of the tiles below level 2 missing
+class SoakTiledMap : public HierarchicalTiledMap
+{
+public:
+    SoakTiledMap(TextureMapLoader* loader, unsigned int tileSize, unsigned int levelCount) :
+        HierarchicalTiledMap(loader, tileSize),
+        m_levelCount(levelCount)
+    {
+    }
+
+    string tileResourceIdentifier(unsigned int level, unsigned int column, unsigned int row)
+    {
+        ostringstream str;
+        str << "tile-" << level << "-" << column << "-" << row;
+        return str.str();
+    }
+
+    bool isValidTileAddress(unsigned int level, unsigned int column, unsigned int row)
+    {
+        return level < m_levelCount && column < (2u << level) && row < (1u << level);
+    }
+
+    bool tileResourceExists(const string& resourceId)
+    {
+        unsigned int hash = 2166136261u;
+        for (unsigned int i = 0; i < resourceId.size(); ++i)
+        {
+            hash = (hash ^ (unsigned char) resourceId[i]) * 16777619u;
+        }
+
+        return resourceId.compare(0, 7, "tile-0-") == 0 ||
+               resourceId.compare(0, 7, "tile-1-") == 0 ||
+               (hash >> 8) % 8 != 0;
+    }
+
+private:
+    unsigned int m_levelCount;
+};
+
+
+struct FrameStats
+{
+    FrameStats() : frameCount(0), totalTime(0), maxTime(0) {}
+
+    void add(qint64 t)
+    {
+        ++frameCount;
+        totalTime += t;
+        maxTime = max(maxTime, t);
+    }
+
+    unsigned int frameCount;
+    qint64 totalTime;
+    qint64 maxTime;
+};
+
+
+static void
+reportStats(QTextStream& out, const char* name, const FrameStats& stats)
+{
+    out << name << ": " << stats.totalTime / double(max(stats.frameCount, 1u)) / 1000.0 << " us average, "
+        << stats.maxTime / 1000.0 << " us maximum per frame" << endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    unsigned int frameCount = 20000;
+    unsigned int levelCount = 12;
+    unsigned int viewTiles = 8;
+    unsigned int tileSize = 64;
+    unsigned int memoryLimit = 16;
+    unsigned int maxTiles = 1024;
+    unsigned int missingTileLifetime = 600;
+
+    const char* usage = "usage: tilesoak [-frames <count>] [-levels <count>] [-view <tiles>] [-tilesize <pixels>]\n"
+                        "                [-memory <MB>] [-maxtiles <count>] [-missinglifetime <frames>]";
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-frames" && i + 1 < args.size())
+        {
+            frameCount = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-levels" && i + 1 < args.size())
+        {
+            levelCount = qBound(1, args[++i].toInt(), 20);
+        }
+        else if (args[i] == "-view" && i + 1 < args.size())
+        {
+            viewTiles = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-tilesize" && i + 1 < args.size())
+        {
+            tileSize = qBound(1, args[++i].toInt(), 1024);
+        }
+        else if (args[i] == "-memory" && i + 1 < args.size())
+        {
+            memoryLimit = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-maxtiles" && i + 1 < args.size())
+        {
+            maxTiles = qMax(1, args[++i].toInt());
+        }
+        else if (args[i] == "-missinglifetime" && i + 1 < args.size())
+        {
+            missingTileLifetime = qMax(0, args[++i].toInt());
+        }
+        else
+        {
+            err << "Unknown option " << args[i] << endl;
+            err << usage << endl;
+            return 1;
+        }
+    }
+
+    QOpenGLContext context;
+    QOffscreenSurface surface;
+    surface.create();
+    if (!context.create() || !context.makeCurrent(&surface))
+    {
+        err << "Couldn't create an OpenGL context." << endl;
+        return 1;
+    }
+    glewInit();
+
+    counted_ptr<SoakTextureLoader> loader(new SoakTextureLoader(tileSize));
+    counted_ptr<SoakTiledMap> map(new SoakTiledMap(loader.ptr(), tileSize, levelCount));
+    map->setMaxCachedTiles(maxTiles);
+    map->setMaxMissingTiles(maxTiles);
+    map->setMissingTileLifetime(missingTileLifetime);
+
+    // Same policy as NetworkTextureLoader::evictTextures()
+    const v_uint64 limit = v_uint64(memoryLimit) * 1024 * 1024;
+    const v_uint64 targetFootprint = limit * 2 / 3;
+
+    unsigned int minLevel = levelCount > 4 ? levelCount - 4 : 0;
+    unsigned int levelSpan = levelCount - minLevel;
+
+    FrameStats firstQuarter;
+    FrameStats lastQuarter;
+    FrameStats evictStats;
+    unsigned int tileMemory = 0;
+    unsigned int maxTextureCount = 0;
+    unsigned int maxMissingCount = 0;
+    v_uint64 maxMemoryUsed = 0;
+    unsigned int failureCount = 0;
+
+    QElapsedTimer timer;
+    for (unsigned int frame = 0; frame < frameCount && failureCount < 10; ++frame)
+    {
+        // Zoom through the levels, spending 250 frames on each, while moving
+        // east by a quarter of the view each frame.
+        unsigned int step = (frame / 250) % (2 * levelSpan);
+        unsigned int level = minLevel + (step < levelSpan ? step : 2 * levelSpan - 1 - step);
+        unsigned int columns = 2u << level;
+        unsigned int rows = 1u << level;
+        unsigned int x0 = (frame * max(1u, viewTiles / 4)) % columns;
+        unsigned int y0 = rows > viewTiles ? (rows - viewTiles) / 2 : 0;
+
+        unsigned int unresolvedCount = 0;
+
+        timer.start();
+        for (unsigned int y = y0; y < min(rows, y0 + viewTiles); ++y)
+        {
+            for (unsigned int i = 0; i < viewTiles; ++i)
+            {
+                if (map->tile(level, (x0 + i) % columns, y).texture == NULL)
+                {
+                    ++unresolvedCount;
+                }
+            }
+        }
+        qint64 tileTime = timer.nsecsElapsed();
+
+        timer.start();
+        loader->incrementFrameCount();
+        if (loader->textureMemoryUsed() > limit)
+        {
+            loader->evictTextures(targetFootprint, loader->frameCount() - 8);
+        }
+        qint64 evictTime = timer.nsecsElapsed();
+
+        evictStats.add(evictTime);
+        if (frame < frameCount / 4)
+        {
+            firstQuarter.add(tileTime + evictTime);
+        }
+        else if (frame >= frameCount - frameCount / 4)
+        {
+            lastQuarter.add(tileTime + evictTime);
+        }
+
+        // All tiles are the same size, so the tracked total must be a multiple
+        // of the resident texture count.
+        if (tileMemory == 0 && loader->residentTextureCount() > 0)
+        {
+            tileMemory = (unsigned int) (loader->textureMemoryUsed() / loader->residentTextureCount());
+        }
+
+        maxTextureCount = max(maxTextureCount, loader->textureCount());
+        maxMissingCount = max(maxMissingCount, map->missingTileCount());
+        maxMemoryUsed = max(maxMemoryUsed, loader->textureMemoryUsed());
+
+        bool ok = true;
+        if (map->cachedTileCount() > map->maxCachedTiles() || map->missingTileCount() > map->maxMissingTiles())
+        {
+            err << "frame " << frame << ": tile cache limit exceeded, " << map->cachedTileCount() << " tiles, "
+                << map->missingTileCount() << " missing" << endl;
+            ok = false;
+        }
+        if (loader->textureCount() > map->cachedTileCount() + loader->residentTextureCount())
+        {
+            err << "frame " << frame << ": loader holds " << loader->textureCount() << " textures, but only "
+                << map->cachedTileCount() << " are cached and " << loader->residentTextureCount() << " resident" << endl;
+            ok = false;
+        }
+        if (loader->textureMemoryUsed() != v_uint64(tileMemory) * loader->residentTextureCount())
+        {
+            err << "frame " << frame << ": tracked texture memory " << loader->textureMemoryUsed() << " doesn't match "
+                << loader->residentTextureCount() << " resident textures" << endl;
+            ok = false;
+        }
+        if (unresolvedCount > 0)
+        {
+            err << "frame " << frame << ": " << unresolvedCount << " tiles without a texture" << endl;
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            ++failureCount;
+        }
+    }
+
+    out << frameCount << " frames, " << levelCount << " levels, " << viewTiles << "x" << viewTiles << " tile view" << endl;
+    out << loader->loadCount() << " tile loads, " << map->cachedTileCount() << " tiles cached at end (limit "
+        << map->maxCachedTiles() << ")" << endl;
+    out << "at most " << maxTextureCount << " textures in the loader, " << maxMissingCount << " missing tiles remembered" << endl;
+    out << "peak texture memory " << maxMemoryUsed / (1024.0 * 1024.0) << " MB (limit " << memoryLimit << " MB)" << endl;
+    reportStats(out, "first quarter", firstQuarter);
+    reportStats(out, "last quarter", lastQuarter);
+    reportStats(out, "eviction", evictStats);
+
+    // Tear down with the context still current so that textures are deleted
+    map = NULL;
+    loader = NULL;
+
+    if (failureCount > 0)
+    {
+        err << "Tile cache checks failed" << endl;
+    }
+
+    return failureCount > 0 ? 1 : 0;
+}
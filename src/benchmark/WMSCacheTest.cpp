@@ -0,0 +1,525 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// wmscachetest: run WMSRequester and its tile cache against a local HTTP
+// server standing in for a WMS server.
+//
+// usage: wmscachetest [-timeout <milliseconds>]
+//
+// The test runs in four stages:
+//   fetch    - tiles are requested from the server, composited, and stored
+//              in the tile cache; files left by older versions are removed
+//   reuse    - a new requester delivers the same tiles from the cache without
+//              sending any requests
+//   errors   - HTTP errors, bad images, and truncated replies are reported
+//              as failures, are never delivered or cached, and are requested
+//              again the next time
+//   eviction - lowering the cache size limit deletes the least recently used
+//              tiles, and the limit holds as new tiles are stored
+// The tile cache is placed in Qt's test mode cache location and is deleted
+// when the test finishes. The exit status is nonzero if any check fails.
+
+#include "WMSCacheTest.h"
+#include "../main/WMSRequester.h"
+#include <vesta/CountedPtr.h>
+#include <QCoreApplication>
+#include <QBuffer>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QNetworkProxy>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QUrl>
+#include <QUrlQuery>
+#include <cstdlib>
+
+using namespace vesta;
+
+
+// Size of the texture tiles and of the images from the stand-in server. With
+// the surface definitions used here, each tile needs exactly one WMS image.
+static const unsigned int TileSize = 512;
+
+
+StandInWmsServer::StandInWmsServer(QObject* parent) :
+    QTcpServer(parent),
+    m_malformedRequestCount(0)
+{
+    connect(this, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+}
+
+
+/** Get the base of the GetMap request URL for a layer, suitable for
+  * WMSRequester::addSurfaceDefinition(). The server must be listening.
+  */
+QString
+StandInWmsServer::requestBase(const QString& layer) const
+{
+    return QString("http://127.0.0.1:%1/wms?request=GetMap&layers=%2&srs=EPSG:4326&format=image/png").arg(serverPort()).arg(layer);
+}
+
+
+/** Get the color of the image returned for the bounding box with the specified
+  * lower left corner.
+  */
+QRgb
+StandInWmsServer::tileColor(double west, double south)
+{
+    return qRgb(int(west + 180.0) % 256, int(south + 90.0) % 256, 200);
+}
+
+
+void
+StandInWmsServer::acceptConnection()
+{
+    while (hasPendingConnections())
+    {
+        QTcpSocket* socket = nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+
+void
+StandInWmsServer::readRequest()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket)
+    {
+        return;
+    }
+
+    // Wait until all of the headers have arrived; GET requests have no body
+    QByteArray& data = m_requestData[socket];
+    data += socket->readAll();
+    if (!data.contains("\r\n\r\n"))
+    {
+        return;
+    }
+
+    QByteArray requestLine = data.left(data.indexOf("\r\n"));
+    m_requestData.remove(socket);
+
+    respond(socket, requestLine);
+}
+
+
+void
+StandInWmsServer::respond(QTcpSocket* socket, const QByteArray& requestLine)
+{
+    QList<QByteArray> parts = requestLine.split(' ');
+    QUrl url;
+    if (parts.size() == 3 && parts[0] == "GET")
+    {
+        url = QUrl::fromEncoded("http://127.0.0.1" + parts[1]);
+    }
+
+    QUrlQuery query(url);
+    QString layer = query.queryItemValue("layers");
+    QStringList bbox = query.queryItemValue("bbox").split(",");
+
+    bool widthOk = false;
+    bool heightOk = false;
+    bool westOk = false;
+    bool southOk = false;
+    int width = query.queryItemValue("width").toInt(&widthOk);
+    int height = query.queryItemValue("height").toInt(&heightOk);
+    double west = bbox.size() == 4 ? bbox[0].toDouble(&westOk) : 0.0;
+    double south = bbox.size() == 4 ? bbox[1].toDouble(&southOk) : 0.0;
+
+    if (!widthOk || !heightOk || !westOk || !southOk || width <= 0 || height <= 0 || layer.isEmpty())
+    {
+        ++m_malformedRequestCount;
+        sendResponse(socket, 400, "Bad Request", "text/plain", "Bad request", -1);
+        return;
+    }
+
+    m_requestCounts[layer]++;
+
+    if (layer == "good" || layer == "truncated")
+    {
+        QImage image(width, height, QImage::Format_RGB32);
+        image.fill(tileColor(west, south));
+
+        QByteArray png;
+        QBuffer buffer(&png);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+
+        sendResponse(socket, 200, "OK", "image/png", png, layer == "truncated" ? png.size() / 2 : -1);
+    }
+    else if (layer == "error500")
+    {
+        sendResponse(socket, 500, "Internal Server Error", "text/plain", "Server error", -1);
+    }
+    else if (layer == "badimage")
+    {
+        sendResponse(socket, 200, "OK", "image/png", "This is not an image", -1);
+    }
+    else
+    {
+        sendResponse(socket, 404, "Not Found", "text/plain", "Unknown layer", -1);
+    }
+}
+
+
+// Send a response and close the connection. If sentLength isn't negative, only
+// that many bytes of the body are sent, though the Content-Length header gives
+// the full size.
+void
+StandInWmsServer::sendResponse(QTcpSocket* socket, int status, const char* reason, const char* contentType,
+                               const QByteArray& body, int sentLength)
+{
+    QString header = QString("HTTP/1.1 %1 %2\r\n"
+                             "Content-Type: %3\r\n"
+                             "Content-Length: %4\r\n"
+                             "Cache-Control: no-store\r\n"
+                             "Connection: close\r\n"
+                             "\r\n").arg(status).arg(reason).arg(contentType).arg(body.size());
+
+    socket->write(header.toLatin1());
+    socket->write(sentLength < 0 ? body : body.left(sentLength));
+    socket->disconnectFromHost();
+}
+
+
+struct TileAddress
+{
+    unsigned int level;
+    unsigned int x;
+    unsigned int y;
+};
+
+
+static QString
+tileName(const QString& surface, const TileAddress& tile)
+{
+    return QString("%1,%2,%3,%4").arg(surface).arg(tile.level).arg(tile.x).arg(tile.y);
+}
+
+
+// Get the longitude/latitude rectangle of a tile, computed the same way as
+// in NetworkTextureLoader.
+static QRectF
+tileRect(const TileAddress& tile)
+{
+    double tileExtent = 180.0 / double(1 << tile.level);
+    return QRectF(-180.0 + tile.x * tileExtent, -90.0 + tile.y * tileExtent, tileExtent, tileExtent);
+}
+
+
+static WMSRequester*
+createRequester(const StandInWmsServer& server, const QStringList& layers, TileCollector* collector)
+{
+    WMSRequester* requester = new WMSRequester(NULL);
+    foreach (QString layer, layers)
+    {
+        requester->addSurfaceDefinition(layer, server.requestBase(layer),
+                                        WMSRequester::LatLongBoundingBox(-180.0, -90.0, 0.0, 90.0),
+                                        TileSize, TileSize);
+    }
+
+    QObject::connect(requester, SIGNAL(imageCompleted(const QString&, const QImage&)),
+                     collector, SLOT(tileCompleted(const QString&, const QImage&)));
+    QObject::connect(requester, SIGNAL(tileCancelled(const QString&)),
+                     collector, SLOT(tileCancelled(const QString&)));
+    QObject::connect(requester, SIGNAL(tileFailed(const QString&)),
+                     collector, SLOT(tileFailed(const QString&)));
+
+    return requester;
+}
+
+
+// Request a tile in the same way as NetworkTextureLoader. The requester
+// only uses the texture to prioritize requests, so it's kept in a list that
+// outlives the requests.
+static void
+requestTile(WMSRequester* requester, const QString& surface, const TileAddress& tile, QList<counted_ptr<TextureMap> >* textures)
+{
+    QString name = tileName(surface, tile);
+    counted_ptr<TextureMap> texture(new TextureMap(("wms:" + name).toUtf8().data(), NULL));
+    textures->append(texture);
+
+    requester->retrieveTile(name, surface, tileRect(tile), TileSize, texture.ptr());
+}
+
+
+// Process events until the requester has no outstanding requests and at
+// least the expected number of tiles has been delivered.
+static bool
+waitForTiles(WMSRequester* requester, const TileCollector& collector, int expectedCount, int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (requester->pendingTileCount() > 0 || collector.completedTiles().size() < expectedCount)
+    {
+        if (timer.elapsed() > timeout)
+        {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents | QEventLoop::WaitForMoreEvents, 50);
+    }
+
+    return true;
+}
+
+
+// Check that a delivered tile has the right size and the color of the server
+// image. Tiles are delivered with red and blue swapped, ready to be used as
+// textures.
+static bool
+isExpectedTile(const QImage& image, const TileAddress& tile)
+{
+    if (image.width() != int(TileSize) || image.height() != int(TileSize))
+    {
+        return false;
+    }
+
+    QRectF rect = tileRect(tile);
+    QRgb expected = StandInWmsServer::tileColor(rect.x(), rect.y());
+    QRgb center = image.pixel(TileSize / 2, TileSize / 2);
+
+    return abs(qRed(center) - qBlue(expected)) <= 2 &&
+           abs(qGreen(center) - qGreen(expected)) <= 2 &&
+           abs(qBlue(center) - qRed(expected)) <= 2;
+}
+
+
+static unsigned int
+countFiles(const QString& directory)
+{
+    unsigned int count = 0;
+    QDirIterator iter(directory, QDir::Files, QDirIterator::Subdirectories);
+    while (iter.hasNext())
+    {
+        iter.next();
+        ++count;
+    }
+
+    return count;
+}
+
+
+static unsigned int failureCount = 0;
+
+static void
+check(QTextStream& err, bool condition, const QString& description)
+{
+    if (!condition)
+    {
+        err << "FAILED: " << description << endl;
+        ++failureCount;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("wmscachetest");
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    int timeout = 10000;
+
+    const char* usage = "usage: wmscachetest [-timeout <milliseconds>]";
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        if (args[i] == "-timeout" && i + 1 < args.size())
+        {
+            timeout = qMax(1, args[++i].toInt());
+        }
+        else
+        {
+            err << "Unknown option " << args[i] << endl;
+            err << usage << endl;
+            return 1;
+        }
+    }
+
+    // Keep the tile cache away from the user's real cache, and make sure that
+    // requests to the local server don't go through a proxy.
+    QStandardPaths::setTestModeEnabled(true);
+    QNetworkProxy::setApplicationProxy(QNetworkProxy(QNetworkProxy::NoProxy));
+
+    StandInWmsServer server;
+    if (!server.listen(QHostAddress::LocalHost))
+    {
+        err << "Couldn't start the HTTP server: " << server.errorString() << endl;
+        return 1;
+    }
+
+    QStringList errorLayers;
+    errorLayers << "error500" << "notfound" << "badimage" << "truncated";
+    QStringList layers;
+    layers << "good" << errorLayers;
+
+    QList<TileAddress> tiles;
+    for (unsigned int level = 0; level < 3; ++level)
+    {
+        for (unsigned int y = 0; y < (1u << level); ++y)
+        {
+            for (unsigned int x = 0; x < (2u << level); x += level + 1)
+            {
+                TileAddress tile = { level, x, y };
+                tiles << tile;
+            }
+        }
+    }
+    int tileCount = tiles.size();
+
+    QList<counted_ptr<TextureMap> > textures;
+    TileCollector collector;
+    QMap<QString, QImage> fetchedTiles;
+
+    WMSRequester* requester = createRequester(server, layers, &collector);
+    QString cacheDirectory = requester->tileCache()->directory();
+    QDir(cacheDirectory).removeRecursively();
+
+    // Leave files in the cache like the ones written by older versions; the
+    // cache should delete them when it's first used.
+    QDir().mkpath(cacheDirectory + "/good/0");
+    QImage legacyTile(TileSize, TileSize, QImage::Format_RGB32);
+    legacyTile.fill(Qt::gray);
+    legacyTile.save(cacheDirectory + "/good/0/0_0.png");
+    QFile interruptedTile(cacheDirectory + "/good/0/1_0.tile.tmp");
+    interruptedTile.open(QIODevice::WriteOnly);
+    interruptedTile.write(QByteArray(1000, '\0'));
+    interruptedTile.close();
+
+    // Fetch: every tile needs one request to the server
+    foreach (TileAddress tile, tiles)
+    {
+        requestTile(requester, "good", tile, &textures);
+    }
+    check(err, waitForTiles(requester, collector, tileCount, timeout), "fetch timed out");
+
+    fetchedTiles = collector.completedTiles();
+    check(err, fetchedTiles.size() == tileCount, "fetch didn't deliver every tile");
+    check(err, collector.cancelledTiles().isEmpty() && collector.failedTiles().isEmpty(), "fetch cancelled or failed tiles");
+    check(err, server.requestCount("good") == (unsigned int) tileCount, "fetch didn't send one request per tile");
+    check(err, requester->tileCache()->misses() == (unsigned int) tileCount, "fetch found tiles in an empty cache");
+    foreach (TileAddress tile, tiles)
+    {
+        check(err, isExpectedTile(fetchedTiles.value(tileName("good", tile)), tile), "wrong image for " + tileName("good", tile));
+    }
+    check(err, countFiles(cacheDirectory) == (unsigned int) tileCount, "fetch didn't store every tile in the cache");
+    check(err, !QFile::exists(cacheDirectory + "/good/0/0_0.png"), "old PNG tile wasn't removed from the cache");
+    check(err, !QFile::exists(cacheDirectory + "/good/0/1_0.tile.tmp"), "temporary file wasn't removed from the cache");
+
+    out << "fetch: " << fetchedTiles.size() << " of " << tileCount << " tiles, "
+        << server.requestCount("good") << " requests" << endl;
+
+    delete requester;
+
+    // Reuse: a new requester finds every tile in the cache
+    collector.clear();
+    requester = createRequester(server, layers, &collector);
+    foreach (TileAddress tile, tiles)
+    {
+        requestTile(requester, "good", tile, &textures);
+    }
+    check(err, waitForTiles(requester, collector, tileCount, timeout), "reuse timed out");
+
+    check(err, server.requestCount("good") == (unsigned int) tileCount, "reuse sent requests for cached tiles");
+    check(err, requester->tileCache()->hits() == (unsigned int) tileCount, "reuse didn't find every tile in the cache");
+    check(err, collector.completedTiles() == fetchedTiles, "cached tiles differ from the fetched tiles");
+
+    out << "reuse: " << collector.completedTiles().size() << " of " << tileCount << " tiles, "
+        << server.requestCount("good") - tileCount << " requests" << endl;
+
+    // Errors: failed tiles are neither delivered nor cached, and a later request
+    // for the same tile goes to the server again.
+    collector.clear();
+    TileAddress errorTiles[] = { { 1, 0, 0 }, { 1, 3, 1 } };
+    for (int pass = 1; pass <= 2; ++pass)
+    {
+        foreach (QString layer, errorLayers)
+        {
+            for (unsigned int i = 0; i < sizeof(errorTiles) / sizeof(errorTiles[0]); ++i)
+            {
+                requestTile(requester, layer, errorTiles[i], &textures);
+            }
+        }
+        check(err, waitForTiles(requester, collector, 0, timeout), "error requests timed out");
+
+        foreach (QString layer, errorLayers)
+        {
+            check(err, server.requestCount(layer) == 2 * (unsigned int) pass, "wrong number of requests for " + layer);
+        }
+
+        // Every failed tile is reported, so that its texture isn't left loading
+        check(err, collector.failedTiles().size() == pass * 2 * errorLayers.size(), "failed tiles weren't reported");
+    }
+
+    check(err, collector.completedTiles().isEmpty(), "tiles with errors were delivered");
+    check(err, countFiles(cacheDirectory) == (unsigned int) tileCount, "tiles with errors were cached");
+
+    // The requester must still work after the errors
+    TileAddress newTile = { 3, 5, 2 };
+    requestTile(requester, "good", newTile, &textures);
+    check(err, waitForTiles(requester, collector, 1, timeout), "request after errors timed out");
+    check(err, isExpectedTile(collector.completedTiles().value(tileName("good", newTile)), newTile), "request after errors failed");
+
+    out << "errors: " << collector.completedTiles().size() - 1 << " tiles delivered for "
+        << 4 * errorLayers.size() << " failed requests" << endl;
+
+    // Eviction: keep room for three tiles. The most recently used tiles are the
+    // new tile and the last two tiles of the reuse stage.
+    TileDiskCache* cache = requester->tileCache();
+    qint64 tileBytes = cache->size() / (tileCount + 1);
+    cache->setMaxSize(3 * tileBytes);
+
+    check(err, cache->size() <= cache->maxSize(), "cache is larger than its limit");
+    check(err, countFiles(cacheDirectory) == 3, "eviction didn't delete files");
+    check(err, cache->loadTile("good", tiles[0].level, tiles[0].x, tiles[0].y).isNull(), "least recently used tile wasn't evicted");
+    check(err, !cache->loadTile("good", newTile.level, newTile.x, newTile.y).isNull(), "most recently used tile was evicted");
+
+    // Fetching an evicted tile stores it again without exceeding the limit
+    collector.clear();
+    unsigned int requestCount = server.requestCount("good");
+    requestTile(requester, "good", tiles[0], &textures);
+    check(err, waitForTiles(requester, collector, 1, timeout), "request after eviction timed out");
+    check(err, server.requestCount("good") == requestCount + 1, "evicted tile wasn't requested from the server");
+    check(err, cache->size() <= cache->maxSize(), "cache is larger than its limit after storing a tile");
+    check(err, countFiles(cacheDirectory) == 3, "cache has the wrong number of files after storing a tile");
+    check(err, !cache->loadTile("good", tiles[0].level, tiles[0].x, tiles[0].y).isNull(), "fetched tile wasn't cached");
+
+    out << "eviction: " << countFiles(cacheDirectory) << " tiles, " << cache->size() << " of "
+        << cache->maxSize() << " bytes" << endl;
+
+    check(err, server.malformedRequestCount() == 0, "server received malformed requests");
+
+    delete requester;
+    QDir(cacheDirectory).removeRecursively();
+
+    if (failureCount > 0)
+    {
+        err << failureCount << " checks failed" << endl;
+    }
+    else
+    {
+        out << "All checks passed" << endl;
+    }
+
+    return failureCount > 0 ? 1 : 0;
+}
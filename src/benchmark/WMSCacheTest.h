@@ -0,0 +1,139 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _WMS_CACHE_TEST_H_
+#define _WMS_CACHE_TEST_H_
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QImage>
+#include <QMap>
+#include <QStringList>
+
+
+/** A minimal HTTP server that stands in for a WMS server in wmscachetest.
+  * The layers parameter of a GetMap request selects the response:
+  *
+  *   good      - a PNG image of the requested size, filled with the color
+  *               given by tileColor() for the lower left corner of the bbox
+  *   error500  - HTTP status 500
+  *   notfound  - HTTP status 404
+  *   badimage  - status 200, but the body isn't an image
+  *   truncated - status 200 and a PNG image, but the connection is closed
+  *               before the whole image is sent
+  *
+  * Requests without a valid width, height, and bbox get status 400 and are
+  * counted as malformed.
+  */
+class StandInWmsServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    StandInWmsServer(QObject* parent = NULL);
+
+    QString requestBase(const QString& layer) const;
+
+    /** Get the number of requests received for a layer.
+      */
+    unsigned int requestCount(const QString& layer) const
+    {
+        return m_requestCounts.value(layer);
+    }
+
+    /** Get the number of requests that weren't valid WMS GetMap requests.
+      */
+    unsigned int malformedRequestCount() const
+    {
+        return m_malformedRequestCount;
+    }
+
+    static QRgb tileColor(double west, double south);
+
+private slots:
+    void acceptConnection();
+    void readRequest();
+
+private:
+    void respond(QTcpSocket* socket, const QByteArray& requestLine);
+    void sendResponse(QTcpSocket* socket, int status, const char* reason, const char* contentType,
+                      const QByteArray& body, int sentLength);
+
+private:
+    QHash<QTcpSocket*, QByteArray> m_requestData;
+    QHash<QString, unsigned int> m_requestCounts;
+    unsigned int m_malformedRequestCount;
+};
+
+
+/** Records the tiles delivered, cancelled, and failed by a WMSRequester.
+  */
+class TileCollector : public QObject
+{
+    Q_OBJECT
+
+public:
+    TileCollector(QObject* parent = NULL) :
+        QObject(parent)
+    {
+    }
+
+    const QMap<QString, QImage>& completedTiles() const
+    {
+        return m_completedTiles;
+    }
+
+    const QStringList& cancelledTiles() const
+    {
+        return m_cancelledTiles;
+    }
+
+    const QStringList& failedTiles() const
+    {
+        return m_failedTiles;
+    }
+
+    void clear()
+    {
+        m_completedTiles.clear();
+        m_cancelledTiles.clear();
+        m_failedTiles.clear();
+    }
+
+public slots:
+    void tileCompleted(const QString& tileName, const QImage& image)
+    {
+        m_completedTiles[tileName] = image;
+    }
+
+    void tileCancelled(const QString& tileName)
+    {
+        m_cancelledTiles << tileName;
+    }
+
+    void tileFailed(const QString& tileName)
+    {
+        m_failedTiles << tileName;
+    }
+
+private:
+    QMap<QString, QImage> m_completedTiles;
+    QStringList m_cancelledTiles;
+    QStringList m_failedTiles;
+};
+
+#endif // _WMS_CACHE_TEST_H_
@@ -20,6 +20,7 @@
 #include "GalleryView.h"
 #include "catalog/UniverseCatalog.h"
 #include "catalog/UniverseLoader.h"
+#include "catalog/BuiltinModels.h"
 #include "qtwrapper/UniverseCatalogObject.h"
 #include "Cosmographia.h"
 #if FFMPEG_SUPPORT
@@ -27,14 +28,7 @@
 #elif QTKIT_SUPPORT
 #include "../video/VideoEncoder.h"
 #endif
-#include "JPLEphemeris.h"
 #include "NetworkTextureLoader.h"
-#include "LinearCombinationTrajectory.h"
-#include "astro/IAULunarRotationModel.h"
-#include "astro/MarsSat.h"
-#include "astro/L1.h"
-#include "astro/TASS17.h"
-#include "astro/Gust86.h"
 #include "DateUtility.h"
 #include "NumberFormat.h"
 #include "SkyLabelLayer.h"
@@ -48,11 +42,14 @@
 #include <vesta/KeplerianTrajectory.h>
 #include <vesta/FixedPointTrajectory.h>
 #include <vesta/WorldGeometry.h>
+#include <vesta/SensorCoverageLayer.h>
 #include <vesta/Units.h>
 #include <vesta/StarsLayer.h>
+#include <vesta/Profiler.h>
 #include <qjson/parser.h>
 #include <qjson/serializer.h>
 #include <algorithm>
+#include <fstream>
 #include <QAction>
 #include <QMenu>
 #include <QMenuBar>
@@ -108,6 +105,7 @@ Cosmographia::Cosmographia() :
     m_catalog = new UniverseCatalog();
     m_view3d = new UniverseView(nullptr, m_universe.ptr(), m_catalog);
     m_loader = new UniverseLoader();
+    m_loader->setMeshCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/meshes");
 
     connect(m_view3d, SIGNAL(sceneGraphInitialized()), SLOT(initialize()));
 
@@ -153,6 +151,10 @@ Cosmographia::Cosmographia() :
 Cosmographia::~Cosmographia()
 {
     saveSettings();
+    if (Profiler::instance()->tracingEnabled())
+    {
+        writePerformanceTrace();
+    }
     delete m_catalogWrapper;
 }
 
@@ -170,8 +172,10 @@ Cosmographia::setupMenuBar()
 #if !FFMPEG_SUPPORT && !QTKIT_SUPPORT
     recordVideoAction->setEnabled(false);
 #endif
+    QAction* exportCoverageAction = new QAction("&Export Sensor Coverage...", this);
     fileMenu->addAction(saveScreenShotAction);
     fileMenu->addAction(recordVideoAction);
+    fileMenu->addAction(exportCoverageAction);
     fileMenu->addSeparator();
     QAction* loadCatalogAction = fileMenu->addAction("&Open Catalog...");
     loadCatalogAction->setShortcut(QKeySequence("Ctrl+O"));
@@ -185,6 +189,7 @@ Cosmographia::setupMenuBar()
     connect(saveScreenShotAction, SIGNAL(triggered()), this, SLOT(saveScreenShot()));
     connect(copyScreenShotAction, SIGNAL(triggered()), m_view3d, SLOT(copyNextFrameToClipboard()));
     connect(recordVideoAction, SIGNAL(triggered()), this, SLOT(recordVideo()));
+    connect(exportCoverageAction, SIGNAL(triggered()), this, SLOT(exportSensorCoverage()));
     connect(loadCatalogAction, SIGNAL(triggered()), this, SLOT(loadCatalog()));
     connect(m_unloadLastCatalogAction, SIGNAL(triggered()), this, SLOT(unloadLastCatalog()));
     connect(quitAction, SIGNAL(triggered()), this, SLOT(close()));
@@ -429,6 +434,10 @@ Cosmographia::setupMenuBar()
     reflectionsAction->setCheckable(true);
     reflectionsAction->setChecked(m_view3d->reflections());
     graphicsMenu->addAction(reflectionsAction);
+    QAction* logDepthAction = new QAction("Logarithmic &Depth", graphicsMenu);
+    logDepthAction->setCheckable(true);
+    logDepthAction->setChecked(m_view3d->logarithmicDepth());
+    graphicsMenu->addAction(logDepthAction);
     QAction* milkyWayAction = new QAction("&Milky Way", graphicsMenu);
     milkyWayAction->setCheckable(true);
     milkyWayAction->setChecked(m_view3d->milkyWayVisible());
@@ -439,6 +448,15 @@ Cosmographia::setupMenuBar()
     graphicsMenu->addAction(m_fullScreenAction);
     connect(m_fullScreenAction, SIGNAL(toggled(bool)), this, SLOT(setFullScreen(bool)));
     graphicsMenu->addMenu(stereoModeMenu);
+    graphicsMenu->addSeparator();
+    QAction* performanceOverlayAction = new QAction("Performance &Overlay", graphicsMenu);
+    performanceOverlayAction->setCheckable(true);
+    performanceOverlayAction->setChecked(m_view3d->performanceOverlay());
+    graphicsMenu->addAction(performanceOverlayAction);
+    QAction* performanceTraceAction = new QAction("Record Performance &Trace", graphicsMenu);
+    performanceTraceAction->setCheckable(true);
+    performanceTraceAction->setChecked(Profiler::instance()->tracingEnabled());
+    graphicsMenu->addAction(performanceTraceAction);
 
     menuBar()->addMenu(graphicsMenu);
 
@@ -449,9 +467,12 @@ Cosmographia::setupMenuBar()
     connect(ambientLightAction,     SIGNAL(triggered(bool)), m_view3d, SLOT(setAmbientLight(bool)));
     connect(sunGlareAction,         SIGNAL(triggered(bool)), m_view3d, SLOT(setSunGlare(bool)));
     connect(reflectionsAction,      SIGNAL(triggered(bool)), m_view3d, SLOT(setReflections(bool)));
+    connect(logDepthAction,         SIGNAL(triggered(bool)), m_view3d, SLOT(setLogarithmicDepth(bool)));
     connect(milkyWayAction,         SIGNAL(triggered(bool)), m_view3d, SLOT(setMilkyWayVisible(bool)));
     connect(starStyleGroup,         SIGNAL(selected(QAction*)), this, SLOT(setStarStyle(QAction*)));
     connect(stereoModeGroup,        SIGNAL(selected(QAction*)), this, SLOT(setStereoMode(QAction*)));
+    connect(performanceOverlayAction, SIGNAL(triggered(bool)), m_view3d, SLOT(setPerformanceOverlay(bool)));
+    connect(performanceTraceAction, SIGNAL(triggered(bool)), this, SLOT(setPerformanceTracing(bool)));
 
     /*** Help menu ***/
     QMenu* helpMenu = new QMenu("Help", this);
@@ -584,17 +605,6 @@ Cosmographia::initializeUniverse()
 }
 
 
-// Convert a JPL ephemeris orbit from SSB-centered to Sun-centered
-static Trajectory*
-createSunRelativeTrajectory(const JPLEphemeris* eph, JPLEphemeris::JplObjectId id)
-{
-    LinearCombinationTrajectory* orbit = new LinearCombinationTrajectory(eph->trajectory(id), 1.0,
-                                                                         eph->trajectory(JPLEphemeris::Sun), -1.0);
-    orbit->setPeriod(eph->trajectory(id)->period());
-    return orbit;
-}
-
-
 static QString cacheFilePath(const QString& fileName)
 {
 #if 0
@@ -637,86 +647,7 @@ static QString documentFilePath(const QString& fileName)
 void
 Cosmographia::initialize()
 {
-    // Set up builtin orbits
-    JPLEphemeris* eph = JPLEphemeris::load("de406_1800-2100.dat");
-    if (eph)
-    {
-        m_loader->addBuiltinOrbit("Sun",     eph->trajectory(JPLEphemeris::Sun));
-        m_loader->addBuiltinOrbit("Moon",    eph->trajectory(JPLEphemeris::Moon));
-
-        // The code below will create planet trajectories relative to the SSB
-        /*
-        m_loader->addBuiltinOrbit("Mercury", eph->trajectory(JPLEphemeris::Mercury));
-        m_loader->addBuiltinOrbit("Venus",   eph->trajectory(JPLEphemeris::Venus));
-        m_loader->addBuiltinOrbit("EMB",     eph->trajectory(JPLEphemeris::EarthMoonBarycenter));
-        m_loader->addBuiltinOrbit("Mars",    eph->trajectory(JPLEphemeris::Mars));
-        m_loader->addBuiltinOrbit("Jupiter", eph->trajectory(JPLEphemeris::Jupiter));
-        m_loader->addBuiltinOrbit("Saturn",  eph->trajectory(JPLEphemeris::Saturn));
-        m_loader->addBuiltinOrbit("Uranus",  eph->trajectory(JPLEphemeris::Uranus));
-        m_loader->addBuiltinOrbit("Neptune", eph->trajectory(JPLEphemeris::Neptune));
-        m_loader->addBuiltinOrbit("Pluto",   eph->trajectory(JPLEphemeris::Pluto));
-        */
-
-        Trajectory* embTrajectory = createSunRelativeTrajectory(eph, JPLEphemeris::EarthMoonBarycenter);
-        m_loader->addBuiltinOrbit("EMB", embTrajectory);
-
-        m_loader->addBuiltinOrbit("Mercury", createSunRelativeTrajectory(eph, JPLEphemeris::Mercury));
-        m_loader->addBuiltinOrbit("Venus",   createSunRelativeTrajectory(eph, JPLEphemeris::Venus));
-        m_loader->addBuiltinOrbit("Mars",    createSunRelativeTrajectory(eph, JPLEphemeris::Mars));
-        m_loader->addBuiltinOrbit("Jupiter", createSunRelativeTrajectory(eph, JPLEphemeris::Jupiter));
-        m_loader->addBuiltinOrbit("Saturn",  createSunRelativeTrajectory(eph, JPLEphemeris::Saturn));
-        m_loader->addBuiltinOrbit("Uranus",  createSunRelativeTrajectory(eph, JPLEphemeris::Uranus));
-        m_loader->addBuiltinOrbit("Neptune", createSunRelativeTrajectory(eph, JPLEphemeris::Neptune));
-        m_loader->addBuiltinOrbit("Pluto",   createSunRelativeTrajectory(eph, JPLEphemeris::Pluto));
-
-        // m = the ratio of the Moon's to the mass of the Earth-Moon system
-        double m = 1.0 / (1.0 + eph->earthMoonMassRatio());
-        LinearCombinationTrajectory* earthTrajectory =
-                new LinearCombinationTrajectory(embTrajectory, 1.0,
-                                                eph->trajectory(JPLEphemeris::Moon), -m);
-        earthTrajectory->setPeriod(embTrajectory->period());
-        m_loader->addBuiltinOrbit("Earth", earthTrajectory);
-
-        // JPL HORIZONS results for position of Moon with respect to Earth at 1 Jan 2000 12:00
-        // position: -2.916083884571964E+05 -2.667168292374240E+05 -7.610248132320160E+04
-        // velocity:  6.435313736079528E-01 -6.660876955662288E-01 -3.013257066079174E-01
-        //std::cout << "Moon @ J2000:  " << eph->trajectory(JPLEphemeris::Moon)->position(0.0).transpose().format(16) << std::endl;
-
-        // JPL HORIZONS results for position of Earth with respect to Sun at 1 Jan 2000 12:00
-        // position: -2.649903422886233E+07  1.327574176646856E+08  5.755671744790662E+07
-        // velocity: -2.979426004836674E+01 -5.018052460415045E+00 -2.175393728607054E+00
-        //std::cout << "Earth @ J2000: " << earthTrajectory->position(0.0).transpose().format(16) << std::endl;
-    }
-
-    // Martian satellites
-    m_loader->addBuiltinOrbit("Phobos", MarsSatOrbit::Create(MarsSatOrbit::Phobos));
-    m_loader->addBuiltinOrbit("Deimos", MarsSatOrbit::Create(MarsSatOrbit::Deimos));
-
-    // Galilean satellites
-    m_loader->addBuiltinOrbit("Io", L1Orbit::Create(L1Orbit::Io));
-    m_loader->addBuiltinOrbit("Europa", L1Orbit::Create(L1Orbit::Europa));
-    m_loader->addBuiltinOrbit("Ganymede", L1Orbit::Create(L1Orbit::Ganymede));
-    m_loader->addBuiltinOrbit("Callisto", L1Orbit::Create(L1Orbit::Callisto));
-
-    // Saturnian satellites
-    m_loader->addBuiltinOrbit("Mimas",     TASS17Orbit::Create(TASS17Orbit::Mimas));
-    m_loader->addBuiltinOrbit("Enceladus", TASS17Orbit::Create(TASS17Orbit::Enceladus));
-    m_loader->addBuiltinOrbit("Tethys",    TASS17Orbit::Create(TASS17Orbit::Tethys));
-    m_loader->addBuiltinOrbit("Dione",     TASS17Orbit::Create(TASS17Orbit::Dione));
-    m_loader->addBuiltinOrbit("Rhea",      TASS17Orbit::Create(TASS17Orbit::Rhea));
-    m_loader->addBuiltinOrbit("Titan",     TASS17Orbit::Create(TASS17Orbit::Titan));
-    m_loader->addBuiltinOrbit("Hyperion",  TASS17Orbit::Create(TASS17Orbit::Hyperion));
-    m_loader->addBuiltinOrbit("Iapetus",   TASS17Orbit::Create(TASS17Orbit::Iapetus));
-
-    // Uranian satellites
-    m_loader->addBuiltinOrbit("Miranda",   Gust86Orbit::Create(Gust86Orbit::Miranda));
-    m_loader->addBuiltinOrbit("Ariel",     Gust86Orbit::Create(Gust86Orbit::Ariel));
-    m_loader->addBuiltinOrbit("Umbriel",   Gust86Orbit::Create(Gust86Orbit::Umbriel));
-    m_loader->addBuiltinOrbit("Titania",   Gust86Orbit::Create(Gust86Orbit::Titania));
-    m_loader->addBuiltinOrbit("Oberon",    Gust86Orbit::Create(Gust86Orbit::Oberon));
-
-    // Set up builtin rotation models
-    m_loader->addBuiltinRotationModel("IAU Moon", new IAULunarRotationModel());
+    AddBuiltinModels(m_loader);
 
     // Set up the network manager. Eventually, the texture tile loader and resource loader should share
     // the same QNetworkAccessManager. However, there is a noticeable lag when loading a TLE orbit
@@ -853,10 +784,11 @@ Cosmographia::findObject()
     connect(buttons, SIGNAL(accepted()), &findDialog, SLOT(accept()));
     connect(buttons, SIGNAL(rejected()), &findDialog, SLOT(reject()));
 
-    // TODO: If we need to support extremely large numbers of objects, we should
-    // use a abstract item model instead of a completer.
-    QCompleter* completer = new QCompleter(m_catalog->names(), nameEntry);
+    // The completion names are sorted case insensitively, which lets the completer
+    // use a binary search instead of scanning the whole list.
+    QCompleter* completer = new QCompleter(m_catalog->completionNames(), nameEntry);
     completer->setCaseSensitivity(Qt::CaseInsensitive);
+    completer->setModelSorting(QCompleter::CaseInsensitivelySortedModel);
     nameEntry->setCompleter(completer);
 
     findDialog.move((width() - findDialog.width()) / 2, 0);
@@ -1067,6 +999,42 @@ Cosmographia::saveScreenShot()
 }
 
 
+// Save the sensor coverage recorded on the selected body as an image
+// in equirectangular projection.
+void
+Cosmographia::exportSensorCoverage()
+{
+    SensorCoverageLayer* coverageLayer = NULL;
+
+    Entity* body = m_view3d->selectedBody();
+    WorldGeometry* world = body ? dynamic_cast<WorldGeometry*>(body->geometry()) : NULL;
+    if (world)
+    {
+        for (unsigned int i = 0; i < world->layerCount() && !coverageLayer; ++i)
+        {
+            coverageLayer = dynamic_cast<SensorCoverageLayer*>(world->layer(i));
+        }
+    }
+
+    if (!coverageLayer)
+    {
+        QMessageBox::information(this, tr("Export Sensor Coverage"), tr("No sensor coverage is recorded for the selected object."));
+        return;
+    }
+
+    const SensorCoverage* coverage = coverageLayer->coverage();
+    QImage image(coverage->longitudeCells(), coverage->latitudeCells(), QImage::Format_RGBA8888);
+    coverage->fillImage(image.bits(), coverageLayer->color(), 1.0f, true);
+
+    QString defaultFileName = pictureFilePath("coverage.png");
+    QString saveFileName = QFileDialog::getSaveFileName(this, "Save Coverage As...", defaultFileName, "*.png *.tif");
+    if (!saveFileName.isEmpty())
+    {
+        image.save(saveFileName);
+    }
+}
+
+
 void
 Cosmographia::loadSettings()
 {
@@ -1086,6 +1054,7 @@ Cosmographia::loadSettings()
     m_view3d->setMilkyWayVisible(settings.value("milkyWay", false).toBool());
     m_view3d->setSunGlare(settings.value("sunGlare", true).toBool());
     m_view3d->setShadows(settings.value("generalShadows", false).toBool());
+    m_view3d->setLogarithmicDepth(settings.value("logarithmicDepth", false).toBool());
     m_view3d->setCloudsVisible(settings.value("clouds", true).toBool());
     m_view3d->setAtmospheresVisible(settings.value("atmospheres", true).toBool());
 
@@ -1102,6 +1071,14 @@ Cosmographia::loadSettings()
 
     setVideoSize(settings.value("videoSize", "wvga").toString());
 
+    m_loader->setMeshQuantization(settings.value("meshQuantization", false).toBool());
+
+    settings.beginGroup("debug");
+    m_view3d->setPerformanceOverlay(settings.value("performanceOverlay", false).toBool());
+    // Performance tracing is deliberately not restored; it only lasts for one session.
+    settings.remove("performanceTrace");
+    settings.endGroup();
+
     settings.beginGroup("ui");
     setMeasurementSystem(settings.value("measurementSystem", "metric").toString());
     setAutoHideToolBar(settings.value("autoHideToolBar", false).toBool());
@@ -1125,6 +1102,7 @@ Cosmographia::saveSettings()
     settings.setValue("milkyWay", m_view3d->milkyWayVisible());
     settings.setValue("sunGlare", m_view3d->sunGlare());
     settings.setValue("generalShadows", m_view3d->shadows());
+    settings.setValue("logarithmicDepth", m_view3d->logarithmicDepth());
     settings.setValue("clouds", m_view3d->cloudsVisible());
     settings.setValue("atmospheres", m_view3d->atmospheresVisible());
 
@@ -1141,6 +1119,10 @@ Cosmographia::saveSettings()
 
     settings.setValue("videoSize", videoSize());
 
+    settings.beginGroup("debug");
+    settings.setValue("performanceOverlay", m_view3d->performanceOverlay());
+    settings.endGroup();
+
     settings.beginGroup("ui");
     settings.setValue("measurementSystem", measurementSystem());
     settings.setValue("autoHideToolBar", m_autoHideToolBar);
@@ -1149,6 +1131,44 @@ Cosmographia::saveSettings()
 }
 
 
+/** Start or stop recording a performance trace. When recording stops, the
+  * trace is written to a file in the Chrome trace event format, which can
+  * be loaded into chrome://tracing or the Perfetto UI.
+  */
+void
+Cosmographia::setPerformanceTracing(bool enabled)
+{
+    if (!enabled && Profiler::instance()->tracingEnabled())
+    {
+        writePerformanceTrace();
+    }
+
+    Profiler::instance()->setTracingEnabled(enabled);
+    if (enabled)
+    {
+        m_view3d->setStatusMessage(tr("Recording performance trace"));
+    }
+}
+
+
+void
+Cosmographia::writePerformanceTrace()
+{
+    QString dirName = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+    QString fileName = dirName + "/cosmographia-trace-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+
+    std::ofstream out(QFile::encodeName(fileName).constData());
+    if (!out.good() || !Profiler::instance()->writeChromeTrace(out))
+    {
+        qWarning() << "Error writing performance trace to " << fileName;
+        return;
+    }
+
+    Profiler::instance()->clearTrace();
+    m_view3d->setStatusMessage(tr("Performance trace saved to %1").arg(fileName));
+}
+
+
 // Necessary because QML doesn't currently allow access to QSettings
 QVariant
 Cosmographia::getSetting(const QString &key)
@@ -1232,7 +1252,7 @@ Cosmographia::recordVideo()
 #if FFMPEG_SUPPORT || QTKIT_SUPPORT
     if (m_view3d->isRecordingVideo())
     {
-        m_view3d->videoEncoder()->close();
+        // The view flushes the capture pipeline and closes the encoder
         m_view3d->finishVideoRecording();
     }
     else
@@ -1411,6 +1431,24 @@ void
 Cosmographia::removeBody(vesta::Entity* body)
 {
     m_view3d->clearTrajectoryPlots(body);
+
+    // Sensor coverage is drawn in a layer of the target body, which isn't
+    // necessarily being removed.
+    SensorFrustumGeometry* sensor = dynamic_cast<SensorFrustumGeometry*>(body->geometry());
+    if (sensor && sensor->coverage() && sensor->target())
+    {
+        WorldGeometry* world = dynamic_cast<WorldGeometry*>(sensor->target()->geometry());
+        for (unsigned int i = world ? world->layerCount() : 0; i > 0; --i)
+        {
+            SensorCoverageLayer* layer = dynamic_cast<SensorCoverageLayer*>(world->layer(i - 1));
+            if (layer && layer->coverage() == sensor->coverage())
+            {
+                world->removeLayer(i - 1);
+            }
+        }
+        sensor->setCoverage(NULL);
+    }
+
     m_universe->removeEntity(body);
 }
 
@@ -82,6 +82,7 @@ public slots:
     void about();
     void saveScreenShot();
     void recordVideo();
+    void exportSensorCoverage();
     void plotTrajectory();
     void plotTrajectoryObserver();
     void setStarStyle(QAction* action);
@@ -110,6 +111,7 @@ private slots:
     void loadCatalog();
     void unloadLastCatalog();
     void copyStateUrlToClipboard();
+    void setPerformanceTracing(bool enabled);
 
 private:
     void initializeUniverse();
@@ -117,6 +119,7 @@ private:
     void setupMenuBar();
     void loadSettings();
     void saveSettings();
+    void writePerformanceTrace();
 
     void removeBody(vesta::Entity* body);
     void removeBody(const QString& name);
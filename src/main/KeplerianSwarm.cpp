@@ -106,7 +106,9 @@ static const char* SwarmVertexShaderSource =
 "uniform float time;              \n"
 "uniform float pointSize;         \n"
 "uniform vec4 color;              \n"
+"uniform float vesta_LogDepthScale;\n"
 "varying vec4 pointColor;         \n"
+"varying float logDepthZ;         \n"
 "\n"
 "void main()                      \n"
 "{                                \n"
@@ -133,17 +135,24 @@ static const char* SwarmVertexShaderSource =
 "        pointColor = mix(vec4(1.0, 1.0, 1.0, 1.0), color, min(t / (86400.0 * 50.0), 1.0));  \n"
 "    gl_PointSize = pointSize;\n"
 "    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);        \n"
+"    logDepthZ = 1.0 + max(gl_Position.w, 0.0) * vesta_LogDepthScale;         \n"
 "}                                                                            \n"
 ;
 
 static const char* SwarmFragmentShaderSource =
 "#version 120                                    \n"
 "varying vec4 pointColor;                        \n"
+"varying float logDepthZ;                        \n"
+"uniform float vesta_LogDepthFactor;             \n"
 "void main()                                     \n"
 "{                                               \n"
 "    vec2 v = gl_PointCoord - vec2(0.5, 0.5); \n"
 "    float opacity = 1.0 - dot(v, v) * 4.0; \n"
 "    gl_FragColor = vec4(pointColor.rgb, opacity * pointColor.a);\n"
+"    if (vesta_LogDepthFactor > 0.0)                                           \n"
+"        gl_FragDepth = log2(logDepthZ) * vesta_LogDepthFactor;                \n"
+"    else                                                                      \n"
+"        gl_FragDepth = gl_FragCoord.z;                                        \n"
 "}                                               \n"
 ;
 
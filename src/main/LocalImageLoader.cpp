@@ -13,8 +13,11 @@
 // limitations under the License.
 
 #include "LocalImageLoader.h"
+#include "vext/TilePackTiledMap.h"
 #include <QDebug>
+#include <QFile>
 #include <QFileInfo>
+#include <cstring>
 
 using namespace vesta;
 
@@ -27,6 +30,10 @@ LocalImageLoader::LocalImageLoader() :
 
 LocalImageLoader::~LocalImageLoader()
 {
+    foreach (MappedTilePack pack, m_tilePacks)
+    {
+        delete pack.file;
+    }
 }
 
 
@@ -36,6 +43,12 @@ LocalImageLoader::loadTexture(TextureMap* texture)
     if (texture)
     {
         QString textureName = QString::fromUtf8(texture->name().c_str());
+        if (TilePackTiledMap::isTileResourceName(textureName))
+        {
+            loadPackedTile(texture, textureName);
+            return;
+        }
+
         QFileInfo info(textureName);
 
         qDebug() << "loadTexture: " << textureName;
@@ -62,7 +75,8 @@ LocalImageLoader::loadTexture(TextureMap* texture)
             QImage image(textureName);
             if (!image.isNull())
             {
-                emit textureLoaded(texture, image);
+                // Convert the image here so that the display thread doesn't have to
+                emit textureLoaded(texture, convertToTextureFormat(image));
             }
             else
             {
@@ -73,6 +87,88 @@ LocalImageLoader::loadTexture(TextureMap* texture)
 }
 
 
+// Decode a tile stored in a tile pack. The pack is mapped into memory the first
+// time that one of its tiles is requested, and the tile is decoded directly from
+// the mapped byte range.
+void
+LocalImageLoader::loadPackedTile(TextureMap* texture, const QString& textureName)
+{
+    QString packFileName;
+    qint64 offset = 0;
+    qint64 length = 0;
+    if (!TilePackTiledMap::parseTileResourceName(textureName, &packFileName, &offset, &length))
+    {
+        emit textureLoadFailed(texture);
+        return;
+    }
+
+    if (!m_tilePacks.contains(packFileName))
+    {
+        MappedTilePack pack;
+        pack.file = new QFile(packFileName);
+        pack.data = NULL;
+        pack.size = 0;
+        if (pack.file->open(QIODevice::ReadOnly))
+        {
+            pack.size = pack.file->size();
+            pack.data = pack.file->map(0, pack.size);
+        }
+
+        if (!pack.data)
+        {
+            qDebug() << "Unable to map tile pack" << packFileName;
+        }
+
+        // Failed packs are remembered too, so that the open isn't retried for every tile
+        m_tilePacks.insert(packFileName, pack);
+    }
+
+    const MappedTilePack& pack = m_tilePacks[packFileName];
+    if (!pack.data || offset < 0 || length <= 0 || offset + length > pack.size)
+    {
+        emit textureLoadFailed(texture);
+        return;
+    }
+
+    const uchar* tileData = pack.data + offset;
+    if (length >= 4 && memcmp(tileData, "DDS ", 4) == 0)
+    {
+        emit ddsTextureLoaded(texture, new DataChunk(reinterpret_cast<const char*>(tileData), (unsigned int) length));
+    }
+    else
+    {
+        QImage image = QImage::fromData(tileData, (int) length);
+        if (!image.isNull())
+        {
+            emit textureLoaded(texture, convertToTextureFormat(image));
+        }
+        else
+        {
+            emit textureLoadFailed(texture);
+        }
+    }
+}
+
+
+/** Convert an image to a format that can be used directly as texture data: either
+  * 24 or 32 bits per pixel. Images already in such a format are returned unmodified.
+  * Conversion can be slow for large images, so this should be called from a loader
+  * thread rather than the display thread.
+  */
+QImage
+LocalImageLoader::convertToTextureFormat(const QImage& image)
+{
+    if (image.isNull() || image.depth() == 24 || image.depth() == 32)
+    {
+        return image;
+    }
+    else
+    {
+        return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    }
+}
+
+
 void
 LocalImageLoader::setSearchPath(const QString& path)
 {
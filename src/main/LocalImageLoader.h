@@ -19,6 +19,9 @@
 #include <vesta/TextureMap.h>
 #include <QImage>
 #include <QObject>
+#include <QHash>
+
+class QFile;
 
 
 /** LocalImageLoader handles loading of images from disk. It uses signals and slots
@@ -37,6 +40,8 @@ public:
         return m_searchPath;
     }
 
+    static QImage convertToTextureFormat(const QImage& image);
+
 public slots:
     void loadTexture(vesta::TextureMap* texture);
     void setSearchPath(const QString& path);
@@ -54,8 +59,22 @@ signals:
       */
     void textureLoadFailed(vesta::TextureMap* texture);
 
+private:
+    struct MappedTilePack
+    {
+        QFile* file;
+        const uchar* data;
+        qint64 size;
+    };
+
+    void loadPackedTile(vesta::TextureMap* texture, const QString& textureName);
+
 private:
     QString m_searchPath;
+
+    // Memory mapped tile packs, keyed by file name. These are only accessed
+    // from the loader thread.
+    QHash<QString, MappedTilePack> m_tilePacks;
 };
 
 #endif // _LOCAL_IMAGE_LOADER_H_
@@ -14,13 +14,17 @@
 
 #include "NetworkTextureLoader.h"
 #include "LocalImageLoader.h"
+#include "vext/TilePackTiledMap.h"
 #include <vesta/DataChunk.h>
 #include <vesta/DDSLoader.h>
+#include <vesta/Profiler.h>
 #include <QFileInfo>
 #include <QImage>
 #include <QStringList>
 #include <QThread>
+#include <QElapsedTimer>
 #include <QDebug>
+#include <algorithm>
 
 using namespace vesta;
 
@@ -67,8 +71,12 @@ NetworkTextureLoader::NetworkTextureLoader(QObject* parent, bool asynchronous) :
     m_localImageLoader(NULL),
     m_wmsHandler(NULL),
     m_imageLoadThread(NULL),
-    m_totalMemoryUsage(0),
-    m_textureMemoryLimit(150)
+    m_textureMemoryLimit(150),
+    m_uploadByteBudget(8 * 1024 * 1024),
+    m_uploadTimeBudget(6),
+    m_lastUploadTime(0.0),
+    m_lastUploadBytes(0),
+    m_lastUploadCount(0)
 {
     // Construct an ImageLoader and WMSRequester object. Both of these will can in a separate thread
     // so that reading images from disk and decompressing them won't cause the frame rate to stutter.
@@ -94,6 +102,13 @@ NetworkTextureLoader::NetworkTextureLoader(QObject* parent, bool asynchronous) :
     connect(m_wmsHandler, SIGNAL(imageCompleted(const QString&, const QImage&)),
             this, SLOT(queueTexture(const QString&, const QImage&)));
 
+    // Cancellation is reported from the loader thread; always queue it so that the
+    // texture status is only changed on the thread that manages texture residency.
+    connect(m_wmsHandler, SIGNAL(tileCancelled(const QString&)),
+            this, SLOT(resetCancelledTile(const QString&)), Qt::QueuedConnection);
+    connect(m_wmsHandler, SIGNAL(tileFailed(const QString&)),
+            this, SLOT(reportTileFailure(const QString&)), Qt::QueuedConnection);
+
     if (asynchronous)
     {
         m_imageLoadThread = new QThread();
@@ -156,6 +171,11 @@ NetworkTextureLoader::resolveResourceName(const std::string& resourceName)
     {
         return resourceName;
     }
+    else if (TilePackTiledMap::isTileResourceName(QString::fromUtf8(resourceName.c_str())))
+    {
+        // Tiles in a tile pack are identified by the absolute path of the pack file
+        return resourceName;
+    }
     else if (!resourceName.empty() && (resourceName.at(0) == ':' || resourceName.at(0) == '/' || isWindowsAbsolutePath))
     {
         // Either a Qt internal resource (prefix ':') or an absolute path (prefix '/')
@@ -242,52 +262,120 @@ NetworkTextureLoader::evictTextures()
     const unsigned int limit = m_textureMemoryLimit * meg;
     const unsigned int targetFootprint = limit * 2 / 3;
 
-    if (m_totalMemoryUsage > limit)
+    if (textureMemoryUsed() > limit)
     {
-        m_totalMemoryUsage = TextureMapLoader::evictTextures(targetFootprint, frameCount() - 8);
+        TextureMapLoader::evictTextures(targetFootprint, frameCount() - 8);
         qDebug() << "Evicted textures, frame: " << frameCount();
     }
 }
 
 
-/** Create GL resources for all loaded textures. This method must be called from
+/** Create GL resources for loaded textures. This method must be called from
   * thread in which a GL context is current (such as the display thread.)
+  *
+  * To avoid long frames when many textures finish loading at once, uploads are
+  * limited by a per-frame budget of bytes and milliseconds; textures that don't
+  * fit within the budget are uploaded during following frames. The most recently
+  * used textures are uploaded first, and coarse tiles take precedence over fine
+  * ones, since they're needed in order to show anything at all.
   */
 void
 NetworkTextureLoader::realizeLoadedTextures()
 {
-    foreach (LoadedTexture t, m_loadedTextures)
+    VESTA_PROFILE_SCOPE("NetworkTextureLoader::realizeLoadedTextures");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    m_lastUploadBytes = 0;
+    m_lastUploadCount = 0;
+
+    std::stable_sort(m_loadedTextures.begin(), m_loadedTextures.end(), LoadedTexturePriorityPredicate());
+
+    while (!m_loadedTextures.isEmpty())
     {
+        // Always upload at least one texture so that loading makes progress
+        if (m_lastUploadCount > 0 &&
+            (m_lastUploadBytes >= m_uploadByteBudget || timer.elapsed() >= qint64(m_uploadTimeBudget)))
+        {
+            break;
+        }
+
+        LoadedTexture t = m_loadedTextures.takeFirst();
+        m_lastUploadBytes += t.dataSize();
+        ++m_lastUploadCount;
+
         bool ok = false;
         if (t.ddsImage)
         {
-            ok = SetTextureImage(t.texture, t.ddsImage);
+            ok = SetTextureImage(t.texture.ptr(), t.ddsImage);
             delete t.ddsImage;
         }
         else
         {
-            if (t.texImage.format() == QImage::Format_Indexed8)
-            {
-                // Convert indexed color images to RGB
-                ok = SetTextureImage(t.texture, t.texImage.convertToFormat(QImage::Format_RGB32));
-            }
-            else
-            {
-                ok = SetTextureImage(t.texture, t.texImage);
-            }
+            ok = SetTextureImage(t.texture.ptr(), t.texImage);
         }
 
         if (!ok)
         {
             t.texture->setStatus(TextureMap::LoadingFailed);
         }
-        else
+    }
+
+    m_lastUploadTime = timer.nsecsElapsed() * 1.0e-6;
+
+    VESTA_PROFILE_COUNTER("Textures uploaded", m_lastUploadCount);
+    VESTA_PROFILE_COUNTER("Texture upload bytes", m_lastUploadBytes);
+    VESTA_PROFILE_COUNTER("Texture upload time (ms)", m_lastUploadTime);
+    VESTA_PROFILE_COUNTER("Texture uploads pending", m_loadedTextures.size());
+}
+
+
+unsigned int
+NetworkTextureLoader::LoadedTexture::dataSize() const
+{
+    if (ddsImage)
+    {
+        return ddsImage->size();
+    }
+    else
+    {
+        return texImage.bytesPerLine() * texImage.height();
+    }
+}
+
+
+// Textures used in the most recent frame come first. Among textures used in
+// the same frame, coarser tiles come first.
+bool
+NetworkTextureLoader::LoadedTexturePriorityPredicate::operator()(const LoadedTexture& t0, const LoadedTexture& t1) const
+{
+    if (t0.texture->lastUsed() != t1.texture->lastUsed())
+    {
+        return t0.texture->lastUsed() > t1.texture->lastUsed();
+    }
+    else
+    {
+        return t0.level < t1.level;
+    }
+}
+
+
+void
+NetworkTextureLoader::queueLoadedTexture(LoadedTexture& t)
+{
+    // Record the level of WMS tiles so that coarse tiles can be uploaded first
+    QString textureName = QString::fromUtf8(t.texture->name().c_str());
+    if (textureName.startsWith("wms:"))
+    {
+        WMSRequester::TileAddress tileAddress = WMSRequester::parseTileName(textureName.mid(4));
+        if (tileAddress.valid)
         {
-            m_totalMemoryUsage += t.texture->memoryUsage();
+            t.level = tileAddress.level;
         }
     }
 
-    m_loadedTextures.clear();
+    m_loadedTextures << t;
 }
 
 
@@ -296,10 +384,13 @@ NetworkTextureLoader::queueTexture(vesta::TextureMap* texture, const QImage& ima
 {
     LoadedTexture t;
     t.texture = texture;
-    t.texImage = image;
+
+    // Images should already have been converted by the loading thread; this
+    // is just a fallback.
+    t.texImage = LocalImageLoader::convertToTextureFormat(image);
     t.ddsImage = NULL;
 
-    m_loadedTextures << t;
+    queueLoadedTexture(t);
 }
 
 
@@ -310,7 +401,7 @@ NetworkTextureLoader::queueTexture(vesta::TextureMap* texture, vesta::DataChunk*
     t.texture = texture;
     t.ddsImage = ddsData;
 
-    m_loadedTextures << t;
+    queueLoadedTexture(t);
 }
 
 
@@ -332,6 +423,36 @@ NetworkTextureLoader::reportTextureLoadFailure(vesta::TextureMap* texture)
 }
 
 
+/** Called when the WMS requester abandons a tile that is no longer wanted. The
+  * texture is made uninitialized so that it will be requested again if it becomes
+  * visible later.
+  */
+void
+NetworkTextureLoader::resetCancelledTile(const QString& textureName)
+{
+    TextureMap* texture = m_textureTable.take(textureName);
+    if (texture && texture->status() == TextureMap::Loading)
+    {
+        texture->setStatus(TextureMap::Uninitialized);
+    }
+}
+
+
+/** Called when a WMS tile couldn't be built because of a network error or a bad
+  * image. The texture is marked as failed rather than left loading, so that it
+  * can be released by the tiled map.
+  */
+void
+NetworkTextureLoader::reportTileFailure(const QString& textureName)
+{
+    TextureMap* texture = m_textureTable.take(textureName);
+    if (texture && texture->status() == TextureMap::Loading)
+    {
+        texture->setStatus(TextureMap::LoadingFailed);
+    }
+}
+
+
 QString
 NetworkTextureLoader::localSearchPath() const
 {
@@ -46,6 +46,65 @@ public:
 
     void setTextureMemoryLimit(unsigned int megs);
 
+    /** Get the maximum number of bytes of texture data uploaded per frame.
+      */
+    unsigned int uploadByteBudget() const
+    {
+        return m_uploadByteBudget;
+    }
+
+    /** Set the maximum number of bytes of texture data uploaded per frame.
+      * At least one texture is always uploaded, even if it is larger than
+      * the budget.
+      */
+    void setUploadByteBudget(unsigned int bytes)
+    {
+        m_uploadByteBudget = bytes;
+    }
+
+    /** Get the maximum time in milliseconds spent uploading textures per frame.
+      */
+    unsigned int uploadTimeBudget() const
+    {
+        return m_uploadTimeBudget;
+    }
+
+    /** Set the maximum time in milliseconds spent uploading textures per frame.
+      */
+    void setUploadTimeBudget(unsigned int milliseconds)
+    {
+        m_uploadTimeBudget = milliseconds;
+    }
+
+    /** Get the time in milliseconds spent uploading textures during the last
+      * call to realizeLoadedTextures().
+      */
+    double lastUploadTime() const
+    {
+        return m_lastUploadTime;
+    }
+
+    /** Get the number of bytes uploaded during the last call to realizeLoadedTextures().
+      */
+    unsigned int lastUploadBytes() const
+    {
+        return m_lastUploadBytes;
+    }
+
+    /** Get the number of textures uploaded during the last call to realizeLoadedTextures().
+      */
+    unsigned int lastUploadCount() const
+    {
+        return m_lastUploadCount;
+    }
+
+    /** Get the number of loaded textures waiting to be uploaded.
+      */
+    unsigned int pendingUploadCount() const
+    {
+        return (unsigned int) m_loadedTextures.size();
+    }
+
     // Required by PathRelativeTextureLoader
     virtual std::string searchPath() const;
     virtual void setSearchPath(const std::string& path);
@@ -58,6 +117,8 @@ public slots:
     void queueTexture(vesta::TextureMap* texture, vesta::DataChunk* ddsData);
     void queueTexture(const QString& textureName, const QImage& image);
     void reportTextureLoadFailure(vesta::TextureMap* texture);
+    void resetCancelledTile(const QString& textureName);
+    void reportTileFailure(const QString& textureName);
 
 signals:
     void wmsTileRequested(const QString& tileName,
@@ -72,25 +133,46 @@ private:
     {
         LoadedTexture() :
             ddsImage(NULL),
-            texture(NULL)
+            level(0)
         {
         }
 
+        unsigned int dataSize() const;
+
         // The texture data is either a QImage or a DataChunk (for formats not handled
         // by Qt.)
         QImage texImage;
         vesta::DataChunk* ddsImage;
-        vesta::TextureMap* texture;
+
+        // Keep a reference so that the texture isn't deleted while the upload
+        // is waiting for a later frame.
+        vesta::counted_ptr<vesta::TextureMap> texture;
+
+        // Tile level; zero for textures that aren't part of a tiled map
+        unsigned int level;
+    };
+
+    class LoadedTexturePriorityPredicate
+    {
+    public:
+        bool operator()(const LoadedTexture& t0, const LoadedTexture& t1) const;
     };
 
+    void queueLoadedTexture(LoadedTexture& t);
+
 private:
     QList<LoadedTexture> m_loadedTextures;
     QHash<QString, vesta::TextureMap*> m_textureTable;
     LocalImageLoader* m_localImageLoader;
     WMSRequester* m_wmsHandler;
     QThread* m_imageLoadThread;
-    unsigned int m_totalMemoryUsage;
     unsigned int m_textureMemoryLimit;
+
+    unsigned int m_uploadByteBudget;
+    unsigned int m_uploadTimeBudget;
+    double m_lastUploadTime;
+    unsigned int m_lastUploadBytes;
+    unsigned int m_lastUploadCount;
 };
 
 #endif // _NETWORK_TEXTURE_LOADER_H_
@@ -24,7 +24,8 @@ using namespace std;
 
 SkyLabelLayer::SkyLabelLayer() :
     m_opacity(1.0f),
-    m_labelCulling(true)
+    m_labelCulling(true),
+    m_placementPriority(-1.0f)
 {
 }
 
@@ -44,6 +45,22 @@ SkyLabelLayer::render(vesta::RenderContext& rc)
     rc.bindMaterial(&material);
     glDepthMask(GL_FALSE);
 
+    processLabels(rc, DrawLabels);
+}
+
+
+void
+SkyLabelLayer::submitLabels(vesta::RenderContext& rc)
+{
+    processLabels(rc, SubmitLabels);
+}
+
+
+// Submit the visible labels for placement or draw the ones that were placed. The
+// same labels are visited in both cases.
+void
+SkyLabelLayer::processLabels(vesta::RenderContext& rc, LabelAction action)
+{
     Quaterniond orientation = Quaterniond::Identity();
 
     rc.pushModelView();
@@ -53,6 +70,10 @@ SkyLabelLayer::render(vesta::RenderContext& rc)
 
     float fov = rc.pixelSize() * rc.viewportHeight();
 
+    TextureFont* font = m_font.isValid() ? m_font.ptr() : rc.defaultFont();
+    float ascent = font ? font->maxAscent() : 0.0f;
+    float descent = font ? font->maxDescent() : 0.0f;
+
     for (vector<SkyLabel>::const_iterator iter = m_labels.begin(); iter != m_labels.end(); ++iter)
     {
         const SkyLabel& label = *iter;
@@ -64,11 +85,24 @@ SkyLabelLayer::render(vesta::RenderContext& rc)
 
             if (!m_labelCulling || !cull)
             {
-                Spectrum color(label.color[0], label.color[1], label.color[2]);
+                unsigned int labelIndex = (unsigned int) (iter - m_labels.begin());
 
                 rc.pushModelView();
                 rc.translateModelView(label.position);
-                rc.drawEncodedText(Vector3f::Zero(), label.text, m_font.ptr(), TextureFont::Utf8, color, m_opacity);
+
+                if (action == SubmitLabels)
+                {
+                    const TextLayout* layout = rc.textLayout(label.text, font, TextureFont::Utf8);
+                    float textWidth = layout ? layout->width : 0.0f;
+                    rc.submitLabel(this, labelIndex,
+                                   Vector2f(0.0f, -descent), Vector2f(textWidth, ascent),
+                                   m_placementPriority);
+                }
+                else if (rc.isLabelPlaced(this, labelIndex))
+                {
+                    Spectrum color(label.color[0], label.color[1], label.color[2]);
+                    rc.drawEncodedText(Vector3f::Zero(), label.text, m_font.ptr(), TextureFont::Utf8, color, m_opacity);
+                }
                 rc.popModelView();
             }
         }
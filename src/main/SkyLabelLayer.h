@@ -33,6 +33,7 @@ public:
     /** Draw the sky layer. Subclasses must implement this method.
       */
     virtual void render(vesta::RenderContext& rc);
+    virtual void submitLabels(vesta::RenderContext& rc);
 
     void addLabel(const std::string& labelText, double latitude, double longitude, const vesta::Spectrum& color, float minimumFov = 3.141592f);
 
@@ -69,6 +70,29 @@ public:
         return m_labelCulling;
     }
 
+    /** Set the priority of labels in this layer for decluttering. Sky labels
+      * have a low priority by default so that they yield to labels of solar
+      * system objects.
+      */
+    void setPlacementPriority(float priority)
+    {
+        m_placementPriority = priority;
+    }
+
+    float placementPriority() const
+    {
+        return m_placementPriority;
+    }
+
+private:
+    enum LabelAction
+    {
+        SubmitLabels,
+        DrawLabels
+    };
+
+    void processLabels(vesta::RenderContext& rc, LabelAction action);
+
 private:
     struct SkyLabel
     {
@@ -84,6 +108,7 @@ private:
     vesta::counted_ptr<vesta::TextureFont> m_font;
     float m_opacity;
     bool m_labelCulling;
+    float m_placementPriority;
 };
 
 #endif // _SKY_LABEL_LAYER_H_
@@ -0,0 +1,300 @@
+// Copyright (C) 2010 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TileDiskCache.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+
+// Cached tiles are stored with a short header followed by the raw scan lines
+// of the image. The cache is private to one machine, so values are written
+// with native byte order.
+struct TileFileHeader
+{
+    char magic[4];
+    quint32 width;
+    quint32 height;
+    quint32 format;
+    quint32 bytesPerLine;
+};
+
+static const char TileFileMagic[4] = { 'C', 'T', 'L', 'C' };
+
+
+static bool fileModifiedBefore(const QFileInfo& f0, const QFileInfo& f1)
+{
+    return f0.lastModified() < f1.lastModified();
+}
+
+
+/** Create a new tile cache. The contents of the cache directory aren't examined
+  * until a tile is loaded or stored, so the cache may be constructed on a different
+  * thread than the one that uses it.
+  */
+TileDiskCache::TileDiskCache(const QString& directory, qint64 maxSize) :
+    m_directory(directory),
+    m_maxSize(maxSize),
+    m_size(0),
+    m_scanned(false),
+    m_accessCounter(0),
+    m_hits(0),
+    m_misses(0)
+{
+}
+
+
+TileDiskCache::~TileDiskCache()
+{
+}
+
+
+/** Set the maximum total size in bytes of the tile files. Tiles are
+  * deleted immediately if the cache is currently larger.
+  */
+void
+TileDiskCache::setMaxSize(qint64 bytes)
+{
+    m_maxSize = bytes;
+    if (m_scanned)
+    {
+        evict(m_maxSize);
+    }
+}
+
+
+/** Load a tile from the cache.
+  *
+  * \return the tile image, or a null image if the tile isn't cached
+  */
+QImage
+TileDiskCache::loadTile(const QString& surface, unsigned int level, unsigned int x, unsigned int y)
+{
+    scan();
+
+    QString path = tilePath(surface, level, x, y);
+    if (!m_entries.contains(path))
+    {
+        ++m_misses;
+        return QImage();
+    }
+
+    QFile file(m_directory + "/" + path);
+    TileFileHeader header;
+    if (!file.open(QIODevice::ReadOnly) ||
+        file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, TileFileMagic, sizeof(TileFileMagic)) != 0 ||
+        header.format == QImage::Format_Invalid || header.format >= QImage::NImageFormats)
+    {
+        qDebug() << "Removing bad tile from cache: " << path;
+        file.close();
+        QFile::remove(m_directory + "/" + path);
+        removeEntry(path);
+        ++m_misses;
+        return QImage();
+    }
+
+    QImage image(int(header.width), int(header.height), QImage::Format(header.format));
+    qint64 dataSize = qint64(header.bytesPerLine) * header.height;
+    if (image.isNull() ||
+        quint32(image.bytesPerLine()) != header.bytesPerLine ||
+        file.read(reinterpret_cast<char*>(image.bits()), dataSize) != dataSize)
+    {
+        qDebug() << "Removing bad tile from cache: " << path;
+        file.close();
+        QFile::remove(m_directory + "/" + path);
+        removeEntry(path);
+        ++m_misses;
+        return QImage();
+    }
+
+    touch(path);
+    ++m_hits;
+
+    return image;
+}
+
+
+/** Store a tile in the cache, replacing any existing tile with the same
+  * address. Least recently used tiles are deleted if necessary to keep the
+  * cache size within the limit.
+  *
+  * \return true if the tile was written successfully
+  */
+bool
+TileDiskCache::storeTile(const QString& surface, unsigned int level, unsigned int x, unsigned int y, const QImage& image)
+{
+    scan();
+
+    if (image.isNull())
+    {
+        return false;
+    }
+
+    QString path = tilePath(surface, level, x, y);
+    QString fileName = m_directory + "/" + path;
+
+    QDir tileDir = QFileInfo(fileName).dir();
+    if (!tileDir.exists())
+    {
+        tileDir.mkpath(tileDir.absolutePath());
+    }
+
+    TileFileHeader header;
+    memcpy(header.magic, TileFileMagic, sizeof(TileFileMagic));
+    header.width = image.width();
+    header.height = image.height();
+    header.format = image.format();
+    header.bytesPerLine = image.bytesPerLine();
+    qint64 dataSize = qint64(header.bytesPerLine) * header.height;
+
+    // Write to a temporary file first so that a partially written tile is
+    // never found in the cache.
+    QString tempFileName = fileName + ".tmp";
+    QFile file(tempFileName);
+    bool ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+              file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header) &&
+              file.write(reinterpret_cast<const char*>(image.constBits()), dataSize) == dataSize;
+    file.close();
+
+    if (ok)
+    {
+        QFile::remove(fileName);
+        ok = QFile::rename(tempFileName, fileName);
+    }
+
+    if (!ok)
+    {
+        qDebug() << "Failed writing to " << fileName;
+        QFile::remove(tempFileName);
+        return false;
+    }
+
+    removeEntry(path);
+    evict(max(qint64(0), m_maxSize - qint64(sizeof(header)) - dataSize));
+    addEntry(path, qint64(sizeof(header)) + dataSize);
+
+    return true;
+}
+
+
+QString
+TileDiskCache::tilePath(const QString& surface, unsigned int level, unsigned int x, unsigned int y) const
+{
+    return QString("%1/%2/%3_%4.tile").arg(surface).arg(level).arg(x).arg(y);
+}
+
+
+// Build the index of cached files on first use. Files are ordered by modification
+// time, so the tiles that were written longest ago are the first to be evicted.
+// Anything else in the directory is deleted: older versions cached PNG tiles
+// here, and those would use up the size limit without ever being read. Temporary
+// files left by an interrupted storeTile() are removed too.
+void
+TileDiskCache::scan()
+{
+    if (m_scanned)
+    {
+        return;
+    }
+    m_scanned = true;
+
+    QList<QFileInfo> files;
+    unsigned int purgedCount = 0;
+    QDirIterator iter(m_directory, QDir::Files, QDirIterator::Subdirectories);
+    while (iter.hasNext())
+    {
+        iter.next();
+        if (iter.fileInfo().suffix() == "tile")
+        {
+            files << iter.fileInfo();
+        }
+        else if (QFile::remove(iter.filePath()))
+        {
+            ++purgedCount;
+        }
+    }
+
+    if (purgedCount > 0)
+    {
+        qDebug() << "Removed" << purgedCount << "old files from tile cache" << m_directory;
+    }
+
+    std::sort(files.begin(), files.end(), fileModifiedBefore);
+
+    QDir dir(m_directory);
+    foreach (QFileInfo info, files)
+    {
+        addEntry(dir.relativeFilePath(info.absoluteFilePath()), info.size());
+    }
+
+    evict(m_maxSize);
+
+    qDebug() << "Tile cache" << m_directory << "contains" << m_entries.size() << "files," << m_size / (1024 * 1024) << "MB";
+}
+
+
+void
+TileDiskCache::touch(const QString& path)
+{
+    Entry& entry = m_entries[path];
+    m_accessOrder.remove(entry.lastAccess);
+    entry.lastAccess = ++m_accessCounter;
+    m_accessOrder.insert(entry.lastAccess, path);
+}
+
+
+void
+TileDiskCache::addEntry(const QString& path, qint64 size)
+{
+    Entry entry;
+    entry.size = size;
+    entry.lastAccess = ++m_accessCounter;
+    m_entries.insert(path, entry);
+    m_accessOrder.insert(entry.lastAccess, path);
+    m_size += size;
+}
+
+
+void
+TileDiskCache::removeEntry(const QString& path)
+{
+    QHash<QString, Entry>::iterator iter = m_entries.find(path);
+    if (iter != m_entries.end())
+    {
+        m_size -= iter->size;
+        m_accessOrder.remove(iter->lastAccess);
+        m_entries.erase(iter);
+    }
+}
+
+
+// Delete least recently used files until the total size is no more than maxSize
+void
+TileDiskCache::evict(qint64 maxSize)
+{
+    while (m_size > maxSize && !m_accessOrder.isEmpty())
+    {
+        QString path = m_accessOrder.begin().value();
+        QFile::remove(m_directory + "/" + path);
+        removeEntry(path);
+    }
+}
@@ -0,0 +1,115 @@
+// Copyright (C) 2010 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _TILE_DISK_CACHE_H_
+#define _TILE_DISK_CACHE_H_
+
+#include <QString>
+#include <QImage>
+#include <QHash>
+#include <QMap>
+
+
+/** TileDiskCache stores finished texture tiles on disk so that they can be
+  * reloaded without any network requests, image decoding, or compositing.
+  * Tiles are stored as raw pixels in exactly the form that they're handed
+  * to the texture loader.
+  *
+  * The total size of the cache is bounded. When it fills up, the least
+  * recently used tiles are deleted. Raw tiles are large (768 KB for a
+  * 512x512 RGB tile), so the default limit of 2 GB holds about 2700 tiles.
+  * Files in the cache directory that aren't tiles, such as the PNG tiles
+  * written by older versions, are deleted when the cache is first used.
+  *
+  * TileDiskCache isn't thread safe; it should only be used from the thread
+  * that handles tile requests.
+  */
+class TileDiskCache
+{
+public:
+    TileDiskCache(const QString& directory, qint64 maxSize = DefaultMaxSize);
+    ~TileDiskCache();
+
+    /** Get the directory in which tiles are stored.
+      */
+    QString directory() const
+    {
+        return m_directory;
+    }
+
+    /** Get the maximum size in bytes of all files in the cache.
+      */
+    qint64 maxSize() const
+    {
+        return m_maxSize;
+    }
+
+    void setMaxSize(qint64 bytes);
+
+    /** Get the total size in bytes of all files in the cache. The size
+      * is zero until the cache directory has been scanned on first use.
+      */
+    qint64 size() const
+    {
+        return m_size;
+    }
+
+    /** Get the number of tile lookups that were found in the cache.
+      */
+    unsigned int hits() const
+    {
+        return m_hits;
+    }
+
+    /** Get the number of tile lookups that weren't found in the cache.
+      */
+    unsigned int misses() const
+    {
+        return m_misses;
+    }
+
+    QImage loadTile(const QString& surface, unsigned int level, unsigned int x, unsigned int y);
+    bool storeTile(const QString& surface, unsigned int level, unsigned int x, unsigned int y, const QImage& image);
+
+    static const qint64 DefaultMaxSize = qint64(2048) * 1024 * 1024;
+
+private:
+    struct Entry
+    {
+        qint64 size;
+        quint64 lastAccess;
+    };
+
+    QString tilePath(const QString& surface, unsigned int level, unsigned int x, unsigned int y) const;
+    void scan();
+    void touch(const QString& path);
+    void addEntry(const QString& path, qint64 size);
+    void removeEntry(const QString& path);
+    void evict(qint64 maxSize);
+
+private:
+    QString m_directory;
+    qint64 m_maxSize;
+    qint64 m_size;
+    bool m_scanned;
+
+    QHash<QString, Entry> m_entries;
+    QMap<quint64, QString> m_accessOrder;
+    quint64 m_accessCounter;
+
+    unsigned int m_hits;
+    unsigned int m_misses;
+};
+
+#endif // _TILE_DISK_CACHE_H_
@@ -37,7 +37,8 @@ TwoVectorFrame::TwoVectorFrame(TwoVectorFrameDirection *primary, Axis primaryAxi
     m_secondary(secondary),
     m_primaryAxis(primaryAxis),
     m_secondaryAxis(secondaryAxis),
-    m_valid(false)
+    m_valid(false),
+    m_nextCacheEntry(0)
 {
     if (!primary || !secondary)
     {
@@ -71,75 +72,158 @@ TwoVectorFrame::~TwoVectorFrame()
   */
 Quaterniond TwoVectorFrame::orientation(double tdbSec) const
 {
-    if (!m_valid)
-    {
-        return Quaterniond::Identity();
-    }
-    else
-    {
-        Vector3d v0 = m_primary->direction(tdbSec);
-        Vector3d v1 = m_secondary->direction(tdbSec);
-        if (v0.isZero() || v1.isZero())
-        {
-            // The primary or secondary vectors are zero at the current time
-            return Quaterniond::Identity();
-        }
+    return update(tdbSec).orientation;
+}
 
-        v0.normalize();
-        v1.normalize();
-        if (isNegativeAxis(m_primaryAxis))
-        {
-            v0 = -v0;
-        }
-        if (isNegativeAxis(m_secondaryAxis))
-        {
-            v1 = -v1;
-        }
 
-        Vector3d v2 = v0.cross(v1);
-        if (v2.isZero())
-        {
-            // Primary and secondary directions are (nearly) collinear and thus
-            // don't determine an orientation.
-            return Quaterniond::Identity();
-        }
-        v2.normalize();
+/** Return the angular velocity of the frame at the specified time. The
+  * angular velocity is computed analytically from the directions and their
+  * rates of change. It is zero whenever the orientation is undefined.
+  */
+Vector3d TwoVectorFrame::angularVelocity(double tdbSec) const
+{
+    return update(tdbSec).angularVelocity;
+}
+
+
+/** Discard the memoized orientations of all two vector frames. This must be
+  * called whenever a trajectory or frame that a direction depends on changes.
+  */
+void
+TwoVectorFrame::InvalidateCachedStates()
+{
+    ++ms_generation;
+}
 
-        int dir0 = (int) m_primaryAxis;
-        int dir1 = (int) m_secondaryAxis;
-        int axis0 = dir0 % 3;
-        int axis1 = dir1 % 3;
-        bool rightHanded = ((axis0 + 1) % 3) == (axis1 % 3);
 
-        // axis2 is whatever axis is not axis0 or axis1
-        int axis2 = 3 - (axis0 + axis1);
+unsigned int TwoVectorFrame::ms_generation = 0;
 
 
-        Matrix3d m;
-        m.col(axis0) = v0;
-        m.col(axis1) = v2.cross(v0);
-        if (rightHanded)
+// Get the orientation and angular velocity of the frame at the specified time,
+// computing them unless they were already computed for that time.
+const TwoVectorFrame::CachedState&
+TwoVectorFrame::update(double tdbSec) const
+{
+    for (unsigned int i = 0; i < CacheSize; ++i)
+    {
+        const CachedState& entry = m_cache[i];
+        if (entry.valid && entry.tdbSec == tdbSec && entry.generation == ms_generation)
         {
-            m.col(axis2) = v2;
+            return entry;
         }
-        else
+    }
+
+    // Evaluating the directions may evaluate other frames, so the state is
+    // computed before a cache entry is chosen.
+    CachedState state;
+    computeState(tdbSec, state);
+
+    // Replace a stale entry for the same time if there is one, otherwise the
+    // oldest entry.
+    unsigned int index = CacheSize;
+    for (unsigned int i = 0; i < CacheSize; ++i)
+    {
+        if (m_cache[i].valid && m_cache[i].tdbSec == tdbSec)
         {
-            m.col(axis2) = -v2;
+            index = i;
+            break;
         }
-
-        return Quaterniond(m);
     }
+    if (index == CacheSize)
+    {
+        index = m_nextCacheEntry;
+        m_nextCacheEntry = (m_nextCacheEntry + 1) % CacheSize;
+    }
+
+    m_cache[index] = state;
+    return m_cache[index];
 }
 
 
-Vector3d TwoVectorFrame::angularVelocity(double tdbSec) const
+// Compute the orientation and angular velocity of the frame at the specified
+// time.
+void
+TwoVectorFrame::computeState(double tdbSec, CachedState& state) const
 {
+    state.valid = true;
+    state.tdbSec = tdbSec;
+    state.generation = ms_generation;
+    state.orientation = Quaterniond::Identity();
+    state.angularVelocity = Vector3d::Zero();
+
     if (!m_valid)
     {
-        return Vector3d::Zero();
+        return;
+    }
+
+    StateVector s0 = m_primary->directionState(tdbSec);
+    StateVector s1 = m_secondary->directionState(tdbSec);
+    Vector3d v0 = s0.position();
+    Vector3d v1 = s1.position();
+    Vector3d dv0 = s0.velocity();
+    Vector3d dv1 = s1.velocity();
+    if (v0.isZero() || v1.isZero())
+    {
+        // The primary or secondary vectors are zero at the current time
+        return;
     }
 
-    return Vector3d::Zero();
+    if (isNegativeAxis(m_primaryAxis))
+    {
+        v0 = -v0;
+        dv0 = -dv0;
+    }
+    if (isNegativeAxis(m_secondaryAxis))
+    {
+        v1 = -v1;
+        dv1 = -dv1;
+    }
+
+    Vector3d u0 = v0.normalized();
+    Vector3d u2 = u0.cross(v1.normalized());
+    if (u2.isZero())
+    {
+        // Primary and secondary directions are (nearly) collinear and thus
+        // don't determine an orientation.
+        return;
+    }
+    u2.normalize();
+    Vector3d u1 = u2.cross(u0);
+
+    int dir0 = (int) m_primaryAxis;
+    int dir1 = (int) m_secondaryAxis;
+    int axis0 = dir0 % 3;
+    int axis1 = dir1 % 3;
+    bool rightHanded = ((axis0 + 1) % 3) == (axis1 % 3);
+
+    // axis2 is whatever axis is not axis0 or axis1
+    int axis2 = 3 - (axis0 + axis1);
+
+    Matrix3d m;
+    m.col(axis0) = u0;
+    m.col(axis1) = u1;
+    if (rightHanded)
+    {
+        m.col(axis2) = u2;
+    }
+    else
+    {
+        m.col(axis2) = -u2;
+    }
+
+    state.orientation = Quaterniond(m);
+
+    // The rates of change of the unit vectors u0 and u2 are the components
+    // of the rates of v0 and v0 x v1 perpendicular to those vectors. Each
+    // axis u obeys du/dt = w x u; the component of the angular velocity w
+    // perpendicular to u0 is u0 x du0/dt, and the component along u0 follows
+    // from du2/dt = -(w.u0) u1 + (w.u1) u0.
+    Vector3d n = v0.cross(v1);
+    Vector3d dn = dv0.cross(v1) + v0.cross(dv1);
+    Vector3d du0 = (dv0 - u0 * u0.dot(dv0)) / v0.norm();
+    Vector3d du2 = (dn - u2 * u2.dot(dn)) / n.norm();
+
+    state.angularVelocity = u0.cross(du0) - du2.dot(u1) * u0;
 }
 
 
@@ -155,6 +239,28 @@ TwoVectorFrame::orthogonalAxes(TwoVectorFrame::Axis a, TwoVectorFrame::Axis b)
 
 
 
+// Time step used for numerically differentiating directions
+static const double DerivativeTimeStep = 1.0;
+
+
+/** Return the direction and its rate of change at the specified time. The
+  * direction is stored in the position of the returned state vector and its
+  * time derivative in the velocity.
+  *
+  * The default implementation differentiates direction() numerically.
+  * Subclasses should override this method when the derivative is available
+  * analytically.
+  */
+StateVector
+TwoVectorFrameDirection::directionState(double tdbSec) const
+{
+    Vector3d d0 = direction(tdbSec - DerivativeTimeStep);
+    Vector3d d1 = direction(tdbSec + DerivativeTimeStep);
+
+    return StateVector(direction(tdbSec), (d1 - d0) / (2.0 * DerivativeTimeStep));
+}
+
+
 RelativePositionVector::RelativePositionVector(vesta::Entity* observer, vesta::Entity* target) :
     m_observer(observer),
     m_target(target)
@@ -181,6 +287,20 @@ RelativePositionVector::direction(double tdbSec) const
 }
 
 
+StateVector
+RelativePositionVector::directionState(double tdbSec) const
+{
+    if (m_observer.isValid() && m_target.isValid())
+    {
+        return m_target->state(tdbSec) - m_observer->state(tdbSec);
+    }
+    else
+    {
+        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+    }
+}
+
+
 RelativeVelocityVector::RelativeVelocityVector(vesta::Entity* observer, vesta::Entity* target) :
     m_observer(observer),
     m_target(target)
@@ -236,3 +356,18 @@ ConstantFrameDirection::direction(double tdbSec) const
         return Vector3d::Zero();
     }
 }
+
+
+StateVector
+ConstantFrameDirection::directionState(double tdbSec) const
+{
+    if (m_frame.isValid())
+    {
+        Vector3d d = m_frame->orientation(tdbSec) * m_vector;
+        return StateVector(d, m_frame->angularVelocity(tdbSec).cross(d));
+    }
+    else
+    {
+        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+    }
+}
@@ -19,6 +19,7 @@
 
 #include <vesta/Frame.h>
 #include <vesta/Entity.h>
+#include <vesta/StateVector.h>
 
 
 class TwoVectorFrameDirection : public vesta::Object
@@ -30,6 +31,8 @@ public:
       * rotation when one or more directions is zero.
       */
     virtual Eigen::Vector3d direction(double tdbSec) const = 0;
+
+    virtual vesta::StateVector directionState(double tdbSec) const;
 };
 
 
@@ -39,6 +42,7 @@ public:
     RelativePositionVector(vesta::Entity* observer, vesta::Entity* target);
     ~RelativePositionVector();
     virtual Eigen::Vector3d direction(double tdbSec) const;
+    virtual vesta::StateVector directionState(double tdbSec) const;
 
     vesta::Entity* observer() const
     {
@@ -85,6 +89,7 @@ public:
     ConstantFrameDirection(vesta::Frame* frame, const Eigen::Vector3d& vector);
     ~ConstantFrameDirection();
     virtual Eigen::Vector3d direction(double tdbSec) const;
+    virtual vesta::StateVector directionState(double tdbSec) const;
 
     Eigen::Vector3d vector() const
     {
@@ -102,9 +107,25 @@ private:
 };
 
 
+/** A TwoVectorFrame is defined by two direction vectors: the primary
+  * direction fixes one axis of the frame, and the secondary direction
+  * constrains a second axis to lie in the plane of the two vectors.
+  *
+  * Evaluating the directions usually requires computing the states of
+  * several entities, so the orientation and angular velocity are memoized
+  * for the few most recently evaluated times. Repeated queries at the same
+  * time (e.g. from the children of an entity that uses the frame) are then
+  * cheap.
+  *
+  * Memoized values become stale when a trajectory changes, e.g. when a new
+  * TLE is received or a catalog is reloaded. InvalidateCachedStates() must
+  * be called after such changes.
+  */
 class TwoVectorFrame : public vesta::Frame
 {
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
     enum Axis
     {
         PositiveX = 0,
@@ -143,13 +164,47 @@ public:
     }
 
     static bool orthogonalAxes(TwoVectorFrame::Axis a, TwoVectorFrame::Axis b);
+    static void InvalidateCachedStates();
 
 private:
+    struct CachedState
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        CachedState() :
+            valid(false),
+            tdbSec(0.0),
+            generation(0),
+            orientation(Eigen::Quaterniond::Identity()),
+            angularVelocity(Eigen::Vector3d::Zero())
+        {
+        }
+
+        bool valid;
+        double tdbSec;
+        unsigned int generation;
+        Eigen::Quaterniond orientation;
+        Eigen::Vector3d angularVelocity;
+    };
+
+    const CachedState& update(double tdbSec) const;
+    void computeState(double tdbSec, CachedState& state) const;
+
     vesta::counted_ptr<TwoVectorFrameDirection> m_primary;
     vesta::counted_ptr<TwoVectorFrameDirection> m_secondary;
     Axis m_primaryAxis;
     Axis m_secondaryAxis;
     bool m_valid;
+
+    // Orientation and angular velocity at recently evaluated times. More than
+    // one time is kept so that the samples taken by numeric derivatives of
+    // directions (at times on either side of the current time) don't evict
+    // the state at the current time.
+    static const unsigned int CacheSize = 3;
+    mutable CachedState m_cache[CacheSize];
+    mutable unsigned int m_nextCacheEntry;
+
+    static unsigned int ms_generation;
 };
 
 #endif // _TWO_VECTOR_FRAME_H_
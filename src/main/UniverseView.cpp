@@ -37,6 +37,7 @@
 #include "geometry/FeatureLabelSetGeometry.h"
 
 #include "NumberFormat.h"
+#include "VideoCapture.h"
 
 #if FFMPEG_SUPPORT
 #include "QVideoEncoder.h"
@@ -48,6 +49,7 @@
 #include <vesta/Arc.h>
 #include <vesta/Body.h>
 #include <vesta/Units.h>
+#include <vesta/Profiler.h>
 #include <vesta/Universe.h>
 #include <vesta/UniverseRenderer.h>
 #include <vesta/WorldGeometry.h>
@@ -65,6 +67,7 @@
 #include <vesta/NadirVisualizer.h>
 #include <vesta/BodyDirectionVisualizer.h>
 #include <vesta/LabelVisualizer.h>
+#include <vesta/LabelPlacement.h>
 #include <vesta/TrajectoryGeometry.h>
 #include <vesta/TextureFont.h>
 #include <vesta/DataChunk.h>
@@ -109,6 +112,7 @@
 #include <QQmlComponent>
 #include <QQmlContext>
 #include <QQuickItem>
+#include <QOpenGLContext>
 
 using namespace vesta;
 using namespace Eigen;
@@ -374,11 +378,14 @@ UniverseView::UniverseView(QWindow *parent, Universe* universe, UniverseCatalog*
     m_sunGlareEnabled(true),
     m_planetOrbitsVisible(false),
     m_infoTextVisible(true),
+    m_performanceOverlayVisible(false),
     m_labelsVisible(true),
     m_surfaceFeatureLabelsVisible(false),
     m_centerIndicatorVisible(true),
     m_gotoObjectTime(6.0),
     m_videoEncoder(NULL),
+    m_finishedVideoEncoder(NULL),
+    m_videoCapture(NULL),
     m_videoRecordingStartTime(0.0),
     m_timeDisplay(TimeDisplay_UTC),
     m_wireframe(false),
@@ -402,6 +409,9 @@ UniverseView::UniverseView(QWindow *parent, Universe* universe, UniverseCatalog*
     m_textureLoader = new NetworkTextureLoader(this);
     m_renderer = new UniverseRenderer();
     m_renderer->setDefaultSunEnabled(false);
+    m_labelPlacement = new LabelPlacement();
+    m_rightEyeLabelPlacement = new LabelPlacement();
+    m_renderer->setLabelPlacement(m_labelPlacement.ptr());
 
     m_labelFont = new TextureFont();
     m_textFont = new TextureFont();
@@ -466,9 +476,50 @@ UniverseView::UniverseView(QWindow *parent, Universe* universe, UniverseCatalog*
 
 UniverseView::~UniverseView()
 {
-    //makeCurrent();
+    // The scene graph may be torn down after this object is partly destroyed,
+    // so invalidateUnderlay() must not be called from here on.
+    disconnect(this, SIGNAL(sceneGraphInvalidated()), this, SLOT(invalidateUnderlay()));
+
+    // The video capture pipeline owns pixel buffer objects, which can only be
+    // deleted with the GL context current. Make sure that a recording in
+    // progress ends up as a complete video file.
+    QOpenGLContext* context = openglContext();
+    bool contextCurrent = context && context->makeCurrent(this);
+    if (m_videoCapture)
+    {
+        if (contextCurrent)
+        {
+            finishVideoCapture();
+        }
+        else
+        {
+            // The context belongs to the render thread; frames still waiting
+            // in pixel buffers are lost.
+            m_videoCapture->abandon();
+            delete m_videoCapture;
+            m_videoCapture = NULL;
+        }
+    }
+#if FFMPEG_SUPPORT || QTKIT_SUPPORT
+    if (m_videoEncoder)
+    {
+        m_videoEncoder->close();
+        delete m_videoEncoder;
+    }
+    if (m_finishedVideoEncoder)
+    {
+        m_finishedVideoEncoder->close();
+        delete m_finishedVideoEncoder;
+    }
+#endif
+
     delete m_galleryView;
     delete m_renderer;
+
+    if (contextCurrent)
+    {
+        context->doneCurrent();
+    }
 }
 
 
@@ -487,8 +538,12 @@ void UniverseView::renderUnderlay()
     resetOpenGLState();
 }
 
+// Called with the GL context current when the scene graph is torn down; GL
+// resources of the video capture pipeline have to be released now.
 void UniverseView::invalidateUnderlay()
-{}
+{
+    finishVideoCapture();
+}
 
 TextureFont*
 UniverseView::font(FontRole role) const
@@ -559,6 +614,37 @@ setLabelFadeRange(LabelGeometry* label, Entity* body, const BodyInfo* info, vest
 }
 
 
+// Priority of a body label when overlapping labels are decluttered. Labels of
+// more prominent classes of objects are shown in preference to others; within a
+// class, the label of the object nearest the camera wins.
+static float
+labelPlacementPriority(const BodyInfo* info)
+{
+    if (!info)
+    {
+        return 0.0f;
+    }
+
+    switch (info->classification)
+    {
+    case BodyInfo::Star:
+        return 6.0f;
+    case BodyInfo::Planet:
+        return 5.0f;
+    case BodyInfo::DwarfPlanet:
+        return 4.0f;
+    case BodyInfo::Satellite:
+        return 3.0f;
+    case BodyInfo::Spacecraft:
+        return 2.0f;
+    case BodyInfo::Asteroid:
+        return 1.0f;
+    default:
+        return 0.0f;
+    }
+}
+
+
 static Visualizer*
 labelBody(Entity* planet, const BodyInfo* info, const QString& labelText, TextureFont* font, TextureMap* icon, const Spectrum& color, double fadeSize, bool visible)
 {
@@ -600,6 +686,7 @@ labelBody(Entity* planet, const BodyInfo* info, const QString& labelText, Textur
             LabelVisualizer* label = new LabelVisualizer(labelText.toUtf8().data(), font, color, 6.0f);
             label->label()->setIcon(icon);
             label->label()->setIconColor(color);
+            label->label()->setPlacementPriority(labelPlacementPriority(info));
             setLabelFadeRange(label->label(), planet, info, arc, fadeSize);
             multiLabel->addLabel(startTime, label);
             startTime += arc->duration();
@@ -612,6 +699,7 @@ labelBody(Entity* planet, const BodyInfo* info, const QString& labelText, Textur
         LabelVisualizer* labelVis = new LabelVisualizer(labelText.toUtf8().data(), font, color, 6.0f);
         labelVis->label()->setIcon(icon);
         labelVis->label()->setIconColor(color);
+        labelVis->label()->setPlacementPriority(labelPlacementPriority(info));
         setLabelFadeRange(labelVis->label(), planet, info, planet->chronology()->firstArc(), fadeSize);
         vis = labelVis;
     }
@@ -1390,10 +1478,56 @@ UniverseView::drawInfoOverlay()
         glEnd();
     }
 
+    if (m_performanceOverlayVisible)
+    {
+        drawPerformanceOverlay();
+    }
+
     end2DDrawing();
 }
 
 
+// Show the time spent in each instrumented scope during the last frame.
+// Must be called between begin2DDrawing() and end2DDrawing().
+void
+UniverseView::drawPerformanceOverlay()
+{
+    if (!m_textFont.isValid())
+    {
+        return;
+    }
+
+    const Profiler* profiler = Profiler::instance();
+    const float lineHeight = 20.0f;
+    const float leftMargin = 32.0f;
+    float y = float(size().height() * devicePixelRatio()) * 0.6f;
+
+    glEnable(GL_TEXTURE_2D);
+    glColor4f(1.0f, 1.0f, 0.6f, 1.0f);
+    m_textFont->bind();
+
+    QString frameString = QString("Frame: %1 ms").arg(profiler->lastFrameTime() * 1000.0, 0, 'f', 2);
+    m_textFont->render(frameString.toLatin1().data(), Vector2f(leftMargin, y));
+    y -= lineHeight;
+
+    const vector<Profiler::ScopeStatistics>& scopes = profiler->lastFrameStatistics();
+    for (vector<Profiler::ScopeStatistics>::const_iterator iter = scopes.begin(); iter != scopes.end(); ++iter)
+    {
+        QString scopeString = QString("%1 ms  %2 (%3)").arg(iter->totalTime * 1000.0, 6, 'f', 2).arg(iter->name).arg(iter->callCount);
+        m_textFont->render(scopeString.toLatin1().data(), Vector2f(leftMargin, y));
+        y -= lineHeight;
+    }
+
+    const vector<Profiler::CounterValue>& counters = profiler->counterValues();
+    for (vector<Profiler::CounterValue>::const_iterator iter = counters.begin(); iter != counters.end(); ++iter)
+    {
+        QString counterString = QString("%1: %2").arg(iter->name).arg(iter->value, 0, 'g', 6);
+        m_textFont->render(counterString.toLatin1().data(), Vector2f(leftMargin, y));
+        y -= lineHeight;
+    }
+}
+
+
 void
 UniverseView::drawFovReticle(float brightness)
 {
@@ -1464,6 +1598,8 @@ UniverseView::drawFovReticle(float brightness)
 
 void UniverseView::paintGL()
 {
+    Profiler::instance()->beginFrame();
+
     // Update the frame counter
     double elapsedTime = secondsFromBaseTime();
 
@@ -1594,10 +1730,12 @@ void UniverseView::paintGL()
             PlanarProjection rightProjection(PlanarProjection::Perspective, -x - frustumOffset, x - frustumOffset, -y, y, nearDistance, farDistance);
 
             Viewport halfHeightViewport(mainViewport.width(), mainViewport.height() / 2.0f);
+            m_renderer->setLabelPlacement(m_rightEyeLabelPlacement.ptr());
             m_renderer->renderView(&lighting, rightEyePosition, cameraOrientation, rightProjection, halfHeightViewport);
 
             double projection[16];
             lglStartRender(m_leoState->context, 1, projection);
+            m_renderer->setLabelPlacement(m_labelPlacement.ptr());
             m_renderer->renderView(&lighting, leftEyePosition, cameraOrientation, leftProjection, halfHeightViewport);
 
             LGLProjection projParams;
@@ -1615,8 +1753,10 @@ void UniverseView::paintGL()
             Viewport rightViewport(width() / 2 * pixelScale, 0, width() / 2 * pixelScale, height() * pixelScale);
             glEnable(GL_SCISSOR_TEST);
             glScissor(leftViewport.x(), leftViewport.y(), leftViewport.width(), leftViewport.height());
+            m_renderer->setLabelPlacement(m_labelPlacement.ptr());
             m_renderer->renderView(&lighting, leftEyePosition, cameraOrientation, leftProjection, leftViewport);
             glScissor(rightViewport.x(), rightViewport.y(), rightViewport.width(), rightViewport.height());
+            m_renderer->setLabelPlacement(m_rightEyeLabelPlacement.ptr());
             m_renderer->renderView(&lighting, rightEyePosition, cameraOrientation, rightProjection, rightViewport);
             glDisable(GL_SCISSOR_TEST);
         }
@@ -1629,17 +1769,20 @@ void UniverseView::paintGL()
 
             glColorMask(GL_TRUE, GL_FALSE, GL_FALSE, GL_TRUE); // red
             //glColorMask(GL_FALSE, GL_TRUE, GL_FALSE, GL_TRUE);  // green
+            m_renderer->setLabelPlacement(m_labelPlacement.ptr());
             m_renderer->renderView(&lighting, leftEyePosition, cameraOrientation, leftProjection, mainViewport);
             glColorMask(GL_FALSE, GL_TRUE, GL_TRUE, GL_TRUE); // cyan
             //glColorMask(GL_TRUE, GL_FALSE, GL_TRUE, GL_TRUE);   // magenta
             glDepthMask(GL_TRUE);
             glClear(GL_DEPTH_BUFFER_BIT);
+            m_renderer->setLabelPlacement(m_rightEyeLabelPlacement.ptr());
             m_renderer->renderView(&lighting, rightEyePosition, cameraOrientation, rightProjection, mainViewport);
             glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
         }
     }
     else
     {
+        m_renderer->setLabelPlacement(m_labelPlacement.ptr());
         m_renderer->renderView(&lighting, m_observer.ptr(), m_fovY, mainViewport);
         if (m_sunGlareEnabled && m_glareOverlay.isValid())
         {
@@ -1671,6 +1814,11 @@ void UniverseView::paintGL()
     }
 
 #if FFMPEG_SUPPORT || QTKIT_SUPPORT
+    if (m_finishedVideoEncoder)
+    {
+        finishVideoCapture();
+    }
+
     if (m_videoEncoder)
     {
         int fbWidth = width();
@@ -1705,26 +1853,30 @@ void UniverseView::paintGL()
             end2DDrawing();
         }
 
-        QImage image = grabFrameBuffer(false);
-        if (captureHeight < fbHeight)
-        {
-            image = image.copy(0, (image.height() - captureHeight) / 2, image.width(), captureHeight);
-        }
-        else
+        if (!m_videoCapture)
         {
-            image = image.copy((image.width() - captureWidth) / 2, 0, captureWidth, image.height());
+            // The capture pipeline must be created on the thread that owns
+            // the GL context.
+            m_videoCapture = new VideoCapture(m_videoEncoder);
         }
 
-        image = image.scaled(QSize(m_videoEncoder->getWidth(), m_videoEncoder->getHeight()), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-#if QTKIT_SUPPORT
-        image = image.rgbSwapped();
-#endif
-        m_videoEncoder->encodeImage(image);
+        // Read back just the centered capture area; the scale to the video
+        // size happens on the capture pipeline's worker threads.
+        float pixelScale = devicePixelRatio();
+        QRect captureRect(int((fbWidth - captureWidth) / 2 * pixelScale),
+                          int((fbHeight - captureHeight) / 2 * pixelScale),
+                          int(captureWidth * pixelScale),
+                          int(captureHeight * pixelScale));
+        m_videoCapture->captureFrame(captureRect);
 
         drawFrame(captureWidth, captureHeight);
     }
 #endif
 
+    // The info overlay isn't included in the frame timings so that the
+    // performance overlay doesn't measure itself.
+    Profiler::instance()->endFrame();
+
     drawInfoOverlay();
 }
 
@@ -2416,6 +2568,8 @@ private:
 void
 UniverseView::updateTrajectoryPlots()
 {
+    VESTA_PROFILE_SCOPE("UniverseView::updateTrajectoryPlots");
+
     for (vector<TrajectoryPlotEntry>::const_iterator iter = m_trajectoryPlots.begin();
          iter != m_trajectoryPlots.end(); ++iter)
     {
@@ -3403,6 +3557,23 @@ UniverseView::setEclipseShadows(bool enable)
 }
 
 
+bool
+UniverseView::logarithmicDepth() const
+{
+    return m_renderer->depthStrategy() == UniverseRenderer::LogarithmicDepth;
+}
+
+
+// Draw the whole scene in a single pass with a logarithmic depth buffer
+// instead of splitting it into depth spans. The renderer falls back to
+// depth spans when shaders aren't available.
+void
+UniverseView::setLogarithmicDepth(bool enable)
+{
+    m_renderer->setDepthStrategy(enable ? UniverseRenderer::LogarithmicDepth : UniverseRenderer::DepthSpans);
+}
+
+
 bool
 UniverseView::reflections() const
 {
@@ -3567,6 +3738,16 @@ UniverseView::setInfoText(bool enable)
 }
 
 
+/** Show or hide the per-frame timings collected by the profiler.
+  */
+void
+UniverseView::setPerformanceOverlay(bool enable)
+{
+    m_performanceOverlayVisible = enable;
+    Profiler::instance()->setFrameStatisticsEnabled(enable);
+}
+
+
 void
 UniverseView::startVideoRecording(QVideoEncoder* encoder)
 {
@@ -3576,14 +3757,54 @@ UniverseView::startVideoRecording(QVideoEncoder* encoder)
 }
 
 
+/** Stop recording video. Frames still in the capture pipeline are flushed
+  * and the encoder is closed and deleted the next time that the view is
+  * rendered, since the pipeline's pixel buffers belong to the GL context.
+  */
 void
 UniverseView::finishVideoRecording()
 {
-    m_videoEncoder = NULL;
+    if (m_videoEncoder)
+    {
+        m_finishedVideoEncoder = m_videoEncoder;
+        m_videoEncoder = NULL;
+        update();
+    }
     emit recordingVideoChanged();
 }
 
 
+// Drain the capture pipeline and close the encoder of a finished
+// recording. Must be called with the GL context current.
+void
+UniverseView::finishVideoCapture()
+{
+    if (m_videoCapture)
+    {
+        m_videoCapture->finish();
+
+        VideoCapture::Statistics stats = m_videoCapture->statistics();
+        qDebug() << "Video capture:" << stats.framesEncoded << "frames encoded,"
+                 << stats.framesDropped << "dropped,"
+                 << "render thread" << stats.readbackTime << "s (" << stats.stallTime << "s stalled),"
+                 << "processing" << stats.processTime << "s,"
+                 << "encoding" << stats.encodeTime << "s";
+
+        delete m_videoCapture;
+        m_videoCapture = NULL;
+    }
+
+#if FFMPEG_SUPPORT || QTKIT_SUPPORT
+    if (m_finishedVideoEncoder)
+    {
+        m_finishedVideoEncoder->close();
+        delete m_finishedVideoEncoder;
+        m_finishedVideoEncoder = NULL;
+    }
+#endif
+}
+
+
 double
 UniverseView::recordedVideoLength() const
 {
@@ -3618,18 +3839,7 @@ UniverseView::setSelectedBody(Entity* body)
 void
 UniverseView::setSelectedBody(const QString& name)
 {
-    Entity* body = NULL;
-
-    QStringList allNames = m_catalog->names();
-    foreach (QString s, allNames)
-    {
-        if (name.compare(s, Qt::CaseInsensitive) == 0)
-        {
-            body = m_catalog->find(s);
-            break;
-        }
-    }
-
+    Entity* body = m_catalog->find(name, Qt::CaseInsensitive);
     if (body)
     {
         setSelectedBody(body);
@@ -34,6 +34,7 @@
 #include <vesta/TiledMap.h>
 
 class QVideoEncoder;
+class VideoCapture;
 class ObserverAction;
 class Viewpoint;
 class MarkerLayer;
@@ -54,6 +55,7 @@ namespace vesta
     class Trajectory;
     class TrajectoryPlotGenerator;
     class GlareOverlay;
+    class LabelPlacement;
 }
 
 class UniverseView : public QQuickView
@@ -71,6 +73,7 @@ class UniverseView : public QQuickView
 
     Q_PROPERTY(bool shadows READ shadows WRITE setShadows);
     Q_PROPERTY(bool eclipseShadows READ eclipseShadows WRITE setEclipseShadows);
+    Q_PROPERTY(bool logarithmicDepth READ logarithmicDepth WRITE setLogarithmicDepth);
     Q_PROPERTY(bool reflections READ reflections WRITE setReflections);
     Q_PROPERTY(bool cloudsVisible READ cloudsVisible WRITE setCloudsVisible);
     Q_PROPERTY(bool atmospheresVisible READ atmospheresVisible WRITE setAtmospheresVisible);
@@ -196,6 +199,11 @@ public:
         return m_centerIndicatorVisible;
     }
 
+    bool performanceOverlay() const
+    {
+        return m_performanceOverlayVisible;
+    }
+
     bool constellationFigureVisibility() const;
     bool constellationNameVisibility() const;
     bool starNameVisibility() const;
@@ -205,6 +213,7 @@ public:
 
     bool shadows() const;
     bool eclipseShadows() const;
+    bool logarithmicDepth() const;
     bool reflections() const;
     bool cloudsVisible() const;
     bool atmospheresVisible() const;
@@ -320,6 +329,7 @@ public slots:
     void setCenterIndicatorVisibility(bool enable);
     void setShadows(bool enable);
     void setEclipseShadows(bool enable);
+    void setLogarithmicDepth(bool enable);
     void setCloudsVisible(bool enable);
     void setAtmospheresVisible(bool enable);
     void setAmbientLight(bool enable);
@@ -332,6 +342,7 @@ public slots:
     void setEarthMapMonth(int month);
 
     void setInfoText(bool enable);
+    void setPerformanceOverlay(bool enable);
     void plotTrajectory(vesta::Entity* body, const BodyInfo* info);
     void plotTrajectoryObserver(const BodyInfo* info);
     void clearTrajectoryPlots(vesta::Entity* body);
@@ -381,6 +392,7 @@ protected:
 private:
     QString bodyName(const vesta::Entity* body) const;
     void drawInfoOverlay();
+    void drawPerformanceOverlay();
     void drawFrame(float width, float height);
     void begin2DDrawing();
     void end2DDrawing();
@@ -407,6 +419,7 @@ private:
     bool initPlanetEphemeris();
 
     void updateTrajectoryPlots();
+    void finishVideoCapture();
     bool gestureEvent(QGestureEvent* event);
 
     vesta::Entity* pickObject(const QPoint& point);
@@ -428,6 +441,10 @@ private:
     vesta::counted_ptr<vesta::ObserverController> m_controller;
     vesta::UniverseRenderer* m_renderer;
     vesta::counted_ptr<vesta::GlareOverlay> m_glareOverlay;
+    // Label placement keeps state between frames, so each view needs its own;
+    // the second one is used for the right eye in stereo modes.
+    vesta::counted_ptr<vesta::LabelPlacement> m_labelPlacement;
+    vesta::counted_ptr<vesta::LabelPlacement> m_rightEyeLabelPlacement;
     FrameType m_observerFrame;
     double m_fovY;
 
@@ -480,6 +497,7 @@ private:
 
     bool m_planetOrbitsVisible;
     bool m_infoTextVisible;
+    bool m_performanceOverlayVisible;
     bool m_labelsVisible;
     bool m_surfaceFeatureLabelsVisible;
     bool m_centerIndicatorVisible;
@@ -488,6 +506,8 @@ private:
     vesta::counted_ptr<ObserverAction> m_observerAction;
 
     QVideoEncoder* m_videoEncoder;
+    QVideoEncoder* m_finishedVideoEncoder;
+    VideoCapture* m_videoCapture;
     double m_videoRecordingStartTime;
 
     TimeDisplayMode m_timeDisplay;
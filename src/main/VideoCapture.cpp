@@ -0,0 +1,461 @@
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "VideoCapture.h"
+
+#if FFMPEG_SUPPORT
+#include "QVideoEncoder.h"
+#elif QTKIT_SUPPORT
+#include "../video/VideoEncoder.h"
+#endif
+
+#include <vesta/Profiler.h>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <algorithm>
+#include <cstring>
+
+using namespace vesta;
+using namespace std;
+
+
+// Worker task that scales and converts a single frame
+class VideoCapture::ProcessTask : public QRunnable
+{
+public:
+    ProcessTask(VideoCapture* capture, unsigned int frameNumber, const QImage& image) :
+        m_capture(capture),
+        m_frameNumber(frameNumber),
+        m_image(image)
+    {
+    }
+
+    void run()
+    {
+        m_capture->processFrame(m_frameNumber, m_image);
+    }
+
+private:
+    VideoCapture* m_capture;
+    unsigned int m_frameNumber;
+    QImage m_image;
+};
+
+
+// The encoder isn't reentrant and frames must reach it in order, so all
+// encoding happens on a single thread.
+class VideoCapture::EncoderThread : public QThread
+{
+public:
+    EncoderThread(VideoCapture* capture) :
+        m_capture(capture)
+    {
+    }
+
+protected:
+    void run()
+    {
+        m_capture->runEncoder();
+    }
+
+private:
+    VideoCapture* m_capture;
+};
+
+
+/** Create a new capture pipeline that feeds the specified encoder. The
+  * encoder must already have an open file; it is not closed or deleted by
+  * the VideoCapture.
+  */
+VideoCapture::VideoCapture(QVideoEncoder* encoder, QObject* parent) :
+    QObject(parent),
+    m_encoder(encoder),
+    m_overflowPolicy(BlockWhenFull),
+    m_maxFramesInFlight(DefaultMaxFramesInFlight),
+    m_asyncReadback(false),
+    m_nextReadback(0),
+    m_nextFrameNumber(0),
+    m_encoderThread(NULL),
+    m_nextEncodeFrame(0),
+    m_framesInFlight(0),
+    m_finishing(false)
+{
+#if FFMPEG_SUPPORT || QTKIT_SUPPORT
+    if (m_encoder)
+    {
+        m_videoSize = QSize(m_encoder->getWidth(), m_encoder->getHeight());
+    }
+#endif
+
+    m_asyncReadback = GLPixelBuffer::supported();
+    m_readbacks.resize(PixelBufferCount);
+
+    // Leave one core for the render thread and one for the encoder
+    m_workers.setMaxThreadCount(max(1, QThread::idealThreadCount() - 2));
+
+    m_encoderThread = new EncoderThread(this);
+    m_encoderThread->start();
+}
+
+
+/** Destroy the capture pipeline. finish() should be called first (with the
+  * OpenGL context current) so that frames still in pixel buffers are not lost.
+  */
+VideoCapture::~VideoCapture()
+{
+    if (!m_finishing)
+    {
+        m_workers.waitForDone();
+
+        m_mutex.lock();
+        m_finishing = true;
+        m_frameProcessed.wakeAll();
+        m_mutex.unlock();
+    }
+
+    m_encoderThread->wait();
+    delete m_encoderThread;
+}
+
+
+void
+VideoCapture::setMaxFramesInFlight(unsigned int frameCount)
+{
+    m_maxFramesInFlight = max(1u, frameCount);
+}
+
+
+/** Capture a rectangle of the current read framebuffer. The rectangle is
+  * given in framebuffer pixels with the origin at the lower left. Returns
+  * false if the frame was dropped because the pipeline is full.
+  */
+bool
+VideoCapture::captureFrame(const QRect& rect)
+{
+    VESTA_PROFILE_SCOPE("Video capture");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (rect.isEmpty() || m_finishing)
+    {
+        return false;
+    }
+
+    // Apply back-pressure: don't start another readback until there's room
+    // in the pipeline for it.
+    m_mutex.lock();
+    if (m_framesInFlight >= m_maxFramesInFlight)
+    {
+        if (m_overflowPolicy == DropWhenFull)
+        {
+            m_statistics.framesDropped++;
+            m_statistics.readbackTime += timer.nsecsElapsed() * 1.0e-9;
+            m_mutex.unlock();
+            return false;
+        }
+
+        // Frames waiting in pixel buffers count as in flight, but they won't
+        // advance unless the render thread collects them; do that before
+        // waiting in order to avoid a deadlock.
+        m_mutex.unlock();
+        collectAllReadbacks();
+        m_mutex.lock();
+
+        QElapsedTimer stallTimer;
+        stallTimer.start();
+        while (m_framesInFlight >= m_maxFramesInFlight)
+        {
+            m_frameEncoded.wait(&m_mutex);
+        }
+        m_statistics.stallTime += stallTimer.nsecsElapsed() * 1.0e-9;
+    }
+    m_framesInFlight++;
+    m_statistics.framesCaptured++;
+    m_mutex.unlock();
+
+    unsigned int frameNumber = m_nextFrameNumber++;
+
+    if (m_asyncReadback && rect.size() != m_pixelBufferSize)
+    {
+        // Capture size changed (e.g. the window was resized.) Flush frames
+        // of the old size before reallocating.
+        collectAllReadbacks();
+        if (!allocatePixelBuffers(rect.size()))
+        {
+            m_asyncReadback = false;
+            m_readbacks.clear();
+        }
+    }
+
+    if (m_asyncReadback)
+    {
+        // Reusing the oldest slot in the ring: its transfer was queued
+        // PixelBufferCount - 1 frames ago and should be complete by now.
+        PendingReadback& readback = m_readbacks[m_nextReadback];
+        m_nextReadback = (m_nextReadback + 1) % m_readbacks.size();
+
+        if (readback.pending)
+        {
+            collectReadback(readback);
+        }
+
+        readback.buffer->readPixels(rect.x(), rect.y(), rect.width(), rect.height(), GL_BGRA, GL_UNSIGNED_BYTE);
+        readback.pending = true;
+        readback.frameNumber = frameNumber;
+        readback.size = rect.size();
+    }
+    else
+    {
+        // No pixel buffer support; fall back to a synchronous read, but
+        // still keep the scaling and encoding off of this thread.
+        QImage image(rect.size(), QImage::Format_ARGB32);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(rect.x(), rect.y(), rect.width(), rect.height(), GL_BGRA, GL_UNSIGNED_BYTE, image.bits());
+        submitFrame(frameNumber, image.mirrored(false, true));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_statistics.readbackTime += timer.nsecsElapsed() * 1.0e-9;
+
+    return true;
+}
+
+
+/** Wait for all captured frames to be encoded. This must be called with
+  * the OpenGL context current; the pixel buffers are released, so no further
+  * frames may be captured afterward.
+  */
+void
+VideoCapture::finish()
+{
+    if (m_finishing)
+    {
+        return;
+    }
+
+    collectAllReadbacks();
+    m_readbacks.clear();
+    m_pixelBufferSize = QSize();
+
+    m_workers.waitForDone();
+
+    m_mutex.lock();
+    m_finishing = true;
+    m_frameProcessed.wakeAll();
+    m_mutex.unlock();
+
+    m_encoderThread->wait();
+}
+
+
+/** Stop the pipeline when the OpenGL context can't be made current (e.g.
+  * it belongs to another thread.) Frames already in the encode pipeline are
+  * still encoded, but frames waiting in pixel buffers are lost. The pixel
+  * buffers themselves are left for the context to reclaim when it's
+  * destroyed, since deleting them requires a current context.
+  */
+void
+VideoCapture::abandon()
+{
+    if (m_finishing)
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < m_readbacks.size(); ++i)
+    {
+        if (m_readbacks[i].buffer.isValid())
+        {
+            // Hold an extra reference so that the buffer is never deleted
+            m_readbacks[i].buffer->addRef();
+        }
+    }
+    m_readbacks.clear();
+    m_pixelBufferSize = QSize();
+
+    m_workers.waitForDone();
+
+    m_mutex.lock();
+    m_finishing = true;
+    m_frameProcessed.wakeAll();
+    m_mutex.unlock();
+
+    m_encoderThread->wait();
+}
+
+
+/** Get a snapshot of the capture statistics. This method may be called from
+  * any thread.
+  */
+VideoCapture::Statistics
+VideoCapture::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_statistics;
+}
+
+
+bool
+VideoCapture::allocatePixelBuffers(const QSize& size)
+{
+    unsigned int bufferSize = size.width() * size.height() * 4;
+
+    for (unsigned int i = 0; i < m_readbacks.size(); ++i)
+    {
+        m_readbacks[i] = PendingReadback();
+        m_readbacks[i].buffer = new GLPixelBuffer(bufferSize, GL_STREAM_READ);
+        if (!m_readbacks[i].buffer->isValid())
+        {
+            return false;
+        }
+    }
+
+    m_nextReadback = 0;
+    m_pixelBufferSize = size;
+
+    return true;
+}
+
+
+// Copy the contents of a pixel buffer into system memory and pass them to
+// the worker pool. The buffer is mapped only for the duration of the copy.
+void
+VideoCapture::collectReadback(PendingReadback& readback)
+{
+    readback.pending = false;
+
+    QImage image(readback.size, QImage::Format_ARGB32);
+    unsigned int rowBytes = readback.size.width() * 4;
+
+    const unsigned char* pixels = reinterpret_cast<const unsigned char*>(readback.buffer->mapReadOnly());
+    if (pixels)
+    {
+        // OpenGL rows are stored bottom to top
+        int height = readback.size.height();
+        for (int row = 0; row < height; ++row)
+        {
+            memcpy(image.scanLine(height - row - 1), pixels + row * rowBytes, rowBytes);
+        }
+    }
+    else
+    {
+        image.fill(0);
+    }
+    readback.buffer->unmap();
+    readback.buffer->unbind();
+
+    submitFrame(readback.frameNumber, image);
+}
+
+
+void
+VideoCapture::collectAllReadbacks()
+{
+    // Visit slots oldest first so that frames are submitted in order
+    for (unsigned int i = 0; i < m_readbacks.size(); ++i)
+    {
+        PendingReadback& readback = m_readbacks[(m_nextReadback + i) % m_readbacks.size()];
+        if (readback.pending)
+        {
+            collectReadback(readback);
+        }
+    }
+}
+
+
+void
+VideoCapture::submitFrame(unsigned int frameNumber, const QImage& image)
+{
+    m_workers.start(new ProcessTask(this, frameNumber, image));
+}
+
+
+// Called on a worker thread
+void
+VideoCapture::processFrame(unsigned int frameNumber, QImage image)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // The framebuffer alpha isn't meaningful; force the image to be opaque.
+    image = image.convertToFormat(QImage::Format_RGB32);
+    if (!m_videoSize.isEmpty() && image.size() != m_videoSize)
+    {
+        image = image.scaled(m_videoSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+#if QTKIT_SUPPORT
+    image = image.rgbSwapped();
+#endif
+
+    QMutexLocker locker(&m_mutex);
+    m_statistics.processTime += timer.nsecsElapsed() * 1.0e-9;
+    m_encodeQueue.insert(frameNumber, image);
+    m_frameProcessed.wakeAll();
+}
+
+
+// Encoder thread main loop. Frames may finish processing out of order; they
+// wait in the encode queue until all earlier frames have been encoded.
+void
+VideoCapture::runEncoder()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (;;)
+    {
+        while (!m_encodeQueue.contains(m_nextEncodeFrame) && !(m_finishing && m_encodeQueue.isEmpty()))
+        {
+            m_frameProcessed.wait(&m_mutex);
+        }
+
+        if (m_encodeQueue.isEmpty())
+        {
+            break;
+        }
+
+        QMap<unsigned int, QImage>::iterator iter = m_encodeQueue.find(m_nextEncodeFrame);
+        if (iter == m_encodeQueue.end())
+        {
+            // Only possible while finishing, if a frame was lost; skip
+            // ahead rather than waiting forever.
+            iter = m_encodeQueue.begin();
+        }
+
+        unsigned int frameNumber = iter.key();
+        QImage image = iter.value();
+        m_encodeQueue.erase(iter);
+
+        locker.unlock();
+
+        QElapsedTimer timer;
+        timer.start();
+#if FFMPEG_SUPPORT || QTKIT_SUPPORT
+        if (m_encoder)
+        {
+            m_encoder->encodeImage(image);
+        }
+#endif
+        double encodeTime = timer.nsecsElapsed() * 1.0e-9;
+
+        locker.relock();
+
+        m_nextEncodeFrame = frameNumber + 1;
+        m_statistics.encodeTime += encodeTime;
+        m_statistics.framesEncoded++;
+        m_framesInFlight--;
+        m_frameEncoded.wakeAll();
+    }
+}
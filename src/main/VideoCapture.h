@@ -0,0 +1,176 @@
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _VIDEO_CAPTURE_H_
+#define _VIDEO_CAPTURE_H_
+
+#include <vesta/glhelp/GLPixelBuffer.h>
+#include <QObject>
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QRect>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <vector>
+
+class QVideoEncoder;
+
+
+/** VideoCapture moves video recording off of the rendering thread. Each
+  * frame passes through three stages:
+  *
+  *   1. Readback: captureFrame() queues an asynchronous read of the capture
+  *      rectangle into a ring of pixel buffer objects. The pixels are copied
+  *      out of a buffer only when that ring slot is reused a few frames later,
+  *      by which time the GPU has finished the transfer.
+  *   2. Processing: a pool of worker threads scales each frame to the video
+  *      size and converts it to the format expected by the encoder.
+  *   3. Encoding: a single encoder thread submits processed frames to the
+  *      encoder in capture order.
+  *
+  * The number of frames between stage 1 and the end of stage 3 is bounded.
+  * When the limit is reached, captureFrame() either waits for the encoder to
+  * catch up (BlockWhenFull) or discards the frame (DropWhenFull). Recording
+  * with a locked time step should block, since a dropped frame would show up
+  * as a skip in the video.
+  *
+  * All methods except statistics() and abandon() must be called from the
+  * thread that owns the OpenGL context.
+  */
+class VideoCapture : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum OverflowPolicy
+    {
+        BlockWhenFull,
+        DropWhenFull
+    };
+
+    struct Statistics
+    {
+        Statistics() :
+            framesCaptured(0),
+            framesEncoded(0),
+            framesDropped(0),
+            stallTime(0.0),
+            readbackTime(0.0),
+            processTime(0.0),
+            encodeTime(0.0)
+        {
+        }
+
+        unsigned int framesCaptured;
+        unsigned int framesEncoded;
+        unsigned int framesDropped;
+        double stallTime;      // total time the render thread waited for free slots (seconds)
+        double readbackTime;   // total render thread time spent in captureFrame, including stalls
+        double processTime;    // total worker time spent scaling and converting frames
+        double encodeTime;     // total encoder thread time
+    };
+
+    VideoCapture(QVideoEncoder* encoder, QObject* parent = NULL);
+    ~VideoCapture();
+
+    QVideoEncoder* encoder() const
+    {
+        return m_encoder;
+    }
+
+    OverflowPolicy overflowPolicy() const
+    {
+        return m_overflowPolicy;
+    }
+
+    void setOverflowPolicy(OverflowPolicy policy)
+    {
+        m_overflowPolicy = policy;
+    }
+
+    /** Get the maximum number of frames that may be in the pipeline at
+      * once (read back but not yet encoded.)
+      */
+    unsigned int maxFramesInFlight() const
+    {
+        return m_maxFramesInFlight;
+    }
+
+    void setMaxFramesInFlight(unsigned int frameCount);
+
+    bool isAsynchronous() const
+    {
+        return m_asyncReadback;
+    }
+
+    bool captureFrame(const QRect& rect);
+    void finish();
+    void abandon();
+
+    Statistics statistics() const;
+
+    static const unsigned int PixelBufferCount = 3;
+    static const unsigned int DefaultMaxFramesInFlight = 8;
+
+private:
+    struct PendingReadback
+    {
+        PendingReadback() : pending(false), frameNumber(0) {}
+
+        vesta::counted_ptr<vesta::GLPixelBuffer> buffer;
+        bool pending;
+        unsigned int frameNumber;
+        QSize size;
+    };
+
+    class ProcessTask;
+    class EncoderThread;
+    friend class ProcessTask;
+    friend class EncoderThread;
+
+    bool allocatePixelBuffers(const QSize& size);
+    void collectReadback(PendingReadback& readback);
+    void collectAllReadbacks();
+    void submitFrame(unsigned int frameNumber, const QImage& image);
+    void processFrame(unsigned int frameNumber, QImage image);
+    void runEncoder();
+
+private:
+    QVideoEncoder* m_encoder;
+    QSize m_videoSize;
+    OverflowPolicy m_overflowPolicy;
+    unsigned int m_maxFramesInFlight;
+    bool m_asyncReadback;
+
+    std::vector<PendingReadback> m_readbacks;
+    unsigned int m_nextReadback;
+    QSize m_pixelBufferSize;
+    unsigned int m_nextFrameNumber;
+
+    QThreadPool m_workers;
+    EncoderThread* m_encoderThread;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_frameProcessed;
+    QWaitCondition m_frameEncoded;
+    QMap<unsigned int, QImage> m_encodeQueue;
+    unsigned int m_nextEncodeFrame;
+    unsigned int m_framesInFlight;
+    bool m_finishing;
+    Statistics m_statistics;
+};
+
+#endif // _VIDEO_CAPTURE_H_
@@ -23,6 +23,7 @@
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QStandardPaths>
 #include <cmath>
 
 using namespace std;
@@ -31,6 +32,19 @@ using namespace std;
 // class will take care of managing the other pending requests itself.
 const static int MaxOutstandingNetworkRequests = 12;
 
+// Default limit on simultaneous requests to one server. This matches the number
+// of connections per host that QNetworkAccessManager will open.
+const static int DefaultMaxRequestsPerServer = 6;
+
+// Requests for tiles that haven't been visible in the last CullLag frames are
+// dropped from the queue, and aborted if they've already been sent.
+const static unsigned int CullLag = 60;
+
+// Minimum interval in milliseconds between recomputing the priorities of all
+// queued requests. Tile visibility changes from frame to frame, but between
+// updates the queue is an ordinary priority queue.
+const static qint64 PriorityUpdateInterval = 20;
+
 
 /** WMSRequester handles retrieving map tiles from a Web Map Server and converting
   * them to a form that can be easily used with VESTA's WorldGeometry class. The
@@ -55,20 +69,39 @@ const static int MaxOutstandingNetworkRequests = 12;
   * then final tile is received, WMSRequester emits an imageCompleted signal that
   * the tile is ready to be converted to a texture.
   *
-  * Requests are sent directly to Qt's NetworkAccessManager until a limit is reached.
-  * At that point requests are added to a queued tiles list. While the
+  * Requests are sent directly to Qt's NetworkAccessManager until a limit is reached,
+  * either on the total number of requests or on the number of requests to a single
+  * server. At that point requests are held in a priority queue. While the
   * NetworkAccessManager does handle queuing itself (restricting the maximum
   * number of simultaneous HTTP connections to 6), we need more control over the
   * queue:
   *    - Currently visible tiles should have priority, and are moved to the front
-  *      of the queue.
+  *      of the queue. Among tiles that are equally recent, lower resolution levels
+  *      are requested first.
+  *    - Tiles that need the same WMS image share a single request.
   *    - If the user moves the camera quickly over the surface of a planet, huge
   *      number of requests may be queued. We occasionally trim queue, removing
-  *      requests for tiles that haven't been visible for some time.
+  *      requests for tiles that haven't been visible for some time, and abort
+  *      requests for such tiles that have already been sent.
+  *
+  * Finished tiles are saved in a TileDiskCache. The cache is checked before any
+  * requests are made to the WMS server, and a cached tile is ready to be used as
+  * a texture without any further decoding or compositing.
   */
 WMSRequester::WMSRequester(QObject* parent) :
     QObject(parent),
-    m_dispatchedRequestCount(0)
+    m_maxRequestsPerServer(DefaultMaxRequestsPerServer),
+    m_dispatchedRequestCount(0),
+    m_requestSequence(0),
+    m_lastPriorityUpdate(0),
+    m_coalescedRequestCount(0),
+    m_cancelledRequestCount(0),
+    m_sentRequestCount(0),
+    m_completedRequestCount(0),
+    m_totalQueueLatency(0),
+    m_maxQueueLatency(0),
+    m_totalResponseTime(0),
+    m_tileCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/wms_tiles")
 {
     m_networkManager = new QNetworkAccessManager(this);
     QNetworkDiskCache* cache = new QNetworkDiskCache(this);
@@ -76,11 +109,20 @@ WMSRequester::WMSRequester(QObject* parent) :
     cache->setCacheDirectory(QStandardPaths::locate(QStandardPaths::CacheLocation, ""));
     m_networkManager->setCache(cache);
     connect(m_networkManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(processTile(QNetworkReply*)));
+    m_clock.start();
 }
 
 
 WMSRequester::~WMSRequester()
 {
+    foreach (WmsRequest* request, m_requests)
+    {
+        foreach (TileBuildOperation op, request->ops)
+        {
+            releaseOperation(op);
+        }
+        delete request;
+    }
 }
 
 
@@ -121,13 +163,15 @@ WMSRequester::retrieveTile(const QString& tileName,
         return;
     }
 
-    QString fileName = tileFileName(tileName, surface);
-    QFileInfo fileInfo(fileName);
-    if (fileInfo.exists())
+    TileAddress address = parseTileName(tileName);
+    if (address.valid)
     {
-        QImage image(fileName);
-        emit imageCompleted(tileName, image);
-        return;
+        QImage image = m_tileCache.loadTile(surface, address.level, address.x, address.y);
+        if (!image.isNull())
+        {
+            emit imageCompleted(tileName, image);
+            return;
+        }
     }
 
     LatLongBoundingBox tileBox(tileRect.x(),
@@ -169,6 +213,8 @@ WMSRequester::retrieveTile(const QString& tileName,
     tileAssembly->tileWidth = tileSize;
     tileAssembly->tileHeight = tileSize;
     tileAssembly->texture = texture;
+    tileAssembly->address = address;
+    tileAssembly->cancelled = false;
 
     for (int lat = southIndex; lat < northIndex; ++lat)
     {
@@ -190,45 +236,260 @@ WMSRequester::retrieveTile(const QString& tileName,
             op.urlString = urlString;
             op.tile->requestCount++;
 
-            if (m_dispatchedRequestCount < MaxOutstandingNetworkRequests)
+            queueOperation(op);
+        }
+    }
+
+    dispatchRequests();
+}
+
+
+// Add a tile build operation to the queue. If there's already a request for the same
+// WMS image, the operation is attached to it rather than creating a new request.
+void
+WMSRequester::queueOperation(const TileBuildOperation& op)
+{
+    QMutexLocker locker(&m_mutex);
+
+    WmsRequest* request = m_requests.value(op.urlString);
+    if (request)
+    {
+        request->ops << op;
+        ++m_coalescedRequestCount;
+
+        // The new operation may raise the priority of a request that hasn't been sent yet
+        if (!request->reply)
+        {
+            m_queue.remove(request->priority);
+            request->priority = requestPriority(request);
+            m_queue.insert(request->priority, request);
+        }
+    }
+    else
+    {
+        request = new WmsRequest;
+        request->urlString = op.urlString;
+        QUrl url(op.urlString);
+        request->server = url.host() + ":" + QString::number(url.port(url.scheme() == "https" ? 443 : 80));
+        request->ops << op;
+        request->reply = NULL;
+        request->queuedTime = m_clock.elapsed();
+        request->dispatchTime = 0;
+        request->priority.sequence = m_requestSequence++;
+        request->priority = requestPriority(request);
+
+        m_requests.insert(request->urlString, request);
+        m_queue.insert(request->priority, request);
+    }
+}
+
+
+// Compute the priority of a request from the most recently used texture that needs it
+WMSRequester::RequestPriority
+WMSRequester::requestPriority(const WmsRequest* request) const
+{
+    RequestPriority priority = request->priority;
+    priority.lastUsed = 0;
+    priority.level = ~0u;
+
+    foreach (TileBuildOperation op, request->ops)
+    {
+        if (!op.tile->cancelled)
+        {
+            priority.lastUsed = max(priority.lastUsed, op.tile->texture->lastUsed());
+            if (op.tile->address.valid)
+            {
+                priority.level = min(priority.level, op.tile->address.level);
+            }
+        }
+    }
+
+    return priority;
+}
+
+
+// Send queued requests in priority order until the limits on active requests are
+// reached.
+void
+WMSRequester::dispatchRequests()
+{
+    QList<WmsRequest*> readyRequests;
+    QList<QNetworkReply*> abortedReplies;
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (m_clock.elapsed() - m_lastPriorityUpdate >= PriorityUpdateInterval)
+        {
+            updatePriorities(&abortedReplies);
+        }
+
+        int activeCount = m_dispatchedRequestCount;
+        QMap<RequestPriority, WmsRequest*>::iterator iter = m_queue.begin();
+        while (iter != m_queue.end() && activeCount < MaxOutstandingNetworkRequests)
+        {
+            WmsRequest* request = iter.value();
+            if (m_activeRequestsPerServer.value(request->server) >= serverRequestLimit(request->server))
             {
-                requestTile(op);
+                // This server is busy; look for requests to other servers
+                ++iter;
             }
             else
             {
-                QMutexLocker locker(&m_mutex);
-                m_queuedTiles.append(op);
+                iter = m_queue.erase(iter);
+                m_activeRequestsPerServer[request->server]++;
+                activeCount++;
+                readyRequests << request;
             }
         }
     }
+
+    // Aborting a reply may emit the finished signal immediately, so this must
+    // be done after the mutex is released.
+    foreach (QNetworkReply* reply, abortedReplies)
+    {
+        reply->abort();
+    }
+
+    foreach (WmsRequest* request, readyRequests)
+    {
+        requestTile(request);
+    }
+}
+
+
+// Recompute the priorities of all queued requests. Queued requests for tiles that
+// haven't been visible recently are dropped, and the replies for active requests
+// for such tiles are added to the list of replies to abort. The caller must hold
+// the mutex.
+void
+WMSRequester::updatePriorities(QList<QNetworkReply*>* abortedReplies)
+{
+    m_lastPriorityUpdate = m_clock.elapsed();
+
+    QList<WmsRequest*> queuedRequests = m_queue.values();
+    m_queue.clear();
+
+    vesta::v_uint64 mostRecent = 0;
+    foreach (WmsRequest* request, queuedRequests)
+    {
+        request->priority = requestPriority(request);
+        mostRecent = max(mostRecent, request->priority.lastUsed);
+    }
+
+    QList<WmsRequest*> activeRequests = m_activeRequests.values();
+    foreach (WmsRequest* request, activeRequests)
+    {
+        request->priority = requestPriority(request);
+        mostRecent = max(mostRecent, request->priority.lastUsed);
+    }
+
+    // We want to load tiles for the location that the user is looking at now, not
+    // the places that they zoomed past quickly on the way there.
+    vesta::v_uint64 cullBefore = mostRecent >= CullLag ? mostRecent - CullLag : 0;
+
+    foreach (WmsRequest* request, queuedRequests)
+    {
+        if (request->priority.lastUsed < cullBefore)
+        {
+            cancelOperations(request);
+            m_requests.remove(request->urlString);
+            delete request;
+            ++m_cancelledRequestCount;
+        }
+        else
+        {
+            m_queue.insert(request->priority, request);
+        }
+    }
+
+    foreach (WmsRequest* request, activeRequests)
+    {
+        if (request->priority.lastUsed < cullBefore)
+        {
+            QNetworkReply* reply = request->reply;
+
+            // Remove all record of the request before it's aborted; the finished
+            // signal for an aborted reply is ignored by processTile().
+            cancelOperations(request);
+            m_requests.remove(request->urlString);
+            m_activeRequests.remove(reply);
+            m_activeRequestsPerServer[request->server]--;
+            m_dispatchedRequestCount--;
+            delete request;
+            ++m_cancelledRequestCount;
+
+            *abortedReplies << reply;
+        }
+    }
+}
+
+
+// Release all of the tile build operations for a request that will never complete.
+// The texture loader is notified so that it can reset the textures; they will be
+// requested again if they become visible later. Texture status is owned by the GUI
+// thread, so it must not be modified here.
+void
+WMSRequester::cancelOperations(WmsRequest* request)
+{
+    foreach (TileBuildOperation op, request->ops)
+    {
+        if (!op.tile->cancelled)
+        {
+            op.tile->cancelled = true;
+            emit tileCancelled(op.tile->tileName);
+        }
+        releaseOperation(op);
+    }
+    request->ops.clear();
+}
+
+
+// Remove one operation from a tile assembly, deleting the assembly if it has no
+// more outstanding operations.
+void
+WMSRequester::releaseOperation(const TileBuildOperation& op)
+{
+    op.tile->requestCount--;
+    if (op.tile->requestCount == 0)
+    {
+        delete op.tile;
+    }
 }
 
 
 void
-WMSRequester::requestTile(const TileBuildOperation& op)
+WMSRequester::requestTile(WmsRequest* request)
 {
-    QUrl url(op.urlString);
+    QUrl url(request->urlString);
 
     // Testing the 'SourceIsFromCache' attribute of replies from the OnEarth server
     // seems to indicate that the tiles are not being cached. However, tiles are still
     // appearing in the cache directory. The following code attempts to force using
     // the cache, but may not be effective.
     QNetworkCacheMetaData cacheData = m_networkManager->cache()->metaData(url);
-    QNetworkRequest request(url);
+    QNetworkRequest networkRequest(url);
     if (cacheData.isValid())
     {
-        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysCache);
+        networkRequest.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysCache);
     }
     else
     {
-        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
+        networkRequest.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
     }
 
-    QNetworkReply* reply = m_networkManager->get(request);
+    QNetworkReply* reply = m_networkManager->get(networkRequest);
 
     m_mutex.lock();
     m_dispatchedRequestCount++;
-    m_requestedTiles[reply] = op;
+    request->reply = reply;
+    request->dispatchTime = m_clock.elapsed();
+    m_activeRequests[reply] = request;
+
+    qint64 queueLatency = request->dispatchTime - request->queuedTime;
+    m_totalQueueLatency += queueLatency;
+    m_maxQueueLatency = max(m_maxQueueLatency, queueLatency);
+    m_sentRequestCount++;
     m_mutex.unlock();
 }
 
@@ -244,7 +505,28 @@ WMSRequester::processTile(QNetworkReply* reply)
     QVariant redirectionTargetUrl = reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
     // see CS001432 on how to handle this
 
-    --m_dispatchedRequestCount;
+    WmsRequest* request = NULL;
+    {
+        QMutexLocker locker(&m_mutex);
+        request = m_activeRequests.take(reply);
+        if (request)
+        {
+            --m_dispatchedRequestCount;
+            m_activeRequestsPerServer[request->server]--;
+            m_requests.remove(request->urlString);
+            m_totalResponseTime += m_clock.elapsed() - request->dispatchTime;
+            m_completedRequestCount++;
+        }
+    }
+
+    if (!request)
+    {
+        // The request was cancelled
+        reply->deleteLater();
+        return;
+    }
+
+    QImage image;
 
     // no error received?
     if (reply->error() == QNetworkReply::NoError)
@@ -252,137 +534,80 @@ WMSRequester::processTile(QNetworkReply* reply)
         bool fromCache = reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
 
         QImageReader imageReader(reply);
-        QImage image = imageReader.read();
+        image = imageReader.read();
 
         if (image.isNull())
         {
             qDebug() << "Received bad image: " << reply->header(QNetworkRequest::LocationHeader);
         }
-        else
-        {
-            QMutexLocker locker(&m_mutex);
-
-            TileBuildOperation op = m_requestedTiles.take(reply);
-
-            TileAssembly* tileAssembly = op.tile;
-
-            if (tileAssembly)
-            {
-                bool firstOp = false;
-                if (tileAssembly->tileImage.isNull())
-                {
-                     tileAssembly->tileImage = QImage(tileAssembly->tileWidth, tileAssembly->tileHeight, QImage::Format_RGB888);
-                     firstOp = true;
-                }
-
-                QPainter painter(&tileAssembly->tileImage);
-
-                // Clear the background to white before the first operation
-                if (firstOp)
-                {
-                    painter.fillRect(QRectF(0.0f, 0.0f, tileAssembly->tileImage.width(), tileAssembly->tileImage.height()), Qt::white);
-                }
-
-                painter.setRenderHints(QPainter::SmoothPixmapTransform, true);
-
-                // A hack to work around some drawing problems that left occasional gaps
-                // in tiles. There's either a bug in Qt's painter class, or some trouble
-                // with roundoff errors. Increasing the rectangle size very slightly
-                // eliminates the gaps.
-                QRectF r(op.subrect);
-                r.setSize(QSizeF(r.width() * 1.0001f, r.height() * 1.0001f));
-                painter.drawImage(r, image);
-                painter.end();
-
-                tileAssembly->requestCount--;
-                if (tileAssembly->requestCount == 0)
-                {
-                    QString imageName = tileFileName(tileAssembly->tileName, tileAssembly->surfaceName);
-                    QFileInfo fileInfo(imageName);
-                    QDir tileDir = fileInfo.dir();
-                    if (!tileDir.exists())
-                    {
-                        tileDir.mkpath(tileDir.absolutePath());
-                    }
-
-                    bool ok = tileAssembly->tileImage.save(imageName);
-                    if (!ok)
-                    {
-                        qDebug() << "Failed writing to " << imageName;
-                    }
-
-                    emit imageCompleted(tileAssembly->tileName, tileAssembly->tileImage.rgbSwapped());
-                    delete tileAssembly;
-                }
-            }
-        }
     }
     else
     {
         qDebug() << "Network error: " << reply->errorString();
     }
 
-    reply->deleteLater();
-
-    // If there are queued tiled requests and not too many active WMS server connections,
-    // then make some more network requests. Prioritize requests for textures tiles that
-    // are currently visible.
-    while (m_dispatchedRequestCount < MaxOutstandingNetworkRequests)
+    // Blit the WMS image into every tile that needs it
+    foreach (TileBuildOperation op, request->ops)
     {
-        int tileIndex = -1;
-        vesta::v_uint64 mostRecent = 0;
-        TileBuildOperation op;
-        {
-            QMutexLocker locker(&m_mutex);
+        TileAssembly* tileAssembly = op.tile;
 
-            // Request a WMS tile for the most recently used texture tile
-            for (int i = 0; i < m_queuedTiles.size(); ++i)
+        if (!image.isNull() && !tileAssembly->cancelled)
+        {
+            bool firstOp = false;
+            if (tileAssembly->tileImage.isNull())
             {
-                if (m_queuedTiles[i].tile->texture->lastUsed() > mostRecent)
-                {
-                    tileIndex = i;
-                    mostRecent = m_queuedTiles[i].tile->texture->lastUsed();
-                }
+                 tileAssembly->tileImage = QImage(tileAssembly->tileWidth, tileAssembly->tileHeight, QImage::Format_RGB888);
+                 firstOp = true;
             }
 
-            if (tileIndex >= 0)
+            QPainter painter(&tileAssembly->tileImage);
+
+            // Clear the background to white before the first operation
+            if (firstOp)
             {
-                op = m_queuedTiles.takeAt(tileIndex);
-
-                // Trim the queue by removing requests for tiles that haven't been visible
-                // for a while. This will happen when the user moves the camera quickly over
-                // the surface of a planet. We want to load tiles for the location that the
-                // user is looking at now, not the places that they zoomed past quickly on
-                // the way there.
-                //
-                // Tiles that haven't been accessed in the last cullLag frames are remove
-                const unsigned int cullLag = 60;
-                if (mostRecent >= cullLag)
-                {
-                    vesta::v_uint64 cullBefore = mostRecent - cullLag;
-                    for (int i = m_queuedTiles.size() - 1; i >= 0; --i)
-                    {
-                        if (m_queuedTiles[i].tile->texture->lastUsed() < cullBefore)
-                        {
-                            // Set status to unitialized so that loading will be retried if the tile
-                            // comes into view later.
-                            m_queuedTiles[i].tile->texture->setStatus(vesta::TextureMap::Uninitialized);
-                            m_queuedTiles.removeAt(i);
-                        }
-                    }
-                }
+                painter.fillRect(QRectF(0.0f, 0.0f, tileAssembly->tileImage.width(), tileAssembly->tileImage.height()), Qt::white);
             }
-        }
 
-        if (tileIndex >= 0)
+            painter.setRenderHints(QPainter::SmoothPixmapTransform, true);
+
+            // A hack to work around some drawing problems that left occasional gaps
+            // in tiles. There's either a bug in Qt's painter class, or some trouble
+            // with roundoff errors. Increasing the rectangle size very slightly
+            // eliminates the gaps.
+            QRectF r(op.subrect);
+            r.setSize(QSizeF(r.width() * 1.0001f, r.height() * 1.0001f));
+            painter.drawImage(r, image);
+            painter.end();
+        }
+        else if (!tileAssembly->cancelled)
         {
-            requestTile(op);
+            // A tile with a missing piece is never completed. Report the failure so
+            // that the texture isn't left in the loading state; it will be requested
+            // again if the tiled map drops it and later needs it.
+            tileAssembly->cancelled = true;
+            emit tileFailed(tileAssembly->tileName);
         }
-        else
+
+        if (tileAssembly->requestCount == 1 && !tileAssembly->cancelled)
         {
-            break;
+            QImage textureImage = tileAssembly->tileImage.rgbSwapped();
+            if (tileAssembly->address.valid)
+            {
+                m_tileCache.storeTile(tileAssembly->surfaceName, tileAssembly->address.level, tileAssembly->address.x, tileAssembly->address.y, textureImage);
+            }
+
+            emit imageCompleted(tileAssembly->tileName, textureImage);
         }
+
+        releaseOperation(op);
     }
+
+    delete request;
+    reply->deleteLater();
+
+    // If there are queued tiled requests and not too many active WMS server connections,
+    // then make some more network requests.
+    dispatchRequests();
 }
 
 
@@ -401,15 +626,6 @@ WMSRequester::addSurfaceDefinition(const QString& name,
 }
 
 
-QString
-WMSRequester::tileFileName(const QString& tileName, const QString& surfaceName)
-{
-    //QString cacheDirName = QDesktopServices::storageLocation(QDesktopServices::CacheLocation) + "/wms_tiles";
-    QString cacheDirName = QStandardPaths::locate(QStandardPaths::CacheLocation, "wms_tiles", QStandardPaths::LocateDirectory);
-    return QString("%1/%2/%3.png").arg(cacheDirName).arg(surfaceName).arg(tileName);
-}
-
-
 // The names should all have the form:
 //   wms:LAYERNAME:LEVEL:X:Y
 // For example, wms:earth-bmng:3:7:1
@@ -462,5 +678,80 @@ WMSRequester::parseTileName(const QString& tileName)
 unsigned int
 WMSRequester::pendingTileCount() const
 {
-    return (unsigned int) (m_dispatchedRequestCount + m_queuedTiles.size());
+    return (unsigned int) (m_dispatchedRequestCount + m_queue.size());
+}
+
+
+/** Set the default maximum number of simultaneous requests to any one server.
+  * The limit for a particular server may be overridden with setServerRequestLimit().
+  */
+void
+WMSRequester::setMaxRequestsPerServer(int maxRequests)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxRequestsPerServer = max(1, maxRequests);
+}
+
+
+/** Set the maximum number of simultaneous requests to a server. The server is
+  * identified by host name and port, e.g. "onearth.jpl.nasa.gov:80". A limit
+  * of zero or less restores the default limit.
+  */
+void
+WMSRequester::setServerRequestLimit(const QString& server, int maxRequests)
+{
+    QMutexLocker locker(&m_mutex);
+    if (maxRequests > 0)
+    {
+        m_serverRequestLimits[server] = maxRequests;
+    }
+    else
+    {
+        m_serverRequestLimits.remove(server);
+    }
+}
+
+
+/** Get the maximum number of simultaneous requests to a server.
+  */
+int
+WMSRequester::serverRequestLimit(const QString& server) const
+{
+    return m_serverRequestLimits.value(server, m_maxRequestsPerServer);
+}
+
+
+/** Get the average time in milliseconds that requests waited in the queue
+  * before being sent to the server.
+  */
+double
+WMSRequester::averageQueueLatency() const
+{
+    return m_sentRequestCount == 0 ? 0.0 : double(m_totalQueueLatency) / double(m_sentRequestCount);
+}
+
+
+/** Get the average time in milliseconds between sending a request and
+  * receiving the reply.
+  */
+double
+WMSRequester::averageResponseTime() const
+{
+    return m_completedRequestCount == 0 ? 0.0 : double(m_totalResponseTime) / double(m_completedRequestCount);
+}
+
+
+/** Reset the request counts and latency statistics.
+  */
+void
+WMSRequester::resetStatistics()
+{
+    QMutexLocker locker(&m_mutex);
+    m_coalescedRequestCount = 0;
+    m_cancelledRequestCount = 0;
+    m_sentRequestCount = 0;
+    m_completedRequestCount = 0;
+    m_totalQueueLatency = 0;
+    m_maxQueueLatency = 0;
+    m_totalResponseTime = 0;
 }
@@ -15,11 +15,14 @@
 #ifndef _WMS_REQUESTER_H_
 #define _WMS_REQUESTER_H_
 
+#include "TileDiskCache.h"
 #include <vesta/TextureMap.h>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QImage>
 #include <QMutex>
+#include <QMap>
+#include <QElapsedTimer>
 
 class WMSRequester : public QObject
 {
@@ -81,6 +84,10 @@ public:
         int requestCount;
         TileAddress address;
         vesta::TextureMap* texture;
+
+        // Set when the tile is no longer wanted; the assembly is deleted without
+        // being emitted once all of its outstanding requests have finished.
+        bool cancelled;
     };
 
     struct SurfaceProperties
@@ -114,6 +121,41 @@ public:
         QString urlString;
     };
 
+    /** Priority of a WMS request. Requests for the most recently visible tiles
+      * come first, followed by requests for lower resolution levels. The sequence
+      * number breaks ties in the order that the requests were queued.
+      */
+    struct RequestPriority
+    {
+        vesta::v_uint64 lastUsed;
+        unsigned int level;
+        quint64 sequence;
+
+        bool operator<(const RequestPriority& other) const
+        {
+            if (lastUsed != other.lastUsed)
+                return lastUsed > other.lastUsed;
+            else if (level != other.level)
+                return level < other.level;
+            else
+                return sequence < other.sequence;
+        }
+    };
+
+    /** A single request to a WMS server. Tiles that need the same WMS image
+      * (e.g. the layers of a MultiWMSTiledMap) share one request.
+      */
+    struct WmsRequest
+    {
+        QString urlString;
+        QString server;
+        QList<TileBuildOperation> ops;
+        RequestPriority priority;
+        QNetworkReply* reply;
+        qint64 queuedTime;
+        qint64 dispatchTime;
+    };
+
     void addSurfaceDefinition(const QString& name,
                               const QString& requestBase,
                               const LatLongBoundingBox& topLeftBox,
@@ -123,6 +165,53 @@ public:
 
     unsigned int pendingTileCount() const;
 
+    /** Get the default maximum number of simultaneous requests to a single server.
+      */
+    int maxRequestsPerServer() const
+    {
+        return m_maxRequestsPerServer;
+    }
+
+    void setMaxRequestsPerServer(int maxRequests);
+    void setServerRequestLimit(const QString& server, int maxRequests);
+    int serverRequestLimit(const QString& server) const;
+
+    /** Get the number of WMS requests that were shared by more than one tile.
+      */
+    unsigned int coalescedRequestCount() const
+    {
+        return m_coalescedRequestCount;
+    }
+
+    /** Get the number of WMS requests that were dropped or aborted because
+      * the tiles that needed them were no longer visible.
+      */
+    unsigned int cancelledRequestCount() const
+    {
+        return m_cancelledRequestCount;
+    }
+
+    double averageQueueLatency() const;
+    double averageResponseTime() const;
+
+    /** Get the longest time in milliseconds that any request waited in the
+      * queue before being sent.
+      */
+    qint64 maxQueueLatency() const
+    {
+        return m_maxQueueLatency;
+    }
+
+    void resetStatistics();
+
+    /** Get the cache of finished tiles. The cache should only be modified
+      * from the thread that the WMSRequester runs in.
+      */
+    TileDiskCache* tileCache()
+    {
+        return &m_tileCache;
+    }
+
 public slots:
     void retrieveTile(const QString& tileName,
                       const QString& surface,
@@ -135,22 +224,52 @@ private slots:
 
 signals:
     void imageCompleted(const QString& tileName, const QImage& image);
+    void tileCancelled(const QString& tileName);
+    void tileFailed(const QString& tileName);
 
 private:
-    QString tileFileName(const QString& tileName, const QString& surfaceName);
     QString createWmsUrl(const QString& requestUrl,
                          const LatLongBoundingBox& box,
                          unsigned int tileWidth,
                          unsigned int tileHeight) const;
-    void requestTile(const TileBuildOperation& op);
+    void queueOperation(const TileBuildOperation& op);
+    RequestPriority requestPriority(const WmsRequest* request) const;
+    void dispatchRequests();
+    void updatePriorities(QList<QNetworkReply*>* abortedReplies);
+    void requestTile(WmsRequest* request);
+    void cancelOperations(WmsRequest* request);
+    void releaseOperation(const TileBuildOperation& op);
 
 private:
     QNetworkAccessManager* m_networkManager;
-    QList<TileBuildOperation> m_queuedTiles;
-    QHash<QNetworkReply*, TileBuildOperation> m_requestedTiles;
+
+    // All queued and active requests, keyed by URL
+    QHash<QString, WmsRequest*> m_requests;
+
+    // Requests waiting to be sent, ordered by priority
+    QMap<RequestPriority, WmsRequest*> m_queue;
+
+    QHash<QNetworkReply*, WmsRequest*> m_activeRequests;
+    QHash<QString, int> m_activeRequestsPerServer;
+    QHash<QString, int> m_serverRequestLimits;
+    int m_maxRequestsPerServer;
+
     QHash<QString, SurfaceProperties> m_surfaces;
     QMutex m_mutex;
     int m_dispatchedRequestCount;
+    quint64 m_requestSequence;
+    QElapsedTimer m_clock;
+    qint64 m_lastPriorityUpdate;
+
+    unsigned int m_coalescedRequestCount;
+    unsigned int m_cancelledRequestCount;
+    unsigned int m_sentRequestCount;
+    unsigned int m_completedRequestCount;
+    qint64 m_totalQueueLatency;
+    qint64 m_maxQueueLatency;
+    qint64 m_totalResponseTime;
+
+    TileDiskCache m_tileCache;
 };
 
 #endif // _WMS_REQUESTER_H_
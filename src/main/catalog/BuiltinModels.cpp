@@ -0,0 +1,130 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "BuiltinModels.h"
+#include "UniverseLoader.h"
+#include "../JPLEphemeris.h"
+#include "../LinearCombinationTrajectory.h"
+#include "../astro/IAULunarRotationModel.h"
+#include "../astro/MarsSat.h"
+#include "../astro/L1.h"
+#include "../astro/TASS17.h"
+#include "../astro/Gust86.h"
+
+using namespace vesta;
+
+
+// Convert a JPL ephemeris orbit from SSB-centered to Sun-centered
+static Trajectory*
+createSunRelativeTrajectory(const JPLEphemeris* eph, JPLEphemeris::JplObjectId id)
+{
+    LinearCombinationTrajectory* orbit = new LinearCombinationTrajectory(eph->trajectory(id), 1.0,
+                                                                         eph->trajectory(JPLEphemeris::Sun), -1.0);
+    orbit->setPeriod(eph->trajectory(id)->period());
+    return orbit;
+}
+
+
+/** Register the orbits and rotation models that are computed by Cosmographia
+  * rather than loaded from catalog files: planetary positions from the JPL
+  * ephemeris and analytical theories for the major planetary satellites.
+  * This must be called before loading any catalogs that refer to the
+  * builtin models.
+  */
+void
+AddBuiltinModels(UniverseLoader* loader)
+{
+    // Set up builtin orbits
+    JPLEphemeris* eph = JPLEphemeris::load("de406_1800-2100.dat");
+    if (eph)
+    {
+        loader->addBuiltinOrbit("Sun",     eph->trajectory(JPLEphemeris::Sun));
+        loader->addBuiltinOrbit("Moon",    eph->trajectory(JPLEphemeris::Moon));
+
+        // The code below will create planet trajectories relative to the SSB
+        /*
+        loader->addBuiltinOrbit("Mercury", eph->trajectory(JPLEphemeris::Mercury));
+        loader->addBuiltinOrbit("Venus",   eph->trajectory(JPLEphemeris::Venus));
+        loader->addBuiltinOrbit("EMB",     eph->trajectory(JPLEphemeris::EarthMoonBarycenter));
+        loader->addBuiltinOrbit("Mars",    eph->trajectory(JPLEphemeris::Mars));
+        loader->addBuiltinOrbit("Jupiter", eph->trajectory(JPLEphemeris::Jupiter));
+        loader->addBuiltinOrbit("Saturn",  eph->trajectory(JPLEphemeris::Saturn));
+        loader->addBuiltinOrbit("Uranus",  eph->trajectory(JPLEphemeris::Uranus));
+        loader->addBuiltinOrbit("Neptune", eph->trajectory(JPLEphemeris::Neptune));
+        loader->addBuiltinOrbit("Pluto",   eph->trajectory(JPLEphemeris::Pluto));
+        */
+
+        Trajectory* embTrajectory = createSunRelativeTrajectory(eph, JPLEphemeris::EarthMoonBarycenter);
+        loader->addBuiltinOrbit("EMB", embTrajectory);
+
+        loader->addBuiltinOrbit("Mercury", createSunRelativeTrajectory(eph, JPLEphemeris::Mercury));
+        loader->addBuiltinOrbit("Venus",   createSunRelativeTrajectory(eph, JPLEphemeris::Venus));
+        loader->addBuiltinOrbit("Mars",    createSunRelativeTrajectory(eph, JPLEphemeris::Mars));
+        loader->addBuiltinOrbit("Jupiter", createSunRelativeTrajectory(eph, JPLEphemeris::Jupiter));
+        loader->addBuiltinOrbit("Saturn",  createSunRelativeTrajectory(eph, JPLEphemeris::Saturn));
+        loader->addBuiltinOrbit("Uranus",  createSunRelativeTrajectory(eph, JPLEphemeris::Uranus));
+        loader->addBuiltinOrbit("Neptune", createSunRelativeTrajectory(eph, JPLEphemeris::Neptune));
+        loader->addBuiltinOrbit("Pluto",   createSunRelativeTrajectory(eph, JPLEphemeris::Pluto));
+
+        // m = the ratio of the Moon's to the mass of the Earth-Moon system
+        double m = 1.0 / (1.0 + eph->earthMoonMassRatio());
+        LinearCombinationTrajectory* earthTrajectory =
+                new LinearCombinationTrajectory(embTrajectory, 1.0,
+                                                eph->trajectory(JPLEphemeris::Moon), -m);
+        earthTrajectory->setPeriod(embTrajectory->period());
+        loader->addBuiltinOrbit("Earth", earthTrajectory);
+
+        // JPL HORIZONS results for position of Moon with respect to Earth at 1 Jan 2000 12:00
+        // position: -2.916083884571964E+05 -2.667168292374240E+05 -7.610248132320160E+04
+        // velocity:  6.435313736079528E-01 -6.660876955662288E-01 -3.013257066079174E-01
+        //std::cout << "Moon @ J2000:  " << eph->trajectory(JPLEphemeris::Moon)->position(0.0).transpose().format(16) << std::endl;
+
+        // JPL HORIZONS results for position of Earth with respect to Sun at 1 Jan 2000 12:00
+        // position: -2.649903422886233E+07  1.327574176646856E+08  5.755671744790662E+07
+        // velocity: -2.979426004836674E+01 -5.018052460415045E+00 -2.175393728607054E+00
+        //std::cout << "Earth @ J2000: " << earthTrajectory->position(0.0).transpose().format(16) << std::endl;
+    }
+
+    // Martian satellites
+    loader->addBuiltinOrbit("Phobos", MarsSatOrbit::Create(MarsSatOrbit::Phobos));
+    loader->addBuiltinOrbit("Deimos", MarsSatOrbit::Create(MarsSatOrbit::Deimos));
+
+    // Galilean satellites
+    loader->addBuiltinOrbit("Io", L1Orbit::Create(L1Orbit::Io));
+    loader->addBuiltinOrbit("Europa", L1Orbit::Create(L1Orbit::Europa));
+    loader->addBuiltinOrbit("Ganymede", L1Orbit::Create(L1Orbit::Ganymede));
+    loader->addBuiltinOrbit("Callisto", L1Orbit::Create(L1Orbit::Callisto));
+
+    // Saturnian satellites
+    loader->addBuiltinOrbit("Mimas",     TASS17Orbit::Create(TASS17Orbit::Mimas));
+    loader->addBuiltinOrbit("Enceladus", TASS17Orbit::Create(TASS17Orbit::Enceladus));
+    loader->addBuiltinOrbit("Tethys",    TASS17Orbit::Create(TASS17Orbit::Tethys));
+    loader->addBuiltinOrbit("Dione",     TASS17Orbit::Create(TASS17Orbit::Dione));
+    loader->addBuiltinOrbit("Rhea",      TASS17Orbit::Create(TASS17Orbit::Rhea));
+    loader->addBuiltinOrbit("Titan",     TASS17Orbit::Create(TASS17Orbit::Titan));
+    loader->addBuiltinOrbit("Hyperion",  TASS17Orbit::Create(TASS17Orbit::Hyperion));
+    loader->addBuiltinOrbit("Iapetus",   TASS17Orbit::Create(TASS17Orbit::Iapetus));
+
+    // Uranian satellites
+    loader->addBuiltinOrbit("Miranda",   Gust86Orbit::Create(Gust86Orbit::Miranda));
+    loader->addBuiltinOrbit("Ariel",     Gust86Orbit::Create(Gust86Orbit::Ariel));
+    loader->addBuiltinOrbit("Umbriel",   Gust86Orbit::Create(Gust86Orbit::Umbriel));
+    loader->addBuiltinOrbit("Titania",   Gust86Orbit::Create(Gust86Orbit::Titania));
+    loader->addBuiltinOrbit("Oberon",    Gust86Orbit::Create(Gust86Orbit::Oberon));
+
+    // Set up builtin rotation models
+    loader->addBuiltinRotationModel("IAU Moon", new IAULunarRotationModel());
+}
@@ -0,0 +1,706 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "MeshCache.h"
+#include <vesta/MeshGeometry.h>
+#include <vesta/Submesh.h>
+#include <vesta/VertexArray.h>
+#include <vesta/PrimitiveBatch.h>
+#include <vesta/Material.h>
+#include <vesta/TextureMapLoader.h>
+#include <vesta/Profiler.h>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstring>
+#include <vector>
+
+using namespace vesta;
+using namespace std;
+
+
+static const char CacheMagic[4] = { 'V', 'M', 'S', 'H' };
+
+// Written as a native integer; reads back differently on a machine with
+// the opposite byte order.
+static const v_uint32 ByteOrderMark = 0x01020304;
+
+// Index size tag for non-indexed primitive batches
+static const v_uint32 NoIndices = 0xffffffff;
+
+
+// Serializes mesh data into a buffer, keeping every item four byte aligned
+class CacheWriter
+{
+public:
+    void writeUint32(v_uint32 value)
+    {
+        m_data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void writeFloat(float value)
+    {
+        m_data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void writeBytes(const void* data, unsigned int size)
+    {
+        m_data.append(reinterpret_cast<const char*>(data), size);
+        while (m_data.size() % 4 != 0)
+        {
+            m_data.append('\0');
+        }
+    }
+
+    void writeString(const string& s)
+    {
+        writeUint32(v_uint32(s.size()));
+        writeBytes(s.data(), s.size());
+    }
+
+    void writeSpectrum(const Spectrum& s)
+    {
+        writeFloat(s.red());
+        writeFloat(s.green());
+        writeFloat(s.blue());
+    }
+
+    const QByteArray& data() const
+    {
+        return m_data;
+    }
+
+private:
+    QByteArray m_data;
+};
+
+
+// Reads mesh data directly from a mapped cache file. Every read is bounds
+// checked; after a failed read, ok() returns false and all further reads
+// return zero.
+class CacheReader
+{
+public:
+    CacheReader(const uchar* data, qint64 size) :
+        m_pos(data),
+        m_end(data + size),
+        m_ok(data != NULL)
+    {
+    }
+
+    bool ok() const
+    {
+        return m_ok;
+    }
+
+    v_uint32 readUint32()
+    {
+        v_uint32 value = 0;
+        const uchar* p = readBytes(sizeof(value));
+        if (p)
+        {
+            memcpy(&value, p, sizeof(value));
+        }
+        return value;
+    }
+
+    float readFloat()
+    {
+        float value = 0.0f;
+        const uchar* p = readBytes(sizeof(value));
+        if (p)
+        {
+            memcpy(&value, p, sizeof(value));
+        }
+        return value;
+    }
+
+    // Return a pointer to the next size bytes of the file and advance
+    // to the next four byte boundary.
+    const uchar* readBytes(unsigned int size)
+    {
+        unsigned int paddedSize = (size + 3) & ~3u;
+        if (!m_ok || size > 0x7fffffffu || m_end - m_pos < qint64(paddedSize))
+        {
+            m_ok = false;
+            return NULL;
+        }
+
+        const uchar* p = m_pos;
+        m_pos += paddedSize;
+        return p;
+    }
+
+    string readString()
+    {
+        v_uint32 length = readUint32();
+        const uchar* p = readBytes(length);
+        return p ? string(reinterpret_cast<const char*>(p), length) : string();
+    }
+
+    Spectrum readSpectrum()
+    {
+        float r = readFloat();
+        float g = readFloat();
+        float b = readFloat();
+        return Spectrum(r, g, b);
+    }
+
+    // Read an enum value, failing if it's larger than maxValue
+    v_uint32 readEnum(v_uint32 maxValue)
+    {
+        v_uint32 value = readUint32();
+        if (value > maxValue)
+        {
+            m_ok = false;
+            return 0;
+        }
+        return value;
+    }
+
+private:
+    const uchar* m_pos;
+    const uchar* m_end;
+    bool m_ok;
+};
+
+
+MeshCache::MeshCache(const QString& directory) :
+    m_directory(directory)
+{
+}
+
+
+/** Get the name of the cache file for a source mesh file. The name depends
+  * on the current state of the source file, so a modified source file
+  * maps to a different cache file. Meshes stored with and without vertex
+  * quantization requested are kept in separate files.
+  */
+QString
+MeshCache::cacheFileName(const QString& sourceFileName, bool quantization) const
+{
+    QFileInfo info(sourceFileName);
+    QString key = QString("%1|%2|%3|%4|%5").arg(info.absoluteFilePath())
+                                           .arg(info.size())
+                                           .arg(info.lastModified().toMSecsSinceEpoch())
+                                           .arg(quantization ? 1 : 0)
+                                           .arg(FormatVersion);
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+    return QDir(m_directory).filePath(QString::fromLatin1(hash) + ".vmesh");
+}
+
+
+// Texture names are stored relative to the texture search path in effect when
+// the mesh was loaded. Loading the texture with the same search path set
+// resolves to the original file, even if the model directory has moved.
+static string
+relativeTextureName(const string& name, const string& searchPath)
+{
+    string prefix = searchPath + "/";
+    if (!searchPath.empty() && name.compare(0, prefix.size(), prefix) == 0)
+    {
+        return name.substr(prefix.size());
+    }
+    else
+    {
+        return name;
+    }
+}
+
+
+static void
+writeTexture(CacheWriter& out, const TextureMap* texture, const string& searchPath)
+{
+    if (!texture || texture->name().empty())
+    {
+        out.writeUint32(0);
+        return;
+    }
+
+    out.writeUint32(1);
+    out.writeString(relativeTextureName(texture->name(), searchPath));
+
+    const TextureProperties& props = texture->properties();
+    out.writeUint32(props.addressS);
+    out.writeUint32(props.addressT);
+    out.writeUint32(props.usage);
+    out.writeUint32(props.useMipmaps ? 1 : 0);
+    out.writeUint32(props.maxAnisotropy);
+    out.writeUint32(props.maxMipmapLevel);
+}
+
+
+static TextureMap*
+readTexture(CacheReader& in, TextureMapLoader* textureLoader)
+{
+    if (in.readUint32() == 0)
+    {
+        return NULL;
+    }
+
+    string name = in.readString();
+
+    TextureProperties props;
+    props.addressS = TextureProperties::AddressMode(in.readEnum(TextureProperties::Clamp));
+    props.addressT = TextureProperties::AddressMode(in.readEnum(TextureProperties::Clamp));
+    props.usage = TextureProperties::TextureUsage(in.readEnum(TextureProperties::DepthTexture));
+    props.useMipmaps = in.readUint32() != 0;
+    props.maxAnisotropy = in.readUint32();
+    props.maxMipmapLevel = in.readUint32();
+
+    if (!in.ok() || !textureLoader)
+    {
+        return NULL;
+    }
+
+    return textureLoader->loadTexture(name, props);
+}
+
+
+static void
+writeMaterial(CacheWriter& out, const Material* material, const string& searchPath)
+{
+    out.writeUint32(material->brdf());
+    out.writeUint32(material->blendMode());
+    out.writeUint32(material->specularModifier());
+    out.writeFloat(material->opacity());
+    out.writeFloat(material->phongExponent());
+    out.writeFloat(material->fresnelReflectance());
+    out.writeSpectrum(material->diffuse());
+    out.writeSpectrum(material->specular());
+    out.writeSpectrum(material->emission());
+    writeTexture(out, material->baseTexture(), searchPath);
+    writeTexture(out, material->normalTexture(), searchPath);
+    writeTexture(out, material->specularTexture(), searchPath);
+}
+
+
+static Material*
+readMaterial(CacheReader& in, TextureMapLoader* textureLoader)
+{
+    Material* material = new Material();
+    material->setBrdf(Material::BRDF(in.readEnum(Material::RingParticles)));
+    material->setBlendMode(Material::BlendMode(in.readEnum(Material::PremultipliedAlphaBlend)));
+    material->setSpecularModifier(Material::SpecularModifierSource(in.readEnum(Material::DiffuseTextureAlpha)));
+    material->setOpacity(in.readFloat());
+    material->setPhongExponent(in.readFloat());
+    material->setFresnelReflectance(in.readFloat());
+    material->setDiffuse(in.readSpectrum());
+    material->setSpecular(in.readSpectrum());
+    material->setEmission(in.readSpectrum());
+    material->setBaseTexture(readTexture(in, textureLoader));
+    material->setNormalTexture(readTexture(in, textureLoader));
+    material->setSpecularTexture(readTexture(in, textureLoader));
+
+    return material;
+}
+
+
+static void
+writeBatch(CacheWriter& out, const PrimitiveBatch* batch)
+{
+    out.writeUint32(batch->primitiveType());
+    out.writeUint32(batch->isIndexed() ? v_uint32(batch->indexSize()) : NoIndices);
+    out.writeUint32(batch->primitiveCount());
+    out.writeUint32(batch->firstVertex());
+    if (batch->isIndexed())
+    {
+        unsigned int indexBytes = batch->indexSize() == PrimitiveBatch::Index16 ? 2 : 4;
+        out.writeUint32(batch->indexCount());
+        out.writeBytes(batch->indexData(), batch->indexCount() * indexBytes);
+    }
+}
+
+
+static void
+writeSubmesh(CacheWriter& out, const Submesh* submesh)
+{
+    const VertexArray* vertices = submesh->vertices();
+    const VertexSpec& spec = vertices->vertexSpec();
+
+    out.writeUint32(spec.attributeCount());
+    for (unsigned int i = 0; i < spec.attributeCount(); ++i)
+    {
+        out.writeUint32(spec.attribute(i).semantic());
+        out.writeUint32(spec.attribute(i).format());
+        out.writeUint32(spec.attributeOffset(i));
+    }
+
+    out.writeUint32(vertices->stride());
+    out.writeUint32(vertices->count());
+    out.writeFloat(vertices->positionScale());
+    out.writeFloat(vertices->positionOffset().x());
+    out.writeFloat(vertices->positionOffset().y());
+    out.writeFloat(vertices->positionOffset().z());
+    out.writeBytes(vertices->data(), vertices->count() * vertices->stride());
+
+    const vector<PrimitiveBatch*>& batches = submesh->primitiveBatches();
+    out.writeUint32(batches.size());
+    for (unsigned int i = 0; i < batches.size(); ++i)
+    {
+        out.writeUint32(submesh->materials()[i]);
+        writeBatch(out, batches[i]);
+    }
+
+    // Levels of detail; batches shared with the full resolution level are
+    // marked as absent.
+    out.writeUint32(submesh->levelOfDetailCount() - 1);
+    for (unsigned int level = 1; level < submesh->levelOfDetailCount(); ++level)
+    {
+        out.writeFloat(submesh->levelOfDetailError(level));
+        for (unsigned int i = 0; i < batches.size(); ++i)
+        {
+            const PrimitiveBatch* batch = submesh->levelOfDetailBatch(level, i);
+            bool shared = batch == batches[i];
+            out.writeUint32(shared ? 0 : 1);
+            if (!shared)
+            {
+                writeBatch(out, batch);
+            }
+        }
+    }
+}
+
+
+// Get the number of vertices (or indices) used by a batch of primitives. This
+// is the same as PrimitiveBatch::indexCount(), but can't overflow for corrupt
+// primitive counts.
+static v_uint64
+batchVertexCount(PrimitiveBatch::PrimitiveType type, unsigned int primitiveCount)
+{
+    switch (type)
+    {
+    case PrimitiveBatch::Triangles:
+        return v_uint64(primitiveCount) * 3;
+    case PrimitiveBatch::TriangleStrip:
+    case PrimitiveBatch::TriangleFan:
+        return v_uint64(primitiveCount) + 2;
+    case PrimitiveBatch::Lines:
+        return v_uint64(primitiveCount) * 2;
+    case PrimitiveBatch::LineStrip:
+        return v_uint64(primitiveCount) + 1;
+    default:
+        return primitiveCount;
+    }
+}
+
+
+// Read a primitive batch, returning null if it is malformed or references
+// vertices beyond the end of the vertex array.
+static PrimitiveBatch*
+readBatch(CacheReader& in, unsigned int vertexCount)
+{
+    PrimitiveBatch::PrimitiveType type = PrimitiveBatch::PrimitiveType(in.readEnum(PrimitiveBatch::Points));
+    v_uint32 indexSize = in.readUint32();
+    unsigned int primitiveCount = in.readUint32();
+    unsigned int firstVertex = in.readUint32();
+    if (!in.ok())
+    {
+        return NULL;
+    }
+
+    if (indexSize == NoIndices)
+    {
+        // Reject batches that would draw vertices beyond the end of the vertex array
+        if (v_uint64(firstVertex) + batchVertexCount(type, primitiveCount) > vertexCount)
+        {
+            return NULL;
+        }
+
+        return new PrimitiveBatch(type, primitiveCount, firstVertex);
+    }
+    else if (indexSize == PrimitiveBatch::Index16 || indexSize == PrimitiveBatch::Index32)
+    {
+        unsigned int indexBytes = indexSize == PrimitiveBatch::Index16 ? 2 : 4;
+        unsigned int indexCount = in.readUint32();
+        if (batchVertexCount(type, primitiveCount) != indexCount)
+        {
+            return NULL;
+        }
+
+        const uchar* indexData = indexCount <= 0x3fffffffu ? in.readBytes(indexCount * indexBytes) : NULL;
+        if (!indexData)
+        {
+            return NULL;
+        }
+
+        PrimitiveBatch* batch = NULL;
+        if (indexSize == PrimitiveBatch::Index16)
+        {
+            batch = new PrimitiveBatch(type, reinterpret_cast<const v_uint16*>(indexData), primitiveCount);
+        }
+        else
+        {
+            batch = new PrimitiveBatch(type, reinterpret_cast<const v_uint32*>(indexData), primitiveCount);
+        }
+
+        // Reject batches that would read beyond the vertex data
+        if (batch->maxVertexIndex() >= vertexCount)
+        {
+            delete batch;
+            return NULL;
+        }
+
+        return batch;
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+
+static Submesh*
+readSubmesh(CacheReader& in, unsigned int materialCount)
+{
+    unsigned int attributeCount = in.readUint32();
+    if (attributeCount == 0 || attributeCount > 16)
+    {
+        return NULL;
+    }
+
+    VertexAttribute attributes[16];
+    unsigned int offsets[16];
+    for (unsigned int i = 0; i < attributeCount; ++i)
+    {
+        VertexAttribute::Semantic semantic = VertexAttribute::Semantic(in.readEnum(VertexAttribute::Tangent));
+        VertexAttribute::Format format = VertexAttribute::Format(in.readEnum(VertexAttribute::Half2));
+        attributes[i] = VertexAttribute(semantic, format);
+        offsets[i] = in.readUint32();
+    }
+
+    VertexSpec spec(attributeCount, attributes, offsets);
+    unsigned int stride = in.readUint32();
+    unsigned int vertexCount = in.readUint32();
+    float positionScale = in.readFloat();
+    float offsetX = in.readFloat();
+    float offsetY = in.readFloat();
+    float offsetZ = in.readFloat();
+    if (!in.ok() || stride < spec.size() || stride % 4 != 0 || vertexCount == 0 || vertexCount > 0xffffffffu / stride)
+    {
+        return NULL;
+    }
+
+    const uchar* vertexData = in.readBytes(vertexCount * stride);
+    if (!vertexData)
+    {
+        return NULL;
+    }
+
+    char* data = new char[vertexCount * stride];
+    memcpy(data, vertexData, vertexCount * stride);
+    VertexArray* vertexArray = new VertexArray(data, vertexCount, spec, stride);
+    vertexArray->setPositionTransform(positionScale, Eigen::Vector3f(offsetX, offsetY, offsetZ));
+    Submesh* submesh = new Submesh(vertexArray);
+
+    unsigned int batchCount = in.readUint32();
+    for (unsigned int i = 0; i < batchCount && in.ok(); ++i)
+    {
+        unsigned int materialIndex = in.readUint32();
+        if (materialIndex != Submesh::DefaultMaterialIndex && materialIndex >= materialCount)
+        {
+            break;
+        }
+
+        PrimitiveBatch* batch = readBatch(in, vertexCount);
+        if (!batch)
+        {
+            break;
+        }
+
+        submesh->addPrimitiveBatch(batch, materialIndex);
+    }
+
+    if (!in.ok() || submesh->primitiveBatchCount() != batchCount)
+    {
+        delete submesh;
+        return NULL;
+    }
+
+    unsigned int levelCount = in.readUint32();
+    bool ok = true;
+    for (unsigned int level = 0; level < levelCount && ok && in.ok(); ++level)
+    {
+        float error = in.readFloat();
+        vector<PrimitiveBatch*> batches(batchCount, (PrimitiveBatch*) NULL);
+        for (unsigned int i = 0; i < batchCount && ok; ++i)
+        {
+            if (in.readUint32() != 0)
+            {
+                batches[i] = readBatch(in, vertexCount);
+                ok = batches[i] != NULL;
+            }
+        }
+
+        // The submesh takes ownership of the batches, so they'll be freed
+        // along with it if the level is incomplete.
+        submesh->addLevelOfDetail(error, batches);
+    }
+
+    if (!ok || !in.ok() || submesh->levelOfDetailCount() != levelCount + 1)
+    {
+        delete submesh;
+        return NULL;
+    }
+
+    return submesh;
+}
+
+
+/** Load the cached version of a mesh file. Returns null if there is no cache
+  * file for the current version of the source file, or if the cache file is
+  * damaged. Textures are created with the texture loader, which should have
+  * the same search path that was in effect when the mesh was stored.
+  *
+  * quantization must match the value passed to store(). It records whether
+  * quantization was requested rather than whether it succeeded, so a mesh
+  * that couldn't be quantized is still found in the cache.
+  */
+MeshGeometry*
+MeshCache::load(const QString& sourceFileName, TextureMapLoader* textureLoader, bool quantization) const
+{
+    VESTA_PROFILE_SCOPE("MeshCache::load");
+
+    QFile file(cacheFileName(sourceFileName, quantization));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return NULL;
+    }
+
+    qint64 fileSize = file.size();
+    uchar* mapped = file.map(0, fileSize);
+    if (!mapped)
+    {
+        return NULL;
+    }
+
+    CacheReader in(mapped, fileSize);
+
+    // Verify the header. The file name is derived from a hash of the key, so
+    // the full key is also checked here to guard against collisions.
+    QFileInfo info(sourceFileName);
+    const uchar* magic = in.readBytes(sizeof(CacheMagic));
+    bool headerOk = magic && memcmp(magic, CacheMagic, sizeof(CacheMagic)) == 0;
+    headerOk = headerOk && in.readUint32() == FormatVersion;
+    headerOk = headerOk && in.readUint32() == ByteOrderMark;
+    headerOk = headerOk && in.readString() == string(info.absoluteFilePath().toUtf8().constData());
+
+    v_uint64 sourceSize = in.readUint32();
+    sourceSize |= v_uint64(in.readUint32()) << 32;
+    v_uint64 sourceModified = in.readUint32();
+    sourceModified |= v_uint64(in.readUint32()) << 32;
+    headerOk = headerOk && sourceSize == v_uint64(info.size());
+    headerOk = headerOk && sourceModified == v_uint64(info.lastModified().toMSecsSinceEpoch());
+    headerOk = headerOk && in.readUint32() == (quantization ? 1u : 0u);
+
+    unsigned int materialCount = in.readUint32();
+    unsigned int submeshCount = in.readUint32();
+
+    if (!headerOk || !in.ok())
+    {
+        file.unmap(mapped);
+        return NULL;
+    }
+
+    MeshGeometry* mesh = new MeshGeometry();
+    for (unsigned int i = 0; i < materialCount && in.ok(); ++i)
+    {
+        mesh->addMaterial(readMaterial(in, textureLoader));
+    }
+
+    for (unsigned int i = 0; i < submeshCount && in.ok(); ++i)
+    {
+        Submesh* submesh = readSubmesh(in, materialCount);
+        if (!submesh)
+        {
+            break;
+        }
+        mesh->addSubmesh(submesh);
+    }
+
+    file.unmap(mapped);
+
+    if (!in.ok() || mesh->submeshCount() != submeshCount)
+    {
+        delete mesh;
+        return NULL;
+    }
+
+    return mesh;
+}
+
+
+/** Write an optimized mesh to the cache. Texture names are stored relative
+  * to textureSearchPath. quantization records whether vertex quantization
+  * was requested for the mesh, whether or not it succeeded. Returns false
+  * if the cache file couldn't be written.
+  */
+bool
+MeshCache::store(const QString& sourceFileName,
+                 const MeshGeometry* mesh,
+                 const string& textureSearchPath,
+                 bool quantization) const
+{
+    VESTA_PROFILE_SCOPE("MeshCache::store");
+
+    QFileInfo info(sourceFileName);
+    v_uint64 sourceSize = v_uint64(info.size());
+    v_uint64 sourceModified = v_uint64(info.lastModified().toMSecsSinceEpoch());
+
+    CacheWriter out;
+    out.writeBytes(CacheMagic, sizeof(CacheMagic));
+    out.writeUint32(FormatVersion);
+    out.writeUint32(ByteOrderMark);
+    out.writeString(string(info.absoluteFilePath().toUtf8().constData()));
+    out.writeUint32(v_uint32(sourceSize & 0xffffffff));
+    out.writeUint32(v_uint32(sourceSize >> 32));
+    out.writeUint32(v_uint32(sourceModified & 0xffffffff));
+    out.writeUint32(v_uint32(sourceModified >> 32));
+    out.writeUint32(quantization ? 1 : 0);
+
+    out.writeUint32(mesh->materialCount());
+    out.writeUint32(mesh->submeshCount());
+
+    for (unsigned int i = 0; i < mesh->materialCount(); ++i)
+    {
+        writeMaterial(out, mesh->material(i), textureSearchPath);
+    }
+
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        writeSubmesh(out, mesh->submesh(i));
+    }
+
+    if (!QDir().mkpath(m_directory))
+    {
+        return false;
+    }
+
+    // Write to a temporary file and rename it so that another process never
+    // sees a partially written cache file.
+    QSaveFile file(cacheFileName(sourceFileName, quantization));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    file.write(out.data());
+    return file.commit();
+}
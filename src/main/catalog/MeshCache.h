@@ -0,0 +1,67 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include <QString>
+#include <string>
+
+namespace vesta
+{
+class MeshGeometry;
+class TextureMapLoader;
+}
+
+
+/** MeshCache stores optimized meshes on disk so that the parsing and
+  * optimization steps can be skipped when the same model is loaded again.
+  * Each cached mesh is keyed by the absolute path, size, and modification
+  * time of its source file, whether vertex quantization was requested, and
+  * the cache format version; a change to any of these causes the mesh to be
+  * rebuilt from the source.
+  *
+  * Cache files are laid out so that they can be memory mapped: all sections
+  * begin on a four byte boundary and vertex and index data are stored in
+  * exactly the form used by VertexArray and PrimitiveBatch. Cache files are
+  * written in native byte order and are rejected on machines with a different
+  * byte order.
+  */
+class MeshCache
+{
+public:
+    explicit MeshCache(const QString& directory);
+
+    QString cacheFileName(const QString& sourceFileName, bool quantization) const;
+
+    vesta::MeshGeometry* load(const QString& sourceFileName,
+                              vesta::TextureMapLoader* textureLoader,
+                              bool quantization) const;
+    bool store(const QString& sourceFileName,
+               const vesta::MeshGeometry* mesh,
+               const std::string& textureSearchPath,
+               bool quantization) const;
+
+    /** Version of the cache file layout. This must be incremented whenever
+      * the file layout or the mesh optimization steps change.
+      */
+    static const unsigned int FormatVersion = 5;
+
+private:
+    QString m_directory;
+};
+
+#endif // _MESH_CACHE_H_
@@ -39,7 +39,13 @@ bool UniverseCatalog::contains(const QString& name) const
 }
 
 
-/** Lookup the VESTA body with the specified name.
+/** Lookup the VESTA body with the specified name. The name may also
+  * be an alias of the body. Case insensitive lookups use the name index,
+  * so they're no more expensive than case sensitive ones.
+  *
+  * A case insensitive lookup may match several names that differ only in
+  * case. A name with exactly the same case is preferred; otherwise, null is
+  * returned if the names refer to different bodies.
   */
 Entity* UniverseCatalog::find(const QString& name, Qt::CaseSensitivity caseSensitivity) const
 {
@@ -47,16 +53,26 @@ Entity* UniverseCatalog::find(const QString& name, Qt::CaseSensitivity caseSensi
 
     if (caseSensitivity == Qt::CaseSensitive)
     {
-        body = m_bodies.value(name).ptr();
+        body = m_bodies.value(resolveAlias(name)).ptr();
     }
     else
     {
-        foreach (QString s, m_bodies.keys())
+        QList<QString> matches = m_foldedNames.values(name.toCaseFolded());
+        if (matches.contains(name))
         {
-            if (name.compare(s, Qt::CaseInsensitive) == 0)
+            body = m_bodies.value(resolveAlias(name)).ptr();
+        }
+        else
+        {
+            foreach (QString match, matches)
             {
-                body = m_bodies.value(s).ptr();
-                break;
+                Entity* matchBody = m_bodies.value(resolveAlias(match)).ptr();
+                if (body && matchBody != body)
+                {
+                    // Ambiguous
+                    return NULL;
+                }
+                body = matchBody;
             }
         }
     }
@@ -88,18 +104,86 @@ BodyInfo* UniverseCatalog::findInfo(const Entity* body) const
 
 void UniverseCatalog::removeBody(const QString& name)
 {
-    m_bodies.remove(name);
+    if (m_bodies.remove(name) > 0)
+    {
+        removeIndexEntry(name);
+    }
     m_info.remove(name);
+
+    // Aliases are removed along with the body
+    foreach (QString alias, m_aliases.keys(name))
+    {
+        removeAlias(alias);
+    }
 }
 
 
 void UniverseCatalog::addBody(const QString& name, vesta::Entity* body, BodyInfo* info)
 {
+    // A body name takes the place of an alias with the same name
+    removeAlias(name);
+
+    if (!m_bodies.contains(name))
+    {
+        addIndexEntry(name);
+    }
     m_bodies[name] = counted_ptr<Entity>(body);
     m_info[name] = info;
 }
 
 
+/** Add an alternate name for a body. The alias may be used in place of
+  * the body name with find() and is included in name completions. An alias
+  * is removed when the body that it refers to is removed. Aliases that are
+  * the same as a body name are ignored.
+  */
+void UniverseCatalog::addAlias(const QString& alias, const QString& name)
+{
+    if (alias == name || m_bodies.contains(alias))
+    {
+        return;
+    }
+
+    if (!m_aliases.contains(alias))
+    {
+        addIndexEntry(alias);
+    }
+    m_aliases[alias] = name;
+}
+
+
+void UniverseCatalog::removeAlias(const QString& alias)
+{
+    if (m_aliases.remove(alias) > 0)
+    {
+        removeIndexEntry(alias);
+    }
+}
+
+
+void UniverseCatalog::addIndexEntry(const QString& name)
+{
+    QString folded = name.toCaseFolded();
+    m_foldedNames.insert(folded, name);
+    m_sortedNames.insert(folded, name);
+}
+
+
+void UniverseCatalog::removeIndexEntry(const QString& name)
+{
+    QString folded = name.toCaseFolded();
+    m_foldedNames.remove(folded, name);
+    m_sortedNames.remove(folded, name);
+}
+
+
+// Get the body name for an alias; names that aren't aliases are returned unchanged.
+QString UniverseCatalog::resolveAlias(const QString& name) const
+{
+    return m_aliases.value(name, name);
+}
+
+
 /** Set the addition information record for a body. This has
   * no effect if the named object doesn't exist in the catalog.
   */
@@ -141,6 +225,38 @@ UniverseCatalog::matchingNames(const QString& pattern) const
 }
 
 
+/** Return up to maxNames body names and aliases that begin with the specified
+  * prefix, ignoring case. The names are returned in case insensitive alphabetical
+  * order. The cost is O(log n + maxNames) for a catalog containing n names.
+  */
+QStringList
+UniverseCatalog::completeName(const QString& prefix, int maxNames) const
+{
+    QString foldedPrefix = prefix.toCaseFolded();
+
+    QStringList matches;
+    for (QMultiMap<QString, QString>::const_iterator iter = m_sortedNames.lowerBound(foldedPrefix);
+         iter != m_sortedNames.end() && matches.size() < maxNames && iter.key().startsWith(foldedPrefix);
+         ++iter)
+    {
+        matches << iter.value();
+    }
+
+    return matches;
+}
+
+
+/** Return a list of all body names and aliases in case insensitive alphabetical
+  * order. This list is suitable for a QCompleter using CaseInsensitivelySortedModel,
+  * which can then use binary searches instead of linear scans.
+  */
+QStringList
+UniverseCatalog::completionNames() const
+{
+    return m_sortedNames.values();
+}
+
+
 /** Look up the viewpoint with the specified name.
   */
 Viewpoint*
@@ -22,6 +22,7 @@
 #include <QString>
 #include <QStringList>
 #include <QMap>
+#include <QHash>
 
 class Viewpoint;
 
@@ -42,6 +43,11 @@ public:
 
     QStringList names() const;
     QStringList matchingNames(const QString& pattern) const;
+    QStringList completeName(const QString& prefix, int maxNames) const;
+    QStringList completionNames() const;
+
+    void addAlias(const QString& alias, const QString& name);
+    void removeAlias(const QString& alias);
 
     Viewpoint* findViewpoint(const QString& name);
     void addViewpoint(const QString& name, Viewpoint* viewpoint);
@@ -50,10 +56,23 @@ public:
 
     QString getDescription(vesta::Entity* body);
 
+private:
+    void addIndexEntry(const QString& name);
+    void removeIndexEntry(const QString& name);
+    QString resolveAlias(const QString& name) const;
+
 private:
     QMap<QString, vesta::counted_ptr<vesta::Entity> > m_bodies;
     QMap<QString, vesta::counted_ptr<BodyInfo> > m_info;
     QMap<QString, vesta::counted_ptr<Viewpoint> > m_viewpoints;
+
+    // Alternate names for bodies, mapped to the name used in m_bodies
+    QHash<QString, QString> m_aliases;
+
+    // Name index for case insensitive lookup and prefix completion. Both
+    // tables contain body names and aliases, keyed by the case folded name.
+    QMultiHash<QString, QString> m_foldedNames;
+    QMultiMap<QString, QString> m_sortedNames;
 };
 
 #endif // _UNIVERSE_CATALOG_H_
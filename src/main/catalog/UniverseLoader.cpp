@@ -17,6 +17,7 @@
 #include "UniverseLoader.h"
 #include "AstorbLoader.h"
 #include "ChebyshevPolyFileLoader.h"
+#include "MeshCache.h"
 #include "../TleTrajectory.h"
 #include "../InterpolatedStateTrajectory.h"
 #include "../InterpolatedRotation.h"
@@ -30,6 +31,7 @@
 #include "../geometry/FeatureLabelSetGeometry.h"
 #include "../compatibility/Scanner.h"
 #include "../compatibility/CmodLoader.h"
+#include "../compatibility/ObjFileLoader.h"
 #include "../compatibility/CatalogParser.h"
 #include "../compatibility/TransformCatalog.h"
 #include "../compatibility/CelBodyFixedFrame.h"
@@ -38,6 +40,7 @@
 #include "../vext/ArcStripParticleGenerator.h"
 #include "../vext/PathRelativeTextureLoader.h"
 #include "../vext/NameTemplateTiledMap.h"
+#include "../vext/TilePackTiledMap.h"
 #include "../vext/CompositeTrajectory.h"
 #include "../astro/Rotation.h"
 #include "../Viewpoint.h"
@@ -59,6 +62,8 @@
 #include <vesta/ArrowGeometry.h>
 #include <vesta/PlanetaryRings.h>
 #include <vesta/SensorFrustumGeometry.h>
+#include <vesta/SensorCoverage.h>
+#include <vesta/SensorCoverageLayer.h>
 #include <vesta/AxesVisualizer.h>
 #include <vesta/BodyDirectionVisualizer.h>
 #include <vesta/LocalVisualizer.h>
@@ -67,6 +72,7 @@
 #include <vesta/ParticleSystemGeometry.h>
 #include <vesta/Units.h>
 #include <vesta/GregorianDate.h>
+#include <vesta/Profiler.h>
 
 #ifdef SPICE_ENABLED
 #include "../spice/SpiceTrajectory.h"
@@ -87,6 +93,11 @@
 #include <QRegExp>
 #include <QBuffer>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThreadPool>
 
 using namespace vesta;
 using namespace Eigen;
@@ -95,6 +106,9 @@ using namespace Eigen;
 static const double DefaultStartTime = daysToSeconds(-36525.0 * 2);  // 12:00:00 1 Jan 1800
 static const double DefaultEndTime   = daysToSeconds( 36525.0);      // 12:00:00 1 Jan 2100
 
+// Upper limit on the memory used for each sensor coverage grid
+static const double MaxSensorCoverageMemory = 64.0 * 1024.0 * 1024.0;
+
 QString ValueUnitsRegexpString("^\\s*([-+]?[0-9]*\\.?[0-9]+(?:[eE][-+]?[0-9]+)?)\\s*([A-Za-z]+)?\\s*$");
 
 
@@ -401,7 +415,8 @@ LoadInterpolatedRotation(const QString& fileName, RotationConvention mode)
 
 UniverseLoader::UniverseLoader() :
     m_dataSearchPath("."),
-    m_texturesInModelDirectory(true)
+    m_texturesInModelDirectory(true),
+    m_meshQuantization(false)
 {
 }
 
@@ -2422,6 +2437,56 @@ loadTiledMap(const QVariantMap& map, PathRelativeTextureLoader* textureLoader)
 
         return tiledMap;
     }
+    else if (type == "TilePack")
+    {
+        QVariant fileNameVar = map.value("file");
+        QVariant borderThicknessVar = map.value("tileBorderThickness");
+
+        if (fileNameVar.type() != QVariant::String)
+        {
+            qDebug() << "Bad or missing file name for TilePack tiled texture";
+            return NULL;
+        }
+
+        float borderThickness = 0.0f;
+        if (borderThicknessVar.isValid())
+        {
+            bool ok = false;
+            borderThickness = borderThicknessVar.toFloat(&ok);
+            if (!ok)
+            {
+                qDebug() << "TilePack tiled texture has invalid border thickness.";
+                return NULL;
+            }
+        }
+
+        QString fileName = QString::fromUtf8(textureLoader->searchPath().c_str()) + QString("/") + fileNameVar.toString();
+
+        TilePackTiledMap* tiledMap = new TilePackTiledMap(textureLoader, fileName);
+        if (!tiledMap->isValid())
+        {
+            delete tiledMap;
+            return NULL;
+        }
+
+        // Enforce the same limits on tile size and level count as for NameTemplate
+        // maps, and report a smaller tile size in order to improve sharpness.
+        if (tiledMap->levelCount() > 16 || tiledMap->packTileSize() < 128 || tiledMap->packTileSize() > 8192)
+        {
+            qDebug() << "TilePack" << fileName << "has unsupported tile size or level count";
+            delete tiledMap;
+            return NULL;
+        }
+        tiledMap->setTileSize((tiledMap->packTileSize() * 3) / 5);
+
+        tiledMap->setTileBorderFraction(borderThickness);
+        if (tiledMap->tileFormat() == "dds" || tiledMap->tileFormat() == "dxt5nm")
+        {
+            tiledMap->setTextureUsage(TextureProperties::CompressedNormalMap);
+        }
+
+        return tiledMap;
+    }
     else
     {
         qDebug() << "Unknown tiled map type.";
@@ -2433,6 +2498,8 @@ loadTiledMap(const QVariantMap& map, PathRelativeTextureLoader* textureLoader)
 Geometry*
 UniverseLoader::loadMeshFile(const QString& fileName)
 {
+    VESTA_PROFILE_SCOPE("UniverseLoader::loadMeshFile");
+
     Geometry* geometry = NULL;
 
     // Check the cache first
@@ -2451,8 +2518,24 @@ UniverseLoader::loadMeshFile(const QString& fileName)
             m_textureLoader->setSearchPath(info.absolutePath().toUtf8().data());
         }
 
+        // Use the preprocessed version of the mesh if the cache has one
+        // for the current version of the file.
         MeshGeometry* meshGeometry = NULL;
-        if (fileName.toLower().endsWith(".cmod"))
+        bool cached = false;
+        if (!m_meshCacheDirectory.isEmpty())
+        {
+            // The quantization setting is part of the cache key. It's compared
+            // instead of checking for quantized vertices, since quantization
+            // fails for some meshes and those would otherwise never be cached.
+            meshGeometry = MeshCache(m_meshCacheDirectory).load(fileName, m_textureLoader.ptr(), m_meshQuantization);
+            cached = meshGeometry != NULL;
+        }
+
+        if (cached)
+        {
+            // Already optimized
+        }
+        else if (fileName.toLower().endsWith(".cmod"))
         {
             QFile cmodFile(fileName);
             if (!cmodFile.open(QIODevice::ReadOnly))
@@ -2469,20 +2552,44 @@ UniverseLoader::loadMeshFile(const QString& fileName)
                 }
             }
         }
+        else if (fileName.toLower().endsWith(".obj"))
+        {
+            ObjFileLoader loader(m_textureLoader.ptr());
+            meshGeometry = loader.loadMesh(fileName);
+            if (loader.error())
+            {
+                errorMessage(QString("Error loading OBJ file %1: %2").arg(fileName, loader.errorMessage()));
+            }
+        }
         else
         {
             meshGeometry = MeshGeometry::loadFromFile(fileName.toUtf8().data(), m_textureLoader.ptr());
         }
 
-        if (meshGeometry)
+        if (meshGeometry && !cached)
         {
             // Optimize the mesh. The optimizations can be expensive for large meshes, but they can dramatically
-            // improve rendering performance. The best solution is to use mesh files that are already optimized, but
-            // the average model loaded off the web benefits from some preprocessing at load time.
+            // improve rendering performance. The optimized mesh is saved in the mesh cache so that the work
+            // only has to be done the first time that a model is loaded.
             meshGeometry->mergeSubmeshes();
             meshGeometry->uniquifyVertices();
             meshGeometry->mergeMaterials();
+            meshGeometry->optimizeVertexCache();
+            meshGeometry->buildLevelsOfDetail();
             meshGeometry->compressIndices();
+            if (m_meshQuantization)
+            {
+                meshGeometry->quantizeVertices();
+            }
+
+            if (!m_meshCacheDirectory.isEmpty())
+            {
+                MeshCache(m_meshCacheDirectory).store(fileName, meshGeometry, m_textureLoader->searchPath(), m_meshQuantization);
+            }
+        }
+
+        if (meshGeometry)
+        {
             m_geometryCache.insert(fileName, vesta::counted_ptr<Geometry>(meshGeometry));
             geometry = meshGeometry;
         }
@@ -2865,10 +2972,98 @@ UniverseLoader::loadSensorGeometry(const QVariantMap& map, const UniverseCatalog
 
     sensorFrustum->setSource(catalog->find(m_currentBodyName));
 
+    QVariant coverageVar = map.value("coverage");
+    if (coverageVar.type() == QVariant::Map)
+    {
+        loadSensorCoverage(coverageVar.toMap(), sensorFrustum);
+    }
+
     return sensorFrustum;
 }
 
 
+// Add a layer to the sensor target showing the ground coverage accumulated
+// by the sensor. Coverage can only be shown on world (planet) geometry.
+void
+UniverseLoader::loadSensorCoverage(const QVariantMap& map, SensorFrustumGeometry* sensor)
+{
+    WorldGeometry* world = dynamic_cast<WorldGeometry*>(sensor->target()->geometry());
+    if (!world)
+    {
+        errorMessage("Sensor coverage can only be recorded on planet geometry");
+        return;
+    }
+
+    // Resolution is the size of a grid cell in degrees
+    double resolution = doubleValue(map.value("resolution"), 0.5);
+    if (resolution <= 0.0 || resolution > 90.0)
+    {
+        errorMessage("Bad resolution given for sensor coverage");
+        return;
+    }
+
+    // Each cell needs a two byte count plus four bytes each for the image and
+    // the texture; limit the grid to MaxSensorCoverageMemory.
+    double minResolution = 180.0 / floor(sqrt(MaxSensorCoverageMemory / (2.0 * 10.0)));
+    if (resolution < minResolution)
+    {
+        warningMessage(QString("Sensor coverage resolution limited to %1 degrees").arg(minResolution));
+        resolution = minResolution;
+    }
+
+    // If the catalog containing the sensor was loaded before, the target still
+    // has the layer for the earlier instance of the sensor; replace it.
+    for (unsigned int i = world->layerCount(); i > 0; --i)
+    {
+        SensorCoverageLayer* layer = dynamic_cast<SensorCoverageLayer*>(world->layer(i - 1));
+        if (layer)
+        {
+            SensorFrustumGeometry* oldSensor = layer->coverage()->sensor();
+            if (!oldSensor || (oldSensor->source() && QString::fromUtf8(oldSensor->source()->name().c_str()) == m_currentBodyName))
+            {
+                world->removeLayer(i - 1);
+            }
+        }
+    }
+
+    bool ok = true;
+    double timeStep = 10.0;
+    QVariant timeStepVar = map.value("timeStep");
+    if (timeStepVar.isValid())
+    {
+        timeStep = durationValue(timeStepVar, Unit_Second, 10.0, &ok);
+        if (!ok || timeStep <= 0.0)
+        {
+            errorMessage("Bad time step given for sensor coverage");
+            return;
+        }
+    }
+
+    unsigned int latitudeCells = (unsigned int) ceil(180.0 / resolution);
+    SensorCoverage* coverage = new SensorCoverage(sensor, latitudeCells * 2, latitudeCells);
+    coverage->setTimeStep(timeStep);
+
+    QVariant startTimeVar = map.value("startTime");
+    if (startTimeVar.isValid())
+    {
+        double startTime = dateValue(startTimeVar, &ok);
+        if (!ok)
+        {
+            errorMessage("Bad start time given for sensor coverage");
+        }
+        else
+        {
+            coverage->setStartTime(startTime);
+        }
+    }
+
+    SensorCoverageLayer* layer = new SensorCoverageLayer(coverage);
+    layer->setColor(colorValue(map.value("color"), sensor->color()));
+    layer->setOpacity(float(doubleValue(map.value("opacity"), 0.5)));
+    world->addLayer(layer);
+}
+
+
 static vesta::ArrowGeometry*
 loadAxesGeometry(const QVariantMap& map)
 {
@@ -3462,6 +3657,13 @@ UniverseLoader::loadGeometry(const QVariantMap& map, const UniverseCatalog* cata
         errorMessage(QString("Unknown type '%1' for geometry.").arg(type));
     }
 
+    // Coverage is only recorded for frustum sensors. Multi-cone sensors and
+    // other geometry have no footprint that SensorCoverage can rasterize.
+    if (geometry && type != "Sensor" && map.contains("coverage"))
+    {
+        warningMessage(QString("Sensor coverage is not supported for geometry of type '%1'; only Sensor geometry records coverage.").arg(type));
+    }
+
     return geometry;
 }
 
@@ -3681,40 +3883,37 @@ planetocentricToRectangular(const AlignedEllipsoid& e, const PlanetographicCoord
 #endif
 
 
-Visualizer*
-UniverseLoader::loadFeatureLabels(const QVariantMap& map,
-                                  const Entity* body)
-{
-    QVariant featuresVar = map.value("features");
-
-    if (featuresVar.type() != QVariant::List)
-    {
-        errorMessage("Features list in FeatureLabels item is missing or invalid.");
-        return NULL;
-    }
+// Color used for all planetary feature labels
+static const Spectrum FeatureLabelColor(1.0f, 1.0f, 0.85f);
 
-    if (!body->geometry() || !body->geometry()->isEllipsoidal())
-    {
-        return NULL;
-    }
+struct FeatureLabelRecord
+{
+    std::string name;
+    Vector3f position;
+    float radius;
+};
 
-    // Get the spin axis at the J2000.0 epoch; use this to determine whether the body
-    // is a retrograde rotator.
-    Vector3d spinAxisEcl = InertialFrame::eclipticJ2000()->orientation().conjugate() * body->orientation(0.0) * Vector3d::UnitZ();
-    bool isRetrogradeRotator = spinAxisEcl.z() < 0.0;
+typedef QVector<FeatureLabelRecord> FeatureLabelRecordList;
 
-    AlignedEllipsoid ellipsoid = body->geometry()->ellipsoid();
 
-    counted_ptr<FeatureLabelSetGeometry> featureLabelSet(new FeatureLabelSetGeometry());
-    featureLabelSet->setOccluder(ellipsoid);
+// Convert a list of features from a FeatureLabels catalog item to positions in the
+// body-fixed frame. This function is also called from the thread that loads deferred
+// feature label catalogs, so it must not touch any shared state.
+static bool
+loadFeatureList(const QVariantList& featuresList,
+                const AlignedEllipsoid& ellipsoid,
+                bool isRetrogradeRotator,
+                FeatureLabelRecordList* features,
+                QString* errorString)
+{
+    features->reserve(features->size() + featuresList.size());
 
-    QVariantList featuresList = featuresVar.toList();
     foreach (QVariant featureVar, featuresList)
     {
         if (featureVar.type() != QVariant::Map)
         {
-            errorMessage("Bad feature in FeatureLabels list");
-            return NULL;
+            *errorString = "Bad feature in FeatureLabels list";
+            return false;
         }
 
         QVariantMap feature = featureVar.toMap();
@@ -3722,32 +3921,30 @@ UniverseLoader::loadFeatureLabels(const QVariantMap& map,
         QVariant nameVar = feature.value("name");
         if (nameVar.type() != QVariant::String)
         {
-            errorMessage("Bad or missing name for feature");
-            return NULL;
+            *errorString = "Bad or missing name for feature";
+            return false;
         }
 
-        std::string name(nameVar.toString().toUtf8().data());
-
         bool ok = false;
         double longitude = feature.value("longitude").toDouble(&ok);
         if (!ok)
         {
-            errorMessage("Bad or missing longitude for feature");
-            return NULL;
+            *errorString = "Bad or missing longitude for feature";
+            return false;
         }
 
         double latitude = feature.value("latitude").toDouble(&ok);
         if (!ok)
         {
-            errorMessage("Bad or missing latitude for feature");
-            return NULL;
+            *errorString = "Bad or missing latitude for feature";
+            return false;
         }
 
         double diameter = distanceValue(feature.value("diameter"), Unit_Kilometer, 0.0, &ok);
         if (!ok)
         {
-            errorMessage("Bad or missing diameter for feature");
-            return NULL;
+            *errorString = "Bad or missing diameter for feature";
+            return false;
         }
 
         // Reverse coordinates for retrograde rotators: the IAU coordinate systems for planets
@@ -3764,13 +3961,291 @@ UniverseLoader::loadFeatureLabels(const QVariantMap& map,
         PlanetographicCoord3 position(latitude, longitude, 0.0);
         Vector3d rectPosition = ellipsoid.planetographicToRectangular(position);
 
-        featureLabelSet->addFeature(name, rectPosition.cast<float>(), float(diameter / 2.0), Spectrum(1.0f, 1.0f, 0.85f));
+        FeatureLabelRecord record;
+        record.name = nameVar.toString().toUtf8().data();
+        record.position = rectPosition.cast<float>();
+        record.radius = float(diameter / 2.0);
+        features->append(record);
+    }
+
+    return true;
+}
+
+
+// Get the spin axis at the J2000.0 epoch; use this to determine whether the body
+// is a retrograde rotator.
+static bool
+isRetrogradeRotator(const Entity* body)
+{
+    Vector3d spinAxisEcl = InertialFrame::eclipticJ2000()->orientation().conjugate() * body->orientation(0.0) * Vector3d::UnitZ();
+    return spinAxisEcl.z() < 0.0;
+}
+
+
+// State shared by the deferred feature label sets loaded from a single catalog
+// file and the worker that parses the file. Everything except the body parameters
+// is guarded by the mutex; the body parameters aren't modified after the catalog
+// has been registered.
+class FeatureLabelCatalogState
+{
+public:
+    struct BodyParameters
+    {
+        Vector3d semiAxes;
+        bool isRetrogradeRotator;
+    };
+
+    FeatureLabelCatalogState(const QString& catalogPath) :
+        path(catalogPath),
+        loadRequested(false),
+        loadFinished(false)
+    {
+    }
+
+    QString path;
+    QHash<QString, BodyParameters> bodies;
+
+    QMutex mutex;
+    bool loadRequested;
+    bool loadFinished;
+    QHash<QString, FeatureLabelRecordList> features;
+};
+
+
+// Worker that parses a feature label catalog in a thread pool thread
+class FeatureLabelCatalogParser : public QRunnable
+{
+public:
+    FeatureLabelCatalogParser(QSharedPointer<FeatureLabelCatalogState> state) :
+        m_state(state)
+    {
+    }
+
+    void run()
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        QHash<QString, FeatureLabelRecordList> features;
+        unsigned int featureCount = 0;
+
+        QFile catalogFile(m_state->path);
+        if (!catalogFile.open(QIODevice::ReadOnly))
+        {
+            qWarning() << "Cannot open feature label catalog" << m_state->path;
+        }
+        else
+        {
+            // Comments are stripped exactly as in UniverseLoader::loadCatalogFile()
+            QString catalogText(catalogFile.readAll());
+            QRegExp stripComments("//[^\"]*[\n\r]");
+            stripComments.setMinimal(true);
+            QByteArray catalogBytes = catalogText.replace(stripComments, " ").toUtf8();
+            QBuffer buffer(&catalogBytes);
+
+            QJson::Parser parser;
+            bool parseOk = false;
+            QVariantList items = parser.parse(&buffer, &parseOk).toMap().value("items").toList();
+            if (!parseOk)
+            {
+                qWarning() << QString("Error in %1, line %2: %3").arg(m_state->path).arg(parser.errorLine()).arg(parser.errorString());
+            }
+
+            foreach (QVariant itemVar, items)
+            {
+                QVariantMap item = itemVar.toMap();
+                QString bodyName = item.value("body").toString();
+                if (m_state->bodies.contains(bodyName))
+                {
+                    FeatureLabelCatalogState::BodyParameters params = m_state->bodies.value(bodyName);
+                    FeatureLabelRecordList bodyFeatures;
+                    QString errorString;
+                    if (loadFeatureList(item.value("features").toList(), AlignedEllipsoid(params.semiAxes), params.isRetrogradeRotator, &bodyFeatures, &errorString))
+                    {
+                        featureCount += bodyFeatures.size();
+                        features[bodyName] = bodyFeatures;
+                    }
+                    else
+                    {
+                        qWarning() << QString("Item '%1': %2").arg(bodyName, errorString);
+                    }
+                }
+            }
+        }
+
+        qDebug() << "Loaded" << featureCount << "feature labels from" << m_state->path << "in" << timer.elapsed() << "ms";
+
+        QMutexLocker locker(&m_state->mutex);
+        m_state->features = features;
+        m_state->loadFinished = true;
+    }
+
+private:
+    QSharedPointer<FeatureLabelCatalogState> m_state;
+};
+
+
+// Supplies the features for one body's label set from a deferred feature label catalog
+class DeferredFeatureLabelLoader : public FeatureLabelSetGeometry::DeferredLoader
+{
+public:
+    DeferredFeatureLabelLoader(QSharedPointer<FeatureLabelCatalogState> state, const QString& bodyName) :
+        m_state(state),
+        m_bodyName(bodyName)
+    {
+    }
+
+    void requestLoad()
+    {
+        QMutexLocker locker(&m_state->mutex);
+        if (!m_state->loadRequested)
+        {
+            m_state->loadRequested = true;
+            QThreadPool::globalInstance()->start(new FeatureLabelCatalogParser(m_state));
+        }
+    }
+
+    bool addLoadedFeatures(FeatureLabelSetGeometry* labelSet)
+    {
+        QMutexLocker locker(&m_state->mutex);
+        if (!m_state->loadFinished)
+        {
+            return false;
+        }
+
+        FeatureLabelRecordList features = m_state->features.take(m_bodyName);
+        foreach (const FeatureLabelRecord& feature, features)
+        {
+            labelSet->addFeature(feature.name, feature.position, feature.radius, FeatureLabelColor);
+        }
+
+        return true;
+    }
+
+private:
+    QSharedPointer<FeatureLabelCatalogState> m_state;
+    QString m_bodyName;
+};
+
+
+Visualizer*
+UniverseLoader::loadFeatureLabels(const QVariantMap& map,
+                                  const Entity* body)
+{
+    QVariant featuresVar = map.value("features");
+
+    if (featuresVar.type() != QVariant::List)
+    {
+        errorMessage("Features list in FeatureLabels item is missing or invalid.");
+        return NULL;
+    }
+
+    if (!body->geometry() || !body->geometry()->isEllipsoidal())
+    {
+        return NULL;
+    }
+
+    AlignedEllipsoid ellipsoid = body->geometry()->ellipsoid();
+
+    FeatureLabelRecordList features;
+    QString errorString;
+    if (!loadFeatureList(featuresVar.toList(), ellipsoid, isRetrogradeRotator(body), &features, &errorString))
+    {
+        errorMessage(errorString);
+        return NULL;
+    }
+
+    counted_ptr<FeatureLabelSetGeometry> featureLabelSet(new FeatureLabelSetGeometry());
+    featureLabelSet->setOccluder(ellipsoid);
+
+    foreach (const FeatureLabelRecord& feature, features)
+    {
+        featureLabelSet->addFeature(feature.name, feature.position, feature.radius, FeatureLabelColor);
     }
 
     return new LocalVisualizer(featureLabelSet.ptr());
 }
 
 
+// Quickly check whether a catalog contains nothing but FeatureLabels items and, if so,
+// get the names of the labeled bodies. This avoids a full parse of the catalog, which
+// is slow for the large planetary feature catalogs.
+static bool
+scanFeatureLabelCatalog(const QString& catalogText, QStringList* bodyNames)
+{
+    if (catalogText.contains("\"require\""))
+    {
+        return false;
+    }
+
+    QRegExp typePattern("\"type\"\\s*:\\s*\"([^\"]*)\"");
+    int typeCount = 0;
+    for (int pos = typePattern.indexIn(catalogText); pos >= 0; pos = typePattern.indexIn(catalogText, pos + typePattern.matchedLength()))
+    {
+        if (typePattern.cap(1) != "FeatureLabels")
+        {
+            return false;
+        }
+        ++typeCount;
+    }
+
+    QRegExp bodyPattern("\"body\"\\s*:\\s*\"([^\"]*)\"");
+    for (int pos = bodyPattern.indexIn(catalogText); pos >= 0; pos = bodyPattern.indexIn(catalogText, pos + bodyPattern.matchedLength()))
+    {
+        *bodyNames << bodyPattern.cap(1);
+    }
+
+    // Give up unless there's exactly one body per item
+    return typeCount > 0 && bodyNames->size() == typeCount && bodyNames->toSet().size() == typeCount;
+}
+
+
+// Register the feature label sets in a catalog file without loading the features. The
+// file will be parsed in a background thread the first time that labels for any of its
+// bodies need to be drawn. Returns false if the file isn't a feature label catalog, in
+// which case it should be loaded normally.
+bool
+UniverseLoader::registerDeferredFeatureLabels(const QString& path,
+                                              const QString& catalogText,
+                                              UniverseCatalog* catalog)
+{
+    QStringList bodyNames;
+    if (!scanFeatureLabelCatalog(catalogText, &bodyNames))
+    {
+        return false;
+    }
+
+    // The body parameters are all recorded here, before any of the feature label sets can
+    // start the background load.
+    QSharedPointer<FeatureLabelCatalogState> state(new FeatureLabelCatalogState(path));
+
+    foreach (QString bodyName, bodyNames)
+    {
+        Entity* body = catalog->find(bodyName);
+        if (body == NULL)
+        {
+            errorMessage(QString("Can't find body '%1' for feature labels.").arg(bodyName));
+        }
+        else if (body->geometry() && body->geometry()->isEllipsoidal())
+        {
+            AlignedEllipsoid ellipsoid = body->geometry()->ellipsoid();
+
+            FeatureLabelCatalogState::BodyParameters params;
+            params.semiAxes = ellipsoid.semiAxes();
+            params.isRetrogradeRotator = isRetrogradeRotator(body);
+            state->bodies.insert(bodyName, params);
+
+            counted_ptr<FeatureLabelSetGeometry> featureLabelSet(new FeatureLabelSetGeometry());
+            featureLabelSet->setOccluder(ellipsoid);
+            featureLabelSet->setDeferredLoader(new DeferredFeatureLabelLoader(state, bodyName));
+            body->setVisualizer("surface features", new LocalVisualizer(featureLabelSet.ptr()));
+        }
+    }
+
+    return true;
+}
+
+
 Viewpoint*
 UniverseLoader::loadViewpoint(const QVariantMap& map,
                               UniverseCatalog* catalog)
@@ -4038,6 +4513,8 @@ CatalogContents*
 UniverseLoader::loadCatalogFile(const QString& fileName,
                                 UniverseCatalog* catalog)
 {
+    VESTA_PROFILE_SCOPE("UniverseLoader::loadCatalogFile");
+
     if (fileName.toLower().endsWith(".ssc"))
     {
         QStringList spiceKernels;
@@ -4174,6 +4651,14 @@ UniverseLoader::loadCatalogFile(const QString& fileName,
     // temporary solution, as the regex used here doesn't properly distinguish
     // and ignore comment characters in the middle of a string.
     QString catalogText(catalogFile.readAll());
+
+    // Planetary feature catalogs are large and their labels are only shown when the
+    // camera is close to a body; just register them now and load them on demand.
+    if (info.fileName().endsWith("-features.json") && registerDeferredFeatureLabels(path, catalogText, catalog))
+    {
+        return contents;
+    }
+
     QRegExp stripComments("//[^\"]*[\n\r]");
     stripComments.setMinimal(true);
     QByteArray catalogBytes = catalogText.replace(stripComments, " ").toUtf8();
@@ -4325,7 +4810,14 @@ UniverseLoader::loadCatalogItems(const QVariantMap& contentsMap,
                 bool newBody = false;
                 bool valid = true;
 
-                vesta::Body* body = dynamic_cast<Body*>(catalog->find(bodyName));
+                // Don't look up aliases here: a body defined with the same name as an
+                // alias replaces the alias rather than the body that it refers to.
+                vesta::Body* body = NULL;
+                if (catalog->contains(bodyName))
+                {
+                    body = dynamic_cast<Body*>(catalog->find(bodyName));
+                }
+
                 if (body == NULL)
                 {
                     newBody = true;
@@ -4426,6 +4918,21 @@ UniverseLoader::loadCatalogItems(const QVariantMap& contentsMap,
                     BodyInfo* info = loadBodyInfo(item);
                     catalog->setBodyInfo(bodyName, info);
 
+                    // Alternate names, e.g. a common name for a spacecraft catalogued
+                    // under its international designator
+                    QVariant aliasesVar = item.value("aliases");
+                    if (aliasesVar.type() == QVariant::List || aliasesVar.type() == QVariant::String)
+                    {
+                        foreach (QString alias, aliasesVar.toStringList())
+                        {
+                            catalog->addAlias(alias, bodyName);
+                        }
+                    }
+                    else if (aliasesVar.isValid())
+                    {
+                        errorMessage("aliases must be a string or a list of strings");
+                    }
+
                     // Set all information about a body to the default state
                     body->setLightSource(NULL);
                     body->setGeometry(NULL);
@@ -4523,6 +5030,9 @@ UniverseLoader::loadCatalogItems(const QVariantMap& contentsMap,
         }
     }
 
+    // Bodies that were already loaded may have been given new trajectories
+    TwoVectorFrame::InvalidateCachedStates();
+
     return contents;
 }
 
@@ -4531,6 +5041,7 @@ void
 UniverseLoader::loadSpiceKernels(const QStringList& kernelList)
 {
 #ifdef SPICE_ENABLED
+    VESTA_PROFILE_SCOPE("SPICE furnsh");
     foreach (QString kernel, kernelList)
     {
         furnsh_c(kernel.toLatin1().data());
@@ -4564,6 +5075,7 @@ void
 UniverseLoader::unloadSpiceKernels(const QStringList& kernelList)
 {
 #ifdef SPICE_ENABLED
+    VESTA_PROFILE_SCOPE("SPICE unload");
     for (int i = kernelList.length() - 1; i >= 0; --i)
     {
         QString kernel = kernelList.at(i);
@@ -4628,6 +5140,16 @@ UniverseLoader::setModelSearchPath(const QString& path)
 }
 
 
+/** Set the directory used to store preprocessed meshes. Mesh caching is
+  * disabled when the path is empty (the default.)
+  */
+void
+UniverseLoader::setMeshCacheDirectory(const QString& path)
+{
+    m_meshCacheDirectory = path;
+}
+
+
 QString
 UniverseLoader::dataFileName(const QString& fileName)
 {
@@ -4689,6 +5211,11 @@ UniverseLoader::processUpdates()
         }
     }
 
+    if (!m_tleUpdates.isEmpty())
+    {
+        TwoVectorFrame::InvalidateCachedStates();
+    }
+
     m_tleUpdates.clear();
 }
 
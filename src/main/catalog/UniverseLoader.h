@@ -37,6 +37,7 @@ namespace vesta
 {
     class PlanetaryRings;
     class InertialFrame;
+    class SensorFrustumGeometry;
 }
 
 class Viewpoint;
@@ -103,6 +104,16 @@ public:
     void setDataSearchPath(const QString& path);
     void setTextureSearchPath(const QString& path);
     void setModelSearchPath(const QString& path);
+    void setMeshCacheDirectory(const QString& path);
+
+    /** Enable storage of mesh vertices in compact quantized formats. This
+      * halves the memory used by vertex data, but requires GLSL shaders and
+      * hardware support for half precision vertex attributes. Off by default.
+      */
+    void setMeshQuantization(bool enable)
+    {
+        m_meshQuantization = enable;
+    }
 
     void updateTle(const QString& source, const QString& name, const QString& line1, const QString& line2);
 
@@ -138,6 +149,7 @@ private:
     vesta::Geometry* loadMeshGeometry(const QVariantMap& map);
     vesta::Geometry* loadSensorGeometry(const QVariantMap& map,
                                         const UniverseCatalog* catalog);
+    void loadSensorCoverage(const QVariantMap& map, vesta::SensorFrustumGeometry* sensor);
     vesta::Geometry* loadSwarmGeometry(const QVariantMap& map);
     vesta::Geometry* loadParticleSystemGeometry(const QVariantMap& map);
     vesta::Geometry* loadTimeSwitchedGeometry(const QVariantMap& map,
@@ -184,6 +196,9 @@ private:
 
     vesta::Visualizer* loadFeatureLabels(const QVariantMap& info,
                                          const vesta::Entity* body);
+    bool registerDeferredFeatureLabels(const QString& path,
+                                       const QString& catalogText,
+                                       UniverseCatalog* catalog);
 
     Viewpoint* loadViewpoint(const QVariantMap& info,
                              UniverseCatalog* catalog);
@@ -221,6 +236,7 @@ private:
     QString m_dataSearchPath;
     QString m_textureSearchPath;
     QString m_modelSearchPath;
+    QString m_meshCacheDirectory;
     QString m_currentBodyName;
 
     struct TleRecord
@@ -244,6 +260,7 @@ private:
     QString m_messageLog;
 
     bool m_texturesInModelDirectory;
+    bool m_meshQuantization;
 };
 
 #endif // _UNIVERSE_LOADER_H_
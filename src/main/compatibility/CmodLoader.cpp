@@ -17,6 +17,8 @@
 #include "CmodLoader.h"
 #include <QDataStream>
 #include <QVector>
+#include <QtEndian>
+#include <algorithm>
 
 using namespace vesta;
 
@@ -24,6 +26,7 @@ using namespace vesta;
 CmodLoader::CmodLoader(QIODevice *in, TextureMapLoader* textureLoader) :
     m_inputStream(NULL),
     m_hasError(false),
+    m_blockReads(true),
     m_textureLoader(textureLoader)
 {
     m_inputStream = new QDataStream(in);
@@ -274,46 +277,122 @@ CmodLoader::loadVertexArray(const VertexSpec& spec)
         return NULL;
     }
 
-    unsigned int vertexOffset = 0;
+    if (m_blockReads)
+    {
+        if (!readVertexBlock(spec, vertexCount, vertexData))
+        {
+            delete[] vertexData;
+            return NULL;
+        }
+    }
+    else
+    {
+        unsigned int vertexOffset = 0;
+        unsigned int vertexSize = spec.size();
+
+        for (unsigned int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex)
+        {
+            for (unsigned int attributeIndex = 0; attributeIndex < spec.attributeCount(); ++attributeIndex)
+            {
+                unsigned int offset = vertexOffset + spec.attributeOffset(attributeIndex);
+                switch (spec.attribute(attributeIndex).format())
+                {
+                case VertexAttribute::Float1:
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset));
+                    break;
+                case VertexAttribute::Float2:
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset));
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 4));
+                    break;
+                case VertexAttribute::Float3:
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset));
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 4));
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 8));
+                    break;
+                case VertexAttribute::Float4:
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset));
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 4));
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 8));
+                    *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 12));
+                    break;
+                case VertexAttribute::UByte4:
+                    m_inputStream->readRawData(vertexData + offset, 4);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            vertexOffset += vertexSize;
+        }
+    }
+
+    return new VertexArray(vertexData, vertexCount, spec);
+}
+
+
+// Read the data for vertexCount vertices with a single read. The in-memory
+// vertex layout produced by loadVertexSpec matches the file layout exactly:
+// attributes are packed in file order and every component is four bytes.
+// CMOD files are little endian, so floats only need to be converted on
+// big endian hosts.
+bool
+CmodLoader::readVertexBlock(const VertexSpec& spec, unsigned int vertexCount, char* vertexData)
+{
     unsigned int vertexSize = spec.size();
+    int dataSize = int(vertexCount * vertexSize);
+    if (m_inputStream->readRawData(vertexData, dataSize) != dataSize)
+    {
+        setError("Unexpected end of file in vertex data");
+        return false;
+    }
 
-    for (unsigned int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex)
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    for (unsigned int attributeIndex = 0; attributeIndex < spec.attributeCount(); ++attributeIndex)
     {
-        for (unsigned int attributeIndex = 0; attributeIndex < spec.attributeCount(); ++attributeIndex)
+        VertexAttribute::Format format = spec.attribute(attributeIndex).format();
+        if (format == VertexAttribute::UByte4)
+        {
+            // Byte data has no byte order
+            continue;
+        }
+
+        unsigned int componentCount = VertexAttribute::formatSize(format) / 4;
+        char* attribute = vertexData + spec.attributeOffset(attributeIndex);
+        for (unsigned int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, attribute += vertexSize)
         {
-            unsigned int offset = vertexOffset + spec.attributeOffset(attributeIndex);
-            switch (spec.attribute(attributeIndex).format())
+            quint32* words = reinterpret_cast<quint32*>(attribute);
+            for (unsigned int i = 0; i < componentCount; ++i)
             {
-            case VertexAttribute::Float1:
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset));
-                break;
-            case VertexAttribute::Float2:
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset));
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 4));
-                break;
-            case VertexAttribute::Float3:
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset));
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 4));
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 8));
-                break;
-            case VertexAttribute::Float4:
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset));
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 4));
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 8));
-                *m_inputStream >> *(reinterpret_cast<float*>(vertexData + offset + 12));
-                break;
-            case VertexAttribute::UByte4:
-                m_inputStream->readRawData(vertexData + offset, 4);
-                break;
-            default:
-                break;
+                words[i] = qFromLittleEndian(words[i]);
             }
         }
+    }
+#endif
+
+    return true;
+}
+
 
-        vertexOffset += vertexSize;
+// Read a block of 32-bit indices with a single read
+bool
+CmodLoader::readIndexBlock(unsigned int indexCount, v_uint32* indices)
+{
+    int dataSize = int(indexCount * sizeof(v_uint32));
+    if (m_inputStream->readRawData(reinterpret_cast<char*>(indices), dataSize) != dataSize)
+    {
+        setError("Unexpected end of file in index data");
+        return false;
     }
 
-    return new VertexArray(vertexData, vertexCount, spec);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    for (unsigned int i = 0; i < indexCount; ++i)
+    {
+        indices[i] = qFromLittleEndian(indices[i]);
+    }
+#endif
+
+    return true;
 }
 
 
@@ -458,7 +537,31 @@ CmodLoader::loadPrimitiveBatch(unsigned int primitiveTypeToken, unsigned int ver
         }
     }
 
-    if (!error())
+    if (!error() && m_blockReads)
+    {
+        if (!readIndexBlock(indexCount, indices))
+        {
+            delete[] indices;
+            indices = NULL;
+        }
+        else
+        {
+            // Validate all indices in one pass after the read
+            v_uint32 maxIndex = 0;
+            for (unsigned int i = 0; i < indexCount; ++i)
+            {
+                maxIndex = std::max(maxIndex, indices[i]);
+            }
+
+            if (maxIndex >= vertexCount)
+            {
+                setError(QString("Vertex index out of range (index %1, vertex count %2)").arg(maxIndex).arg(vertexCount));
+                delete[] indices;
+                indices = NULL;
+            }
+        }
+    }
+    else if (!error())
     {
         for (unsigned int i = 0; i < indexCount; ++i)
         {
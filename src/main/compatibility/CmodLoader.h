@@ -42,6 +42,22 @@ public:
 
     vesta::MeshGeometry* loadMesh();
 
+    /** Return true if vertex and index data are read a whole block at a
+      * time (the default) rather than one value at a time.
+      */
+    bool blockReadsEnabled() const
+    {
+        return m_blockReads;
+    }
+
+    /** Enable or disable block reads of vertex and index data. Block reads are
+      * much faster; the value-at-a-time path is kept for comparison.
+      */
+    void setBlockReadsEnabled(bool enable)
+    {
+        m_blockReads = enable;
+    }
+
 private:
     enum CmodToken
     {
@@ -96,11 +112,14 @@ private:
     vesta::VertexSpec* loadVertexSpec();
     vesta::PrimitiveBatch* loadPrimitiveBatch(unsigned int primitiveTypeToken, unsigned int vertexCount, unsigned int* materialIndex);
     vesta::VertexArray* loadVertexArray(const vesta::VertexSpec& spec);
+    bool readVertexBlock(const vesta::VertexSpec& spec, unsigned int vertexCount, char* vertexData);
+    bool readIndexBlock(unsigned int indexCount, vesta::v_uint32* indices);
 
 private:
     QDataStream* m_inputStream;
     QString m_errorMessage;
     bool m_hasError;
+    bool m_blockReads;
     vesta::counted_ptr<vesta::TextureMapLoader> m_textureLoader;
 };
 
@@ -0,0 +1,182 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ObjFileLoader.h"
+#include <vesta/internal/ObjLoader.h>
+#include <vesta/Profiler.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+
+using namespace vesta;
+using namespace std;
+
+
+// Worker task that parses one chunk of an OBJ file
+class ParseObjChunkTask : public QRunnable
+{
+public:
+    ParseObjChunkTask(const char* begin, const char* end, ObjLoader::ObjChunk* chunk) :
+        m_begin(begin),
+        m_end(end),
+        m_chunk(chunk)
+    {
+        setAutoDelete(true);
+    }
+
+    void run()
+    {
+        ObjLoader::parseChunk(m_begin, m_end, *m_chunk);
+    }
+
+private:
+    const char* m_begin;
+    const char* m_end;
+    ObjLoader::ObjChunk* m_chunk;
+};
+
+
+ObjFileLoader::ObjFileLoader(TextureMapLoader* textureLoader) :
+    m_textureLoader(textureLoader),
+    m_threadCount(0)
+{
+}
+
+
+ObjFileLoader::~ObjFileLoader()
+{
+}
+
+
+/** Load an OBJ mesh from a file. Returns null and sets the error message if
+  * the file couldn't be read or isn't a valid OBJ file.
+  */
+MeshGeometry*
+ObjFileLoader::loadMesh(const QString& fileName)
+{
+    VESTA_PROFILE_SCOPE("ObjFileLoader::loadMesh");
+
+    m_errorMessage = QString();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        m_errorMessage = QString("Error opening OBJ file '%1'").arg(fileName);
+        return NULL;
+    }
+
+    QString pathName = QFileInfo(fileName).absolutePath() + "/";
+    qint64 size = file.size();
+    if (size == 0)
+    {
+        return loadMesh("", 0, pathName);
+    }
+
+    // Map the file to avoid copying it; fall back to reading it if mapping
+    // isn't possible.
+    uchar* mapped = file.map(0, size);
+    if (mapped)
+    {
+        MeshGeometry* mesh = loadMesh(reinterpret_cast<const char*>(mapped), size, pathName);
+        file.unmap(mapped);
+        return mesh;
+    }
+    else
+    {
+        QByteArray data = file.readAll();
+        if (data.size() != size)
+        {
+            m_errorMessage = QString("Error reading OBJ file '%1'").arg(fileName);
+            return NULL;
+        }
+        return loadMesh(data.constData(), data.size(), pathName);
+    }
+}
+
+
+/** Load an OBJ mesh from a block of memory. The material library, if any, is
+  * loaded from the directory pathName (which must end with a separator.)
+  */
+MeshGeometry*
+ObjFileLoader::loadMesh(const char* data, qint64 size, const QString& pathName)
+{
+    m_errorMessage = QString();
+
+    unsigned int threadCount = m_threadCount;
+    if (threadCount == 0)
+    {
+        threadCount = (unsigned int) max(1, QThread::idealThreadCount());
+    }
+
+    // Use a few chunks per thread so that threads finishing early can pick up
+    // remaining work.
+    unsigned int chunkCount = (unsigned int) min(qint64(threadCount * 4), max(qint64(1), size / MinChunkSize));
+
+    vector<const char*> boundaries;
+    ObjLoader::splitChunks(data, size_t(size), chunkCount, boundaries);
+
+    vector<ObjLoader::ObjChunk*> chunks;
+    for (unsigned int i = 0; i + 1 < boundaries.size(); ++i)
+    {
+        chunks.push_back(new ObjLoader::ObjChunk());
+    }
+
+    {
+        VESTA_PROFILE_SCOPE("Parse OBJ chunks");
+        if (chunks.size() == 1 || threadCount == 1)
+        {
+            for (unsigned int i = 0; i < chunks.size(); ++i)
+            {
+                ObjLoader::parseChunk(boundaries[i], boundaries[i + 1], *chunks[i]);
+            }
+        }
+        else
+        {
+            QThreadPool workers;
+            workers.setMaxThreadCount(threadCount);
+            for (unsigned int i = 0; i < chunks.size(); ++i)
+            {
+                workers.start(new ParseObjChunkTask(boundaries[i], boundaries[i + 1], chunks[i]));
+            }
+            workers.waitForDone();
+        }
+    }
+
+    ObjLoader loader;
+    MeshGeometry* mesh = NULL;
+    {
+        VESTA_PROFILE_SCOPE("Merge OBJ chunks");
+        mesh = loader.loadChunks(chunks);
+    }
+
+    for (unsigned int i = 0; i < chunks.size(); ++i)
+    {
+        delete chunks[i];
+    }
+
+    if (!mesh)
+    {
+        m_errorMessage = QString::fromUtf8(loader.errorMessage().c_str());
+        return NULL;
+    }
+
+    loader.applyMaterialLibrary(mesh, m_textureLoader.ptr(), pathName.toUtf8().constData());
+
+    return mesh;
+}
@@ -0,0 +1,71 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _COMPATIBILITY_OBJ_FILE_LOADER_H_
+#define _COMPATIBILITY_OBJ_FILE_LOADER_H_
+
+#include <vesta/MeshGeometry.h>
+#include <vesta/TextureMapLoader.h>
+#include <QString>
+
+
+/** ObjFileLoader loads Wavefront OBJ meshes, splitting large files into
+  * chunks that are parsed on multiple threads. The file is memory mapped
+  * when possible. Parsing is handled by vesta's ObjLoader; materials are
+  * read from the file's material library, if it has one.
+  */
+class ObjFileLoader
+{
+public:
+    ObjFileLoader(vesta::TextureMapLoader* textureLoader);
+    ~ObjFileLoader();
+
+    bool error() const
+    {
+        return !m_errorMessage.isEmpty();
+    }
+
+    QString errorMessage() const
+    {
+        return m_errorMessage;
+    }
+
+    /** Get the maximum number of threads used for parsing. Zero (the
+      * default) means use one thread per core.
+      */
+    unsigned int threadCount() const
+    {
+        return m_threadCount;
+    }
+
+    void setThreadCount(unsigned int threadCount)
+    {
+        m_threadCount = threadCount;
+    }
+
+    vesta::MeshGeometry* loadMesh(const QString& fileName);
+    vesta::MeshGeometry* loadMesh(const char* data, qint64 size, const QString& pathName);
+
+    /** Files smaller than this are parsed on a single thread. */
+    static const qint64 MinChunkSize = 1024 * 1024;
+
+private:
+    vesta::counted_ptr<vesta::TextureMapLoader> m_textureLoader;
+    unsigned int m_threadCount;
+    QString m_errorMessage;
+};
+
+#endif // _COMPATIBILITY_OBJ_FILE_LOADER_H_
@@ -26,10 +26,12 @@ using namespace std;
 
 
 float FeatureLabelSetGeometry::ms_globalOpacity = 1.0f;
+float FeatureLabelSetGeometry::ms_placementPriority = -0.5f;
 
 
 FeatureLabelSetGeometry::FeatureLabelSetGeometry() :
     m_maxFeatureDistance(0.0f),
+    m_deferredLoader(NULL),
     m_occludingEllipsoid(Vector3d::Zero())
 {
 }
@@ -37,6 +39,7 @@ FeatureLabelSetGeometry::FeatureLabelSetGeometry() :
 
 FeatureLabelSetGeometry::~FeatureLabelSetGeometry()
 {
+    delete m_deferredLoader;
 }
 
 
@@ -44,6 +47,28 @@ FeatureLabelSetGeometry::~FeatureLabelSetGeometry()
   */
 void
 FeatureLabelSetGeometry::render(RenderContext& rc, double /* clock */) const
+{
+    // Render during the opaque pass if opaque or during the translucent pass if not.
+    if (rc.pass() == RenderContext::TranslucentPass)
+    {
+        processLabels(rc, DrawLabels);
+    }
+}
+
+
+/** \reimpl
+  */
+void
+FeatureLabelSetGeometry::submitLabels(RenderContext& rc, double /* clock */) const
+{
+    processLabels(rc, SubmitLabels);
+}
+
+
+// Submit the visible labels for placement or draw the ones that were placed. The
+// visibility tests are the same in both cases, so the same labels are visited.
+void
+FeatureLabelSetGeometry::processLabels(RenderContext& rc, LabelAction action) const
 {
     const float visibleSizeThreshold = 20.0f; // in pixels
 
@@ -54,58 +79,103 @@ FeatureLabelSetGeometry::render(RenderContext& rc, double /* clock */) const
         return;
     }
 
-    // Render during the opaque pass if opaque or during the translucent pass if not.
-    if (rc.pass() == RenderContext::TranslucentPass)
-    {
-        // Get the position of the camera in the body-fixed frame of the labeled object
-        Affine3f inv = Affine3f(rc.modelview().inverse(Affine)); // Assuming an affine modelview matrix
-        Vector3f cameraPosition = inv.translation();
-        float overallPixelSize = boundingSphereRadius() / (rc.pixelSize() * cameraPosition.norm());
+    // Get the position of the camera in the body-fixed frame of the labeled object
+    Affine3f inv = Affine3f(rc.modelview().inverse(Affine)); // Assuming an affine modelview matrix
+    Vector3f cameraPosition = inv.translation();
+    float overallPixelSize = boundingSphereRadius() / (rc.pixelSize() * cameraPosition.norm());
 
-        // Only draw individual labels if the overall projected size of the set exceeds the threshold
-        if (overallPixelSize > visibleSizeThreshold)
+    // Only draw individual labels if the overall projected size of the set exceeds the threshold
+    if (overallPixelSize > visibleSizeThreshold)
+    {
+        // Deferred label sets are loaded the first time that their labels are needed. Nothing
+        // is drawn until loading has finished.
+        if (m_deferredLoader)
         {
-            // Labels are treated as either completely visible or completely occluded. A label is
-            // visible when the labeled point isn't blocked by the occluding ellipsoid.
-            AlignedEllipsoid testEllipsoid(m_occludingEllipsoid.semiAxes() * 0.999);
-            Vector3f ellipsoidSemiAxes = testEllipsoid.semiAxes().cast<float>();
-
-            Vector3f viewDir = -cameraPosition.normalized();
-            double distanceToEllipsoid = 0.0;
+            m_deferredLoader->requestLoad();
+            if (!m_deferredLoader->addLoadedFeatures(const_cast<FeatureLabelSetGeometry*>(this)))
+            {
+                return;
+            }
 
-            // Instead of computing the ellipsoid intersection (as the line below), just treat the planet as a sphere
-            //TestRayEllipsoidIntersection(cameraPosition, viewDir, ellipsoidSemiAxes, &distanceToEllipsoid);
-            distanceToEllipsoid = (cameraPosition.norm() - ellipsoidSemiAxes.maxCoeff()) * 0.99f;
+            delete m_deferredLoader;
+            m_deferredLoader = NULL;
+        }
 
-            // We don't want labels partially hidden by the planet ellipsoid, so we'll project them onto a
-            // plane that lies just in front of the planet ellipsoid and which is parallel to the view plane
-            Hyperplane<float, 3> labelPlane(viewDir, cameraPosition + viewDir * float(distanceToEllipsoid));
+        // Labels are treated as either completely visible or completely occluded. A label is
+        // visible when the labeled point isn't blocked by the occluding ellipsoid.
+        AlignedEllipsoid testEllipsoid(m_occludingEllipsoid.semiAxes() * 0.999);
+        Vector3f ellipsoidSemiAxes = testEllipsoid.semiAxes().cast<float>();
+
+        Vector3f viewDir = -cameraPosition.normalized();
+        double distanceToEllipsoid = 0.0;
+
+        // Instead of computing the ellipsoid intersection (as the line below), just treat the planet as a sphere
+        //TestRayEllipsoidIntersection(cameraPosition, viewDir, ellipsoidSemiAxes, &distanceToEllipsoid);
+        distanceToEllipsoid = (cameraPosition.norm() - ellipsoidSemiAxes.maxCoeff()) * 0.99f;
+
+        // We don't want labels partially hidden by the planet ellipsoid, so we'll project them onto a
+        // plane that lies just in front of the planet ellipsoid and which is parallel to the view plane
+        Hyperplane<float, 3> labelPlane(viewDir, cameraPosition + viewDir * float(distanceToEllipsoid));
+
+        TextureFont* font = m_font.isValid() ? m_font.ptr() : rc.defaultFont();
+        float ascent = font ? font->maxAscent() : 0.0f;
+        float descent = font ? font->maxDescent() : 0.0f;
+
+        // Intersect the rays from the camera to all of the features with the occluding
+        // ellipsoid at once. The rays aren't normalized, so a feature is in front of the
+        // ellipsoid when the intersection distance is greater than one.
+        unsigned int featureCount = (unsigned int) m_features.size();
+        m_rayX.resize(featureCount);
+        m_rayY.resize(featureCount);
+        m_rayZ.resize(featureCount);
+        m_rayDistance.resize(featureCount);
+        for (unsigned int i = 0; i < featureCount; ++i)
+        {
+            Vector3f r = m_features[i].position - cameraPosition;
+            m_rayX[i] = r.x();
+            m_rayY[i] = r.y();
+            m_rayZ[i] = r.z();
+        }
 
-            for (vector<Feature, Eigen::aligned_allocator<Feature> >::const_iterator iter = m_features.begin(); iter != m_features.end(); ++iter)
-            {
-                Vector3f r = iter->position - cameraPosition;
+        if (featureCount > 0)
+        {
+            TestRayBatchEllipsoidIntersection(cameraPosition, &m_rayX[0], &m_rayY[0], &m_rayZ[0], featureCount,
+                                              ellipsoidSemiAxes, &m_rayDistance[0]);
+        }
 
-                Vector3f labelPosition = labelPlane.projection(iter->position);
-                float k = -(labelPlane.normal().dot(cameraPosition) + labelPlane.offset()) / (labelPlane.normal().dot(r));
-                labelPosition = cameraPosition + k * r;
+        for (vector<Feature, Eigen::aligned_allocator<Feature> >::const_iterator iter = m_features.begin(); iter != m_features.end(); ++iter)
+        {
+            unsigned int featureIndex = (unsigned int) (iter - m_features.begin());
+            Vector3f r = iter->position - cameraPosition;
 
-                rc.pushModelView();
-                rc.translateModelView(labelPosition);
-                float featureDistance = rc.modelview().translation().norm();
-                float pixelSize = iter->size / (rc.pixelSize() * featureDistance);
+            Vector3f labelPosition = labelPlane.projection(iter->position);
+            float k = -(labelPlane.normal().dot(cameraPosition) + labelPlane.offset()) / (labelPlane.normal().dot(r));
+            labelPosition = cameraPosition + k * r;
 
-                float d = r.norm();
-                r /= d;
-                double t = 0.0;
-                TestRayEllipsoidIntersection(cameraPosition, r, ellipsoidSemiAxes, &t);
+            rc.pushModelView();
+            rc.translateModelView(labelPosition);
+            float featureDistance = rc.modelview().translation().norm();
+            float pixelSize = iter->size / (rc.pixelSize() * featureDistance);
 
-                if (pixelSize > visibleSizeThreshold && d < t)
+            if (pixelSize > visibleSizeThreshold && m_rayDistance[featureIndex] > 1.0f)
+            {
+                if (action == SubmitLabels)
+                {
+                    // Larger features win out over smaller ones when labels overlap
+                    float priority = ms_placementPriority + 0.2f * pixelSize / (pixelSize + 1000.0f);
+                    const TextLayout* layout = rc.textLayout(iter->label, font, TextureFont::Utf8);
+                    float textWidth = layout ? layout->width : 0.0f;
+                    rc.submitLabel(this, featureIndex,
+                                   Vector2f(0.0f, -descent), Vector2f(textWidth, ascent),
+                                   priority);
+                }
+                else if (rc.isLabelPlaced(this, featureIndex))
                 {
                     rc.drawEncodedText(Vector3f::Zero(), iter->label, m_font.ptr(), TextureFont::Utf8, iter->color, ms_globalOpacity);
                 }
-
-                rc.popModelView();
             }
+
+            rc.popModelView();
         }
     }
 }
@@ -120,6 +190,28 @@ FeatureLabelSetGeometry::boundingSphereRadius() const
 }
 
 
+/** Set a loader that will supply the features for this label set when they're
+  * first needed. The label set takes ownership of the loader. The occluder
+  * must be set before calling this method: since features lie on the surface
+  * of the occluding ellipsoid, it is used to compute the bounding sphere of the
+  * label set before any features have been loaded.
+  */
+void
+FeatureLabelSetGeometry::setDeferredLoader(DeferredLoader* loader)
+{
+    if (loader != m_deferredLoader)
+    {
+        delete m_deferredLoader;
+        m_deferredLoader = loader;
+    }
+
+    if (m_deferredLoader)
+    {
+        m_maxFeatureDistance = max(m_maxFeatureDistance, float(m_occludingEllipsoid.semiAxes().maxCoeff()));
+    }
+}
+
+
 /** Add a new labeled feature
   *
   * \param a UTF-8 string containing the feature name
@@ -29,11 +29,34 @@
   */
 class FeatureLabelSetGeometry : public vesta::Geometry
 {
+public:
+    /** A DeferredLoader supplies the features for a label set that isn't
+      * loaded until its labels are first needed. Typically, the loader parses
+      * a catalog file in a background thread.
+      */
+    class DeferredLoader
+    {
+    public:
+        virtual ~DeferredLoader() {}
+
+        /** Start loading features if loading hasn't already been started. This
+          * is called from the render thread and must return quickly.
+          */
+        virtual void requestLoad() = 0;
+
+        /** Add the loaded features to the label set. Return false if loading
+          * hasn't finished yet. Once this method has returned true, the label
+          * set deletes the loader.
+          */
+        virtual bool addLoadedFeatures(FeatureLabelSetGeometry* labelSet) = 0;
+    };
+
 public:
     FeatureLabelSetGeometry();
     virtual ~FeatureLabelSetGeometry();
 
     void render(vesta::RenderContext& rc, double clock) const;
+    void submitLabels(vesta::RenderContext& rc, double clock) const;
     float boundingSphereRadius() const;
 
     virtual bool isOpaque() const
@@ -63,6 +86,15 @@ public:
         m_occludingEllipsoid = e;
     }
 
+    void setDeferredLoader(DeferredLoader* loader);
+
+    /** Return true if the features of this label set haven't been loaded yet.
+      */
+    bool isDeferred() const
+    {
+        return m_deferredLoader != NULL;
+    }
+
     /** Get the value of the global label opacity. This controls the visibility of
       * all feature label sets.
       */
@@ -81,6 +113,31 @@ public:
         ms_globalOpacity = opacity;
     }
 
+    /** Get the base priority of feature labels for decluttering.
+      */
+    static float placementPriority()
+    {
+        return ms_placementPriority;
+    }
+
+    /** Set the base priority of feature labels for decluttering. Within a
+      * feature label set, labels of features with a larger apparent size are
+      * given a slightly higher priority.
+      */
+    static void setPlacementPriority(float priority)
+    {
+        ms_placementPriority = priority;
+    }
+
+private:
+    enum LabelAction
+    {
+        SubmitLabels,
+        DrawLabels
+    };
+
+    void processLabels(vesta::RenderContext& rc, LabelAction action) const;
+
 private:
     struct Feature
     {
@@ -94,10 +151,21 @@ private:
     std::vector<Feature, Eigen::aligned_allocator<Feature> > m_features;
     float m_maxFeatureDistance;
 
+    // Only mutable because rendering is const; the loader is deleted as soon
+    // as the deferred features have been added.
+    mutable DeferredLoader* m_deferredLoader;
+
+    // Scratch arrays for the label occlusion test, mutable for the same reason
+    mutable std::vector<float> m_rayX;
+    mutable std::vector<float> m_rayY;
+    mutable std::vector<float> m_rayZ;
+    mutable std::vector<float> m_rayDistance;
+
     vesta::counted_ptr<vesta::TextureFont> m_font;
     vesta::AlignedEllipsoid m_occludingEllipsoid;
 
     static float ms_globalOpacity;
+    static float ms_placementPriority;
 };
 
 #endif // _FEATURE_LABEL_SET_GEOMETRY_H_
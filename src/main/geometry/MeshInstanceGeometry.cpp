@@ -45,7 +45,7 @@ MeshInstanceGeometry::render(RenderContext& rc,
     rc.scaleModelView(Vector3f::Constant(m_scale));
     rc.translateModelView(m_meshOffset);
     rc.rotateModelView(m_meshRotation);
-    m_mesh->render(rc, animationClock);
+    m_mesh->render(rc, animationClock, &m_levelsOfDetail);
     rc.popModelView();
 }
 
@@ -58,7 +58,7 @@ MeshInstanceGeometry::renderShadow(RenderContext& rc,
     rc.scaleModelView(Vector3f::Constant(m_scale));
     rc.translateModelView(m_meshOffset);
     rc.rotateModelView(m_meshRotation);
-    m_mesh->renderShadow(rc, animationClock);
+    m_mesh->renderShadow(rc, animationClock, &m_levelsOfDetail);
     rc.popModelView();
 }
 
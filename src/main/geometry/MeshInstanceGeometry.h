@@ -44,6 +44,19 @@ public:
         return m_mesh.isNull() || m_mesh->isOpaque();
     }
 
+    /** \reimp */
+    void renderStateKeys(unsigned int* shaderKey, unsigned int* textureKey) const
+    {
+        if (m_mesh.isValid())
+        {
+            m_mesh->renderStateKeys(shaderKey, textureKey);
+        }
+        else
+        {
+            Geometry::renderStateKeys(shaderKey, textureKey);
+        }
+    }
+
     /** Set the scale factor that will be applied to the mesh. The scale
       * factor is multiplied by the scale factor of the mesh geometry.
       */
@@ -110,6 +123,10 @@ private:
     float m_scale;
     Eigen::Vector3f m_meshOffset;
     Eigen::Quaternionf m_meshRotation;
+
+    // Levels of detail last drawn for this instance; the mesh may be shared
+    // with other instances that are drawn at different distances.
+    mutable vesta::MeshGeometry::LevelOfDetailState m_levelsOfDetail;
 };
 
 #endif // _MESH_INSTANCE_GEOMETRY_H_
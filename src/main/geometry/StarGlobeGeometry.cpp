@@ -134,14 +134,17 @@ static const char* SunVertexShaderSource =
 "uniform float time;              \n"
 "uniform mat4 noiseTransform1;    \n"
 "uniform mat4 noiseTransform2;    \n"
+"uniform float vesta_LogDepthScale;\n"
 "varying vec3 position1;          \n"
 "varying vec3 position2;          \n"
+"varying float logDepthZ;         \n"
 "\n"
 "void main()                      \n"
 "{                                \n"
 "    position1 = (noiseTransform1 * gl_Vertex).xyz;    \n"
 "    position2 = (noiseTransform2 * gl_Vertex).xyz;    \n"
 "    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;                  \n"
+"    logDepthZ = 1.0 + max(gl_Position.w, 0.0) * vesta_LogDepthScale;         \n"
 "}                                                                            \n"
 ;
 
@@ -150,10 +153,16 @@ static const char* SunFragmentShaderSource =
 "varying vec3 position2;                         \n"
 "uniform vec3 color1;                            \n"
 "uniform vec3 color2;                            \n"
+"uniform float vesta_LogDepthFactor;             \n"
+"varying float logDepthZ;                        \n"
 "void main()                                     \n"
 "{                                               \n"
         "    float a = snoise(position1 * 3.5) * 0.17 + abs(snoise(position1 * 20.0)) + abs(snoise(position2 * 43.0) * 0.5) + pow(snoise(position2 * 89.2), 2.0) * 0.25;\n"
 "    gl_FragColor = vec4(mix(color1, color2, a), 1.0);                             \n"
+"    if (vesta_LogDepthFactor > 0.0)                                               \n"
+"        gl_FragDepth = log2(logDepthZ) * vesta_LogDepthFactor;                    \n"
+"    else                                                                          \n"
+"        gl_FragDepth = gl_FragCoord.z;                                            \n"
 "}                                               \n"
 ;
 
@@ -51,9 +51,9 @@ UniverseCatalogObject::getMatchingNames(const QString& pattern) const
 QString
 UniverseCatalogObject::getCompletionString(const QString& partialName, int maxNames) const
 {
-    QStringList matches = m_catalog->matchingNames(partialName + ".*");
+    QStringList matches = m_catalog->completeName(partialName, maxNames);
     QString completionList;
-    for (int i = 0; i < std::min(maxNames, matches.length()); ++i)
+    for (int i = 0; i < matches.length(); ++i)
     {
         if (i != 0)
         {
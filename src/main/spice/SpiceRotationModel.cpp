@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "SpiceRotationModel.h"
+#include <vesta/Profiler.h>
 #include <SpiceUsr.h>
 
 using namespace vesta;
@@ -37,6 +38,8 @@ SpiceRotationModel::~SpiceRotationModel()
 Quaterniond
 SpiceRotationModel::orientation(double tdbSec) const
 {
+    VESTA_PROFILE_SCOPE("SPICE pxform");
+
     double et = tdbSec;
     SpiceDouble transform[3][3];
 
@@ -63,6 +66,8 @@ SpiceRotationModel::orientation(double tdbSec) const
 Vector3d
 SpiceRotationModel::angularVelocity(double tdbSec) const
 {
+    VESTA_PROFILE_SCOPE("SPICE sxform");
+
     double et = tdbSec;
     SpiceDouble transform[6][6];
 
@@ -0,0 +1,213 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2011 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TilePackTiledMap.h"
+#include <QFileInfo>
+#include <QtEndian>
+#include <QDebug>
+#include <sstream>
+#include <cstring>
+
+using namespace vesta;
+using namespace std;
+
+
+static const unsigned int TilePackVersion = 1;
+static const qint64 HeaderSize = 32;
+static const qint64 IndexEntrySize = 24;
+static const char* TileResourcePrefix = "tilepack:";
+
+
+static inline quint32 readUInt32(const uchar* p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+
+
+static inline quint64 readUInt64(const uchar* p)
+{
+    return qFromLittleEndian<quint64>(p);
+}
+
+
+/** Open a tile pack and map it into memory. If the file can't be opened or
+  * doesn't contain a valid tile pack, isValid() will return false and the
+  * tiled map will report that no tiles exist.
+  */
+TilePackTiledMap::TilePackTiledMap(TextureMapLoader* loader, const QString& packFileName) :
+    HierarchicalTiledMap(loader, 0),
+    m_packFile(QFileInfo(packFileName).absoluteFilePath()),
+    m_index(NULL),
+    m_packTileSize(0),
+    m_tileSize(0),
+    m_levelCount(0),
+    m_tileCount(0)
+{
+    m_packFileName = string(m_packFile.fileName().toUtf8().data());
+
+    if (!m_packFile.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Unable to open tile pack" << packFileName;
+        return;
+    }
+
+    qint64 fileSize = m_packFile.size();
+    const uchar* data = m_packFile.map(0, fileSize);
+    if (!data || fileSize < HeaderSize || memcmp(data, "CTPK", 4) != 0)
+    {
+        qDebug() << packFileName << "is not a tile pack";
+        return;
+    }
+
+    if (readUInt32(data + 4) != TilePackVersion)
+    {
+        qDebug() << "Unsupported tile pack version in" << packFileName;
+        return;
+    }
+
+    m_packTileSize = readUInt32(data + 8);
+    m_levelCount = readUInt32(data + 12);
+    m_tileCount = readUInt32(data + 16);
+    m_tileFormat = QString::fromLatin1(reinterpret_cast<const char*>(data + 24), 8);
+    // The format name is NUL padded unless it uses all eight bytes
+    int formatLength = m_tileFormat.indexOf(QChar('\0'));
+    if (formatLength >= 0)
+    {
+        m_tileFormat.truncate(formatLength);
+    }
+    m_tileSize = m_packTileSize;
+
+    if (HeaderSize + qint64(m_tileCount) * IndexEntrySize > fileSize)
+    {
+        qDebug() << "Tile pack index is truncated in" << packFileName;
+        return;
+    }
+
+    m_index = data + HeaderSize;
+}
+
+
+TilePackTiledMap::~TilePackTiledMap()
+{
+}
+
+
+/** Look up the tile in the pack index. The returned string identifies the byte
+  * range of the encoded tile so that the image loader doesn't need to consult
+  * the index. An empty string is returned when the tile isn't in the pack.
+  */
+string
+TilePackTiledMap::tileResourceIdentifier(unsigned int level, unsigned int column, unsigned int row)
+{
+    if (!m_index)
+    {
+        return "";
+    }
+
+    // Binary search of the index, which is sorted by level, column, and row
+    unsigned int low = 0;
+    unsigned int high = m_tileCount;
+    while (low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        const uchar* entry = m_index + mid * IndexEntrySize;
+        quint32 entryLevel = readUInt32(entry);
+        quint32 entryColumn = readUInt32(entry + 4);
+        quint32 entryRow = readUInt32(entry + 8);
+
+        if (entryLevel < level ||
+            (entryLevel == level && (entryColumn < column || (entryColumn == column && entryRow < row))))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (low < m_tileCount)
+    {
+        const uchar* entry = m_index + low * IndexEntrySize;
+        if (readUInt32(entry) == level && readUInt32(entry + 4) == column && readUInt32(entry + 8) == row)
+        {
+            ostringstream str;
+            str << TileResourcePrefix << readUInt64(entry + 16) << ":" << readUInt32(entry + 12) << ":" << m_packFileName;
+            return str.str();
+        }
+    }
+
+    return "";
+}
+
+
+bool
+TilePackTiledMap::isValidTileAddress(unsigned int level, unsigned int column, unsigned int row)
+{
+    return level < m_levelCount && column < (1u << (level + 1)) && row < (1u << level);
+}
+
+
+bool
+TilePackTiledMap::tileResourceExists(const std::string& resourceId)
+{
+    return !resourceId.empty();
+}
+
+
+/** Return true if the resource name refers to a tile stored in a tile pack.
+  */
+bool
+TilePackTiledMap::isTileResourceName(const QString& resourceName)
+{
+    return resourceName.startsWith(TileResourcePrefix);
+}
+
+
+/** Extract the pack file name and the byte range of the encoded tile from a
+  * resource name produced by tileResourceIdentifier().
+  *
+  * \return true if the resource name was valid
+  */
+bool
+TilePackTiledMap::parseTileResourceName(const QString& resourceName, QString* packFileName, qint64* offset, qint64* length)
+{
+    if (!isTileResourceName(resourceName))
+    {
+        return false;
+    }
+
+    int offsetStart = QString(TileResourcePrefix).length();
+    int lengthStart = resourceName.indexOf(':', offsetStart) + 1;
+    if (lengthStart == 0)
+    {
+        return false;
+    }
+
+    int nameStart = resourceName.indexOf(':', lengthStart) + 1;
+    if (nameStart == 0)
+    {
+        return false;
+    }
+
+    bool offsetOk = false;
+    bool lengthOk = false;
+    *offset = resourceName.mid(offsetStart, lengthStart - offsetStart - 1).toLongLong(&offsetOk);
+    *length = resourceName.mid(lengthStart, nameStart - lengthStart - 1).toLongLong(&lengthOk);
+    *packFileName = resourceName.mid(nameStart);
+
+    return offsetOk && lengthOk && !packFileName->isEmpty();
+}
@@ -0,0 +1,126 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2011 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _VEXT_TILE_PACK_TILED_MAP_H_
+#define _VEXT_TILE_PACK_TILED_MAP_H_
+
+#include <vesta/HierarchicalTiledMap.h>
+#include <QFile>
+#include <QString>
+#include <string>
+
+
+/** TilePackTiledMap loads texture tiles from a tile pack: a single file containing
+  * all of the encoded tiles of a tiled map, preceded by an index sorted by tile
+  * address. The file is memory mapped, and existence checks are answered from
+  * the index without touching the file system.
+  *
+  * Tile pack layout (all values little endian):
+  *   header (32 bytes):
+  *      char[4]  magic "CTPK"
+  *      uint32   version (1)
+  *      uint32   tile size in pixels
+  *      uint32   level count
+  *      uint32   tile count
+  *      uint32   reserved
+  *      char[8]  tile image format, e.g. "png", "jpg", or "dds"; zero padded
+  *   index (24 bytes per tile, sorted by level, then column, then row):
+  *      uint32   level
+  *      uint32   column
+  *      uint32   row (row 0 is southernmost)
+  *      uint32   length in bytes of the encoded tile
+  *      uint64   offset of the encoded tile from the start of the file
+  *   encoded tile data
+  *
+  * Tile packs are created from a directory of tiles with the maketilepack.py
+  * script in tools/tilepack.
+  */
+class TilePackTiledMap : public vesta::HierarchicalTiledMap
+{
+public:
+    TilePackTiledMap(vesta::TextureMapLoader* loader, const QString& packFileName);
+    ~TilePackTiledMap();
+
+    virtual std::string tileResourceIdentifier(unsigned int level, unsigned int column, unsigned int row);
+    virtual bool isValidTileAddress(unsigned int level, unsigned int column, unsigned int row);
+    virtual bool tileResourceExists(const std::string& resourceId);
+
+    /** Get the tile size used when choosing the level of detail. Initially this is the
+      * tile size recorded in the pack header.
+      */
+    virtual unsigned int tileSize() const
+    {
+        return m_tileSize;
+    }
+
+    /** Set the tile size used when choosing the level of detail. Reporting a tile size
+      * smaller than the actual one causes higher resolution tiles to be loaded sooner.
+      */
+    void setTileSize(unsigned int tileSize)
+    {
+        m_tileSize = tileSize;
+    }
+
+    /** Return true if the tile pack was opened and its index is valid.
+      */
+    bool isValid() const
+    {
+        return m_index != NULL;
+    }
+
+    /** Get the tile size recorded in the tile pack header.
+      */
+    unsigned int packTileSize() const
+    {
+        return m_packTileSize;
+    }
+
+    /** Get the number of levels recorded in the tile pack header.
+      */
+    unsigned int levelCount() const
+    {
+        return m_levelCount;
+    }
+
+    /** Get the number of tiles in the pack.
+      */
+    unsigned int tileCount() const
+    {
+        return m_tileCount;
+    }
+
+    /** Get the image format of the tiles in the pack, e.g. "png" or "dds".
+      */
+    QString tileFormat() const
+    {
+        return m_tileFormat;
+    }
+
+    static bool isTileResourceName(const QString& resourceName);
+    static bool parseTileResourceName(const QString& resourceName, QString* packFileName, qint64* offset, qint64* length);
+
+private:
+    QFile m_packFile;
+    const uchar* m_index;
+    unsigned int m_packTileSize;
+    unsigned int m_tileSize;
+    unsigned int m_levelCount;
+    unsigned int m_tileCount;
+    QString m_tileFormat;
+    std::string m_packFileName;
+};
+
+#endif // _VEXT_TILE_PACK_TILED_MAP_H_
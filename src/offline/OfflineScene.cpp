@@ -0,0 +1,298 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "OfflineScene.h"
+#include "../main/NetworkTextureLoader.h"
+#include "../main/RotationUtility.h"
+#include "../main/DateUtility.h"
+#include "../main/catalog/UniverseCatalog.h"
+#include "../main/catalog/UniverseLoader.h"
+#include <vesta/LabelVisualizer.h>
+#include <vesta/LabelGeometry.h>
+#include <vesta/LightSource.h>
+#include <vesta/Units.h>
+#include <qjson/parser.h>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+CameraPath::CameraPath() :
+    startTime(0.0),
+    endTime(daysToSeconds(1.0)),
+    frameCount(300),
+    timeStep(0.0),
+    warmupFrames(30),
+    width(1280),
+    height(720),
+    fieldOfView(50.0)
+{
+}
+
+
+/** Get the simulation time (TDB seconds) of a frame.
+  */
+double
+CameraPath::frameTime(int frame) const
+{
+    if (timeStep > 0.0)
+    {
+        // Multiply rather than accumulate so that the time of a frame doesn't
+        // depend on which frames were rendered before it.
+        return startTime + frame * timeStep;
+    }
+    else
+    {
+        return startTime + (endTime - startTime) * frameFraction(frame);
+    }
+}
+
+
+/** Get the fraction of the way through the camera path (in [0, 1]) of a frame.
+  */
+double
+CameraPath::frameFraction(int frame) const
+{
+    if (timeStep > 0.0)
+    {
+        return endTime > startTime ? min(1.0, (frameTime(frame) - startTime) / (endTime - startTime)) : 0.0;
+    }
+    else
+    {
+        return frameCount > 1 ? double(frame) / double(frameCount - 1) : 0.0;
+    }
+}
+
+
+static double
+parseDate(const QVariant& v, double defaultValue)
+{
+    QDateTime d = QDateTime::fromString(v.toString(), Qt::ISODate);
+    if (!d.isValid())
+    {
+        return defaultValue;
+    }
+
+    d.setTimeSpec(Qt::UTC);
+    return QtDateToVestaDate(d).toTDBSec();
+}
+
+
+/** Load a camera path from a JSON file. Values missing from the file
+  * are left unchanged.
+  */
+bool
+LoadCameraPath(const QString& fileName, CameraPath* path)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Could not open camera path " << fileName;
+        return false;
+    }
+
+    QJson::Parser parser;
+    bool parseOk = false;
+    QVariantMap contents = parser.parse(&file, &parseOk).toMap();
+    if (!parseOk)
+    {
+        qWarning() << "Error parsing camera path: " << parser.errorString() << " (line: " << parser.errorLine() << ")";
+        return false;
+    }
+
+    path->startTime = parseDate(contents.value("startTime"), path->startTime);
+    path->endTime = parseDate(contents.value("endTime"), path->startTime);
+    path->frameCount = contents.value("frameCount", path->frameCount).toInt();
+    path->timeStep = contents.value("timeStep", path->timeStep).toDouble();
+    path->warmupFrames = contents.value("warmupFrames", path->warmupFrames).toInt();
+    path->width = contents.value("width", path->width).toInt();
+    path->height = contents.value("height", path->height).toInt();
+    path->fieldOfView = contents.value("fieldOfView", path->fieldOfView).toDouble();
+
+    if (path->timeStep > 0.0)
+    {
+        // Small tolerance so that an end time that's an exact multiple of
+        // the step isn't lost to roundoff.
+        path->frameCount = int(floor((path->endTime - path->startTime) / path->timeStep + 1.0e-6)) + 1;
+    }
+
+    path->keyframes.clear();
+    foreach (QVariant v, contents.value("keyframes").toList())
+    {
+        QVariantMap map = v.toMap();
+        CameraKeyframe key;
+        key.center = map.value("center").toString();
+        key.distance = map.value("distance", 10000.0).toDouble();
+        key.longitude = map.value("longitude", 0.0).toDouble();
+        key.latitude = map.value("latitude", 0.0).toDouble();
+        path->keyframes << key;
+    }
+
+    if (path->frameCount < 1 || path->width < 1 || path->height < 1 || path->keyframes.isEmpty())
+    {
+        qWarning() << "Camera path must have at least one frame and one keyframe.";
+        return false;
+    }
+
+    return true;
+}
+
+
+static Vector3d
+keyframePosition(Universe* universe, const CameraKeyframe& key, double t, double distance)
+{
+    Vector3d centerPosition = Vector3d::Zero();
+    const Entity* center = universe->findFirst(key.center.toUtf8().data());
+    if (center)
+    {
+        centerPosition = center->position(t);
+    }
+
+    double lon = toRadians(key.longitude);
+    double lat = toRadians(key.latitude);
+    return centerPosition + distance * Vector3d(cos(lat) * cos(lon), cos(lat) * sin(lon), sin(lat));
+}
+
+
+/** Compute the camera position and orientation for a frame of the path.
+  */
+void
+CameraPathState(Universe* universe, const CameraPath& path, int frame,
+                Vector3d* position, Quaterniond* orientation)
+{
+    double t = path.frameTime(frame);
+    double s = path.frameFraction(frame);
+
+    int lastKey = path.keyframes.size() - 1;
+    double u = s * lastKey;
+    int k0 = min(int(floor(u)), lastKey);
+    int k1 = min(k0 + 1, lastKey);
+    double f = u - k0;
+
+    const CameraKeyframe& key0 = path.keyframes[k0];
+    const CameraKeyframe& key1 = path.keyframes[k1];
+
+    CameraKeyframe key;
+    key.longitude = key0.longitude + (key1.longitude - key0.longitude) * f;
+    key.latitude = key0.latitude + (key1.latitude - key0.latitude) * f;
+    double distance = exp(log(key0.distance) + (log(key1.distance) - log(key0.distance)) * f);
+
+    // Blend the positions relative to the two center objects so that the camera
+    // moves smoothly between them.
+    key.center = key0.center;
+    Vector3d p0 = keyframePosition(universe, key, t, distance);
+    key.center = key1.center;
+    Vector3d p1 = keyframePosition(universe, key, t, distance);
+    *position = p0 + (p1 - p0) * f;
+
+    Vector3d target0 = keyframePosition(universe, key0, t, 0.0);
+    Vector3d target1 = keyframePosition(universe, key1, t, 0.0);
+    *orientation = LookRotation(*position, target0 + (target1 - target0) * f, Vector3d::UnitZ());
+}
+
+
+static void
+addEntity(Universe* universe, Entity* entity, const BodyInfo* info, TextureFont* font)
+{
+    Entity* existingBody = universe->findFirst(entity->name());
+    if (existingBody)
+    {
+        universe->removeEntity(existingBody);
+    }
+
+    universe->addEntity(entity);
+
+    // Give every visible object a label, as the interactive program does
+    if (font && entity->isVisible() && !entity->name().empty() && entity->name()[0] != '_')
+    {
+        QString labelText = QString::fromUtf8(entity->name().c_str());
+        labelText = labelText.right(labelText.length() - labelText.lastIndexOf('/') - 1);
+
+        Spectrum color = info ? info->labelColor : Spectrum::White();
+        LabelVisualizer* label = new LabelVisualizer(labelText.toUtf8().data(), font, color, 6.0f);
+        if (info && info->classification == BodyInfo::Planet)
+        {
+            label->label()->setPlacementPriority(1.0f);
+        }
+        label->setDepthAdjustment(Visualizer::AdjustToFront);
+        entity->setVisualizer("label", label);
+    }
+
+    if (entity->name() == "Sun")
+    {
+        LightSource* sunlight = new LightSource();
+        sunlight->setLightType(LightSource::Sun);
+        sunlight->setShadowCaster(true);
+        sunlight->setSpectrum(Spectrum::White());
+        entity->setLightSource(sunlight);
+    }
+}
+
+
+/** Load a catalog file and add all of its bodies to the universe. If
+  * labelFont is not null, every visible body is given a label.
+  */
+bool
+LoadSceneCatalog(const QString& fileName, UniverseLoader* loader, UniverseCatalog* catalog, Universe* universe, TextureFont* labelFont)
+{
+    QFileInfo info(fileName);
+    if (!info.exists())
+    {
+        qWarning() << "Catalog file " << fileName << " not found.";
+        return false;
+    }
+
+    loader->setDataSearchPath(info.absolutePath());
+    loader->setModelSearchPath(info.absolutePath());
+
+    NetworkTextureLoader* textureLoader = dynamic_cast<NetworkTextureLoader*>(loader->textureLoader());
+    if (textureLoader)
+    {
+        textureLoader->setLocalSearchPath(info.absolutePath());
+    }
+
+    loader->clearMessageLog();
+    CatalogContents* contents = loader->loadCatalogFile(info.absoluteFilePath(), catalog);
+    QString errorMessages = loader->messageLog();
+    if (!errorMessages.isEmpty())
+    {
+        qWarning() << errorMessages;
+    }
+
+    foreach (QString name, contents->bodyNames())
+    {
+        Entity* e = catalog->find(name);
+        if (e)
+        {
+            addEntity(universe, e, catalog->findInfo(name), labelFont);
+        }
+    }
+    delete contents;
+
+    if (textureLoader)
+    {
+        textureLoader->setLocalSearchPath(".");
+    }
+
+    return true;
+}
@@ -0,0 +1,95 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OFFLINE_SCENE_H_
+#define _OFFLINE_SCENE_H_
+
+#include <vesta/Universe.h>
+#include <vesta/TextureFont.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <QList>
+#include <QString>
+
+class UniverseLoader;
+class UniverseCatalog;
+
+
+// Scene setup shared by the headless tools (renderbench and rendersequence):
+// loading a scripted camera path and populating a universe from catalog files
+// without a UniverseView.
+
+struct CameraKeyframe
+{
+    QString center;
+    double distance;
+    double longitude;
+    double latitude;
+};
+
+
+/** A camera path is a JSON file of the form:
+  *
+  * {
+  *     "startTime": "2012-01-01T00:00:00",
+  *     "endTime": "2012-01-02T00:00:00",
+  *     "frameCount": 600,
+  *     "timeStep": 60,
+  *     "warmupFrames": 30,
+  *     "width": 1280,
+  *     "height": 720,
+  *     "fieldOfView": 50,
+  *     "keyframes": [
+  *         { "center": "Earth", "distance": 20000, "longitude": 0, "latitude": 20 },
+  *         { "center": "Saturn", "distance": 500000, "longitude": 90, "latitude": 10 }
+  *     ]
+  * }
+  *
+  * Keyframes are evenly spaced over the path. Distance is interpolated
+  * logarithmically and the camera always looks at the center object with
+  * the z-axis up. If timeStep (in seconds) is given, it overrides frameCount:
+  * frames are placed exactly timeStep apart starting at startTime.
+  */
+struct CameraPath
+{
+    CameraPath();
+
+    double startTime;
+    double endTime;
+    int frameCount;
+    double timeStep;
+    int warmupFrames;
+    int width;
+    int height;
+    double fieldOfView;
+    QList<CameraKeyframe> keyframes;
+
+    double frameTime(int frame) const;
+    double frameFraction(int frame) const;
+};
+
+bool LoadCameraPath(const QString& fileName, CameraPath* path);
+
+void CameraPathState(vesta::Universe* universe, const CameraPath& path, int frame,
+                     Eigen::Vector3d* position, Eigen::Quaterniond* orientation);
+
+bool LoadSceneCatalog(const QString& fileName,
+                      UniverseLoader* loader,
+                      UniverseCatalog* catalog,
+                      vesta::Universe* universe,
+                      vesta::TextureFont* labelFont);
+
+#endif // _OFFLINE_SCENE_H_
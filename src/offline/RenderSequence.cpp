@@ -0,0 +1,592 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// rendersequence: render a camera path to a numbered sequence of image files
+// without a window. Every frame is drawn at a fixed simulation time, so the
+// output doesn't depend on how long rendering takes, and frames may be split
+// between several processes (e.g. on a render farm) with -first and -last.
+//
+// usage: rendersequence [-data <dir>] -path <camera path> [-o <output pattern>]
+//                       [-size <width>x<height>] [-first <frame>] [-last <frame>]
+//                       [-threads <count>] [-timeout <seconds>] [-labels]
+//                       [-alpha] [-logdepth] [catalog files...]
+//
+// The camera path format is described in OfflineScene.h. The output pattern
+// is a printf-style file name containing the frame number, e.g. the default
+// of frame%05d.png; it must contain exactly one integer conversion. The image
+// format is chosen from the file extension; any format supported by a Qt image
+// plugin may be used (EXR output requires an EXR image format plugin.) The
+// image size may be larger than the maximum OpenGL framebuffer size, in which
+// case frames are drawn in tiles.
+//
+// Before a frame is saved, it is redrawn until every texture that it uses
+// is resident, or until the timeout expires.
+
+#include "OfflineScene.h"
+#include "../main/NetworkTextureLoader.h"
+#include "../main/catalog/UniverseCatalog.h"
+#include "../main/catalog/UniverseLoader.h"
+#include "../main/catalog/BuiltinModels.h"
+#include <vesta/OGLHeaders.h>
+#include <vesta/Universe.h>
+#include <vesta/UniverseRenderer.h>
+#include <vesta/LabelPlacement.h>
+#include <vesta/LightingEnvironment.h>
+#include <vesta/PlanarProjection.h>
+#include <vesta/TextureFont.h>
+#include <vesta/DataChunk.h>
+#include <vesta/Units.h>
+#include <vesta/Stopwatch.h>
+#include <QApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QAtomicInt>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Largest tile drawn in a single pass. The actual tile size is also limited
+// by the OpenGL implementation.
+static const int MaxTileSize = 4096;
+
+
+static void
+printUsage()
+{
+    QTextStream err(stderr);
+    err << "usage: rendersequence [-data <dir>] -path <camera path> [-o <output pattern>] [-size <width>x<height>]\n"
+        << "                      [-first <frame>] [-last <frame>] [-threads <count>] [-timeout <seconds>]\n"
+        << "                      [-labels] [-alpha] [-logdepth] [catalog files...]\n";
+}
+
+
+// Task that writes one frame to disk on a thread from the encoder pool. The
+// semaphore bounds the number of finished frames held in memory: a slot is
+// acquired before a frame is rendered and released once it has been written.
+class WriteFrameTask : public QRunnable
+{
+public:
+    WriteFrameTask(const QImage& image, const QString& fileName, const QByteArray& format, bool keepAlpha,
+                   QSemaphore* frameSlots, QAtomicInt* errorCount) :
+        m_image(image),
+        m_fileName(fileName),
+        m_format(format),
+        m_keepAlpha(keepAlpha),
+        m_slots(frameSlots),
+        m_errorCount(errorCount)
+    {
+    }
+
+    void run()
+    {
+        QImage image = m_keepAlpha ? m_image : m_image.convertToFormat(QImage::Format_RGB32);
+
+        QImageWriter writer(m_fileName, m_format);
+        if (!writer.write(image))
+        {
+            qWarning() << "Error writing " << m_fileName << ": " << writer.errorString();
+            m_errorCount->ref();
+        }
+
+        m_image = QImage();
+        m_slots->release();
+    }
+
+private:
+    QImage m_image;
+    QString m_fileName;
+    QByteArray m_format;
+    bool m_keepAlpha;
+    QSemaphore* m_slots;
+    QAtomicInt* m_errorCount;
+};
+
+
+// Return true if the output file name pattern contains exactly one integer
+// conversion (such as %05d) for the frame number. The pattern is passed to
+// snprintf, so any other conversion would read an argument that isn't there.
+static bool
+isValidOutputPattern(const QString& pattern)
+{
+    unsigned int conversionCount = 0;
+    int length = pattern.length();
+    for (int i = 0; i < length; ++i)
+    {
+        if (pattern[i] != QChar('%'))
+        {
+            continue;
+        }
+
+        ++i;
+        if (i < length && pattern[i] == QChar('%'))
+        {
+            continue;
+        }
+
+        // Flags, field width, and precision
+        while (i < length && QString("-+ 0#").contains(pattern[i]))
+        {
+            ++i;
+        }
+        while (i < length && pattern[i].isDigit())
+        {
+            ++i;
+        }
+        if (i < length && pattern[i] == QChar('.'))
+        {
+            ++i;
+            while (i < length && pattern[i].isDigit())
+            {
+                ++i;
+            }
+        }
+
+        if (i < length && (pattern[i] == QChar('d') || pattern[i] == QChar('i')))
+        {
+            ++conversionCount;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return conversionCount == 1;
+}
+
+
+// Deliver textures loaded by worker threads. Returns the number of textures
+// that are still loading.
+static unsigned int
+updateTextures(QApplication& app, NetworkTextureLoader* textureLoader)
+{
+    app.processEvents();
+
+    textureLoader->incrementFrameCount();
+    textureLoader->evictTextures();
+    textureLoader->realizeLoadedTextures();
+
+    return textureLoader->loadingTextureCount() + textureLoader->pendingUploadCount();
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Don't require a window system
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+
+    QString dataPath = "data";
+    QString pathFileName;
+    QString outputPattern = "frame%05d.png";
+    QSize imageSize;
+    int firstFrame = 0;
+    int lastFrame = -1;
+    int threadCount = 0;
+    double textureTimeout = 30.0;
+    bool showLabels = false;
+    bool keepAlpha = false;
+    bool logDepth = false;
+    QStringList catalogFiles;
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        bool hasValue = i + 1 < args.size();
+        if (args[i] == "-data" && hasValue)
+        {
+            dataPath = args[++i];
+        }
+        else if (args[i] == "-path" && hasValue)
+        {
+            pathFileName = QFileInfo(args[++i]).absoluteFilePath();
+        }
+        else if (args[i] == "-o" && hasValue)
+        {
+            outputPattern = QFileInfo(args[++i]).absoluteFilePath();
+        }
+        else if (args[i] == "-size" && hasValue)
+        {
+            QStringList dims = args[++i].split('x');
+            if (dims.size() == 2)
+            {
+                imageSize = QSize(dims[0].toInt(), dims[1].toInt());
+            }
+        }
+        else if (args[i] == "-first" && hasValue)
+        {
+            firstFrame = args[++i].toInt();
+        }
+        else if (args[i] == "-last" && hasValue)
+        {
+            lastFrame = args[++i].toInt();
+        }
+        else if (args[i] == "-threads" && hasValue)
+        {
+            threadCount = args[++i].toInt();
+        }
+        else if (args[i] == "-timeout" && hasValue)
+        {
+            textureTimeout = args[++i].toDouble();
+        }
+        else if (args[i] == "-labels")
+        {
+            showLabels = true;
+        }
+        else if (args[i] == "-alpha")
+        {
+            keepAlpha = true;
+        }
+        else if (args[i] == "-logdepth")
+        {
+            logDepth = true;
+        }
+        else if (args[i].startsWith("-"))
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            catalogFiles << QFileInfo(args[i]).absoluteFilePath();
+        }
+    }
+
+    if (pathFileName.isEmpty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (!isValidOutputPattern(outputPattern))
+    {
+        qCritical() << "Output pattern " << outputPattern << " must contain exactly one integer conversion for the frame number (e.g. %05d)";
+        return 1;
+    }
+
+    // Relative output paths were resolved against the starting directory
+    // above, since the current directory changes to the data directory.
+    QByteArray imageFormat = QFileInfo(outputPattern).suffix().toLower().toLatin1();
+    if (!QImageWriter::supportedImageFormats().contains(imageFormat))
+    {
+        qCritical() << "Image format " << imageFormat << " is not supported.";
+        return 1;
+    }
+
+    CameraPath path;
+    if (!LoadCameraPath(pathFileName, &path))
+    {
+        return 1;
+    }
+
+    if (imageSize.isValid() && !imageSize.isEmpty())
+    {
+        path.width = imageSize.width();
+        path.height = imageSize.height();
+    }
+
+    if (lastFrame < 0 || lastFrame >= path.frameCount)
+    {
+        lastFrame = path.frameCount - 1;
+    }
+    firstFrame = max(0, firstFrame);
+
+    if (!QDir::setCurrent(dataPath))
+    {
+        qWarning() << "Data directory " << dataPath << " not found.";
+        return 1;
+    }
+
+    if (catalogFiles.isEmpty())
+    {
+        catalogFiles << QFileInfo("solarsys.json").absoluteFilePath();
+    }
+
+    // Set up an offscreen OpenGL context. The renderer still relies on fixed
+    // function state, so request a compatibility profile.
+    QSurfaceFormat format;
+    format.setDepthBufferSize(24);
+    format.setProfile(QSurfaceFormat::CompatibilityProfile);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    if (!context.create() || !context.makeCurrent(&surface))
+    {
+        qCritical("Couldn't create an OpenGL context.");
+        return 1;
+    }
+
+    UniverseRenderer* renderer = new UniverseRenderer();
+    renderer->setDefaultSunEnabled(false);
+    if (!renderer->initializeGraphics())
+    {
+        qCritical("Creating renderer failed because OpenGL couldn't be initialized.");
+        return 1;
+    }
+
+    if (logDepth)
+    {
+        if (!renderer->logarithmicDepthSupported())
+        {
+            qWarning("Logarithmic depth isn't supported; using depth spans.");
+        }
+        renderer->setDepthStrategy(UniverseRenderer::LogarithmicDepth);
+    }
+
+    // Images larger than the largest framebuffer are drawn in tiles
+    GLint maxRenderbufferSize = 0;
+    GLint maxViewportDims[2] = { 0, 0 };
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbufferSize);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims);
+    int maxTileWidth = min(MaxTileSize, min(int(maxRenderbufferSize), int(maxViewportDims[0])));
+    int maxTileHeight = min(MaxTileSize, min(int(maxRenderbufferSize), int(maxViewportDims[1])));
+    int tileColumns = (path.width + maxTileWidth - 1) / maxTileWidth;
+    int tileRows = (path.height + maxTileHeight - 1) / maxTileHeight;
+    int tileWidth = (path.width + tileColumns - 1) / tileColumns;
+    int tileHeight = (path.height + tileRows - 1) / tileRows;
+
+    QOpenGLFramebufferObject fbo(tileWidth, tileHeight, QOpenGLFramebufferObject::CombinedDepthStencil);
+    if (!fbo.isValid())
+    {
+        qCritical("Couldn't create an offscreen framebuffer.");
+        return 1;
+    }
+    fbo.bind();
+
+    counted_ptr<TextureFont> labelFont(new TextureFont());
+    QFile labelFontFile("csans-14.txf");
+    if (labelFontFile.open(QIODevice::ReadOnly))
+    {
+        QByteArray data = labelFontFile.readAll();
+        DataChunk chunk(data.data(), data.size());
+        labelFont->loadTxf(&chunk);
+        renderer->setDefaultFont(labelFont.ptr());
+    }
+
+    // Load catalogs
+    NetworkTextureLoader* textureLoader = new NetworkTextureLoader(NULL, true);
+    UniverseCatalog* catalog = new UniverseCatalog();
+    UniverseLoader* loader = new UniverseLoader();
+    loader->setTextureLoader(textureLoader);
+    loader->setMeshCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/meshes");
+    AddBuiltinModels(loader);
+
+    counted_ptr<Universe> universe(new Universe());
+    foreach (QString fileName, catalogFiles)
+    {
+        LoadSceneCatalog(fileName, loader, catalog, universe.ptr(), showLabels ? labelFont.ptr() : NULL);
+    }
+
+    // The full view frustum at the near plane; each tile draws a piece of it
+    PlanarProjection fullProjection = PlanarProjection::CreatePerspective(float(toRadians(path.fieldOfView)),
+                                                                          float(path.width) / float(path.height),
+                                                                          UniverseRenderer::MinimumNearDistance,
+                                                                          UniverseRenderer::MaximumFarDistance);
+    LightingEnvironment lighting;
+
+    // Encoder pool. Frames are written in parallel; at most two frames per
+    // thread are queued before rendering waits for the writers.
+    QThreadPool encoderPool;
+    if (threadCount > 0)
+    {
+        encoderPool.setMaxThreadCount(threadCount);
+    }
+    QSemaphore frameSlots(encoderPool.maxThreadCount() * 2);
+    QAtomicInt writeErrors(0);
+
+    QTextStream err(stderr);
+    err << "Rendering frames " << firstFrame << " to " << lastFrame << " at " << path.width << "x" << path.height;
+    if (tileColumns * tileRows > 1)
+    {
+        err << " in " << tileColumns << "x" << tileRows << " tiles";
+    }
+    err << "\n";
+    err.flush();
+
+    Stopwatch sequenceTimer;
+    unsigned int incompleteFrames = 0;
+
+    for (int frame = firstFrame; frame <= lastFrame; ++frame)
+    {
+        double t = path.frameTime(frame);
+        Vector3d cameraPosition;
+        Quaterniond cameraOrientation;
+        CameraPathState(universe.ptr(), path, frame, &cameraPosition, &cameraOrientation);
+
+        frameSlots.acquire();
+        QImage image(path.width, path.height, QImage::Format_ARGB32);
+
+        unsigned int drawCount = 0;
+        bool complete = true;
+
+        // A label near the edge of a tile may overlap one in the next tile,
+        // so labels are placed for the whole frame at once. When labels are
+        // shown, each tile is first drawn once just to collect its labels.
+        // The placement starts out empty for every frame so that a frame
+        // looks the same no matter which frames were rendered before it.
+        counted_ptr<LabelPlacement> labelPlacement;
+        if (showLabels)
+        {
+            labelPlacement = new LabelPlacement();
+        }
+        renderer->setLabelPlacement(labelPlacement.ptr());
+
+        for (int pass = showLabels ? 0 : 1; pass < 2; ++pass)
+        {
+            bool imagePass = pass == 1;
+            if (labelPlacement.isValid())
+            {
+                labelPlacement->beginTiledView(path.width, path.height);
+            }
+
+            for (int row = 0; row < tileRows; ++row)
+            {
+                for (int column = 0; column < tileColumns; ++column)
+                {
+                    // Tile rectangle in OpenGL coordinates (origin at lower left)
+                    int x0 = column * tileWidth;
+                    int y0 = row * tileHeight;
+                    int width = min(tileWidth, path.width - x0);
+                    int height = min(tileHeight, path.height - y0);
+
+                    float frustumWidth = fullProjection.right() - fullProjection.left();
+                    float frustumHeight = fullProjection.top() - fullProjection.bottom();
+                    PlanarProjection projection(PlanarProjection::Perspective,
+                                                fullProjection.left() + frustumWidth * x0 / path.width,
+                                                fullProjection.left() + frustumWidth * (x0 + width) / path.width,
+                                                fullProjection.bottom() + frustumHeight * y0 / path.height,
+                                                fullProjection.bottom() + frustumHeight * (y0 + height) / path.height,
+                                                fullProjection.nearDistance(),
+                                                fullProjection.farDistance());
+                    Viewport viewport(width, height);
+
+                    if (labelPlacement.isValid())
+                    {
+                        labelPlacement->setTileOrigin(x0, y0);
+                    }
+
+                    // Redraw the tile until drawing it doesn't request any textures
+                    // that aren't already resident.
+                    Stopwatch waitTimer;
+                    for (;;)
+                    {
+                        unsigned int loadingBefore = updateTextures(app, textureLoader);
+
+                        glDepthMask(GL_TRUE);
+                        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+                        renderer->beginViewSet(universe.ptr(), t);
+                        renderer->renderView(&lighting, cameraPosition, cameraOrientation, projection, viewport);
+                        renderer->endViewSet();
+                        ++drawCount;
+
+                        if (!imagePass || (loadingBefore == 0 && textureLoader->loadingTextureCount() == 0))
+                        {
+                            break;
+                        }
+
+                        if (waitTimer.elapsed() > textureTimeout)
+                        {
+                            complete = false;
+                            break;
+                        }
+
+                        // Give the loader threads a chance to run
+                        QThread::msleep(5);
+                    }
+
+                    if (!imagePass)
+                    {
+                        continue;
+                    }
+
+                    // Copy the tile into the frame, flipping it so that the first
+                    // row is at the top.
+                    vector<unsigned char> pixels(width * height * 4);
+                    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+                    glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, &pixels[0]);
+                    for (int y = 0; y < height; ++y)
+                    {
+                        unsigned char* destRow = image.scanLine(path.height - (y0 + y) - 1) + x0 * 4;
+                        memcpy(destRow, &pixels[y * width * 4], width * 4);
+                    }
+                }
+            }
+
+            if (labelPlacement.isValid())
+            {
+                labelPlacement->endTiledView();
+            }
+        }
+
+        if (!complete)
+        {
+            qWarning() << "Frame " << frame << ": timed out waiting for textures.";
+            ++incompleteFrames;
+        }
+
+        char fileName[1024];
+        snprintf(fileName, sizeof(fileName), outputPattern.toUtf8().constData(), frame);
+        encoderPool.start(new WriteFrameTask(image, QString::fromUtf8(fileName), imageFormat, keepAlpha, &frameSlots, &writeErrors));
+
+        err << "Frame " << frame << " (" << drawCount << " passes)\n";
+        err.flush();
+    }
+
+    encoderPool.waitForDone();
+
+    double elapsed = sequenceTimer.elapsed();
+    int renderedFrames = lastFrame - firstFrame + 1;
+    err << "Rendered " << renderedFrames << " frames in " << elapsed << " s ("
+        << (elapsed > 0.0 ? renderedFrames / elapsed : 0.0) << " frames/s)\n";
+
+    textureLoader->stop();
+    fbo.release();
+
+    if (incompleteFrames > 0)
+    {
+        err << incompleteFrames << " frames were saved before all textures were loaded.\n";
+    }
+
+    return writeErrors.load() > 0 ? 1 : 0;
+}
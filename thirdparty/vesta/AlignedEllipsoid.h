@@ -70,7 +70,7 @@ public:
       * When c lies on the ellipsoid, the latitude is the angle between the ellipsoid
       * normal at c and the xy-plane.
       */
-    Eigen::Vector3d planetographicToRectangular(const PlanetographicCoord3& c)
+    Eigen::Vector3d planetographicToRectangular(const PlanetographicCoord3& c) const
     {
         // Compute the planetographic normal
         double cosLat = std::cos(c.latitude());
@@ -79,7 +79,7 @@ Entity::state(double t) const
         Matrix3d m = arc->trajectoryFrame()->orientation(t).toRotationMatrix();
         Vector3d omega = arc->trajectoryFrame()->angularVelocity(t);
         Vector3d position = m * state.position();
-        Vector3d velocity = m * state.velocity() + omega.cross(state.position());
+        Vector3d velocity = m * state.velocity() + omega.cross(position);
 
         return centerState + StateVector(position, velocity);
     }
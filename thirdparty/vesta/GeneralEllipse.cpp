@@ -31,7 +31,7 @@ GeneralEllipse::principalSemiAxes() const
     double s10 = s01;
     S << s00, s01, s10, s11;
 
-    SelfAdjointEigenSolver<Matrix2d> solver(S, true);
+    SelfAdjointEigenSolver<Matrix2d> solver(S, ComputeEigenvectors);
     Vector2d e = solver.eigenvalues();
     Matrix2d ev = solver.eigenvectors();
 
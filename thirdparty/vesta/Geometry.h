@@ -98,6 +98,22 @@ public:
         render(rc, clock);
     }
 
+    /** Submit the screen rectangles of any labels drawn by this geometry to
+      * the label placement service. When labels are being decluttered, the
+      * renderer calls submitLabels for every visible item, with the same
+      * modelview transformation that render() will see, and resolves the
+      * placement before anything is drawn. render() should then draw only
+      * the labels for which RenderContext::isLabelPlaced() returns true. The
+      * default implementation does nothing.
+      *
+      * @param rc a valid render context
+      * @param clock is a time in seconds which can be used for time-driven animations
+      */
+    virtual void submitLabels(RenderContext& /* rc */,
+                              double /* clock */) const
+    {
+    }
+
 
     /** Get the radius of an origin-centered sphere large enough to contain
       * the geometry. Subclasses must implement this method.
@@ -110,6 +126,22 @@ public:
       */
     virtual bool isOpaque() const { return true; }
 
+    /** Get keys describing the render state used to draw this geometry. The
+      * renderer groups opaque geometry with the same shader key, and within
+      * that the same texture key, in order to reduce state changes. A key of
+      * zero means that the state is unknown; the default implementation
+      * returns zero for both keys.
+      *
+      * \param shaderKey receives a key for the shader and material setup,
+      *        usually Material::shaderStateKey() of the main material
+      * \param textureKey receives the id of the base texture
+      */
+    virtual void renderStateKeys(unsigned int* shaderKey, unsigned int* textureKey) const
+    {
+        *shaderKey = 0;
+        *textureKey = 0;
+    }
+
     /** Returns true if this geometry can be well approximated by an
       * ellipsoid. This affects shadow rendering: light occlusion is computed
       * analytically for ellipsoidal objects instead of by rendering the
@@ -10,6 +10,7 @@
 
 #include "HierarchicalTiledMap.h"
 #include "TextureMapLoader.h"
+#include <algorithm>
 
 using namespace vesta;
 using namespace std;
@@ -19,6 +20,11 @@ using namespace std;
   */
 HierarchicalTiledMap::HierarchicalTiledMap(TextureMapLoader* loader, unsigned int tileSize) :
     m_loader(loader),
+    m_cachedTileCount(0),
+    m_missingTileCount(0),
+    m_maxCachedTiles(4096),
+    m_maxMissingTiles(4096),
+    m_missingTileLifetime(3600),
     m_tileSize(tileSize),
     m_tileBorderFraction(0.0f)
 {
@@ -61,14 +67,35 @@ HierarchicalTiledMap::tile(unsigned int level, unsigned int x, unsigned int y)
         v_uint64 tileId = computeTileId((unsigned int) testLevel, testX, testY);
 
         TextureMap* tileTexture = NULL;
+        bool cached = false;
 
         TileCache::iterator iter = m_tiles.find(tileId);
         if (iter != m_tiles.end())
         {
-            // An entry for the tile exists in the hash
-            tileTexture = iter->second.ptr();
+            // An entry for the tile exists in the cache
+            TileList::iterator entry = iter->second;
+            if (entry->texture.isValid())
+            {
+                // Move the tile to the front of the list
+                m_tileList.splice(m_tileList.begin(), m_tileList, entry);
+                tileTexture = entry->texture.ptr();
+                cached = true;
+            }
+            else if (m_loader->frameCount() - entry->created <= v_int64(m_missingTileLifetime))
+            {
+                // The tile is known not to exist
+                cached = true;
+            }
+            else
+            {
+                // The missing tile entry has expired; check again whether the tile exists
+                m_missingTileList.erase(entry);
+                m_tiles.erase(iter);
+                --m_missingTileCount;
+            }
         }
-        else
+
+        if (!cached)
         {
             if (isValidTileAddress((unsigned int) testLevel, testX, testY))
             {
@@ -81,13 +108,13 @@ HierarchicalTiledMap::tile(unsigned int level, unsigned int x, unsigned int y)
                     props.usage = textureUsage();
 
                     tileTexture = m_loader->loadTexture(resourceId, props);
-                    m_tiles[tileId] = counted_ptr<TextureMap>(tileTexture);
+                    addTile(tileId, tileTexture);
                 }
                 else
                 {
-                    // Insert a null in the table so that we don't attempt to load the
-                    // tile again.
-                    m_tiles[tileId] = counted_ptr<TextureMap>();
+                    // Remember that the tile is missing so that we don't attempt to load
+                    // it again for a while.
+                    addMissingTile(tileId);
                 }
             }
         }
@@ -120,3 +147,87 @@ HierarchicalTiledMap::tile(unsigned int level, unsigned int x, unsigned int y)
     return r;
 }
 
+
+
+/** Set the maximum number of tiles held in the tile cache. When the cache is
+  * full, the least recently used tiles are dropped. The textures of dropped
+  * tiles are released by the loader if they aren't resident. The default
+  * limit is 4096 tiles.
+  */
+void
+HierarchicalTiledMap::setMaxCachedTiles(unsigned int tileCount)
+{
+    m_maxCachedTiles = max(1u, tileCount);
+    trimTileCache();
+}
+
+
+/** Set the maximum number of missing tiles that will be remembered. When the
+  * limit is reached, the oldest missing tile entries are forgotten. The default
+  * limit is 4096 tiles.
+  */
+void
+HierarchicalTiledMap::setMaxMissingTiles(unsigned int tileCount)
+{
+    m_maxMissingTiles = max(1u, tileCount);
+    trimTileCache();
+}
+
+
+void
+HierarchicalTiledMap::addTile(v_uint64 tileId, TextureMap* texture)
+{
+    TileCacheEntry entry;
+    entry.tileId = tileId;
+    entry.texture = texture;
+    entry.created = m_loader->frameCount();
+
+    m_tileList.push_front(entry);
+    m_tiles[tileId] = m_tileList.begin();
+    ++m_cachedTileCount;
+
+    trimTileCache();
+}
+
+
+void
+HierarchicalTiledMap::addMissingTile(v_uint64 tileId)
+{
+    TileCacheEntry entry;
+    entry.tileId = tileId;
+    entry.created = m_loader->frameCount();
+
+    m_missingTileList.push_front(entry);
+    m_tiles[tileId] = m_missingTileList.begin();
+    ++m_missingTileCount;
+
+    trimTileCache();
+}
+
+
+// Drop least recently used tiles and the oldest missing tile entries until
+// the cache is within its limits.
+void
+HierarchicalTiledMap::trimTileCache()
+{
+    while (m_cachedTileCount > m_maxCachedTiles)
+    {
+        TileCacheEntry& entry = m_tileList.back();
+        TextureMap* texture = entry.texture.ptr();
+
+        m_tiles.erase(entry.tileId);
+        m_tileList.pop_back();
+        --m_cachedTileCount;
+
+        // The loader may still be holding the texture; let it know that the
+        // texture is no longer needed by the tiled map.
+        m_loader->releaseTexture(texture);
+    }
+
+    while (m_missingTileCount > m_maxMissingTiles)
+    {
+        m_tiles.erase(m_missingTileList.back().tileId);
+        m_missingTileList.pop_back();
+        --m_missingTileCount;
+    }
+}
@@ -15,6 +15,7 @@
 #include "IntegerTypes.h"
 #include <string>
 #include <map>
+#include <list>
 
 
 namespace vesta
@@ -87,12 +88,87 @@ public:
         m_tileBorderFraction = fraction;
     }
 
+    /** Get the number of tiles currently held in the tile cache.
+      */
+    unsigned int cachedTileCount() const
+    {
+        return m_cachedTileCount;
+    }
+
+    /** Get the maximum number of tiles held in the tile cache.
+      */
+    unsigned int maxCachedTiles() const
+    {
+        return m_maxCachedTiles;
+    }
+
+    void setMaxCachedTiles(unsigned int tileCount);
+
+    /** Get the number of tiles currently known not to exist.
+      */
+    unsigned int missingTileCount() const
+    {
+        return m_missingTileCount;
+    }
+
+    /** Get the maximum number of missing tiles that will be remembered.
+      */
+    unsigned int maxMissingTiles() const
+    {
+        return m_maxMissingTiles;
+    }
+
+    void setMaxMissingTiles(unsigned int tileCount);
+
+    /** Get the number of frames for which a tile is remembered as missing before
+      * its existence is checked again.
+      */
+    unsigned int missingTileLifetime() const
+    {
+        return m_missingTileLifetime;
+    }
+
+    /** Set the number of frames for which a tile is remembered as missing before
+      * its existence is checked again.
+      */
+    void setMissingTileLifetime(unsigned int frames)
+    {
+        m_missingTileLifetime = frames;
+    }
+
+private:
+    struct TileCacheEntry
+    {
+        v_uint64 tileId;
+
+        // Texture is null for tiles that don't exist
+        counted_ptr<TextureMap> texture;
+
+        // Frame in which a missing tile entry was created
+        v_int64 created;
+    };
+
+    typedef std::list<TileCacheEntry> TileList;
+    typedef std::map<v_uint64, TileList::iterator> TileCache;
+
+    void addTile(v_uint64 tileId, TextureMap* texture);
+    void addMissingTile(v_uint64 tileId);
+    void trimTileCache();
+
 private:
     TextureMapLoader* m_loader;
 
-    // TODO: a hash table would be a better fit here
-    typedef std::map<v_uint64, counted_ptr<TextureMap> > TileCache;
+    // Tiles are kept in a list ordered from most to least recently used; tiles
+    // known not to exist are kept in a separate list ordered by creation time.
     TileCache m_tiles;
+    TileList m_tileList;
+    TileList m_missingTileList;
+    unsigned int m_cachedTileCount;
+    unsigned int m_missingTileCount;
+    unsigned int m_maxCachedTiles;
+    unsigned int m_maxMissingTiles;
+    unsigned int m_missingTileLifetime;
+
     unsigned int m_tileSize;
     float m_tileBorderFraction;
 };
@@ -12,6 +12,8 @@
 #define _VESTA_INTERSECT_H_
 
 #include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
 
 
 namespace vesta
@@ -133,5 +135,199 @@ bool TestRayEllipsoidIntersection(const Eigen::MatrixBase<DERIVED1>& rayOrigin,
     }
 }
 
+
+/** Intersect a batch of rays sharing a common origin with an axis-aligned,
+  * origin-centered ellipsoid. Ray directions are given in structure-of-arrays
+  * form and need not be normalized; the distances are measured in units of
+  * the direction length. For each ray, the distance to the nearest intersection
+  * in front of the origin is stored in distances[i], or -1 if the ray misses.
+  * The results are the same as calling TestRayEllipsoidIntersection for each
+  * ray.
+  *
+  * Rays are processed in fixed-size packets with Eigen array expressions, which
+  * Eigen maps onto SSE, AVX or NEON instructions depending on the instruction
+  * sets enabled at compile time; with default x86-64 compiler flags, only SSE2
+  * is available, and AVX2 must be enabled explicitly (e.g. with -mavx2 -mfma.)
+  * Results are stored a whole packet at a time when all of its rays hit or all
+  * of them miss, and selected one ray at a time otherwise.
+  *
+  * \return the number of rays that hit the ellipsoid
+  */
+template<typename SCALAR> unsigned int
+TestRayBatchEllipsoidIntersection(const Eigen::Matrix<SCALAR, 3, 1>& rayOrigin,
+                                  const SCALAR directionX[],
+                                  const SCALAR directionY[],
+                                  const SCALAR directionZ[],
+                                  unsigned int rayCount,
+                                  const Eigen::Matrix<SCALAR, 3, 1>& semiAxes,
+                                  SCALAR distances[])
+{
+    enum { PacketSize = 8 };
+    typedef Eigen::Array<SCALAR, PacketSize, 1> Packet;
+    typedef Eigen::Array<SCALAR, Eigen::Dynamic, 1> ArrayType;
+
+    const SCALAR ax = SCALAR(1) / (semiAxes.x() * semiAxes.x());
+    const SCALAR ay = SCALAR(1) / (semiAxes.y() * semiAxes.y());
+    const SCALAR az = SCALAR(1) / (semiAxes.z() * semiAxes.z());
+    const SCALAR bx = rayOrigin.x() * ax;
+    const SCALAR by = rayOrigin.y() * ay;
+    const SCALAR bz = rayOrigin.z() * az;
+    const SCALAR c = rayOrigin.x() * bx + rayOrigin.y() * by + rayOrigin.z() * bz - SCALAR(1);
+
+    // The origin is the same for every ray. When it lies outside the ellipsoid,
+    // both roots have the same sign and the near root is the intersection. When
+    // the origin is inside, only the far root can be in front of the origin.
+    const bool outside = c > SCALAR(0);
+    const SCALAR rootSign = outside ? SCALAR(-1) : SCALAR(1);
+
+    unsigned int hitCount = 0;
+    for (unsigned int i = 0; i < rayCount; i += PacketSize)
+    {
+        unsigned int count = std::min(rayCount - i, (unsigned int) PacketSize);
+
+        Packet dx;
+        Packet dy;
+        Packet dz;
+        if (count == PacketSize)
+        {
+            dx = Eigen::Map<const Packet>(directionX + i);
+            dy = Eigen::Map<const Packet>(directionY + i);
+            dz = Eigen::Map<const Packet>(directionZ + i);
+        }
+        else
+        {
+            // Pad a partial packet with a valid direction so that there's no division by zero
+            dx.setOnes();
+            dy.setZero();
+            dz.setZero();
+            dx.head(count) = Eigen::Map<const ArrayType>(directionX + i, count);
+            dy.head(count) = Eigen::Map<const ArrayType>(directionY + i, count);
+            dz.head(count) = Eigen::Map<const ArrayType>(directionZ + i, count);
+        }
+
+        Packet a = dx.square() * ax + dy.square() * ay + dz.square() * az;
+        Packet b = dx * bx + dy * by + dz * bz;
+        Packet discriminant = b.square() - a * c;
+        Packet t = (discriminant.max(SCALAR(0)).sqrt() * rootSign - b) / a;
+
+        // A ray from outside hits if the discriminant is positive and the roots are
+        // in front of the origin; from inside, the far root must be in front.
+        Packet hitTest = outside ? Packet(discriminant.min(t)) : t;
+
+        if (count == PacketSize && hitTest.minCoeff() > SCALAR(0))
+        {
+            // Every ray in the packet hits
+            Eigen::Map<Packet>(distances + i) = t;
+            hitCount += PacketSize;
+        }
+        else if (count == PacketSize && hitTest.maxCoeff() <= SCALAR(0))
+        {
+            // Every ray in the packet misses
+            Eigen::Map<Packet>(distances + i).setConstant(SCALAR(-1));
+        }
+        else
+        {
+            for (unsigned int j = 0; j < count; ++j)
+            {
+                bool hit = hitTest[j] > SCALAR(0);
+                distances[i + j] = hit ? t[j] : SCALAR(-1);
+                hitCount += hit ? 1 : 0;
+            }
+        }
+    }
+
+    return hitCount;
+}
+
+
+/** Intersect a ray with a batch of spheres. The sphere centers and radii are
+  * given in structure-of-arrays form. For each sphere, the distance to the
+  * nearest intersection in front of the ray origin is stored in distances[i],
+  * or -1 if the ray misses it. The results are the same as calling
+  * TestRaySphereIntersection for each sphere.
+  *
+  * As with TestRayBatchEllipsoidIntersection, spheres are processed in
+  * packets that Eigen evaluates with SIMD instructions.
+  *
+  * \param rayOrigin origin of the ray
+  * \param rayDirection direction of the ray (must be normalized)
+  * \return the number of spheres hit by the ray
+  */
+template<typename SCALAR> unsigned int
+TestRayBatchSphereIntersection(const Eigen::Matrix<SCALAR, 3, 1>& rayOrigin,
+                               const Eigen::Matrix<SCALAR, 3, 1>& rayDirection,
+                               const SCALAR centerX[],
+                               const SCALAR centerY[],
+                               const SCALAR centerZ[],
+                               const SCALAR radii[],
+                               unsigned int sphereCount,
+                               SCALAR distances[])
+{
+    enum { PacketSize = 8 };
+    typedef Eigen::Array<SCALAR, PacketSize, 1> Packet;
+    typedef Eigen::Array<SCALAR, Eigen::Dynamic, 1> ArrayType;
+
+    unsigned int hitCount = 0;
+    for (unsigned int i = 0; i < sphereCount; i += PacketSize)
+    {
+        unsigned int count = std::min(sphereCount - i, (unsigned int) PacketSize);
+
+        Packet x;
+        Packet y;
+        Packet z;
+        Packet r;
+        if (count == PacketSize)
+        {
+            x = Eigen::Map<const Packet>(centerX + i);
+            y = Eigen::Map<const Packet>(centerY + i);
+            z = Eigen::Map<const Packet>(centerZ + i);
+            r = Eigen::Map<const Packet>(radii + i);
+        }
+        else
+        {
+            // Pad a partial packet with empty spheres, which are never hit
+            x.setZero();
+            y.setZero();
+            z.setZero();
+            r.setZero();
+            x.head(count) = Eigen::Map<const ArrayType>(centerX + i, count);
+            y.head(count) = Eigen::Map<const ArrayType>(centerY + i, count);
+            z.head(count) = Eigen::Map<const ArrayType>(centerZ + i, count);
+            r.head(count) = Eigen::Map<const ArrayType>(radii + i, count);
+        }
+
+        x = rayOrigin.x() - x;
+        y = rayOrigin.y() - y;
+        z = rayOrigin.z() - z;
+
+        Packet xv = x * rayDirection.x() + y * rayDirection.y() + z * rayDirection.z();
+        Packet discriminant = xv.square() - (x.square() + y.square() + z.square()) + r.square();
+        if (discriminant.maxCoeff() <= SCALAR(0))
+        {
+            // The ray misses every sphere in the packet; this is the common case
+            // when picking.
+            for (unsigned int j = 0; j < count; ++j)
+            {
+                distances[i + j] = SCALAR(-1);
+            }
+            continue;
+        }
+
+        Packet d = discriminant.max(SCALAR(0)).sqrt();
+        Packet nearRoot = -xv - d;
+        Packet farRoot = -xv + d;
+
+        for (unsigned int j = 0; j < count; ++j)
+        {
+            SCALAR t = nearRoot[j] > SCALAR(0) ? nearRoot[j] : farRoot[j];
+            bool hit = discriminant[j] > SCALAR(0) && t > SCALAR(0);
+            distances[i + j] = hit ? t : SCALAR(-1);
+            hitCount += hit ? 1 : 0;
+        }
+    }
+
+    return hitCount;
+}
+
 }
 #endif // _VESTA_INTERSECT_H_
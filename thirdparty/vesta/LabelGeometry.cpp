@@ -12,6 +12,7 @@
 #include "RenderContext.h"
 #include "Material.h"
 #include <Eigen/Core>
+#include <algorithm>
 
 using namespace vesta;
 using namespace Eigen;
@@ -19,7 +20,8 @@ using namespace std;
 
 
 LabelGeometry::LabelGeometry() :
-    m_iconColor(Spectrum::White())
+    m_iconColor(Spectrum::White()),
+    m_placementPriority(0.0f)
 {
     setFixedApparentSize(true);
 }
@@ -33,7 +35,8 @@ LabelGeometry::LabelGeometry(const std::string& text, TextureFont* font, const S
     m_iconSize(iconSize),
     m_iconColor(Spectrum::White()),
     m_fadeSize(1.0f),
-    m_pickSizeAdjustment(0.0f)
+    m_pickSizeAdjustment(0.0f),
+    m_placementPriority(0.0f)
 {
     setFixedApparentSize(true);
     setClippingPolicy(ZeroExtent);
@@ -45,6 +48,23 @@ LabelGeometry::~LabelGeometry()
 }
 
 
+// Get the opacity of the label, including the fade with apparent size.
+float
+LabelGeometry::labelOpacity(const RenderContext& rc) const
+{
+    float opacity = 0.99f * m_opacity;
+    if (m_fadeRange.isValid())
+    {
+        float cameraDistance = rc.modelview().translation().norm();
+        float pixelSize = m_fadeSize / (rc.pixelSize() * cameraDistance);
+
+        opacity *= m_fadeRange->opacity(pixelSize);
+    }
+
+    return opacity;
+}
+
+
 void
 LabelGeometry::render(RenderContext& rc, double /* clock */) const
 {
@@ -56,15 +76,7 @@ LabelGeometry::render(RenderContext& rc, double /* clock */) const
         labelOffset.x() = std::floor(m_iconSize / 2.0f) + 1.0f;
     }
 
-    float opacity = 0.99f * m_opacity;
-    if (m_fadeRange.isValid())
-    {
-        float cameraDistance = rc.modelview().translation().norm();
-        float pixelSize = m_fadeSize / (rc.pixelSize() * cameraDistance);
-
-        opacity *= m_fadeRange->opacity(pixelSize);
-    }
-
+    float opacity = labelOpacity(rc);
     if (opacity == 0.0f)
     {
         return;
@@ -73,6 +85,11 @@ LabelGeometry::render(RenderContext& rc, double /* clock */) const
     // Render during the opaque pass if opaque or during the translucent pass if not.
     if (rc.pass() == RenderContext::TranslucentPass)
     {
+        if (!rc.isLabelPlaced(this, 0))
+        {
+            return;
+        }
+
         // Keep the screen size of the icon fixed by adding a scale factor equal
         // to the distance from the eye.
         float distanceScale = rc.modelview().translation().norm();
@@ -96,6 +113,35 @@ LabelGeometry::render(RenderContext& rc, double /* clock */) const
 }
 
 
+/** Submit the screen rectangle covered by the icon and text for decluttering.
+  * Labels that are faded out completely aren't submitted.
+  */
+void
+LabelGeometry::submitLabels(RenderContext& rc, double /* clock */) const
+{
+    if (labelOpacity(rc) == 0.0f)
+    {
+        return;
+    }
+
+    bool hasIcon = !m_icon.isNull();
+    float halfIconSize = hasIcon ? m_iconSize * 0.5f : 0.0f;
+    float textOffset = hasIcon ? std::floor(m_iconSize / 2.0f) + 1.0f : 0.0f;
+    Vector2f minOffset(-halfIconSize, -halfIconSize);
+    Vector2f maxOffset(halfIconSize, halfIconSize);
+
+    const TextureFont* font = m_font.isValid() ? m_font.ptr() : rc.defaultFont();
+    if (!m_text.empty() && font)
+    {
+        minOffset.y() = min(minOffset.y(), -font->maxDescent());
+        maxOffset.x() = max(maxOffset.x(), textOffset + rc.textLayout(m_text, font, TextureFont::Latin1)->width);
+        maxOffset.y() = max(maxOffset.y(), font->maxAscent());
+    }
+
+    rc.submitLabel(this, 0, minOffset, maxOffset, m_placementPriority);
+}
+
+
 float
 LabelGeometry::boundingSphereRadius() const
 {
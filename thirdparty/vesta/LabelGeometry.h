@@ -38,6 +38,8 @@ public:
     // Implementations of abstract methods for Geometry
     void render(RenderContext& rc,
                 double clock) const;
+    void submitLabels(RenderContext& rc,
+                      double clock) const;
 
     float boundingSphereRadius() const;
 
@@ -182,6 +184,27 @@ public:
         m_pickSizeAdjustment = pixels;
     }
 
+    /** Get the priority of this label for decluttering.
+      */
+    float placementPriority() const
+    {
+        return m_placementPriority;
+    }
+
+    /** Set the priority of this label for decluttering. When labels overlap on
+      * screen, the one with the higher priority is shown. Labels with the same
+      * priority are ranked by distance from the camera. The default priority is
+      * zero. Placement priority only has an effect when the renderer has a
+      * LabelPlacement service set.
+      */
+    void setPlacementPriority(float priority)
+    {
+        m_placementPriority = priority;
+    }
+
+private:
+    float labelOpacity(const RenderContext& rc) const;
+
 private:
     std::string m_text;
     counted_ptr<TextureFont> m_font;
@@ -193,6 +216,7 @@ private:
     counted_ptr<FadeRange> m_fadeRange;
     float m_fadeSize;
     float m_pickSizeAdjustment;
+    float m_placementPriority;
 };
 
 }
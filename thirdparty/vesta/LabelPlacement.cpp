@@ -0,0 +1,270 @@
+/*
+ * $Revision: 223 $ $Date: 2010-03-30 05:44:44 -0700 (Tue, 30 Mar 2010) $
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "LabelPlacement.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+LabelPlacement::LabelPlacement() :
+    m_viewportWidth(1),
+    m_viewportHeight(1),
+    m_tiled(false),
+    m_tileOriginX(0.0f),
+    m_tileOriginY(0.0f),
+    m_cellSize(32.0f),
+    m_stickiness(0.25f),
+    m_padding(2.0f),
+    m_lastCandidateCount(0),
+    m_gridColumns(0),
+    m_gridRows(0)
+{
+}
+
+
+LabelPlacement::~LabelPlacement()
+{
+}
+
+
+/** Set the size in pixels of the grid cells used for overlap tests. The
+  * best value is close to the height of a typical label; the default is
+  * 32 pixels.
+  */
+void
+LabelPlacement::setCellSize(float pixels)
+{
+    m_cellSize = max(1.0f, pixels);
+}
+
+
+/** Start collecting labels for a new view. This is called by UniverseRenderer
+  * at the start of renderView(). Within a tiled view, it does nothing.
+  * Placement results from the previous view remain available from isPlaced()
+  * until endView() is called.
+  */
+void
+LabelPlacement::beginView(int viewportWidth, int viewportHeight)
+{
+    if (m_tiled)
+    {
+        return;
+    }
+
+    m_viewportWidth = max(1, viewportWidth);
+    m_viewportHeight = max(1, viewportHeight);
+    m_candidates.clear();
+}
+
+
+/** Submit a label for placement. Whether the label should be drawn is known
+  * once the view has been resolved by endView().
+  *
+  * \param owner the object that draws the label
+  * \param index identifies the label when the owner draws more than one
+  * \param minCorner the lower left corner of the label in viewport coordinates
+  * \param maxCorner the upper right corner of the label in viewport coordinates
+  * \param priority labels with higher priority are placed first
+  * \param distance distance from the camera; used to rank labels of equal priority
+  */
+void
+LabelPlacement::submit(const void* owner,
+                       unsigned int index,
+                       const Vector2f& minCorner,
+                       const Vector2f& maxCorner,
+                       float priority,
+                       float distance)
+{
+    Candidate candidate;
+    candidate.key.owner = owner;
+    candidate.key.index = index;
+    candidate.x0 = m_tileOriginX + minCorner.x() - m_padding;
+    candidate.y0 = m_tileOriginY + minCorner.y() - m_padding;
+    candidate.x1 = m_tileOriginX + maxCorner.x() + m_padding;
+    candidate.y1 = m_tileOriginY + maxCorner.y() + m_padding;
+    candidate.distance = distance;
+
+    bool placed = m_placedLabels.find(candidate.key) != m_placedLabels.end();
+    candidate.rank = placed ? priority + m_stickiness : priority;
+
+    m_candidates.push_back(candidate);
+}
+
+
+/** Return true if a label was placed when the view was last resolved, false if
+  * it was hidden by another label or wasn't submitted.
+  */
+bool
+LabelPlacement::isPlaced(const void* owner, unsigned int index) const
+{
+    LabelKey key;
+    key.owner = owner;
+    key.index = index;
+
+    return m_placedLabels.find(key) != m_placedLabels.end();
+}
+
+
+// Labels are ordered by decreasing rank, then by increasing distance. Ties
+// are broken by submission order so that the placement is deterministic.
+bool
+LabelPlacement::CandidateRankPredicate::operator()(unsigned int i0, unsigned int i1) const
+{
+    const Candidate& c0 = m_candidates[i0];
+    const Candidate& c1 = m_candidates[i1];
+
+    if (c0.rank != c1.rank)
+    {
+        return c0.rank > c1.rank;
+    }
+    else if (c0.distance != c1.distance)
+    {
+        return c0.distance < c1.distance;
+    }
+    else
+    {
+        return i0 < i1;
+    }
+}
+
+
+bool
+LabelPlacement::overlapsPlacedLabel(const Candidate& candidate,
+                                    int cellX0, int cellY0, int cellX1, int cellY1) const
+{
+    for (int y = cellY0; y <= cellY1; ++y)
+    {
+        for (int x = cellX0; x <= cellX1; ++x)
+        {
+            for (int e = m_gridCells[y * m_gridColumns + x]; e >= 0; e = m_gridEntries[e].next)
+            {
+                const Candidate& other = m_candidates[m_gridEntries[e].candidate];
+                if (candidate.x0 < other.x1 && candidate.x1 > other.x0 &&
+                    candidate.y0 < other.y1 && candidate.y1 > other.y0)
+                {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+
+/** Resolve the placement of all labels submitted since beginView(). The
+  * results are reported by isPlaced() until the view is resolved again. Within
+  * a tiled view, it does nothing; labels are resolved by endTiledView() instead.
+  */
+void
+LabelPlacement::endView()
+{
+    if (m_tiled)
+    {
+        return;
+    }
+
+    m_gridColumns = (int) ceil(m_viewportWidth / m_cellSize);
+    m_gridRows = (int) ceil(m_viewportHeight / m_cellSize);
+    m_gridCells.assign(m_gridColumns * m_gridRows, -1);
+    m_gridEntries.clear();
+
+    m_rankOrder.resize(m_candidates.size());
+    for (unsigned int i = 0; i < m_candidates.size(); ++i)
+    {
+        m_rankOrder[i] = i;
+    }
+    sort(m_rankOrder.begin(), m_rankOrder.end(), CandidateRankPredicate(m_candidates));
+
+    m_placedLabels.clear();
+
+    for (vector<unsigned int>::const_iterator iter = m_rankOrder.begin(); iter != m_rankOrder.end(); ++iter)
+    {
+        const Candidate& candidate = m_candidates[*iter];
+
+        // Labels entirely outside the viewport don't occupy any space
+        if (candidate.x1 < 0.0f || candidate.y1 < 0.0f ||
+            candidate.x0 >= m_viewportWidth || candidate.y0 >= m_viewportHeight)
+        {
+            continue;
+        }
+
+        int cellX0 = max(0, int(candidate.x0 / m_cellSize));
+        int cellY0 = max(0, int(candidate.y0 / m_cellSize));
+        int cellX1 = min(m_gridColumns - 1, int(candidate.x1 / m_cellSize));
+        int cellY1 = min(m_gridRows - 1, int(candidate.y1 / m_cellSize));
+
+        if (!overlapsPlacedLabel(candidate, cellX0, cellY0, cellX1, cellY1))
+        {
+            for (int y = cellY0; y <= cellY1; ++y)
+            {
+                for (int x = cellX0; x <= cellX1; ++x)
+                {
+                    GridEntry entry;
+                    entry.candidate = *iter;
+                    entry.next = m_gridCells[y * m_gridColumns + x];
+                    m_gridCells[y * m_gridColumns + x] = (int) m_gridEntries.size();
+                    m_gridEntries.push_back(entry);
+                }
+            }
+
+            m_placedLabels.insert(candidate.key);
+        }
+    }
+
+    m_lastCandidateCount = (unsigned int) m_candidates.size();
+}
+
+
+/** Start collecting labels for an image that is drawn as several tiles. Until
+  * endTiledView() is called, the labels from all views are collected together
+  * and resolved as one view of the whole image; beginView() and endView()
+  * have no effect. Each tile should be positioned with setTileOrigin() before
+  * it is drawn. While the tiles are drawn, isPlaced() reports the results of
+  * the previous resolution, so the tiles must be drawn once to collect the
+  * labels before they are drawn for the final image.
+  *
+  * \param width the width of the whole image in pixels
+  * \param height the height of the whole image in pixels
+  */
+void
+LabelPlacement::beginTiledView(int width, int height)
+{
+    m_tiled = false;
+    beginView(width, height);
+    m_tiled = true;
+    setTileOrigin(0, 0);
+}
+
+
+/** Set the position in pixels of the lower left corner of the next tile within
+  * the whole image.
+  */
+void
+LabelPlacement::setTileOrigin(int x, int y)
+{
+    m_tileOriginX = float(x);
+    m_tileOriginY = float(y);
+}
+
+
+/** Resolve the placement of all labels submitted since beginTiledView().
+  */
+void
+LabelPlacement::endTiledView()
+{
+    m_tiled = false;
+    setTileOrigin(0, 0);
+    endView();
+}
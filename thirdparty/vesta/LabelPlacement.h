@@ -0,0 +1,194 @@
+/*
+ * $Revision: 223 $ $Date: 2010-03-30 05:44:44 -0700 (Tue, 30 Mar 2010) $
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_LABEL_PLACEMENT_H_
+#define _VESTA_LABEL_PLACEMENT_H_
+
+#include "Object.h"
+#include <Eigen/Core>
+#include <vector>
+#include <set>
+
+
+namespace vesta
+{
+
+/** LabelPlacement is a screen space decluttering service shared by all of the
+  * label producers in a view. Each label submits its screen rectangle along with
+  * a priority. At the end of the view, the candidates are ranked by priority and
+  * then by distance from the camera, and any label that overlaps a higher ranked
+  * label is rejected. Overlap tests use a uniform grid over the viewport, so the
+  * cost of the placement pass is linear in the number of labels.
+  *
+  * UniverseRenderer submits all labels in a view before drawing anything and
+  * resolves them with endView(); while the view is drawn, isPlaced() reports
+  * which labels were placed. Labels are thus drawn in the same pass as the
+  * objects they're attached to, so that they're still depth tested properly,
+  * without lagging a frame behind. Labels that were placed in the previous
+  * frame receive a small priority bonus, which prevents labels with nearly
+  * the same rank from flickering as they trade places.
+  *
+  * A LabelPlacement object retains state between frames. Because of this, a
+  * separate instance should be used for each view, including each eye of a
+  * stereo pair.
+  *
+  * An image that is drawn in several tiles (each one a separate view) can be
+  * decluttered as a whole by bracketing the views with beginTiledView() and
+  * endTiledView().
+  */
+class LabelPlacement : public Object
+{
+public:
+    LabelPlacement();
+    ~LabelPlacement();
+
+    void beginView(int viewportWidth, int viewportHeight);
+    void endView();
+
+    void beginTiledView(int width, int height);
+    void setTileOrigin(int x, int y);
+    void endTiledView();
+
+    void submit(const void* owner,
+                unsigned int index,
+                const Eigen::Vector2f& minCorner,
+                const Eigen::Vector2f& maxCorner,
+                float priority,
+                float distance);
+
+    bool isPlaced(const void* owner, unsigned int index) const;
+
+    /** Get the number of labels submitted during the last view.
+      */
+    unsigned int candidateCount() const
+    {
+        return m_lastCandidateCount;
+    }
+
+    /** Get the number of labels that were placed (i.e. not rejected because
+      * of overlaps) when the last view was resolved.
+      */
+    unsigned int placedCount() const
+    {
+        return (unsigned int) m_placedLabels.size();
+    }
+
+    /** Get the priority bonus given to labels that were visible in the
+      * previous frame.
+      */
+    float stickiness() const
+    {
+        return m_stickiness;
+    }
+
+    /** Set the priority bonus given to labels that were visible in the
+      * previous frame. This should be smaller than the difference between
+      * the priorities of different classes of labels. The default value
+      * is 0.25.
+      */
+    void setStickiness(float stickiness)
+    {
+        m_stickiness = stickiness;
+    }
+
+    /** Get the size in pixels of the grid cells used for overlap tests.
+      */
+    float cellSize() const
+    {
+        return m_cellSize;
+    }
+
+    void setCellSize(float pixels);
+
+    /** Get the number of pixels of padding added around each label.
+      */
+    float padding() const
+    {
+        return m_padding;
+    }
+
+    /** Set the number of pixels of padding added around each label. The
+      * default value is two pixels.
+      */
+    void setPadding(float pixels)
+    {
+        m_padding = pixels;
+    }
+
+private:
+    struct LabelKey
+    {
+        const void* owner;
+        unsigned int index;
+
+        bool operator<(const LabelKey& other) const
+        {
+            return owner < other.owner || (owner == other.owner && index < other.index);
+        }
+    };
+
+    struct Candidate
+    {
+        LabelKey key;
+        float x0;
+        float y0;
+        float x1;
+        float y1;
+        float rank;
+        float distance;
+    };
+
+    struct GridEntry
+    {
+        unsigned int candidate;
+        int next;
+    };
+
+    class CandidateRankPredicate
+    {
+    public:
+        CandidateRankPredicate(const std::vector<Candidate>& candidates) :
+            m_candidates(candidates)
+        {
+        }
+
+        bool operator()(unsigned int i0, unsigned int i1) const;
+
+    private:
+        const std::vector<Candidate>& m_candidates;
+    };
+
+    bool overlapsPlacedLabel(const Candidate& candidate,
+                             int cellX0, int cellY0, int cellX1, int cellY1) const;
+
+private:
+    int m_viewportWidth;
+    int m_viewportHeight;
+    bool m_tiled;
+    float m_tileOriginX;
+    float m_tileOriginY;
+    float m_cellSize;
+    float m_stickiness;
+    float m_padding;
+
+    std::vector<Candidate> m_candidates;
+    std::vector<unsigned int> m_rankOrder;
+    std::set<LabelKey> m_placedLabels;
+    unsigned int m_lastCandidateCount;
+
+    int m_gridColumns;
+    int m_gridRows;
+    std::vector<int> m_gridCells;
+    std::vector<GridEntry> m_gridEntries;
+};
+
+}
+
+#endif // _VESTA_LABEL_PLACEMENT_H_
@@ -15,7 +15,8 @@ using namespace vesta;
 
 
 MapLayer::MapLayer() :
-    m_opacity(1.0f)
+    m_opacity(1.0f),
+    m_blendMode(Material::Opaque)
 {
 }
 
@@ -13,6 +13,7 @@
 
 #include "Object.h"
 #include "TextureMap.h"
+#include "Material.h"
 
 namespace vesta
 {
@@ -55,7 +56,7 @@ class MapLayer : public Object
 {
 public:
     MapLayer();
-    ~MapLayer();
+    virtual ~MapLayer();
 
     /** Get the texture map used for this layer. */
     TextureMap* texture() const
@@ -86,6 +87,24 @@ public:
         m_opacity = opacity;
     }
 
+    /** Get the blend mode used when drawing this layer over the base
+      * texture and underlying layers.
+      */
+    Material::BlendMode blendMode() const
+    {
+        return m_blendMode;
+    }
+
+    /** Set the blend mode used when drawing this layer. The default is
+      * Material::Opaque; layers with textures that are partly transparent
+      * (e.g. an overlay that covers only some regions) should use
+      * Material::AlphaBlend so that underlying layers show through.
+      */
+    void setBlendMode(Material::BlendMode blendMode)
+    {
+        m_blendMode = blendMode;
+    }
+
     /** Get the rectangular patch of the layer that
       * is actually visible.
       */
@@ -101,10 +120,18 @@ public:
         m_box = box;
     }
 
+    /** Called before the layer is drawn at time t (in seconds since J2000 TDB).
+      * Layers with contents that change over time may override this method in
+      * order to update their texture. The default implementation does nothing.
+      */
+    virtual void prepareToRender(double /* t */)
+    {
+    }
 
 private:
     counted_ptr<TextureMap> m_texture;
     float m_opacity;
+    Material::BlendMode m_blendMode;
     MapLayerBounds m_box;
 };
 
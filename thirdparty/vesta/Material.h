@@ -167,6 +167,35 @@ public:
         return m_specularTexture.ptr();
     }
 
+    /** Get a value identifying the shader features that this material
+      * requires: the BRDF, whether there's a specular highlight, and which
+      * textures are used. Under the same lighting, materials with equal keys
+      * are drawn with the same shader. The key is never zero.
+      */
+    unsigned int shaderStateKey() const
+    {
+        return ShaderStateKey(m_brdf, !m_specular.isBlack(),
+                              m_baseTexture.isValid(), m_normalTexture.isValid(), m_specularTexture.isValid(),
+                              m_specularModifier);
+    }
+
+    /** Compute the shader state key of a material with the specified properties
+      * without constructing it.
+      * \see shaderStateKey()
+      */
+    static unsigned int ShaderStateKey(BRDF brdf, bool hasSpecular,
+                                       bool hasBaseTexture, bool hasNormalTexture, bool hasSpecularTexture,
+                                       SpecularModifierSource specularModifier)
+    {
+        unsigned int key = (unsigned int) brdf + 1;
+        key |= hasSpecular ? 0x100 : 0;
+        key |= hasBaseTexture ? 0x200 : 0;
+        key |= hasNormalTexture ? 0x400 : 0;
+        key |= hasSpecularTexture ? 0x800 : 0;
+        key |= (unsigned int) specularModifier << 12;
+        return key;
+    }
+
     void setBrdf(BRDF brdf)
     {
         m_brdf = brdf;
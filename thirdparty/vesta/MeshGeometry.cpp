@@ -30,9 +30,20 @@ using namespace Eigen;
 using namespace std;
 
 
+// Default for the largest projected geometric error allowed in a level of
+// detail, in pixels.
+static const float DefaultLevelOfDetailThreshold = 1.0f;
+
+// A coarser level of detail is only chosen once its projected error is below
+// this fraction of the threshold. Without the gap, a mesh at just the right
+// distance would switch levels every few frames.
+static const float LevelOfDetailHysteresis = 0.75f;
+
+
 MeshGeometry::MeshGeometry() :
     m_boundingSphereRadius(0.0f),
     m_meshScale(1.0f, 1.0f, 1.0f),
+    m_levelOfDetailThreshold(DefaultLevelOfDetailThreshold),
     m_hwBuffersCurrent(false)
 {
     // By default, mesh geometry both casts and receives shadows
@@ -47,15 +58,46 @@ MeshGeometry::~MeshGeometry()
 }
 
 
+// Apply the transformation that converts quantized vertex positions to model
+// space. The scale is uniform, so normals aren't distorted.
+static void
+pushPositionTransform(RenderContext& rc, const VertexArray* vertices)
+{
+    rc.pushModelView();
+    rc.translateModelView(vertices->positionOffset());
+    rc.scaleModelView(Vector3f::Constant(vertices->positionScale()));
+}
+
+
+/** Render the mesh. No level of detail state is kept between calls, so the
+  * levels are chosen without hysteresis. Callers that draw the same mesh
+  * repeatedly should keep a LevelOfDetailState and use the other overload.
+  */
 void
 MeshGeometry::render(RenderContext& rc,
-                     double /* clock */) const
+                     double clock) const
+{
+    LevelOfDetailState levels;
+    render(rc, clock, &levels);
+}
+
+
+/** Render the mesh, choosing the level of detail for each submesh starting
+  * from the levels drawn last time for the same instance. The chosen levels
+  * are stored in levels, which must not be null.
+  */
+void
+MeshGeometry::render(RenderContext& rc,
+                     double /* clock */,
+                     LevelOfDetailState* levels) const
 {
     if (!m_hwBuffersCurrent)
     {
         realize();
     }
 
+    selectLevelsOfDetail(rc, levels);
+
     // Track the last used material in order to avoid redundant
     // material bindings.
     unsigned int lastMaterialIndex = Submesh::DefaultMaterialIndex;
@@ -69,6 +111,7 @@ MeshGeometry::render(RenderContext& rc,
     for (unsigned int i = 0; i < m_submeshes.size(); ++i)
     {
         const Submesh& submesh = *m_submeshes[i];
+        unsigned int level = (*levels)[i];
         if (i < m_submeshBuffers.size() && m_submeshBuffers[i])
         {
             boundVertexBuffer = m_submeshBuffers[i];
@@ -84,6 +127,14 @@ MeshGeometry::render(RenderContext& rc,
             rc.bindVertexArray(submesh.vertices());
         }
 
+        // The quantization transform is folded into the modelview matrix,
+        // so lighting and shadows continue to work in model space.
+        bool quantized = submesh.vertices()->hasQuantizedPositions();
+        if (quantized)
+        {
+            pushPositionTransform(rc, submesh.vertices());
+        }
+
         const vector<PrimitiveBatch*>& batches = submesh.primitiveBatches();
         const vector<unsigned int>& materials = submesh.materials();
         assert(batches.size() == materials.size());
@@ -102,7 +153,12 @@ MeshGeometry::render(RenderContext& rc,
                 lastMaterialIndex = materialIndex;
             }
 
-            rc.drawPrimitives(*batches[j]);
+            rc.drawPrimitives(*submesh.levelOfDetailBatch(level, j));
+        }
+
+        if (quantized)
+        {
+            rc.popModelView();
         }
     }
 
@@ -115,9 +171,24 @@ MeshGeometry::render(RenderContext& rc,
 }
 
 
+/** Render the mesh into a shadow map at full resolution. */
 void
 MeshGeometry::renderShadow(RenderContext& rc,
-                           double /* clock */) const
+                           double clock) const
+{
+    renderShadow(rc, clock, NULL);
+}
+
+
+/** Render the mesh into a shadow map using the levels of detail last chosen
+  * by render() for the same instance. Selecting levels here from the light's
+  * point of view could give a shadow that doesn't match the geometry that
+  * receives it. If levels is null, the full resolution mesh is drawn.
+  */
+void
+MeshGeometry::renderShadow(RenderContext& rc,
+                           double /* clock */,
+                           const LevelOfDetailState* levels) const
 {
     if (!m_hwBuffersCurrent)
     {
@@ -139,6 +210,12 @@ MeshGeometry::renderShadow(RenderContext& rc,
     {
         const Submesh& submesh = *m_submeshes[i];
 
+        unsigned int level = 0;
+        if (levels && i < levels->size())
+        {
+            level = min((*levels)[i], submesh.levelOfDetailCount() - 1);
+        }
+
         if (i < m_submeshBuffers.size() && m_submeshBuffers[i])
         {
             boundVertexBuffer = m_submeshBuffers[i];
@@ -154,6 +231,12 @@ MeshGeometry::renderShadow(RenderContext& rc,
             rc.bindVertexArray(submesh.vertices());
         }
 
+        bool quantized = submesh.vertices()->hasQuantizedPositions();
+        if (quantized)
+        {
+            pushPositionTransform(rc, submesh.vertices());
+        }
+
         const vector<PrimitiveBatch*>& batches = submesh.primitiveBatches();
         const vector<unsigned int>& materials = submesh.materials();
         assert(batches.size() == materials.size());
@@ -167,9 +250,14 @@ MeshGeometry::renderShadow(RenderContext& rc,
             unsigned int materialIndex = materials[j];
             if (materialIndex >= m_materials.size() || m_materials[materialIndex]->opacity() > 0.5f)
             {
-                rc.drawPrimitives(*batches[j]);
+                rc.drawPrimitives(*submesh.levelOfDetailBatch(level, j));
             }
         }
+
+        if (quantized)
+        {
+            rc.popModelView();
+        }
     }
 
     if (boundVertexBuffer)
@@ -188,6 +276,27 @@ MeshGeometry::boundingSphereRadius() const
 }
 
 
+/** Get the render state keys of the first material in the mesh. Meshes with
+  * several materials change state while drawing anyway; the first material
+  * is the one that is bound when drawing starts.
+  */
+void
+MeshGeometry::renderStateKeys(unsigned int* shaderKey, unsigned int* textureKey) const
+{
+    const Material* material = m_materials.empty() ? NULL : m_materials.front().ptr();
+    if (material)
+    {
+        *shaderKey = material->shaderStateKey();
+        *textureKey = material->baseTexture() ? material->baseTexture()->id() : 0;
+    }
+    else
+    {
+        *shaderKey = 0;
+        *textureKey = 0;
+    }
+}
+
+
 bool
 MeshGeometry::handleRayPick(const Eigen::Vector3d& pickOrigin,
                             const Eigen::Vector3d& pickDirection,
@@ -287,7 +396,9 @@ MeshGeometry::mergeSubmeshes()
         {
             Submesh* s = *iter;
             if (vertexArray->stride() == s->vertices()->stride() &&
-                vertexArray->vertexSpec() == s->vertices()->vertexSpec())
+                vertexArray->vertexSpec() == s->vertices()->vertexSpec() &&
+                vertexArray->positionScale() == s->vertices()->positionScale() &&
+                vertexArray->positionOffset() == s->vertices()->positionOffset())
             {
                 matches.push_back(s);
             }
@@ -339,8 +450,8 @@ MeshGeometry::setMeshChanged()
 }
 
 
-/** Optimize the mesh by removing duplicate vertices. This operation is expensive for large meshes,
-  * but can greatly reduce the number of vertices in unoptimized meshes. Naive normal generation can
+/** Optimize the mesh by removing duplicate vertices. The expected cost is linear in the number of
+  * vertices, and it can greatly reduce the number of vertices in unoptimized meshes. Naive normal generation can
   * produce large numbers of duplicate vertices that should be removed with a uniquify operation.
   * The positionTolerance, normalTolerance, and texCoordTolerance determine how closely vertices
   * need to match in order to be considered identical. Components of two positions (or normals, etc.)
@@ -368,6 +479,88 @@ MeshGeometry::uniquifyVertices(float positionTolerance, float normalTolerance, f
 }
 
 
+/** Reorder the triangles and vertices of every submesh for better use of the
+  * GPU's post-transform cache and more sequential vertex fetches. The average
+  * cache miss ratio (ACMR) of each submesh before and after is logged. This
+  * should be the last of the optimization steps.
+  *
+  * \return true if the optimization was successful (it should only ever fail in
+  *         out of memory conditions.)
+  */
+bool
+MeshGeometry::optimizeVertexCache()
+{
+    for (unsigned int i = 0; i < m_submeshes.size(); ++i)
+    {
+        Submesh* submesh = m_submeshes[i].ptr();
+
+        float acmrBefore = submesh->averageCacheMissRatio();
+        bool ok = submesh->optimizeVertexCache();
+        if (!ok)
+        {
+            VESTA_WARNING("Error occurred while optimizing mesh for vertex cache.");
+            return false;
+        }
+        float acmrAfter = submesh->averageCacheMissRatio();
+
+        VESTA_LOG("Submesh %u (%u vertices): ACMR %.3f -> %.3f", i, submesh->vertices()->count(), acmrBefore, acmrAfter);
+    }
+
+    setMeshChanged();
+
+    return true;
+}
+
+
+// Count the triangles drawn for a submesh at the specified level of detail
+static unsigned int
+triangleCount(const Submesh* submesh, unsigned int level)
+{
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < submesh->primitiveBatchCount(); ++i)
+    {
+        const PrimitiveBatch* batch = submesh->levelOfDetailBatch(level, i);
+        if (batch->primitiveType() == PrimitiveBatch::Triangles)
+        {
+            count += batch->primitiveCount();
+        }
+    }
+
+    return count;
+}
+
+
+/** Build a chain of simplified levels of detail for every submesh. See
+  * Submesh::buildLevelsOfDetail for details. This should be called after
+  * optimizeVertexCache. Simplification may take a few seconds for meshes
+  * with millions of triangles, so it's best to save the result along with
+  * the rest of the optimized mesh.
+  *
+  * \return true if levels of detail were created for any submesh
+  */
+bool
+MeshGeometry::buildLevelsOfDetail(unsigned int maxLevelCount)
+{
+    bool built = false;
+    for (unsigned int i = 0; i < m_submeshes.size(); ++i)
+    {
+        Submesh* submesh = m_submeshes[i].ptr();
+        if (submesh->buildLevelsOfDetail(maxLevelCount))
+        {
+            unsigned int lastLevel = submesh->levelOfDetailCount() - 1;
+            VESTA_LOG("Submesh %u: %u levels of detail, %u -> %u triangles (error %g)",
+                      i, lastLevel, triangleCount(submesh, 0), triangleCount(submesh, lastLevel),
+                      submesh->levelOfDetailError(lastLevel));
+            built = true;
+        }
+    }
+
+    setMeshChanged();
+
+    return built;
+}
+
+
 /** Compress indices to 16-bit where possible. This can improve rendering performance
   * on some hardware, and some mobile GPUs can only use 16-bit vertex indices.
   */
@@ -383,6 +576,62 @@ MeshGeometry::compressIndices()
 }
 
 
+/** Store vertices in compact quantized formats. See Submesh::quantizeVertices
+  * for details. This should be the final optimization step, as the other steps
+  * expect floating point vertex attributes.
+  *
+  * \return true if the vertices of all submeshes were quantized
+  */
+bool
+MeshGeometry::quantizeVertices()
+{
+    bool ok = true;
+    unsigned int originalSize = 0;
+    unsigned int quantizedSize = 0;
+
+    for (unsigned int i = 0; i < m_submeshes.size(); ++i)
+    {
+        Submesh* submesh = m_submeshes[i].ptr();
+        originalSize += submesh->vertices()->count() * submesh->vertices()->stride();
+        if (!submesh->vertices()->hasQuantizedPositions() && !submesh->quantizeVertices())
+        {
+            ok = false;
+        }
+        quantizedSize += submesh->vertices()->count() * submesh->vertices()->stride();
+
+        // Quantization may move vertices very slightly outside the original bounds
+        m_boundingSphereRadius = std::max(m_boundingSphereRadius, submesh->boundingSphereRadius());
+        m_boundingBox = m_boundingBox.merged(submesh->boundingBox());
+    }
+
+    if (quantizedSize < originalSize)
+    {
+        VESTA_LOG("Quantized vertices: %u -> %u bytes (%.1f%% saved)",
+                  originalSize, quantizedSize, 100.0 * (originalSize - quantizedSize) / originalSize);
+    }
+
+    setMeshChanged();
+
+    return ok;
+}
+
+
+/** Return true if any submesh has quantized vertex positions. */
+bool
+MeshGeometry::hasQuantizedVertices() const
+{
+    for (unsigned int i = 0; i < m_submeshes.size(); ++i)
+    {
+        if (m_submeshes[i]->vertices()->hasQuantizedPositions())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
 #define TEST_PROPERTY(p0, p1) if ((p0) < (p1)) return true; else if ((p0) > (p1)) return false;
 #define TEST_PROPERTY_REVERSE(p0, p1) if ((p0) > (p1)) return true; else if ((p0) < (p1)) return false;
 
@@ -581,6 +830,47 @@ MeshGeometry::realize() const
 }
 
 
+// Choose the level of detail to draw for each submesh. The geometric error
+// of each level is projected to pixels at the distance of the nearest point
+// on the mesh's bounding sphere. Levels get finer as soon as the error
+// exceeds the threshold, but coarser only once it drops well below.
+void
+MeshGeometry::selectLevelsOfDetail(const RenderContext& rc, LevelOfDetailState* levels) const
+{
+    levels->resize(m_submeshes.size(), 0);
+
+    float distance = rc.modelview().translation().norm() - boundingSphereRadius();
+    float maxScale = m_meshScale.maxCoeff();
+    if (m_levelOfDetailThreshold <= 0.0f || distance <= 0.0f || maxScale <= 0.0f)
+    {
+        fill(levels->begin(), levels->end(), 0u);
+        return;
+    }
+
+    // Largest error in mesh units that projects to the threshold size
+    float allowedError = m_levelOfDetailThreshold * rc.pixelSize() * distance / maxScale;
+
+    for (unsigned int i = 0; i < m_submeshes.size(); ++i)
+    {
+        const Submesh* submesh = m_submeshes[i].ptr();
+        unsigned int level = min((*levels)[i], submesh->levelOfDetailCount() - 1);
+
+        while (level > 0 && submesh->levelOfDetailError(level) > allowedError)
+        {
+            --level;
+        }
+
+        while (level + 1 < submesh->levelOfDetailCount() &&
+               submesh->levelOfDetailError(level + 1) <= allowedError * LevelOfDetailHysteresis)
+        {
+            ++level;
+        }
+
+        (*levels)[i] = level;
+    }
+}
+
+
 // Free any index and vertex buffers used by this mesh
 // TODO: make this non-const, as it modifies the submesh buffers list. This requires
 // the render() method to be non-const.
@@ -702,55 +992,14 @@ Convert3DSMesh(Lib3dsFile* meshfile, TextureMapLoader* textureLoader)
 
 
 static MeshGeometry*
-ConvertObjMesh(istream& in, TextureMapLoader* textureLoader, const std::string& pathName)
+ConvertObjMesh(const vector<char>& text, TextureMapLoader* textureLoader, const std::string& pathName)
 {
     ObjLoader loader;
-    ObjMaterialLibrary* materialLibrary = NULL;
 
-    MeshGeometry* mesh = loader.loadModel(in);
+    MeshGeometry* mesh = loader.loadModel(text.empty() ? NULL : &text[0], text.size());
     if (mesh)
     {
-        if (!loader.materialLibrary().empty())
-        {
-            string materialLibraryFileName = pathName + loader.materialLibrary();
-            ifstream matStream(materialLibraryFileName.c_str(), ios::in);
-            if (!matStream.good())
-            {
-                VESTA_LOG("Can't find material library file '%s' for OBJ format mesh", materialLibraryFileName.c_str());
-            }
-            else
-            {
-                ObjMaterialLibraryLoader matLoader(textureLoader);
-                materialLibrary = matLoader.loadMaterials(matStream);
-            }
-        }
-
-        if (materialLibrary)
-        {
-            const vector<string>& materials = loader.materials();
-            for (unsigned int i = 0; i < materials.size(); ++i)
-            {
-                string materialName = materials[i];
-                if (!materialName.empty())
-                {
-                    Material* material = materialLibrary->material(materialName);
-                    if (material)
-                    {
-                        Material* meshMaterial = mesh->material(i);
-                        if (meshMaterial)
-                        {
-                            *meshMaterial = *material;
-                        }
-                    }
-                    else
-                    {
-                        VESTA_LOG("Missing material in OBJ file: '%s'", materialName.c_str());
-                    }
-                }
-            }
-
-            delete materialLibrary;
-        }
+        loader.applyMaterialLibrary(mesh, textureLoader, pathName);
     }
 
     return mesh;
@@ -806,14 +1055,33 @@ MeshGeometry::loadFromFile(const string& fileName, TextureMapLoader* textureLoad
     }
     else if (extension == "obj")
     {
-        ifstream meshStream(fileName.c_str(), ios::in);
+        // Read the whole file at once; the in-memory OBJ parser is much
+        // faster than parsing from a stream.
+        ifstream meshStream(fileName.c_str(), ios::in | ios::binary);
         if (!meshStream.good())
         {
             VESTA_LOG("MeshGeometry::loadFromFile() : Can't find mesh file '%s'", fileName.c_str());
         }
         else
         {
-            meshGeometry = ConvertObjMesh(meshStream, textureLoader, pathName);
+            meshStream.seekg(0, ios::end);
+            streamoff fileSize = meshStream.tellg();
+            meshStream.seekg(0, ios::beg);
+
+            vector<char> text(size_t(max(fileSize, streamoff(0))));
+            if (!text.empty())
+            {
+                meshStream.read(&text[0], text.size());
+            }
+
+            if (meshStream.fail())
+            {
+                VESTA_LOG("MeshGeometry::loadFromFile() : Error reading mesh file '%s'", fileName.c_str());
+            }
+            else
+            {
+                meshGeometry = ConvertObjMesh(text, textureLoader, pathName);
+            }
         }
     }
     else
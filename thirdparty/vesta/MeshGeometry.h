@@ -31,17 +31,26 @@ class GLVertexBuffer;
   * Often, 3D mesh files are not well-conditioned for rendering on
   * graphics hardware. They may contain redundant vertexes and materials.
   * Or, the geometry may be split into many small chunks that result
-  * in extra overhead for the hardware or driver. MeshGeometry has three
+  * in extra overhead for the hardware or driver. MeshGeometry has four
   * methods to preprocess meshes for better hardware performance:
   *
   * - mergeSubmeshes
   * - unquifyVertices
   * - mergeMaterials
+  * - optimizeVertexCache
   *
-  * For the best possible results, all three methods should be called
+  * For the best possible results, all four methods should be called
   * after a model is loaded. The sequence is important: the methods should
   * be called in the order given above.
   *
+  * buildLevelsOfDetail may be called after the other optimization steps
+  * to precompute simplified versions of the mesh. When levels of detail are
+  * available, render() draws the coarsest level whose geometric error
+  * projects to less than levelOfDetailThreshold() pixels.
+  *
+  * quantizeVertices may be called last of all to halve the memory used by
+  * vertices. Quantized meshes require GLSL shaders.
+  *
   * If mesh files are saved in optimized form, then preprocessing at load
   * time can be skipped. This is ideal, as the optimization functions can
   * require significant amounts of computation for complex models with many
@@ -55,16 +64,49 @@ public:
     MeshGeometry();
     virtual ~MeshGeometry();
 
+    /** Levels of detail chosen for one instance of the mesh, one entry per
+      * submesh. The state is kept by the caller between frames so that levels
+      * change with hysteresis; objects that share a mesh each need their own.
+      */
+    typedef std::vector<unsigned int> LevelOfDetailState;
+
     void render(RenderContext& rc,
                 double animationClock) const;
     void renderShadow(RenderContext& rc,
                       double animationClock) const;
+    void render(RenderContext& rc,
+                double animationClock,
+                LevelOfDetailState* levels) const;
+    void renderShadow(RenderContext& rc,
+                      double animationClock,
+                      const LevelOfDetailState* levels) const;
 
     float boundingSphereRadius() const;
+    virtual void renderStateKeys(unsigned int* shaderKey, unsigned int* textureKey) const;
 
     void addSubmesh(Submesh* submesh);
     void addMaterial(Material* material);
 
+    unsigned int submeshCount() const
+    {
+        return m_submeshes.size();
+    }
+
+    /** Get the submesh at the specified index. Returns null if the
+      * index is out of range.
+      */
+    const Submesh* submesh(unsigned int index) const
+    {
+        if (index < m_submeshes.size())
+        {
+            return m_submeshes[index].ptr();
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
     unsigned int materialCount() const
     {
         return m_materials.size();
@@ -114,13 +156,35 @@ public:
     bool mergeSubmeshes();
     bool uniquifyVertices(float positionTolerance = 0.0f, float normalTolerance = 0.0f, float texCoordTolerance = 0.0f);
     bool mergeMaterials();
+    bool optimizeVertexCache();
+    bool buildLevelsOfDetail(unsigned int maxLevelCount = Submesh::DefaultLevelOfDetailCount);
     void compressIndices();
+    bool quantizeVertices();
+    bool hasQuantizedVertices() const;
+
+    /** Get the largest geometric error, in pixels, allowed when choosing a
+      * level of detail.
+      */
+    float levelOfDetailThreshold() const
+    {
+        return m_levelOfDetailThreshold;
+    }
+
+    /** Set the largest geometric error, in pixels, allowed when choosing a
+      * level of detail. A threshold of zero disables level of detail
+      * selection, so that the full resolution mesh is always drawn.
+      */
+    void setLevelOfDetailThreshold(float pixels)
+    {
+        m_levelOfDetailThreshold = pixels;
+    }
 
     static MeshGeometry* loadFromFile(const std::string& filename, TextureMapLoader* textureLoader);
 
 private:
     void freeSubmeshBuffers() const;
     bool realize() const;
+    void selectLevelsOfDetail(const RenderContext& rc, LevelOfDetailState* levels) const;
 
 protected:
     virtual bool handleRayPick(const Eigen::Vector3d& pickOrigin,
@@ -134,6 +198,7 @@ private:
     float m_boundingSphereRadius;
     BoundingBox m_boundingBox;
     Eigen::Vector3f m_meshScale;
+    float m_levelOfDetailThreshold;
 
     // TODO: these values are only mutable because the render() method
     // must be const. Consider changing this requirement.
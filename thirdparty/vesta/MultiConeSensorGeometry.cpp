@@ -237,6 +237,12 @@ MultiConeSensorGeometry::render(RenderContext& rc,
 
                 const unsigned int sideDivisions = 24;
                 const unsigned int sections = 4 * sideDivisions;
+
+                // Directions of the rays along the edge of the beam, in the target frame
+                double rayX[sections];
+                double rayY[sections];
+                double rayZ[sections];
+
                 for (unsigned int i = 0; i < sections; ++i)
                 {
                     double t = (double) i / (double) sections;
@@ -258,14 +264,27 @@ MultiConeSensorGeometry::render(RenderContext& rc,
                         r = center + t * rayDirection;
                     }
 
+                    m_frustumPoints.push_back(r);
+
+                    Vector3d targetRay = targetRotation * r;
+                    rayX[i] = targetRay.x();
+                    rayY[i] = targetRay.y();
+                    rayZ[i] = targetRay.z();
+                }
+
+                // Trim the rays where they intersect the target
+                double intersectDistances[sections];
+                TestRayBatchEllipsoidIntersection(p2, rayX, rayY, rayZ, sections, targetSemiAxes, intersectDistances);
+                for (unsigned int i = 0; i < sections; ++i)
+                {
                     double intersectDistance = m_range;
-                    if (TestRayEllipsoidIntersection(p2, targetRotation * r, targetSemiAxes, &intersectDistance))
+                    if (intersectDistances[i] >= 0.0)
                     {
                         // Reduce the intersect distance slightly to reduce depth precision problems
                         // when drawing the sensor footprint on a planet surface.
-                        intersectDistance *= 0.9999;
+                        intersectDistance = intersectDistances[i] * 0.9999;
                     }
-                    m_frustumPoints.push_back(r * min(m_range, intersectDistance));
+                    m_frustumPoints[i] *= min(m_range, intersectDistance);
                 }
 
                 if (m_opacity > 0.0f)
@@ -0,0 +1,387 @@
+/*
+ * $Revision: 223 $ $Date: 2010-03-30 05:44:44 -0700 (Tue, 30 Mar 2010) $
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+using namespace vesta;
+using namespace std;
+
+
+bool Profiler::s_enabled = false;
+
+
+#ifdef _WIN32
+struct Profiler::LockImpl
+{
+    LockImpl()  { InitializeCriticalSection(&section); }
+    ~LockImpl() { DeleteCriticalSection(&section); }
+    CRITICAL_SECTION section;
+};
+
+void Profiler::lock()   { EnterCriticalSection(&m_lock->section); }
+void Profiler::unlock() { LeaveCriticalSection(&m_lock->section); }
+
+static unsigned long currentThreadKey()
+{
+    return (unsigned long) GetCurrentThreadId();
+}
+#else
+struct Profiler::LockImpl
+{
+    LockImpl()  { pthread_mutex_init(&mutex, NULL); }
+    ~LockImpl() { pthread_mutex_destroy(&mutex); }
+    pthread_mutex_t mutex;
+};
+
+void Profiler::lock()   { pthread_mutex_lock(&m_lock->mutex); }
+void Profiler::unlock() { pthread_mutex_unlock(&m_lock->mutex); }
+
+static unsigned long currentThreadKey()
+{
+    return (unsigned long) (size_t) pthread_self();
+}
+#endif
+
+
+static bool
+scopeTimePredicate(const Profiler::ScopeStatistics& s0, const Profiler::ScopeStatistics& s1)
+{
+    return s0.totalTime > s1.totalTime;
+}
+
+
+// Write a string as a JSON string literal
+static void
+writeJsonString(ostream& out, const char* s)
+{
+    out << '"';
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            out << '\\';
+        }
+
+        if ((unsigned char) *s >= 0x20)
+        {
+            out << *s;
+        }
+    }
+    out << '"';
+}
+
+
+bool
+Profiler::NameLess::operator()(const char* a, const char* b) const
+{
+    return a != b && strcmp(a, b) < 0;
+}
+
+
+Profiler::Profiler() :
+    m_frameStatisticsEnabled(false),
+    m_tracingEnabled(false),
+    m_startTime(Stopwatch::currentTime()),
+    m_frameStartTime(0.0),
+    m_lastFrameTime(0.0),
+    m_maxTraceEvents(DefaultMaxTraceEvents),
+    m_lock(new LockImpl())
+{
+}
+
+
+Profiler::~Profiler()
+{
+    delete m_lock;
+}
+
+
+/** Get the profiler shared by all instrumented code.
+  */
+Profiler*
+Profiler::instance()
+{
+    static Profiler profiler;
+    return &profiler;
+}
+
+
+/** Enable or disable collection of per-frame scope statistics. Statistics
+  * are collected between calls to beginFrame() and endFrame().
+  */
+void
+Profiler::setFrameStatisticsEnabled(bool enable)
+{
+    lock();
+    m_frameStatisticsEnabled = enable;
+    m_currentFrameScopes.clear();
+    m_lastFrameStatistics.clear();
+    updateEnabled();
+    unlock();
+}
+
+
+/** Start or stop recording a trace. Starting a trace discards any events
+  * from a previous trace.
+  */
+void
+Profiler::setTracingEnabled(bool enable)
+{
+    lock();
+    if (enable && !m_tracingEnabled)
+    {
+        m_traceEvents.clear();
+    }
+    m_tracingEnabled = enable;
+    updateEnabled();
+    unlock();
+}
+
+
+void
+Profiler::updateEnabled()
+{
+    s_enabled = m_frameStatisticsEnabled || m_tracingEnabled;
+}
+
+
+/** Mark the start of a frame.
+  */
+void
+Profiler::beginFrame()
+{
+    if (!s_enabled)
+    {
+        return;
+    }
+
+    lock();
+    m_frameStartTime = Stopwatch::currentTime();
+    m_currentFrameScopes.clear();
+    unlock();
+}
+
+
+/** Mark the end of a frame. The statistics for the frame become available
+  * through lastFrameStatistics(), and the frame is added to the trace.
+  */
+void
+Profiler::endFrame()
+{
+    if (!s_enabled)
+    {
+        return;
+    }
+
+    lock();
+
+    double now = Stopwatch::currentTime();
+    m_lastFrameTime = now - m_frameStartTime;
+
+    if (m_tracingEnabled)
+    {
+        addTraceEvent("Frame", FrameEvent, m_frameStartTime, m_lastFrameTime);
+    }
+
+    if (m_frameStatisticsEnabled)
+    {
+        m_lastFrameStatistics.clear();
+        for (ScopeAccumulatorTable::const_iterator iter = m_currentFrameScopes.begin(); iter != m_currentFrameScopes.end(); ++iter)
+        {
+            ScopeStatistics stats;
+            stats.name = iter->first;
+            stats.totalTime = iter->second.totalTime;
+            stats.maxTime = iter->second.maxTime;
+            stats.callCount = iter->second.callCount;
+            m_lastFrameStatistics.push_back(stats);
+        }
+        sort(m_lastFrameStatistics.begin(), m_lastFrameStatistics.end(), scopeTimePredicate);
+
+        m_lastCounterValues.clear();
+        for (CounterTable::const_iterator iter = m_counters.begin(); iter != m_counters.end(); ++iter)
+        {
+            CounterValue counter;
+            counter.name = iter->first;
+            counter.value = iter->second;
+            m_lastCounterValues.push_back(counter);
+        }
+    }
+
+    m_currentFrameScopes.clear();
+
+    unlock();
+}
+
+
+/** Record the execution of a scope. This is normally called by ProfileScope.
+  *
+  * \param name name of the scope
+  * \param startTime start time as returned by Stopwatch::currentTime()
+  * \param duration duration in seconds
+  */
+void
+Profiler::recordScope(const char* name, double startTime, double duration)
+{
+    lock();
+
+    if (m_frameStatisticsEnabled)
+    {
+        ScopeAccumulatorTable::iterator iter = m_currentFrameScopes.find(name);
+        if (iter == m_currentFrameScopes.end())
+        {
+            ScopeAccumulator acc;
+            acc.totalTime = duration;
+            acc.maxTime = duration;
+            acc.callCount = 1;
+            m_currentFrameScopes[name] = acc;
+        }
+        else
+        {
+            iter->second.totalTime += duration;
+            iter->second.maxTime = max(iter->second.maxTime, duration);
+            iter->second.callCount++;
+        }
+    }
+
+    if (m_tracingEnabled)
+    {
+        addTraceEvent(name, ScopeEvent, startTime, duration);
+    }
+
+    unlock();
+}
+
+
+/** Record the current value of a counter.
+  */
+void
+Profiler::recordCounter(const char* name, double value)
+{
+    lock();
+
+    m_counters[name] = value;
+    if (m_tracingEnabled)
+    {
+        addTraceEvent(name, CounterEvent, Stopwatch::currentTime(), value);
+    }
+
+    unlock();
+}
+
+
+// Map the platform's thread identifier to a small integer. Must be called
+// with the lock held.
+unsigned int
+Profiler::currentThreadId()
+{
+    unsigned long key = currentThreadKey();
+    map<unsigned long, unsigned int>::const_iterator iter = m_threadIds.find(key);
+    if (iter != m_threadIds.end())
+    {
+        return iter->second;
+    }
+
+    unsigned int id = (unsigned int) m_threadIds.size() + 1;
+    m_threadIds[key] = id;
+    return id;
+}
+
+
+void
+Profiler::addTraceEvent(const char* name, EventType type, double timestamp, double value)
+{
+    if (m_traceEvents.size() < m_maxTraceEvents)
+    {
+        TraceEvent event;
+        event.name = name;
+        event.type = type;
+        event.threadId = currentThreadId();
+        event.timestamp = timestamp;
+        event.value = value;
+        m_traceEvents.push_back(event);
+    }
+}
+
+
+/** Set the maximum number of events kept in the trace buffer.
+  */
+void
+Profiler::setMaxTraceEvents(unsigned int maxEvents)
+{
+    lock();
+    m_maxTraceEvents = maxEvents;
+    unlock();
+}
+
+
+/** Discard all recorded trace events.
+  */
+void
+Profiler::clearTrace()
+{
+    lock();
+    m_traceEvents.clear();
+    unlock();
+}
+
+
+/** Write the recorded trace in the Chrome trace event format. Scopes are
+  * written as complete ('X') events, counters as counter ('C') events, and
+  * frames as complete events on a separate track. Timestamps are in
+  * microseconds from the creation of the profiler.
+  *
+  * \return true if the trace was written successfully
+  */
+bool
+Profiler::writeChromeTrace(ostream& out)
+{
+    lock();
+
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"VESTA\"}}";
+
+    const unsigned int FrameTrackId = 0;
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << FrameTrackId << ",\"args\":{\"name\":\"Frames\"}}";
+
+    out.precision(12);
+    for (vector<TraceEvent>::const_iterator iter = m_traceEvents.begin(); iter != m_traceEvents.end(); ++iter)
+    {
+        double ts = (iter->timestamp - m_startTime) * 1.0e6;
+
+        out << ",\n{\"name\":";
+        writeJsonString(out, iter->name);
+        switch (iter->type)
+        {
+        case ScopeEvent:
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << iter->threadId << ",\"ts\":" << ts << ",\"dur\":" << iter->value * 1.0e6 << "}";
+            break;
+        case FrameEvent:
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << FrameTrackId << ",\"ts\":" << ts << ",\"dur\":" << iter->value * 1.0e6 << "}";
+            break;
+        case CounterEvent:
+            out << ",\"ph\":\"C\",\"pid\":1,\"ts\":" << ts << ",\"args\":{\"value\":" << iter->value << "}}";
+            break;
+        }
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    unlock();
+
+    return out.good();
+}
@@ -0,0 +1,256 @@
+/*
+ * $Revision: 223 $ $Date: 2010-03-30 05:44:44 -0700 (Tue, 30 Mar 2010) $
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_PROFILER_H_
+#define _VESTA_PROFILER_H_
+
+#include "Stopwatch.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+
+
+namespace vesta
+{
+
+/** Profiler collects timings of named code scopes and the values of named
+  * counters. Instrumented code uses the VESTA_PROFILE_SCOPE and
+  * VESTA_PROFILE_COUNTER macros. When the profiler is disabled (the default),
+  * each instrumentation point costs a single test of a static flag; defining
+  * VESTA_NO_PROFILING removes the instrumentation entirely.
+  *
+  * The profiler has two independent outputs:
+  * \list
+  * \li Frame statistics: the total time and call count of every scope during
+  *     the most recently completed frame, suitable for an on-screen overlay.
+  * \li A trace: every scope and counter sample with its timestamp, which can
+  *     be written as a Chrome trace event file and opened in chrome://tracing
+  *     or Perfetto.
+  * \endlist
+  *
+  * Names passed to the profiler must be string literals (or otherwise remain
+  * valid for the lifetime of the profiler); only the pointers are stored.
+  * Scopes may be recorded from any thread.
+  */
+class Profiler
+{
+public:
+    struct ScopeStatistics
+    {
+        const char* name;
+        double totalTime;
+        double maxTime;
+        unsigned int callCount;
+    };
+
+    struct CounterValue
+    {
+        const char* name;
+        double value;
+    };
+
+    static Profiler* instance();
+
+    /** Return true if either frame statistics or tracing is enabled. This
+      * is tested by the instrumentation macros before doing any other work.
+      */
+    static bool isEnabled()
+    {
+        return s_enabled;
+    }
+
+    /** Return true if per-frame statistics are being collected.
+      */
+    bool frameStatisticsEnabled() const
+    {
+        return m_frameStatisticsEnabled;
+    }
+
+    void setFrameStatisticsEnabled(bool enable);
+
+    /** Return true if a trace is being recorded.
+      */
+    bool tracingEnabled() const
+    {
+        return m_tracingEnabled;
+    }
+
+    void setTracingEnabled(bool enable);
+
+    void beginFrame();
+    void endFrame();
+
+    void recordScope(const char* name, double startTime, double duration);
+    void recordCounter(const char* name, double value);
+
+    /** Get statistics for all scopes recorded during the last complete frame,
+      * sorted by decreasing total time.
+      */
+    const std::vector<ScopeStatistics>& lastFrameStatistics() const
+    {
+        return m_lastFrameStatistics;
+    }
+
+    /** Get the most recent value of every counter.
+      */
+    const std::vector<CounterValue>& counterValues() const
+    {
+        return m_lastCounterValues;
+    }
+
+    /** Get the duration in seconds of the last complete frame.
+      */
+    double lastFrameTime() const
+    {
+        return m_lastFrameTime;
+    }
+
+    /** Get the number of events in the trace buffer.
+      */
+    unsigned int traceEventCount() const
+    {
+        return (unsigned int) m_traceEvents.size();
+    }
+
+    /** Get the maximum number of events kept in the trace buffer. Once the
+      * buffer is full, further events are dropped until it is cleared.
+      */
+    unsigned int maxTraceEvents() const
+    {
+        return m_maxTraceEvents;
+    }
+
+    void setMaxTraceEvents(unsigned int maxEvents);
+    void clearTrace();
+    bool writeChromeTrace(std::ostream& out);
+
+    static const unsigned int DefaultMaxTraceEvents = 1000000;
+
+private:
+    Profiler();
+    ~Profiler();
+
+    enum EventType
+    {
+        ScopeEvent,
+        CounterEvent,
+        FrameEvent,
+    };
+
+    struct TraceEvent
+    {
+        const char* name;
+        EventType type;
+        unsigned int threadId;
+        double timestamp;
+        double value;  // duration for scopes, value for counters
+    };
+
+    struct ScopeAccumulator
+    {
+        double totalTime;
+        double maxTime;
+        unsigned int callCount;
+    };
+
+    // Identical names in different modules aren't guaranteed to share the
+    // same address, so names are compared by value.
+    struct NameLess
+    {
+        bool operator()(const char* a, const char* b) const;
+    };
+
+    typedef std::map<const char*, ScopeAccumulator, NameLess> ScopeAccumulatorTable;
+    typedef std::map<const char*, double, NameLess> CounterTable;
+
+    void updateEnabled();
+    unsigned int currentThreadId();
+    void addTraceEvent(const char* name, EventType type, double timestamp, double value);
+    void lock();
+    void unlock();
+
+private:
+    static bool s_enabled;
+
+    bool m_frameStatisticsEnabled;
+    bool m_tracingEnabled;
+    double m_startTime;
+    double m_frameStartTime;
+    double m_lastFrameTime;
+
+    ScopeAccumulatorTable m_currentFrameScopes;
+    CounterTable m_counters;
+    std::vector<ScopeStatistics> m_lastFrameStatistics;
+    std::vector<CounterValue> m_lastCounterValues;
+
+    std::vector<TraceEvent> m_traceEvents;
+    unsigned int m_maxTraceEvents;
+    std::map<unsigned long, unsigned int> m_threadIds;
+
+    struct LockImpl;
+    LockImpl* m_lock;
+};
+
+
+/** ProfileScope records the time between its construction and destruction
+  * (or the call to end()) with the profiler. Use the VESTA_PROFILE_SCOPE
+  * macro rather than creating ProfileScope objects directly.
+  */
+class ProfileScope
+{
+public:
+    ProfileScope(const char* name) :
+        m_name(Profiler::isEnabled() ? name : 0),
+        m_startTime(0.0)
+    {
+        if (m_name)
+        {
+            m_startTime = Stopwatch::currentTime();
+        }
+    }
+
+    ~ProfileScope()
+    {
+        end();
+    }
+
+    /** Stop timing before the end of the enclosing block.
+      */
+    void end()
+    {
+        if (m_name)
+        {
+            Profiler::instance()->recordScope(m_name, m_startTime, Stopwatch::currentTime() - m_startTime);
+            m_name = 0;
+        }
+    }
+
+private:
+    const char* m_name;
+    double m_startTime;
+};
+
+}
+
+
+#ifdef VESTA_NO_PROFILING
+#define VESTA_PROFILE_SCOPE(name)
+#define VESTA_PROFILE_COUNTER(name, value)
+#else
+#define VESTA_PROFILE_CONCAT_(a, b) a##b
+#define VESTA_PROFILE_CONCAT(a, b) VESTA_PROFILE_CONCAT_(a, b)
+#define VESTA_PROFILE_SCOPE(name) \
+    vesta::ProfileScope VESTA_PROFILE_CONCAT(vestaProfileScope_, __LINE__)(name)
+#define VESTA_PROFILE_COUNTER(name, value) \
+    if (vesta::Profiler::isEnabled()) vesta::Profiler::instance()->recordCounter(name, double(value)); else (void) 0
+#endif
+
+#endif // _VESTA_PROFILER_H_
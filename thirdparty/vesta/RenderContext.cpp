@@ -13,6 +13,7 @@
 #include "TextureMap.h"
 #include "Material.h"
 #include "TextureFont.h"
+#include "LabelPlacement.h"
 #include "OGLHeaders.h"
 #include "ShaderBuilder.h"
 #include "VertexBuffer.h"
@@ -24,6 +25,7 @@
 #include <vector>
 #include <cmath>
 #include <cassert>
+#include <algorithm>
 
 using namespace vesta;
 using namespace Eigen;
@@ -236,9 +238,16 @@ RenderContext::RenderContext(ShaderCapability capability) :
     m_vertexStream(NULL),
     m_vertexStreamFloats(0),
     m_shaderCapability(capability),
+    m_currentShader(NULL),
+    m_boundShader(NULL),
     m_shaderStateCurrent(false),
     m_modelViewMatrixCurrent(false),
-    m_rendererOutput(FragmentColor)
+    m_rendererOutput(FragmentColor),
+    m_logDepthEnabled(false),
+    m_logDepthScale(1.0f),
+    m_logDepthFactor(1.0f),
+    m_labelPlacement(NULL),
+    m_textLayoutCache(new TextLayoutCache())
 {
     m_matrixStack[0] = Matrix4f::Identity();
 
@@ -477,6 +486,23 @@ RenderContext::setProjection(const PlanarProjection& projection)
 }
 
 
+#ifdef VESTA_OGLES2
+static const GLenum HalfFloatType = GL_HALF_FLOAT_OES;
+#else
+static const GLenum HalfFloatType = GL_HALF_FLOAT;
+#endif
+
+// Half precision vertex attributes are used for quantized texture coordinates
+static bool HalfFloatVertexSupported()
+{
+#ifdef VESTA_OGLES2
+    return true;
+#else
+    return GLEW_ARB_half_float_vertex || GLEW_VERSION_3_0;
+#endif
+}
+
+
 void
 RenderContext::bindVertexArray(const VertexArray* vertexArray)
 {
@@ -499,22 +525,28 @@ RenderContext::bindVertexArray(const VertexSpec& spec, const void* vertexData, u
     if (positionIndex == VertexSpec::InvalidAttribute)
         return;
 
-    // Position must be float3
+    // Position must be float3 or quantized. The transformation that maps
+    // quantized positions to model space must be applied by the caller
+    // (see VertexArray::positionScale)
     VertexAttribute positionAttr = spec.attribute(positionIndex);
-    if (positionAttr.format() != VertexAttribute::Float3)
+    GLenum positionType = GL_FLOAT;
+    if (positionAttr.format() == VertexAttribute::Short4)
+        positionType = GL_SHORT;
+    else if (positionAttr.format() != VertexAttribute::Float3)
         return;
 
 #ifdef VESTA_OGLES2
     glEnableVertexAttribArray(ShaderBuilder::PositionAttributeLocation);
-    glVertexAttribPointer(ShaderBuilder::PositionAttributeLocation, 3, GL_FLOAT, GL_FALSE, stride,
+    glVertexAttribPointer(ShaderBuilder::PositionAttributeLocation, 3, positionType, GL_FALSE, stride,
                           data + spec.attributeOffset(positionIndex));
 #else
     glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, stride, data + spec.attributeOffset(positionIndex));
+    glVertexPointer(3, positionType, stride, data + spec.attributeOffset(positionIndex));
 #endif
 
     // Normals
     m_vertexInfo.hasNormals = false;
+    m_vertexInfo.hasPackedNormals = false;
     if (normalIndex != VertexSpec::InvalidAttribute)
     {
         VertexAttribute normalAttr = spec.attribute(normalIndex);
@@ -530,9 +562,24 @@ RenderContext::bindVertexArray(const VertexSpec& spec, const void* vertexData, u
 #endif
             m_vertexInfo.hasNormals = true;
         }
+        else if (normalAttr.format() == VertexAttribute::Short2 && m_shaderCapability != FixedFunction)
+        {
+            // Octahedral normals are decoded in the vertex shader
+#ifdef VESTA_OGLES2
+            glEnableVertexAttribArray(ShaderBuilder::PackedNormalAttributeLocation);
+            glVertexAttribPointer(ShaderBuilder::PackedNormalAttributeLocation, 2, GL_SHORT, GL_TRUE, stride,
+                                  data + spec.attributeOffset(normalIndex));
+#else
+            glEnableVertexAttribArrayARB(ShaderBuilder::PackedNormalAttributeLocation);
+            glVertexAttribPointerARB(ShaderBuilder::PackedNormalAttributeLocation,
+                                     2, GL_SHORT, GL_TRUE, stride, data + spec.attributeOffset(normalIndex));
+#endif
+            m_vertexInfo.hasNormals = true;
+            m_vertexInfo.hasPackedNormals = true;
+        }
     }
 
-    if (!m_vertexInfo.hasNormals)
+    if (!m_vertexInfo.hasNormals || m_vertexInfo.hasPackedNormals)
     {
 #ifdef VESTA_OGLES2
         glDisableVertexAttribArray(ShaderBuilder::NormalAttributeLocation);
@@ -541,18 +588,32 @@ RenderContext::bindVertexArray(const VertexSpec& spec, const void* vertexData, u
 #endif
     }
 
+    if (!m_vertexInfo.hasPackedNormals && m_shaderCapability != FixedFunction)
+    {
+#ifdef VESTA_OGLES2
+        glDisableVertexAttribArray(ShaderBuilder::PackedNormalAttributeLocation);
+#else
+        glDisableVertexAttribArrayARB(ShaderBuilder::PackedNormalAttributeLocation);
+#endif
+    }
+
     // Texture coordinates
     m_vertexInfo.hasTexCoords = false;
     if (texCoordIndex != VertexSpec::InvalidAttribute)
     {
         VertexAttribute texCoordAttr = spec.attribute(texCoordIndex);
         unsigned int formatSize = 0;
+        GLenum formatType = GL_FLOAT;
         switch (texCoordAttr.format())
         {
             case VertexAttribute::Float1: formatSize = 1; break;
             case VertexAttribute::Float2: formatSize = 2; break;
             case VertexAttribute::Float3: formatSize = 3; break;
             case VertexAttribute::Float4: formatSize = 4; break;
+            case VertexAttribute::Half2:
+                formatSize = HalfFloatVertexSupported() ? 2 : 0;
+                formatType = HalfFloatType;
+                break;
             default: formatSize = 0; break;
         }
 
@@ -561,11 +622,11 @@ RenderContext::bindVertexArray(const VertexSpec& spec, const void* vertexData, u
 #ifdef VESTA_OGLES2
             glEnableVertexAttribArray(ShaderBuilder::TexCoordAttributeLocation);
             glVertexAttribPointer(ShaderBuilder::TexCoordAttributeLocation,
-                                  formatSize, GL_FLOAT, GL_FALSE, stride,
+                                  formatSize, formatType, GL_FALSE, stride,
                                   data + spec.attributeOffset(texCoordIndex));
 #else
             glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-            glTexCoordPointer(formatSize, GL_FLOAT, stride, data + spec.attributeOffset(texCoordIndex));
+            glTexCoordPointer(formatSize, formatType, stride, data + spec.attributeOffset(texCoordIndex));
 #endif
             m_vertexInfo.hasTexCoords = true;
         }
@@ -625,17 +686,24 @@ RenderContext::bindVertexArray(const VertexSpec& spec, const void* vertexData, u
     {
         if (tangentIndex != VertexSpec::InvalidAttribute)
         {
+            // Packed tangents are only usable along with packed normals; the
+            // shader decodes both or neither.
             VertexAttribute tangentAttr = spec.attribute(tangentIndex);
-            if (tangentAttr.format() == VertexAttribute::Float3)
+            bool packed = tangentAttr.format() == VertexAttribute::Short2;
+            bool usable = m_vertexInfo.hasPackedNormals ? packed : tangentAttr.format() == VertexAttribute::Float3;
+            if (usable)
             {
+                GLint size = packed ? 2 : 3;
+                GLenum type = packed ? GL_SHORT : GL_FLOAT;
+                GLboolean normalized = packed ? GL_TRUE : GL_FALSE;
 #ifdef VESTA_OGLES2
                 glEnableVertexAttribArray(ShaderBuilder::TangentAttributeLocation);
-                glVertexAttribPointer(ShaderBuilder::TangentAttributeLocation, 3, GL_FLOAT, GL_FALSE, stride,
+                glVertexAttribPointer(ShaderBuilder::TangentAttributeLocation, size, type, normalized, stride,
                                       data + spec.attributeOffset(tangentIndex));
 #else
                 glEnableVertexAttribArrayARB(ShaderBuilder::TangentAttributeLocation);
                 glVertexAttribPointerARB(ShaderBuilder::TangentAttributeLocation,
-                                         3, GL_FLOAT, GL_FALSE, stride, data + spec.attributeOffset(tangentIndex));
+                                         size, type, normalized, stride, data + spec.attributeOffset(tangentIndex));
 #endif
                 m_vertexInfo.hasTangents = true;
             }
@@ -700,6 +768,7 @@ RenderContext::unbindVertexArray()
     glDisableVertexAttribArray(ShaderBuilder::TexCoordAttributeLocation);
     glDisableVertexAttribArray(ShaderBuilder::ColorAttributeLocation);
     glDisableVertexAttribArray(ShaderBuilder::TangentAttributeLocation);
+    glDisableVertexAttribArray(ShaderBuilder::PackedNormalAttributeLocation);
 #else
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_NORMAL_ARRAY);
@@ -708,10 +777,12 @@ RenderContext::unbindVertexArray()
     if (m_shaderCapability != FixedFunction)
     {
         glDisableVertexAttribArrayARB(ShaderBuilder::TangentAttributeLocation);
+        glDisableVertexAttribArrayARB(ShaderBuilder::PackedNormalAttributeLocation);
     }
 #endif
     m_vertexInfo.hasColors = false;
     m_vertexInfo.hasNormals = false;
+    m_vertexInfo.hasPackedNormals = false;
     m_vertexInfo.hasTexCoords = false;
     m_vertexInfo.hasTangents = false;
 }
@@ -745,6 +816,8 @@ RenderContext::drawPrimitives(const PrimitiveBatch& batch)
     updateShaderState();
     updateShaderTransformConstants();
 
+    ++m_statistics.drawCalls;
+
     GLenum oglPrimitiveType = OGLPrimitiveType(batch.primitiveType());
     if (batch.isIndexed())
     {
@@ -771,6 +844,8 @@ RenderContext::drawPrimitives(PrimitiveBatch::PrimitiveType type,
     updateShaderState();
     updateShaderTransformConstants();
 
+    ++m_statistics.drawCalls;
+
     GLenum oglPrimitiveType = OGLPrimitiveType(type);
     glDrawElements(oglPrimitiveType,
                    indexCount,
@@ -814,6 +889,7 @@ RenderContext::enableCustomShader(GLShaderProgram* customShader)
         }
 
         m_customShader = customShader;
+        m_boundShader = NULL;
         invalidateShaderState();
     }
 }
@@ -960,6 +1036,11 @@ computeShaderInfo(const Material* material,
         shaderInfo.setVertexColors(true);
     }
 
+    if (vertexInfo->hasPackedNormals)
+    {
+        shaderInfo.setPackedNormals(true);
+    }
+
     bool hasSpecular = false;
     bool lightingEnabled = true;
 
@@ -1104,10 +1185,13 @@ RenderContext::setShaderMaterial(const Material* material)
         return;
     }
 
-    // TODO: For efficiency, we should cache the indexes of uniform variables used
-    // in shaders.
+    // Uniform locations are cached by the shader program, which also skips
+    // uploads of values that haven't changed since the last time the program
+    // was used. Meshes that rebind the same material for each submesh are thus
+    // fairly cheap.
 
     ShaderInfo shaderInfo = computeShaderInfo(material, &m_vertexInfo, m_environment);
+    shaderInfo.setLogDepth(m_logDepthEnabled);
     GLShaderProgram* shader = ShaderBuilder::GLSL()->getShader(shaderInfo);
     if (!shader)
     {
@@ -1121,7 +1205,14 @@ RenderContext::setShaderMaterial(const Material* material)
         invalidateModelViewMatrix();
     }
 
-    shader->bind();
+    if (shader != m_boundShader)
+    {
+        shader->bind();
+        m_boundShader = shader;
+        ++m_statistics.shaderSwitches;
+    }
+    ++m_statistics.materialUpdates;
+
     m_currentShaderInfo = shaderInfo;
     m_currentShader = shader;
 
@@ -1139,6 +1230,12 @@ RenderContext::setShaderMaterial(const Material* material)
     }
 
     shader->setConstant("opacity", material->opacity());
+    if (shaderInfo.hasLogDepth())
+    {
+        shader->setConstant("vesta_LogDepthScale", m_logDepthScale);
+        shader->setConstant("vesta_LogDepthFactor", m_logDepthFactor);
+    }
+
     if (shaderInfo.hasTexture(ShaderInfo::DiffuseTexture))
     {
         glBindTexture(GL_TEXTURE_2D, material->baseTexture()->id());
@@ -1352,6 +1449,13 @@ RenderContext::updateShaderState()
                 if (m_rendererOutput == FragmentColor)
                 {
                     m_customShader->bind();
+                    m_boundShader = NULL;
+
+                    // Custom shaders may opt in to logarithmic depth by declaring
+                    // the same uniforms as the generated shaders. A factor of zero
+                    // tells the shader to write the standard depth.
+                    m_customShader->setConstant("vesta_LogDepthScale", m_logDepthScale);
+                    m_customShader->setConstant("vesta_LogDepthFactor", m_logDepthEnabled ? m_logDepthFactor : 0.0f);
                 }
             }
             else
@@ -1454,6 +1558,7 @@ RenderContext::setVertexInfo(const VertexSpec& spec)
 {
     m_vertexInfo.hasColors = false;
     m_vertexInfo.hasNormals = false;
+    m_vertexInfo.hasPackedNormals = false;
     m_vertexInfo.hasTangents = false;
     m_vertexInfo.hasTexCoords = false;
 
@@ -1469,6 +1574,11 @@ RenderContext::setVertexInfo(const VertexSpec& spec)
         {
             m_vertexInfo.hasNormals = true;
         }
+        else if (normalAttr.format() == VertexAttribute::Short2 && m_shaderCapability != FixedFunction)
+        {
+            m_vertexInfo.hasNormals = true;
+            m_vertexInfo.hasPackedNormals = true;
+        }
     }
 
     if (texCoordIndex != VertexSpec::InvalidAttribute)
@@ -1481,6 +1591,7 @@ RenderContext::setVertexInfo(const VertexSpec& spec)
             case VertexAttribute::Float2: formatSize = 2; break;
             case VertexAttribute::Float3: formatSize = 3; break;
             case VertexAttribute::Float4: formatSize = 4; break;
+            case VertexAttribute::Half2: formatSize = HalfFloatVertexSupported() ? 2 : 0; break;
             default: formatSize = 0; break;
         }
 
@@ -1512,7 +1623,8 @@ RenderContext::setVertexInfo(const VertexSpec& spec)
 
     if (tangentIndex != VertexSpec::InvalidAttribute && m_shaderCapability != FixedFunction)
     {
-        if (spec.attribute(tangentIndex).format() == VertexAttribute::Float3)
+        VertexAttribute::Format tangentFormat = spec.attribute(tangentIndex).format();
+        if (m_vertexInfo.hasPackedNormals ? tangentFormat == VertexAttribute::Short2 : tangentFormat == VertexAttribute::Float3)
         {
             m_vertexInfo.hasTangents = true;
         }
@@ -1822,6 +1934,12 @@ RenderContext::drawEncodedText(const Vector3f& position,
         }
     }
 
+    const TextLayout* layout = m_textLayoutCache->layout(font, text, encoding);
+    if (layout->vertexCount == 0)
+    {
+        return;
+    }
+
     Material material;
     material.setDiffuse(color);
     material.setOpacity(opacity);
@@ -1844,66 +1962,112 @@ RenderContext::drawEncodedText(const Vector3f& position,
     pushModelView();
     identityModelView();
 
-    // Slight offset to keep texel centers from landing right on
-    // pixel boundaries and causing poor text quality. We'll also
-    // set the z position of the text so that it's hidden by
-    // any objects in front of it.
-    translateModelView(position + Vector3f(0.125f, 0.125f, -ndc.z()));
+    // The cached layout starts at the origin, so the text is positioned entirely
+    // with the modelview matrix. The start position is rounded to a whole pixel,
+    // with a slight offset to keep texel centers from landing right on pixel
+    // boundaries and causing poor text quality. We'll also set the z position of
+    // the text so that it's hidden by any objects in front of it.
+    Vector3f textOrigin(std::floor(p.x() * m_viewportWidth + 0.5f) + 0.125f,
+                        std::floor(p.y() * m_viewportHeight + 0.5f) + 0.125f,
+                        -ndc.z());
+    translateModelView(position + textOrigin);
 
-#ifdef VESTA_NO_IMMEDIATE_MODE_3D
-#ifndef USE_VERTEX_BUFFER_OBJECT_FOR_TEXT
-    char vertexData[4096];
-    unsigned int vertexCount = 0;
-    font->renderStringToBuffer(text,
-                               Vector2f(std::floor(p.x() * m_viewportWidth + 0.5f), std::floor(p.y() * m_viewportHeight + 0.5f)),
-                               encoding,
-                               vertexData,
-                               sizeof(vertexData),
-                               &vertexCount);
-    if (vertexCount > 0)
-    {
-        const VertexSpec& vspec = VertexSpec::PositionTex;
-        bindVertexArray(vspec, vertexData, vspec.size());
-        drawPrimitives(PrimitiveBatch(PrimitiveBatch::Triangles, vertexCount / 3, 0));
-        unbindVertexArray();
-    }
-#else
+    const VertexSpec& vspec = VertexSpec::PositionTex;
+
+#ifdef USE_VERTEX_BUFFER_OBJECT_FOR_TEXT
     // This version uses the vertex stream buffer. Unfortunately, on some systems this is is slower
     // than simply writing to a system memory array. With the PowerVR driver, there is a dramatic
     // slowdown when more than eight labels are onscreen. This is almost certainly due to exhausting
     // the vertex buffer renaming chain. When several small primitive batches can't be aggregated, it is
     // better to let the driver copy from system memory.
-    char* vertexData = reinterpret_cast<char*>(vertexStreamBuffer()->mapWriteOnly());
-    if (vertexData)
-    {
-        unsigned int vertexCount = 0;
-        font->renderStringToBuffer(text,
-                                   Vector2f(std::floor(p.x() * m_viewportWidth + 0.5f), std::floor(p.y() * m_viewportHeight + 0.5f)),
-                                   encoding,
-                                   vertexData,
-                                   vertexStreamBuffer()->size(),
-                                   &vertexCount);
- 
-        vertexStreamBuffer()->unmap();
-        if (vertexCount > 0)
+    if (layout->vertexCount * vspec.size() <= vertexStreamBuffer()->size())
+    {
+        char* vertexData = reinterpret_cast<char*>(vertexStreamBuffer()->mapWriteOnly());
+        if (vertexData)
         {
-            const VertexSpec& vspec = VertexSpec::PositionTex;
+            std::copy(layout->vertices.begin(), layout->vertices.end(), reinterpret_cast<float*>(vertexData));
+            vertexStreamBuffer()->unmap();
+
             bindVertexBuffer(vspec, vertexStreamBuffer(), vspec.size());
-            drawPrimitives(PrimitiveBatch(PrimitiveBatch::Triangles, vertexCount / 3, 0));
+            drawPrimitives(PrimitiveBatch(PrimitiveBatch::Triangles, layout->vertexCount / 3, 0));
             unbindVertexBuffer();
         }
     }
+#else
+    bindVertexArray(vspec, &layout->vertices[0], vspec.size());
+    drawPrimitives(PrimitiveBatch(PrimitiveBatch::Triangles, layout->vertexCount / 3, 0));
+    unbindVertexArray();
 #endif // USE_VERTEX_BUFFER_OBJECT_FOR_TEXT
-    
-#else // VESTA_NO_IMMEDIATE_MODE_3D
-    font->renderEncodedString(text, Vector2f(std::floor(p.x() * m_viewportWidth + 0.5f), std::floor(p.y() * m_viewportHeight + 0.5f)), encoding);
-#endif    
 
     popModelView();
     popProjection();
 }
 
 
+/** Get the layout of a string of text in the specified font. Layouts are
+  * cached, so this is inexpensive for strings that are drawn every frame. The
+  * width and ascent of the layout are useful for positioning labels.
+  *
+  * \param font the font to use; the default font is used when font is NULL
+  * \return the text layout, or NULL if no font was specified and there is no default font
+  */
+const TextLayout*
+RenderContext::textLayout(const std::string& text,
+                          const TextureFont* font,
+                          TextureFont::Encoding encoding)
+{
+    if (!font)
+    {
+        font = m_defaultFont.ptr();
+    }
+
+    return m_textLayoutCache->layout(font, text, encoding);
+}
+
+
+/** Submit a label to the label placement service. The label rectangle is given
+  * as pixel offsets from the screen position of the current modelview origin, which
+  * is the same anchor point used by drawText(). This is called from
+  * Geometry::submitLabels(); it does nothing when no label placement service is set.
+  *
+  * \param owner the object that draws the label
+  * \param index identifies the label when the owner draws more than one
+  * \param minOffset offset in pixels of the lower left corner of the label
+  * \param maxOffset offset in pixels of the upper right corner of the label
+  * \param priority labels with higher priority are placed in preference to others
+  */
+void
+RenderContext::submitLabel(const void* owner,
+                           unsigned int index,
+                           const Vector2f& minOffset,
+                           const Vector2f& maxOffset,
+                           float priority)
+{
+    if (!m_labelPlacement)
+    {
+        return;
+    }
+
+    Vector3f origin = m_matrixStack[m_modelViewStackDepth].translation();
+
+    // Project the label origin into viewport coordinates exactly as drawEncodedText() does.
+    Vector3f ndc = m_projectionStack[m_projectionStackDepth] * origin;
+    Vector2f p((ndc.x() + 1.0f) * 0.5f * m_viewportWidth, (ndc.y() + 1.0f) * 0.5f * m_viewportHeight);
+
+    m_labelPlacement->submit(owner, index, p + minOffset, p + maxOffset, priority, origin.norm());
+}
+
+
+/** Return true if a label submitted with submitLabel() should be drawn. This
+  * is always true when no label placement service is set.
+  */
+bool
+RenderContext::isLabelPlaced(const void* owner, unsigned int index) const
+{
+    return !m_labelPlacement || m_labelPlacement->isPlaced(owner, index);
+}
+
+
 void
 RenderContext::drawCone(float apexAngle,
                         const Vector3f& axis,
@@ -2245,6 +2409,7 @@ RenderContext::unbindShader()
         glUseProgramObjectARB(0);
 #endif
     }
+    m_boundShader = NULL;
 }
 
 
@@ -2259,6 +2424,90 @@ RenderContext::rendererOutput() const
 }
 
 
+/** Get counts of draw calls, shader switches, and uniform uploads since the
+  * last call to resetStatistics().
+  */
+RenderContext::RenderStatistics
+RenderContext::statistics() const
+{
+    RenderStatistics stats = m_statistics;
+    stats.uniformUploads = GLShaderProgram::uniformUploadCount();
+    stats.redundantUniforms = GLShaderProgram::redundantUniformCount();
+    return stats;
+}
+
+
+/** Reset all render statistics to zero.
+  */
+void
+RenderContext::resetStatistics()
+{
+    m_statistics = RenderStatistics();
+    GLShaderProgram::resetUniformStatistics();
+}
+
+
+/** Enable or disable logarithmic depth. When enabled, the generated
+  * shaders write a depth value proportional to the logarithm of the distance
+  * from the camera instead of the usual perspective depth. The whole range
+  * set with setLogarithmicDepthRange() then fits in a single depth buffer
+  * range with roughly constant relative precision.
+  *
+  * Logarithmic depth only affects generated shaders and custom shaders that
+  * declare the vesta_LogDepthScale and vesta_LogDepthFactor uniforms. It should
+  * be disabled when rendering shadow maps, which use a parallel projection.
+  */
+void
+RenderContext::setLogarithmicDepth(bool enable)
+{
+    enable = enable && isLogarithmicDepthSupported();
+    if (enable != m_logDepthEnabled)
+    {
+        m_logDepthEnabled = enable;
+        invalidateShaderState();
+    }
+}
+
+
+/** Set the range of distances mapped into the depth buffer when logarithmic
+  * depth is enabled. The near distance determines the scale of the region with
+  * approximately linear depth; precision beyond it is constant relative to
+  * the distance.
+  */
+void
+RenderContext::setLogarithmicDepthRange(float nearDistance, float farDistance)
+{
+    m_logDepthScale = 1.0f / std::max(nearDistance, 1.0e-12f);
+    m_logDepthFactor = 1.0f / (std::log(farDistance * m_logDepthScale + 1.0f) / std::log(2.0f));
+    invalidateShaderState();
+}
+
+
+/** Compute the depth buffer value that the generated shaders write for a
+  * point at the specified distance from the camera when logarithmic depth
+  * is enabled.
+  */
+float
+RenderContext::logarithmicDepthValue(float distance) const
+{
+    return std::log(1.0f + std::max(distance, 0.0f) * m_logDepthScale) / std::log(2.0f) * m_logDepthFactor;
+}
+
+
+/** Return true if this render context can use logarithmic depth. Writing
+  * fragment depth requires GLSL shaders, and isn't available in OpenGL ES 2.0.
+  */
+bool
+RenderContext::isLogarithmicDepthSupported() const
+{
+#ifdef VESTA_OGLES2
+    return false;
+#else
+    return m_shaderCapability != FixedFunction;
+#endif
+}
+
+
 /** Set the current renderer output. The output must be one of:
   *   FragmentColor - render the usual pixel color
   *   CameraDistance - write the distance of the pixel from the camera (in the red channel)
@@ -2285,6 +2534,7 @@ RenderContext::setRendererOutput(RendererOutput output)
         if (output == CameraDistance && m_cameraDistanceShader.isValid())
         {
             m_cameraDistanceShader->bind();
+            m_boundShader = NULL;
         }
     }
 }
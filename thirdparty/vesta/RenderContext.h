@@ -17,6 +17,7 @@
 #include "ShaderInfo.h"
 #include "PlanarProjection.h"
 #include "TextureFont.h"
+#include "TextLayoutCache.h"
 #include "glhelp/GLVertexBuffer.h"
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -31,6 +32,7 @@ class ParticleBuffer;
 class VertexBuffer;
 class GLShaderProgram;
 class GLFramebuffer;
+class LabelPlacement;
 
 /** RenderContext provides an interface for state tracking and shader
   * setup. Vesta classes which need to do rendering should use RenderContext
@@ -347,6 +349,40 @@ public:
                     unsigned int subdivision);
     void drawParticles(ParticleEmitter* emitter, double clock);
 
+    const TextLayout* textLayout(const std::string& text,
+                                 const TextureFont* font,
+                                 TextureFont::Encoding encoding);
+
+    /** Get the cache of laid out strings used by drawText() and drawEncodedText().
+      */
+    TextLayoutCache* textLayoutCache() const
+    {
+        return m_textLayoutCache.ptr();
+    }
+
+    void submitLabel(const void* owner,
+                     unsigned int index,
+                     const Eigen::Vector2f& minOffset,
+                     const Eigen::Vector2f& maxOffset,
+                     float priority);
+    bool isLabelPlaced(const void* owner, unsigned int index) const;
+
+    /** Get the label placement service for the current view. This will be
+      * null when labels aren't being decluttered.
+      */
+    LabelPlacement* labelPlacement() const
+    {
+        return m_labelPlacement;
+    }
+
+    /** Set the label placement service for the current view. This is normally
+      * only called by UniverseRenderer.
+      */
+    void setLabelPlacement(LabelPlacement* labelPlacement)
+    {
+        m_labelPlacement = labelPlacement;
+    }
+
     /** Get the vertex stream buffer for the render context. This is useful
       * for drawing dynamic geometry.
       */
@@ -374,17 +410,60 @@ public:
         return m_shaderCapability;
     }
 
+    /** Return true if logarithmic depth is enabled for generated shaders.
+      */
+    bool logarithmicDepth() const
+    {
+        return m_logDepthEnabled;
+    }
+
+    void setLogarithmicDepth(bool enable);
+    void setLogarithmicDepthRange(float nearDistance, float farDistance);
+    float logarithmicDepthValue(float distance) const;
+    bool isLogarithmicDepthSupported() const;
+
+    /** RenderStatistics counts the work submitted to OpenGL since the
+      * last call to resetStatistics(). Uniform counts include uploads made
+      * by all shader programs, not just the ones used by this context.
+      */
+    struct RenderStatistics
+    {
+        RenderStatistics() :
+            drawCalls(0),
+            shaderSwitches(0),
+            materialUpdates(0),
+            uniformUploads(0),
+            redundantUniforms(0)
+        {}
+
+        /** Number of glDrawArrays and glDrawElements calls */
+        unsigned int drawCalls;
+        /** Number of times a different generated shader was bound */
+        unsigned int shaderSwitches;
+        /** Number of times material state was sent to a generated shader */
+        unsigned int materialUpdates;
+        /** Number of uniform values sent to OpenGL */
+        unsigned int uniformUploads;
+        /** Number of uniform updates skipped because the value was unchanged */
+        unsigned int redundantUniforms;
+    };
+
+    RenderStatistics statistics() const;
+    void resetStatistics();
+
 public:
     struct VertexInfo
     {
         VertexInfo() :
             hasNormals(false),
+            hasPackedNormals(false),
             hasTexCoords(false),
             hasTangents(false),
             hasColors(false)
         {}
 
         bool hasNormals;
+        bool hasPackedNormals;    // normals (and tangents) in octahedral encoding
         bool hasTexCoords;
         bool hasTangents;
         bool hasColors;
@@ -429,6 +508,7 @@ private:
     VertexInfo m_vertexInfo;
     ShaderInfo m_currentShaderInfo;
     GLShaderProgram* m_currentShader;
+    GLShaderProgram* m_boundShader;
     counted_ptr<GLShaderProgram> m_customShader;
     Material m_currentMaterial;
     Environment m_environment;
@@ -440,9 +520,17 @@ private:
     bool m_modelViewMatrixCurrent;
     RendererOutput m_rendererOutput;
 
+    RenderStatistics m_statistics;
+
+    bool m_logDepthEnabled;
+    float m_logDepthScale;
+    float m_logDepthFactor;
+
     static bool m_glInitialized;
 
     counted_ptr<vesta::TextureFont> m_defaultFont;
+    LabelPlacement* m_labelPlacement;
+    counted_ptr<TextLayoutCache> m_textLayoutCache;
 };
 
 }
@@ -0,0 +1,928 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "SensorCoverage.h"
+#include "Entity.h"
+#include "Intersect.h"
+#include "Units.h"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Number of rays cast around the edge of the sensor frustum to find the
+// extent of the footprint.
+static const unsigned int BoundaryRayCount = 48;
+
+// Number of observations at which a cell is drawn at full opacity
+static const unsigned int SaturationCount = 8;
+
+static const unsigned int MaxObservationCount = 0xffff;
+
+
+/** Create a new coverage grid for the specified sensor and attach it to the
+  * sensor. The default time step is 10 seconds, and at most 100 footprints
+  * are added by a single call to update(). Until a start time is set,
+  * incremental accumulation begins at the time passed to the first call to
+  * update().
+  */
+SensorCoverage::SensorCoverage(SensorFrustumGeometry* sensor,
+                               unsigned int longitudeCells,
+                               unsigned int latitudeCells) :
+    m_sensor(sensor),
+    m_longitudeCells(max(1u, longitudeCells)),
+    m_latitudeCells(max(1u, latitudeCells)),
+    m_timeStep(10.0),
+    m_startTime(0.0),
+    m_hasStartTime(false),
+    m_nextTime(0.0),
+    m_accumulatedTime(-m_timeStep),
+    m_lastUpdateTime(0.0),
+    m_hasLastUpdateTime(false),
+    m_maxStepsPerUpdate(100),
+    m_version(0),
+    m_rayX(BoundaryRayCount),
+    m_rayY(BoundaryRayCount),
+    m_rayZ(BoundaryRayCount),
+    m_rayDistance(BoundaryRayCount)
+{
+    if (sensor)
+    {
+        sensor->setCoverage(this);
+    }
+
+    m_counts.resize(m_longitudeCells * m_latitudeCells, 0);
+
+    // Cell centers are used for the footprint test; tabulate their sines
+    // and cosines once.
+    double lonStep = 2.0 * PI / m_longitudeCells;
+    for (unsigned int i = 0; i < m_longitudeCells; ++i)
+    {
+        double lon = -PI + (i + 0.5) * lonStep;
+        m_cosLongitude.push_back(cos(lon));
+        m_sinLongitude.push_back(sin(lon));
+    }
+
+    double latStep = PI / m_latitudeCells;
+    for (unsigned int i = 0; i < m_latitudeCells; ++i)
+    {
+        double lat = -PI / 2.0 + (i + 0.5) * latStep;
+        m_cosLatitude.push_back(cos(lat));
+        m_sinLatitude.push_back(sin(lat));
+    }
+}
+
+
+SensorCoverage::~SensorCoverage()
+{
+}
+
+
+/** Set the interval in seconds between sampled footprints. Smaller steps
+  * give a more continuous swath at a proportionally higher cost. The step
+  * should be short enough that consecutive footprints overlap.
+  */
+void
+SensorCoverage::setTimeStep(double seconds)
+{
+    if (seconds > 0.0 && seconds != m_timeStep)
+    {
+        m_timeStep = seconds;
+        clear();
+    }
+}
+
+
+/** Set the time at which incremental coverage accumulation starts. Any
+  * coverage already recorded is discarded.
+  */
+void
+SensorCoverage::setStartTime(double tdbSec)
+{
+    m_startTime = tdbSec;
+    m_hasStartTime = true;
+    clear();
+}
+
+
+/** Discard all recorded coverage. The next call to update() resumes at
+  * the start time.
+  */
+void
+SensorCoverage::clear()
+{
+    fill(m_counts.begin(), m_counts.end(), v_uint16(0));
+    m_nextTime = m_startTime;
+    m_accumulatedTime = m_startTime - m_timeStep;
+    ++m_version;
+}
+
+
+/** Add the footprints for every time step in the range [startTime, endTime].
+  * Unlike update(), the number of footprints is not limited; this is meant for
+  * computing the coverage over a time span in a single pass, e.g. for export.
+  * The state used by update() is not affected.
+  */
+void
+SensorCoverage::accumulate(double startTime, double endTime)
+{
+    unsigned int stepCount = (unsigned int) floor((endTime - startTime) / m_timeStep);
+    for (unsigned int i = 0; i <= stepCount; ++i)
+    {
+        addFootprint(startTime + i * m_timeStep);
+    }
+}
+
+
+/** Advance the coverage to the current time. Footprints are added for the
+  * time steps between the last update and currentTime, up to the limit set by
+  * setMaxStepsPerUpdate(). If currentTime is earlier than the time already
+  * accumulated, the coverage is cleared and rebuilt from the start time.
+  *
+  * When simulation time runs so fast that the footprints for a frame wouldn't
+  * fit within the limit, footprints are sampled at a multiple of the time step
+  * chosen from the time elapsed since the previous update. Keeping up with the
+  * current rate uses at most half of the limit, so the coverage never falls
+  * further behind, and the rest works off any backlog (e.g. the span between
+  * the start time and the time when the layer was first drawn.) The ground
+  * between two samples is filled in with the swept footprint (see addSweep()),
+  * so the swath doesn't break up into separate footprints; each sweep counts
+  * as a single observation. Use accumulate() for full resolution coverage of
+  * a long time span.
+  *
+  * \return true if the contents of the grid changed
+  */
+bool
+SensorCoverage::update(double currentTime)
+{
+    unsigned int startVersion = m_version;
+
+    if (!m_hasStartTime)
+    {
+        m_startTime = currentTime;
+        m_nextTime = currentTime;
+        m_accumulatedTime = currentTime - m_timeStep;
+        m_hasStartTime = true;
+    }
+
+    if (m_nextTime > m_startTime && currentTime < accumulatedTime())
+    {
+        clear();
+    }
+
+    double elapsed = m_hasLastUpdateTime ? currentTime - m_lastUpdateTime : 0.0;
+    m_lastUpdateTime = currentTime;
+    m_hasLastUpdateTime = true;
+
+    double stride = 1.0;
+    double stepsPerUpdate = elapsed / m_timeStep;
+    if (stepsPerUpdate > 0.5 * m_maxStepsPerUpdate)
+    {
+        stride = ceil(stepsPerUpdate / (0.5 * m_maxStepsPerUpdate));
+    }
+
+    vector<Vector3d> previousBoundary;
+    vector<Vector3d> boundary;
+    bool hasPreviousBoundary = false;
+
+    for (unsigned int step = 0; step < m_maxStepsPerUpdate && m_nextTime <= currentTime; ++step)
+    {
+        if (m_nextTime > m_startTime && m_nextTime - m_accumulatedTime > 1.5 * m_timeStep)
+        {
+            // Time steps were skipped since the last footprint. Consecutive
+            // sweeps share an end, so the boundary at the end of one sweep is
+            // reused as the start of the next.
+            if (!hasPreviousBoundary)
+            {
+                hasPreviousBoundary = footprintBoundary(m_accumulatedTime, previousBoundary);
+            }
+
+            bool hasBoundary = footprintBoundary(m_nextTime, boundary);
+            if (hasPreviousBoundary && hasBoundary)
+            {
+                markSweep(previousBoundary, boundary, m_nextTime);
+            }
+            else
+            {
+                addFootprint(m_nextTime);
+            }
+
+            previousBoundary.swap(boundary);
+            hasPreviousBoundary = hasBoundary;
+        }
+        else
+        {
+            addFootprint(m_nextTime);
+            hasPreviousBoundary = false;
+        }
+        m_accumulatedTime = m_nextTime;
+        m_nextTime += m_timeStep * stride;
+    }
+
+    return m_version != startVersion;
+}
+
+
+// Find the smallest range of longitudes containing all of the given
+// longitudes (in radians, between -pi and pi.) The range spans the complement
+// of the largest gap between longitudes. The longitudes are sorted in place.
+static void
+longitudeRange(double longitudes[], unsigned int count, double* west, double* extent)
+{
+    sort(longitudes, longitudes + count);
+    double largestGap = longitudes[0] + 2.0 * PI - longitudes[count - 1];
+    *west = longitudes[0];
+    for (unsigned int i = 1; i < count; ++i)
+    {
+        double gap = longitudes[i] - longitudes[i - 1];
+        if (gap > largestGap)
+        {
+            largestGap = gap;
+            *west = longitudes[i];
+        }
+    }
+    *extent = 2.0 * PI - largestGap;
+}
+
+
+// Return true if a point on the surface of the target is seen by the sensor.
+// All quantities are in the body-fixed frame of the target except for
+// bodyToSensor, which rotates body-fixed vectors into the sensor frame (with
+// the boresight along +z.)
+static bool
+isObserved(const Vector3d& surfacePoint,
+           const Vector3d& sensorPosition,
+           const Vector3d& inverseSemiAxesSquared,
+           const Matrix3d& bodyToSensor,
+           double halfWidth,
+           double halfHeight,
+           bool elliptical,
+           double rangeSquared)
+{
+    Vector3d toSensor = sensorPosition - surfacePoint;
+
+    // Reject points on the far side of the body
+    if (surfacePoint.cwiseProduct(inverseSemiAxesSquared).dot(toSensor) <= 0.0)
+    {
+        return false;
+    }
+
+    if (toSensor.squaredNorm() > rangeSquared)
+    {
+        return false;
+    }
+
+    Vector3d s = bodyToSensor * -toSensor;
+    if (s.z() <= 0.0)
+    {
+        return false;
+    }
+
+    double x = s.x() / s.z() / halfWidth;
+    double y = s.y() / s.z() / halfHeight;
+    if (elliptical)
+    {
+        return x * x + y * y <= 1.0;
+    }
+    else
+    {
+        return abs(x) <= 1.0 && abs(y) <= 1.0;
+    }
+}
+
+
+// Compute the position and orientation of the sensor in the body-fixed frame
+// of the target at time t, and cast rays around the edge of the frustum. The
+// ray directions and the distances to the surface are left in the scratch ray
+// arrays. Returns false if there's no footprint because the sensor has no
+// ellipsoidal target or the target is out of range.
+bool
+SensorCoverage::computeFootprintGeometry(double t, FootprintGeometry& footprint)
+{
+    const SensorFrustumGeometry* sensor = m_sensor;
+    if (!sensor)
+    {
+        return false;
+    }
+
+    const Entity* source = sensor->source();
+    const Entity* target = sensor->target();
+    if (!source || !target || !target->geometry() || !target->geometry()->isEllipsoidal())
+    {
+        return false;
+    }
+
+    footprint.semiAxes = target->geometry()->ellipsoid().semiAxes();
+    footprint.inverseSemiAxesSquared = footprint.semiAxes.cwiseAbs2().cwiseInverse();
+
+    // Work in the body-fixed frame of the target
+    Matrix3d targetRotation = target->orientation(t).conjugate().toRotationMatrix();
+    footprint.origin = targetRotation * (source->position(t) - target->position(t));
+    Matrix3d sensorToBody = targetRotation * (source->orientation(t) * sensor->sensorOrientation()).toRotationMatrix();
+    footprint.bodyToSensor = sensorToBody.transpose();
+
+    footprint.range = sensor->range();
+    if (footprint.origin.norm() - footprint.semiAxes.maxCoeff() > footprint.range)
+    {
+        // Target is entirely out of range
+        return false;
+    }
+
+    // The rectangular frustum is scaled the same way as in SensorFrustumGeometry::render()
+    bool elliptical = sensor->frustumShape() == SensorFrustumGeometry::Elliptical;
+    double halfWidth = tan(sensor->frustumHorizontalAngle() / 2.0);
+    double halfHeight = tan(sensor->frustumVerticalAngle() / 2.0);
+    if (!elliptical)
+    {
+        halfWidth *= 0.5;
+        halfHeight *= 0.5;
+    }
+    footprint.elliptical = elliptical;
+    footprint.halfWidth = halfWidth;
+    footprint.halfHeight = halfHeight;
+
+    // Cast rays around the edge of the frustum
+    const unsigned int sideRays = BoundaryRayCount / 4;
+    for (unsigned int i = 0; i < BoundaryRayCount; ++i)
+    {
+        Vector3d r;
+        if (elliptical)
+        {
+            double theta = 2.0 * PI * i / BoundaryRayCount;
+            r = Vector3d(halfWidth * cos(theta), halfHeight * sin(theta), 1.0);
+        }
+        else
+        {
+            unsigned int side = i / sideRays;
+            double s = 2.0 * (i % sideRays) / sideRays - 1.0;
+            switch (side)
+            {
+            case 0:  r = Vector3d(s * halfWidth, -halfHeight, 1.0); break;
+            case 1:  r = Vector3d(halfWidth, s * halfHeight, 1.0); break;
+            case 2:  r = Vector3d(-s * halfWidth, halfHeight, 1.0); break;
+            default: r = Vector3d(-halfWidth, -s * halfHeight, 1.0); break;
+            }
+        }
+
+        r = sensorToBody * r;
+        m_rayX[i] = r.x();
+        m_rayY[i] = r.y();
+        m_rayZ[i] = r.z();
+    }
+
+    footprint.hitCount = TestRayBatchEllipsoidIntersection(footprint.origin,
+                                                           &m_rayX[0], &m_rayY[0], &m_rayZ[0],
+                                                           BoundaryRayCount,
+                                                           footprint.semiAxes,
+                                                           &m_rayDistance[0]);
+
+    return true;
+}
+
+
+/** Rasterize the sensor footprint at time t into the coverage grid. Only
+  * cells inside the footprint, on the side of the body facing the sensor,
+  * and within the sensor range are marked.
+  *
+  * \return true if any cells were marked
+  */
+bool
+SensorCoverage::addFootprint(double t)
+{
+    FootprintGeometry footprint;
+    if (!computeFootprintGeometry(t, footprint))
+    {
+        return false;
+    }
+
+    const Vector3d& semiAxes = footprint.semiAxes;
+    const Vector3d& inverseSemiAxesSquared = footprint.inverseSemiAxesSquared;
+    const Vector3d& origin = footprint.origin;
+    const Matrix3d& bodyToSensor = footprint.bodyToSensor;
+    bool elliptical = footprint.elliptical;
+    double halfWidth = footprint.halfWidth;
+    double halfHeight = footprint.halfHeight;
+    double range = footprint.range;
+    unsigned int hitCount = footprint.hitCount;
+
+    // By default, test every cell of the grid
+    double lonStep = 2.0 * PI / m_longitudeCells;
+    double latStep = PI / m_latitudeCells;
+    unsigned int firstColumn = 0;
+    unsigned int columnCount = m_longitudeCells;
+    unsigned int firstRow = 0;
+    unsigned int lastRow = m_latitudeCells - 1;
+
+    if (hitCount == 0)
+    {
+        // Either the whole body is inside the frustum or none of it is; check
+        // whether the center of the body is in view.
+        Vector3d s = bodyToSensor * -origin;
+        if (s.z() <= 0.0)
+        {
+            return false;
+        }
+
+        double x = s.x() / s.z() / halfWidth;
+        double y = s.y() / s.z() / halfHeight;
+        if ((elliptical && x * x + y * y > 1.0) || (!elliptical && (abs(x) > 1.0 || abs(y) > 1.0)))
+        {
+            return false;
+        }
+    }
+    else if (hitCount == BoundaryRayCount)
+    {
+        // The whole boundary of the footprint lies on the surface, so the
+        // footprint is contained in the latitude/longitude box of the boundary
+        // hits. When a boundary ray misses, part of the limb is in view and we
+        // fall back to testing the whole grid.
+        double longitudes[BoundaryRayCount];
+        double minLat = PI;
+        double maxLat = -PI;
+        for (unsigned int i = 0; i < BoundaryRayCount; ++i)
+        {
+            Vector3d p = origin + m_rayDistance[i] * Vector3d(m_rayX[i], m_rayY[i], m_rayZ[i]);
+            Vector3d u = p.cwiseQuotient(semiAxes).normalized();
+            double lat = asin(max(-1.0, min(1.0, u.z())));
+            minLat = min(minLat, lat);
+            maxLat = max(maxLat, lat);
+            longitudes[i] = atan2(u.y(), u.x());
+        }
+
+        double west = 0.0;
+        double lonExtent = 0.0;
+        longitudeRange(longitudes, BoundaryRayCount, &west, &lonExtent);
+
+        // Pad the box to account for the boundary bulging between rays
+        double lonPad = lonExtent * 0.05 + lonStep;
+        double latPad = (maxLat - minLat) * 0.05 + latStep;
+        west -= lonPad;
+        lonExtent += 2.0 * lonPad;
+        minLat -= latPad;
+        maxLat += latPad;
+
+        // A pole inside the footprint isn't enclosed by the boundary longitudes
+        double rangeSquared = range * range;
+        if (isObserved(Vector3d(0.0, 0.0, semiAxes.z()), origin, inverseSemiAxesSquared, bodyToSensor,
+                       halfWidth, halfHeight, elliptical, rangeSquared))
+        {
+            maxLat = PI / 2.0;
+            lonExtent = 2.0 * PI;
+        }
+        if (isObserved(Vector3d(0.0, 0.0, -semiAxes.z()), origin, inverseSemiAxesSquared, bodyToSensor,
+                       halfWidth, halfHeight, elliptical, rangeSquared))
+        {
+            minLat = -PI / 2.0;
+            lonExtent = 2.0 * PI;
+        }
+
+        firstRow = (unsigned int) max(0.0, floor((minLat + PI / 2.0) / latStep));
+        lastRow = (unsigned int) max(0.0, min(double(m_latitudeCells - 1), floor((maxLat + PI / 2.0) / latStep)));
+        if (lonExtent < 2.0 * PI)
+        {
+            int column = (int) floor((west + PI) / lonStep);
+            firstColumn = (unsigned int) ((column % (int) m_longitudeCells + m_longitudeCells) % m_longitudeCells);
+            columnCount = min(m_longitudeCells, (unsigned int) ceil(lonExtent / lonStep) + 1);
+        }
+    }
+
+    double rangeSquared = range * range;
+    bool marked = false;
+    for (unsigned int row = firstRow; row <= lastRow; ++row)
+    {
+        double cosLat = m_cosLatitude[row];
+        double z = semiAxes.z() * m_sinLatitude[row];
+        v_uint16* rowCounts = &m_counts[row * m_longitudeCells];
+
+        for (unsigned int i = 0; i < columnCount; ++i)
+        {
+            unsigned int column = firstColumn + i;
+            if (column >= m_longitudeCells)
+            {
+                column -= m_longitudeCells;
+            }
+
+            Vector3d p(semiAxes.x() * cosLat * m_cosLongitude[column],
+                       semiAxes.y() * cosLat * m_sinLongitude[column],
+                       z);
+            if (isObserved(p, origin, inverseSemiAxesSquared, bodyToSensor, halfWidth, halfHeight, elliptical, rangeSquared))
+            {
+                if (rowCounts[column] < MaxObservationCount)
+                {
+                    ++rowCounts[column];
+                }
+                marked = true;
+            }
+        }
+    }
+
+    if (marked)
+    {
+        ++m_version;
+    }
+
+    return marked;
+}
+
+
+// Point in the plane of a gnomonic projection
+struct ProjectedPoint
+{
+    double x;
+    double y;
+    unsigned int index;
+
+    bool operator<(const ProjectedPoint& other) const
+    {
+        return x < other.x || (x == other.x && y < other.y);
+    }
+};
+
+
+static double
+cross(const ProjectedPoint& o, const ProjectedPoint& a, const ProjectedPoint& b)
+{
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+
+// Compute the convex hull of a set of points with the monotone chain
+// algorithm. The hull vertices are returned in counterclockwise order.
+static void
+convexHull(vector<ProjectedPoint>& points, vector<ProjectedPoint>& hull)
+{
+    sort(points.begin(), points.end());
+
+    hull.resize(2 * points.size());
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < points.size(); ++i)
+    {
+        while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0)
+        {
+            --k;
+        }
+        hull[k++] = points[i];
+    }
+
+    for (unsigned int i = points.size() - 1, lowerSize = k + 1; i > 0; --i)
+    {
+        while (k >= lowerSize && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0.0)
+        {
+            --k;
+        }
+        hull[k++] = points[i - 1];
+    }
+
+    // The last point is the same as the first
+    hull.resize(k - 1);
+}
+
+
+// Edge of a swept region: a great circle arc from a to b. The region lies on
+// the side of the arc that the normal points to.
+struct SweepEdge
+{
+    Vector3d a;
+    Vector3d b;
+    Vector3d normal;
+    double longitude;
+    double horizontalNormal;
+    double minZ;
+    double maxZ;
+
+    // Test whether a point on the great circle lies between a and b
+    bool contains(const Vector3d& p) const
+    {
+        return a.cross(p).dot(normal) >= 0.0 && p.cross(b).dot(normal) >= 0.0;
+    }
+};
+
+
+/** Mark the cells swept by the sensor footprint between times t0 and t1. The
+  * swept region is approximated by the convex hull of the footprints at the two
+  * times, which is exact for a convex footprint moving along a great circle.
+  * The footprint is sampled only at t0 and t1, so the cost is about the same as
+  * adding a single footprint no matter how far apart the times are. Each cell
+  * in the swept region counts as observed once.
+  *
+  * The hull is only computed when both footprints lie entirely on the surface
+  * of the target; otherwise (e.g. when the limb is in view) just the
+  * footprint at t1 is added.
+  *
+  * \return true if any cells were marked
+  */
+bool
+SensorCoverage::addSweep(double t0, double t1)
+{
+    vector<Vector3d> boundary0;
+    vector<Vector3d> boundary1;
+    if (footprintBoundary(t0, boundary0) && footprintBoundary(t1, boundary1))
+    {
+        return markSweep(boundary0, boundary1, t1);
+    }
+    else
+    {
+        return addFootprint(t1);
+    }
+}
+
+
+// Get the points where the edge of the sensor frustum meets the surface of the
+// target at time t. Boundary points are stored as directions on the unit
+// sphere, the same parameterization as the centers of the grid cells. Returns
+// false unless the whole boundary lies on the surface.
+bool
+SensorCoverage::footprintBoundary(double t, vector<Vector3d>& boundary)
+{
+    FootprintGeometry footprint;
+    if (!computeFootprintGeometry(t, footprint) || footprint.hitCount != BoundaryRayCount)
+    {
+        return false;
+    }
+
+    boundary.resize(BoundaryRayCount);
+    for (unsigned int i = 0; i < BoundaryRayCount; ++i)
+    {
+        Vector3d p = footprint.origin + m_rayDistance[i] * Vector3d(m_rayX[i], m_rayY[i], m_rayZ[i]);
+        boundary[i] = p.cwiseQuotient(footprint.semiAxes).normalized();
+    }
+
+    return true;
+}
+
+
+// Mark the cells inside the convex hull of two footprint boundaries. When the
+// hull can't be computed, just the footprint at time t1 is added.
+bool
+SensorCoverage::markSweep(const vector<Vector3d>& boundary0, const vector<Vector3d>& boundary1, double t1)
+{
+    vector<Vector3d> boundary(boundary0);
+    boundary.insert(boundary.end(), boundary1.begin(), boundary1.end());
+
+    // Project the boundary with a gnomonic projection centered on the swept
+    // region. Great circles are straight lines in this projection.
+    Vector3d center = Vector3d::Zero();
+    for (unsigned int i = 0; i < boundary.size(); ++i)
+    {
+        center += boundary[i];
+    }
+    if (center.isZero())
+    {
+        return addFootprint(t1);
+    }
+    center.normalize();
+
+    Vector3d e1 = center.unitOrthogonal();
+    Vector3d e2 = center.cross(e1);
+
+    // Points too far from the center of projection would be badly distorted;
+    // this only happens when a sweep covers a large part of the body.
+    const double minCos = 0.1;
+
+    vector<ProjectedPoint> points(boundary.size());
+    for (unsigned int i = 0; i < boundary.size(); ++i)
+    {
+        const Vector3d& u = boundary[i];
+        double d = u.dot(center);
+        if (d < minCos)
+        {
+            return addFootprint(t1);
+        }
+        points[i].x = u.dot(e1) / d;
+        points[i].y = u.dot(e2) / d;
+        points[i].index = i;
+    }
+
+    vector<ProjectedPoint> hull;
+    convexHull(points, hull);
+    if (hull.size() < 3)
+    {
+        return addFootprint(t1);
+    }
+
+    // Lines in the projection are great circles, so the edges of the hull are
+    // great circle arcs, and a point is inside the swept region when it lies
+    // on the inner side of the plane of every edge. Rather than testing every
+    // cell in a bounding box, each row of cells is filled between the points
+    // where its parallel of latitude crosses the edges. The cost then depends
+    // on the number of rows and marked cells, not on the size of the box,
+    // which is most of the grid for a sweep near a pole.
+    unsigned int edgeCount = hull.size();
+    vector<SweepEdge> edges(edgeCount);
+    double minZ = 1.0;
+    double maxZ = -1.0;
+    bool northPoleInside = true;
+    bool southPoleInside = true;
+    for (unsigned int i = 0; i < edgeCount; ++i)
+    {
+        SweepEdge& edge = edges[i];
+        edge.a = boundary[hull[i].index];
+        edge.b = boundary[hull[(i + 1) % edgeCount].index];
+        edge.normal = edge.a.cross(edge.b).normalized();
+        edge.longitude = atan2(edge.normal.y(), edge.normal.x());
+        edge.horizontalNormal = sqrt(edge.normal.x() * edge.normal.x() + edge.normal.y() * edge.normal.y());
+
+        // An arc can rise above (or dip below) both of its endpoints
+        edge.minZ = min(edge.a.z(), edge.b.z());
+        edge.maxZ = max(edge.a.z(), edge.b.z());
+        Vector3d apex = Vector3d::UnitZ() - edge.normal.z() * edge.normal;
+        if (!apex.isZero())
+        {
+            apex.normalize();
+            if (edge.contains(apex))
+            {
+                edge.maxZ = apex.z();
+            }
+            if (edge.contains(-apex))
+            {
+                edge.minZ = -apex.z();
+            }
+        }
+
+        minZ = min(minZ, edge.minZ);
+        maxZ = max(maxZ, edge.maxZ);
+        northPoleInside = northPoleInside && edge.normal.z() >= 0.0;
+        southPoleInside = southPoleInside && edge.normal.z() <= 0.0;
+    }
+
+    if (northPoleInside)
+    {
+        maxZ = 1.0;
+    }
+    if (southPoleInside)
+    {
+        minZ = -1.0;
+    }
+
+    double lonStep = 2.0 * PI / m_longitudeCells;
+    double latStep = PI / m_latitudeCells;
+    unsigned int firstRow = (unsigned int) max(0.0, floor((asin(max(-1.0, minZ)) + PI / 2.0) / latStep));
+    unsigned int lastRow = (unsigned int) max(0.0, min(double(m_latitudeCells - 1), floor((asin(min(1.0, maxZ)) + PI / 2.0) / latStep)));
+
+    bool marked = false;
+    vector<double> crossings;
+    for (unsigned int row = firstRow; row <= lastRow; ++row)
+    {
+        double cosLat = m_cosLatitude[row];
+        double sinLat = m_sinLatitude[row];
+        v_uint16* rowCounts = &m_counts[row * m_longitudeCells];
+
+        // Longitudes where the parallel crosses the boundary of the region
+        crossings.clear();
+        for (unsigned int i = 0; i < edgeCount; ++i)
+        {
+            const SweepEdge& edge = edges[i];
+            if (sinLat < edge.minZ || sinLat > edge.maxZ || edge.horizontalNormal == 0.0)
+            {
+                continue;
+            }
+
+            double c = -edge.normal.z() * sinLat / (cosLat * edge.horizontalNormal);
+            if (abs(c) > 1.0)
+            {
+                continue;
+            }
+
+            double delta = acos(c);
+            for (int side = -1; side <= 1; side += 2)
+            {
+                double lon = edge.longitude + side * delta;
+                if (edge.contains(Vector3d(cosLat * cos(lon), cosLat * sin(lon), sinLat)))
+                {
+                    crossings.push_back(lon - 2.0 * PI * floor((lon + PI) / (2.0 * PI)));
+                }
+            }
+        }
+
+        if (crossings.empty())
+        {
+            // The parallel is either entirely inside or entirely outside
+            crossings.push_back(-PI);
+        }
+        sort(crossings.begin(), crossings.end());
+
+        // Fill the spans between crossings that lie inside the region
+        for (unsigned int i = 0; i < crossings.size(); ++i)
+        {
+            double west = crossings[i];
+            double east = i + 1 < crossings.size() ? crossings[i + 1] : crossings[0] + 2.0 * PI;
+            if (east <= west)
+            {
+                continue;
+            }
+
+            double lon = 0.5 * (west + east);
+            Vector3d u(cosLat * cos(lon), cosLat * sin(lon), sinLat);
+            bool inside = true;
+            for (unsigned int j = 0; j < edgeCount && inside; ++j)
+            {
+                inside = edges[j].normal.dot(u) >= 0.0;
+            }
+            if (!inside)
+            {
+                continue;
+            }
+
+            // Cells with centers between the crossings
+            int firstColumn = (int) ceil((west + PI) / lonStep - 0.5);
+            int lastColumn = (int) floor((east + PI) / lonStep - 0.5);
+            for (int j = firstColumn; j <= lastColumn; ++j)
+            {
+                unsigned int column = (unsigned int) (j % (int) m_longitudeCells);
+                if (rowCounts[column] < MaxObservationCount)
+                {
+                    ++rowCounts[column];
+                }
+                marked = true;
+            }
+        }
+    }
+
+    if (marked)
+    {
+        ++m_version;
+    }
+
+    return marked;
+}
+
+
+/** Get the fraction of the surface area of the target that has been observed
+  * at least once. Cells are weighted by their area, so that the small cells
+  * near the poles don't count as much as cells at the equator.
+  */
+double
+SensorCoverage::coveredFraction() const
+{
+    double coveredArea = 0.0;
+    double totalArea = 0.0;
+    for (unsigned int row = 0; row < m_latitudeCells; ++row)
+    {
+        const v_uint16* rowCounts = &m_counts[row * m_longitudeCells];
+        unsigned int coveredCells = 0;
+        for (unsigned int column = 0; column < m_longitudeCells; ++column)
+        {
+            if (rowCounts[column] != 0)
+            {
+                ++coveredCells;
+            }
+        }
+
+        coveredArea += m_cosLatitude[row] * coveredCells;
+        totalArea += m_cosLatitude[row] * m_longitudeCells;
+    }
+
+    return totalArea > 0.0 ? coveredArea / totalArea : 0.0;
+}
+
+
+/** Convert the coverage grid to an RGBA image with one pixel per cell. The
+  * buffer must hold 4 * longitudeCells * latitudeCells bytes. Unobserved cells
+  * are transparent; observed cells have the specified color and an alpha that
+  * grows from half to full opacity as the number of observations increases.
+  *
+  * \param northFirst if true, the first row of the image is the northernmost
+  *        row of the grid (the usual orientation for image files); otherwise
+  *        the southernmost row comes first, as expected for texture data.
+  */
+void
+SensorCoverage::fillImage(unsigned char rgba[], const Spectrum& color, float opacity, bool northFirst) const
+{
+    unsigned char r = (unsigned char) (max(0.0f, min(1.0f, color.red())) * 255.0f + 0.5f);
+    unsigned char g = (unsigned char) (max(0.0f, min(1.0f, color.green())) * 255.0f + 0.5f);
+    unsigned char b = (unsigned char) (max(0.0f, min(1.0f, color.blue())) * 255.0f + 0.5f);
+    float maxAlpha = max(0.0f, min(1.0f, opacity)) * 255.0f;
+
+    for (unsigned int row = 0; row < m_latitudeCells; ++row)
+    {
+        unsigned int imageRow = northFirst ? m_latitudeCells - 1 - row : row;
+        const v_uint16* rowCounts = &m_counts[row * m_longitudeCells];
+        unsigned char* pixel = rgba + imageRow * m_longitudeCells * 4;
+
+        for (unsigned int column = 0; column < m_longitudeCells; ++column, pixel += 4)
+        {
+            unsigned int count = rowCounts[column];
+            if (count == 0)
+            {
+                pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+            }
+            else
+            {
+                float level = 0.5f + 0.5f * float(min(count, SaturationCount) - 1) / float(SaturationCount - 1);
+                pixel[0] = r;
+                pixel[1] = g;
+                pixel[2] = b;
+                pixel[3] = (unsigned char) (maxAlpha * level + 0.5f);
+            }
+        }
+    }
+}
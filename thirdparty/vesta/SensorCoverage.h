@@ -0,0 +1,191 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_SENSOR_COVERAGE_H_
+#define _VESTA_SENSOR_COVERAGE_H_
+
+#include "Object.h"
+#include "SensorFrustumGeometry.h"
+#include "IntegerTypes.h"
+#include <vector>
+
+
+namespace vesta
+{
+
+/** SensorCoverage accumulates the ground swath of a sensor on its target
+  * body. The surface of the target is divided into a grid of cells of equal
+  * size in longitude and latitude, and each cell records how many times it
+  * was inside the sensor footprint. Footprints are sampled at a fixed time
+  * step, or swept between samples when update() can't keep up with every
+  * step.
+  *
+  * The grid is laid out with longitude increasing from -180 to 180 degrees
+  * across each row and rows running from south to north. This matches the
+  * texture mapping of WorldGeometry, so that the grid can be shown directly
+  * as a map layer (see SensorCoverageLayer.)
+  *
+  * Coverage can either be computed for a whole time range at once with
+  * accumulate(), or built up incrementally with update() as the simulation
+  * time advances. A footprint can only be rasterized when the sensor target
+  * is ellipsoidal; no coverage is recorded for other targets.
+  *
+  * The coverage is usually shown in a layer belonging to the target's geometry,
+  * while the sensor holds a reference to the target. To avoid a reference cycle,
+  * the coverage doesn't hold a reference to its sensor. Instead, it attaches
+  * itself to the sensor when created, and the sensor detaches it when the sensor
+  * is destroyed; a detached coverage keeps its grid but records no more
+  * footprints.
+  */
+class SensorCoverage : public Object
+{
+public:
+    SensorCoverage(SensorFrustumGeometry* sensor,
+                   unsigned int longitudeCells,
+                   unsigned int latitudeCells);
+    ~SensorCoverage();
+
+    /** Get the sensor whose coverage is being recorded. This is null once the
+      * sensor has been destroyed.
+      */
+    SensorFrustumGeometry* sensor() const
+    {
+        return m_sensor;
+    }
+
+    /** Called by the sensor when it no longer records coverage in this grid. */
+    void detachSensor()
+    {
+        m_sensor = NULL;
+    }
+
+    /** Get the number of grid cells in longitude. */
+    unsigned int longitudeCells() const
+    {
+        return m_longitudeCells;
+    }
+
+    /** Get the number of grid cells in latitude. */
+    unsigned int latitudeCells() const
+    {
+        return m_latitudeCells;
+    }
+
+    /** Get the interval in seconds between sampled footprints. */
+    double timeStep() const
+    {
+        return m_timeStep;
+    }
+
+    void setTimeStep(double seconds);
+
+    /** Get the time at which coverage accumulation begins. */
+    double startTime() const
+    {
+        return m_startTime;
+    }
+
+    void setStartTime(double tdbSec);
+
+    /** Get the time up to which footprints have been accumulated by update(). */
+    double accumulatedTime() const
+    {
+        return m_accumulatedTime;
+    }
+
+    /** Get the maximum number of footprints rasterized in a single call
+      * to update().
+      */
+    unsigned int maxStepsPerUpdate() const
+    {
+        return m_maxStepsPerUpdate;
+    }
+
+    /** Set the maximum number of footprints rasterized in a single call to
+      * update(). This bounds the per-frame cost; see update() for how the
+      * coverage keeps up when time advances faster than this allows.
+      */
+    void setMaxStepsPerUpdate(unsigned int steps)
+    {
+        m_maxStepsPerUpdate = steps;
+    }
+
+    /** Get the number of observations recorded for a grid cell. Row 0 is
+      * the southernmost row and column 0 begins at longitude -180 degrees.
+      */
+    unsigned int observationCount(unsigned int column, unsigned int row) const
+    {
+        return m_counts[row * m_longitudeCells + column];
+    }
+
+    /** Get a counter that changes whenever the contents of the grid change. */
+    unsigned int version() const
+    {
+        return m_version;
+    }
+
+    void clear();
+    void accumulate(double startTime, double endTime);
+    bool update(double currentTime);
+    bool addFootprint(double t);
+    bool addSweep(double t0, double t1);
+
+    double coveredFraction() const;
+    void fillImage(unsigned char rgba[], const Spectrum& color, float opacity, bool northFirst) const;
+
+private:
+    // Position and orientation of the sensor relative to the target at one
+    // instant, in the body-fixed frame of the target.
+    struct FootprintGeometry
+    {
+        Eigen::Vector3d semiAxes;
+        Eigen::Vector3d inverseSemiAxesSquared;
+        Eigen::Vector3d origin;
+        Eigen::Matrix3d bodyToSensor;
+        double halfWidth;
+        double halfHeight;
+        double range;
+        bool elliptical;
+        unsigned int hitCount;
+    };
+
+    bool computeFootprintGeometry(double t, FootprintGeometry& footprint);
+    bool footprintBoundary(double t, std::vector<Eigen::Vector3d>& boundary);
+    bool markSweep(const std::vector<Eigen::Vector3d>& boundary0,
+                   const std::vector<Eigen::Vector3d>& boundary1,
+                   double t1);
+
+private:
+    SensorFrustumGeometry* m_sensor;
+    unsigned int m_longitudeCells;
+    unsigned int m_latitudeCells;
+    std::vector<v_uint16> m_counts;
+    std::vector<double> m_cosLongitude;
+    std::vector<double> m_sinLongitude;
+    std::vector<double> m_cosLatitude;
+    std::vector<double> m_sinLatitude;
+    double m_timeStep;
+    double m_startTime;
+    bool m_hasStartTime;
+    double m_nextTime;
+    double m_accumulatedTime;
+    double m_lastUpdateTime;
+    bool m_hasLastUpdateTime;
+    unsigned int m_maxStepsPerUpdate;
+    unsigned int m_version;
+
+    // Scratch arrays for the footprint boundary rays
+    std::vector<double> m_rayX;
+    std::vector<double> m_rayY;
+    std::vector<double> m_rayZ;
+    std::vector<double> m_rayDistance;
+};
+
+}
+
+#endif // _VESTA_SENSOR_COVERAGE_H_
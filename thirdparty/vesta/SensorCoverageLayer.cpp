@@ -0,0 +1,145 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "SensorCoverageLayer.h"
+#include "TextureMap.h"
+#include "Units.h"
+#include "OGLHeaders.h"
+
+using namespace vesta;
+using namespace std;
+
+
+/** Create a new layer showing the specified coverage grid. The layer box is
+  * set to cover the whole body, matching the layout of the grid.
+  */
+SensorCoverageLayer::SensorCoverageLayer(SensorCoverage* coverage) :
+    m_coverage(coverage),
+    m_color(1.0f, 1.0f, 1.0f),
+    m_textureVersion(coverage->version() - 1),
+    m_reduction(1)
+{
+    setBox(MapLayerBounds(-PI, -PI / 2.0, PI, PI / 2.0));
+
+    // Uncovered regions of the coverage texture are transparent
+    setBlendMode(Material::AlphaBlend);
+}
+
+
+SensorCoverageLayer::~SensorCoverageLayer()
+{
+}
+
+
+/** Advance the coverage to time t and refresh the texture if the coverage
+  * grid changed. The texture is created on first use; later changes only
+  * upload new texel data, avoiding the cost of reallocating the texture.
+  */
+void
+SensorCoverageLayer::prepareToRender(double t)
+{
+    m_coverage->update(t);
+    if (m_coverage->version() == m_textureVersion)
+    {
+        return;
+    }
+
+    bool createTexture = !texture() || !texture()->isResident();
+    if (createTexture)
+    {
+        // Find the smallest power of two reduction that fits the grid into
+        // a texture.
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        unsigned int maxDimension = max(m_coverage->longitudeCells(), m_coverage->latitudeCells());
+        m_reduction = 1;
+        while (maxTextureSize > 0 && (maxDimension + m_reduction - 1) / m_reduction > (unsigned int) maxTextureSize)
+        {
+            m_reduction *= 2;
+        }
+    }
+
+    m_imageData.resize(m_coverage->longitudeCells() * m_coverage->latitudeCells() * 4);
+
+    // The layer opacity is applied when the layer is drawn
+    m_coverage->fillImage(&m_imageData[0], m_color, 1.0f, false);
+    if (m_reduction > 1)
+    {
+        reduceImage();
+    }
+
+    unsigned int width = (m_coverage->longitudeCells() + m_reduction - 1) / m_reduction;
+    unsigned int height = (m_coverage->latitudeCells() + m_reduction - 1) / m_reduction;
+
+    if (createTexture)
+    {
+        TextureProperties properties(TextureProperties::Clamp);
+        properties.useMipmaps = false;
+
+        counted_ptr<TextureMap> coverageTexture(new TextureMap("coverage", NULL, properties));
+        if (!coverageTexture->generate(&m_imageData[0], width * height * 4, width, height, TextureMap::R8G8B8A8))
+        {
+            return;
+        }
+        setTexture(coverageTexture.ptr());
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_2D, texture()->id());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &m_imageData[0]);
+    }
+
+    m_textureVersion = m_coverage->version();
+}
+
+
+// Shrink the coverage image in place by the reduction factor. Each reduced
+// pixel takes the value of the most opaque (i.e. most observed) pixel in its
+// block, so that narrow swaths don't disappear from the reduced image.
+void
+SensorCoverageLayer::reduceImage()
+{
+    unsigned int width = m_coverage->longitudeCells();
+    unsigned int height = m_coverage->latitudeCells();
+    unsigned int reducedWidth = (width + m_reduction - 1) / m_reduction;
+    unsigned int reducedHeight = (height + m_reduction - 1) / m_reduction;
+
+    // Reduced pixels are always written at or before the first pixel of their
+    // block, so the reduction can be done in place.
+    unsigned char* pixels = &m_imageData[0];
+    for (unsigned int row = 0; row < reducedHeight; ++row)
+    {
+        unsigned int rowEnd = min(height, (row + 1) * m_reduction);
+        for (unsigned int column = 0; column < reducedWidth; ++column)
+        {
+            unsigned int columnEnd = min(width, (column + 1) * m_reduction);
+            const unsigned char* best = pixels + (row * m_reduction * width + column * m_reduction) * 4;
+            for (unsigned int y = row * m_reduction; y < rowEnd; ++y)
+            {
+                for (unsigned int x = column * m_reduction; x < columnEnd; ++x)
+                {
+                    const unsigned char* pixel = pixels + (y * width + x) * 4;
+                    if (pixel[3] > best[3])
+                    {
+                        best = pixel;
+                    }
+                }
+            }
+
+            unsigned char* reduced = pixels + (row * reducedWidth + column) * 4;
+            unsigned char r = best[0];
+            unsigned char g = best[1];
+            unsigned char b = best[2];
+            unsigned char a = best[3];
+            reduced[0] = r;
+            reduced[1] = g;
+            reduced[2] = b;
+            reduced[3] = a;
+        }
+    }
+}
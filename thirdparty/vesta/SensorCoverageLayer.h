@@ -0,0 +1,71 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_SENSOR_COVERAGE_LAYER_H_
+#define _VESTA_SENSOR_COVERAGE_LAYER_H_
+
+#include "MapLayer.h"
+#include "SensorCoverage.h"
+#include "Spectrum.h"
+#include <vector>
+
+
+namespace vesta
+{
+
+/** SensorCoverageLayer displays the accumulated coverage of a sensor as
+  * a map layer on the target body. The coverage is advanced to the current
+  * simulation time each time that the layer is drawn, and the layer texture
+  * is updated in place whenever the coverage changes.
+  *
+  * A coverage grid larger than the maximum texture size supported by the
+  * GPU is reduced for display: each texel shows the most observed cell of
+  * the block of cells that it covers. The grid itself keeps its full
+  * resolution.
+  */
+class SensorCoverageLayer : public MapLayer
+{
+public:
+    SensorCoverageLayer(SensorCoverage* coverage);
+    ~SensorCoverageLayer();
+
+    /** Get the coverage grid shown by this layer. */
+    SensorCoverage* coverage() const
+    {
+        return m_coverage.ptr();
+    }
+
+    /** Get the color used for covered regions. */
+    Spectrum color() const
+    {
+        return m_color;
+    }
+
+    /** Set the color used for covered regions. */
+    void setColor(const Spectrum& color)
+    {
+        m_color = color;
+        m_textureVersion = m_coverage->version() - 1;
+    }
+
+    virtual void prepareToRender(double t);
+
+private:
+    void reduceImage();
+
+private:
+    counted_ptr<SensorCoverage> m_coverage;
+    Spectrum m_color;
+    unsigned int m_textureVersion;
+    unsigned int m_reduction;
+    std::vector<unsigned char> m_imageData;
+};
+
+}
+
+#endif // _VESTA_SENSOR_COVERAGE_LAYER_H_
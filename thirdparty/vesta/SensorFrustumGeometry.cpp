@@ -9,6 +9,7 @@
  */
 
 #include "SensorFrustumGeometry.h"
+#include "SensorCoverage.h"
 #include "Material.h"
 #include "RenderContext.h"
 #include "Intersect.h"
@@ -42,6 +43,27 @@ SensorFrustumGeometry::SensorFrustumGeometry() :
 
 SensorFrustumGeometry::~SensorFrustumGeometry()
 {
+    setCoverage(NULL);
+}
+
+
+/** Set the coverage grid that records the ground swath of this sensor. The
+  * coverage refers back to the sensor without holding a reference to it;
+  * the reference is cleared when the coverage is replaced or the sensor is
+  * destroyed. A SensorCoverage attaches itself to its sensor when it is
+  * created, so this method normally doesn't need to be called directly.
+  */
+void
+SensorFrustumGeometry::setCoverage(SensorCoverage* coverage)
+{
+    if (m_coverage.ptr() != coverage)
+    {
+        if (m_coverage.isValid())
+        {
+            m_coverage->detachSensor();
+        }
+        m_coverage = coverage;
+    }
 }
 
 
@@ -91,6 +113,12 @@ SensorFrustumGeometry::render(RenderContext& rc,
 
         const unsigned int sideDivisions = 12;
         const unsigned int sections = 4 * sideDivisions;
+
+        // Directions of the rays along the edge of the frustum, in the target frame
+        double rayX[sections];
+        double rayY[sections];
+        double rayZ[sections];
+
         for (unsigned int i = 0; i < sections; ++i)
         {
             Vector3d r;
@@ -125,15 +153,27 @@ SensorFrustumGeometry::render(RenderContext& rc,
                 }
             }
             r = m * r;
+            m_frustumPoints.push_back(r);
 
+            Vector3d targetRay = targetRotation * r;
+            rayX[i] = targetRay.x();
+            rayY[i] = targetRay.y();
+            rayZ[i] = targetRay.z();
+        }
+
+        // Trim the rays where they intersect the target
+        double intersectDistances[sections];
+        TestRayBatchEllipsoidIntersection(p2, rayX, rayY, rayZ, sections, targetSemiAxes, intersectDistances);
+        for (unsigned int i = 0; i < sections; ++i)
+        {
             double intersectDistance = m_range;
-            if (TestRayEllipsoidIntersection(p2, targetRotation * r, targetSemiAxes, &intersectDistance))
+            if (intersectDistances[i] >= 0.0)
             {
                 // Reduce the intersect distance slightly to reduce depth precision problems
                 // when drawing the sensor footprint on a planet surface.
-                intersectDistance *= 0.9999;
+                intersectDistance = intersectDistances[i] * 0.9999;
             }
-            m_frustumPoints.push_back(r * min(m_range, intersectDistance));
+            m_frustumPoints[i] *= min(m_range, intersectDistance);
         }
 
         if (m_opacity > 0.0f)
@@ -19,6 +19,7 @@
 
 namespace vesta
 {
+class SensorCoverage;
 
 /** SensorFrustumGeometry class is used by SensorVisualizer for drawing
  *  spacecraft sensor volumes.
@@ -128,12 +129,34 @@ public:
         m_frustumShape = shape;
     }
 
+    /** Get the full horizontal angle of the frustum in radians. */
+    double frustumHorizontalAngle() const
+    {
+        return m_frustumHorizontalAngle;
+    }
+
+    /** Get the full vertical angle of the frustum in radians. */
+    double frustumVerticalAngle() const
+    {
+        return m_frustumVerticalAngle;
+    }
+
     void setFrustumAngles(double horizontal, double vertical)
     {
         m_frustumHorizontalAngle = horizontal;
         m_frustumVerticalAngle = vertical;
     }
 
+    /** Get the ground coverage recorded for this sensor, or null if
+      * coverage isn't being recorded.
+      */
+    SensorCoverage* coverage() const
+    {
+        return m_coverage.ptr();
+    }
+
+    void setCoverage(SensorCoverage* coverage);
+
 private:
     Eigen::Quaterniond m_orientation;
 
@@ -147,6 +170,7 @@ private:
     FrustumShape m_frustumShape;
     double m_frustumHorizontalAngle;
     double m_frustumVerticalAngle;
+    counted_ptr<SensorCoverage> m_coverage;
 
     // TODO: Eliminate this once streaming vertex array is exposed by
     // RenderContext.
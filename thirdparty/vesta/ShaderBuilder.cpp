@@ -36,6 +36,7 @@ const char* ShaderBuilder::NormalAttribute    = "vesta_Normal";
 const char* ShaderBuilder::ColorAttribute     = "vesta_Color";
 const char* ShaderBuilder::TexCoordAttribute  = "vesta_TexCoord0";
 const char* ShaderBuilder::TangentAttribute   = "vesta_Tangent";
+const char* ShaderBuilder::PackedNormalAttribute = "vesta_PackedNormal";
 
 static const char* HighPrec   = "highp";
 static const char* MediumPrec = "mediump";
@@ -47,6 +48,7 @@ const char* ShaderBuilder::NormalAttribute    = "gl_Normal";
 const char* ShaderBuilder::ColorAttribute     = "gl_Color";
 const char* ShaderBuilder::TexCoordAttribute  = "gl_MultiTexCoord0";
 const char* ShaderBuilder::TangentAttribute   = "vesta_Tangent";
+const char* ShaderBuilder::PackedNormalAttribute = "vesta_PackedNormal";
 
 static const char* HighPrec   = "";
 static const char* MediumPrec = "";
@@ -178,6 +180,51 @@ static void declareAttribute(ostream& out, const char* type, const char* name)
 }
 
 
+// Decode a unit vector stored in octahedral encoding (see Submesh::quantizeVertices)
+static void declareOctahedralDecodeFunc(ostream& out)
+{
+    out << "vec3 octDecode(vec2 e)" << endl;
+    out << "{" << endl;
+    out << "    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));" << endl;
+    out << "    if (v.z < 0.0)" << endl;
+    out << "    {" << endl;
+    out << "        v.xy = (1.0 - abs(v.yx)) * (step(0.0, v.xy) * 2.0 - 1.0);" << endl;
+    out << "    }" << endl;
+    out << "    return normalize(v);" << endl;
+    out << "}" << endl;
+}
+
+
+// Logarithmic depth: the vertex shader passes the scaled eye distance to the
+// fragment shader, which writes a depth value proportional to its logarithm.
+// This gives roughly constant relative depth precision from the near plane
+// out to the far plane, so that a single depth range covers the whole scene.
+// Depth is written per fragment rather than per vertex so that large triangles
+// close to the camera aren't incorrectly clipped or occluded.
+static void declareLogDepth(ostream& vertex, ostream& fragment)
+{
+    declareVarying(vertex, fragment, "float", "logDepthZ");
+    declareUniform(vertex, "float", "vesta_LogDepthScale");
+    declareUniform(fragment, "float", "vesta_LogDepthFactor");
+}
+
+static void writeLogDepthVertex(ostream& out, const ShaderInfo& shaderInfo)
+{
+    if (shaderInfo.hasLogDepth())
+    {
+        out << "    logDepthZ = 1.0 + max(gl_Position.w, 0.0) * vesta_LogDepthScale;" << endl;
+    }
+}
+
+static void writeLogDepthFragment(ostream& out, const ShaderInfo& shaderInfo)
+{
+    if (shaderInfo.hasLogDepth())
+    {
+        out << "    gl_FragDepth = log2(logDepthZ) * vesta_LogDepthFactor;" << endl;
+    }
+}
+
+
 static void declareTransformations(ostream& out)
 {
 #ifdef VESTA_OGLES2
@@ -498,6 +545,7 @@ static void generateUnlitShader(ostream& vertex, ostream& fragment, const Shader
 #else
     vertex << "    gl_Position = ftransform();" << endl;
 #endif
+    writeLogDepthVertex(vertex, shaderInfo);
     vertex << "}" << endl;
 
     declareSamplers(fragment, shaderInfo.textures() & ShaderInfo::DiffuseTexture);
@@ -523,6 +571,7 @@ static void generateUnlitShader(ostream& vertex, ostream& fragment, const Shader
         fragment << "    fragColor *= vertexColor;" << endl;
     }
     fragment << "    gl_FragColor = fragColor;" << endl;
+    writeLogDepthFragment(fragment, shaderInfo);
     fragment << "}" << endl;
 }
 
@@ -541,6 +590,7 @@ static void generateStandardShader(ostream& vertex, ostream& fragment, const Sha
 
     bool phong = shaderInfo.reflectanceModel() == ShaderInfo::BlinnPhong;
     bool hasTangents = hasSurface && shaderInfo.hasTexture(ShaderInfo::NormalTexture);
+    bool packedNormals = shaderInfo.hasPackedNormals();
     bool hasLocalLightSources = shaderInfo.pointLightCount() > 0;
     bool hasEnvironmentMap = hasSurface && shaderInfo.hasTexture(ShaderInfo::ReflectionTexture);
 
@@ -571,15 +621,24 @@ static void generateStandardShader(ostream& vertex, ostream& fragment, const Sha
     // Declare attributes
 #ifdef VESTA_OGLES2
     declareAttribute(vertex, "vec4", ShaderBuilder::PositionAttribute);
-    declareAttribute(vertex, "vec3", ShaderBuilder::NormalAttribute);
+    if (!packedNormals)
+    {
+        declareAttribute(vertex, "vec3", ShaderBuilder::NormalAttribute);
+    }
     if (shaderInfo.hasTextureCoord())
     {
         declareAttribute(vertex, "vec2", ShaderBuilder::TexCoordAttribute);
     }
 #endif
+    if (packedNormals)
+    {
+        // Normals and tangents of quantized meshes are both packed
+        declareAttribute(vertex, "vec2", ShaderBuilder::PackedNormalAttribute);
+        declareOctahedralDecodeFunc(vertex);
+    }
     if (hasTangents)
     {
-        declareAttribute(vertex, "vec3", ShaderBuilder::TangentAttribute);
+        declareAttribute(vertex, packedNormals ? "vec2" : "vec3", ShaderBuilder::TangentAttribute);
         declareVarying(vertex, fragment, "vec3", "tangent", MediumPrec);   // surface tangent
     }
 
@@ -674,11 +733,22 @@ static void generateStandardShader(ostream& vertex, ostream& fragment, const Sha
     }
     if (hasSurface)
     {
-        if (hasTangents)
+        if (packedNormals)
         {
-            vertex << "    tangent = " << ShaderBuilder::TangentAttribute << ";" << endl;
+            if (hasTangents)
+            {
+                vertex << "    tangent = octDecode(" << ShaderBuilder::TangentAttribute << ");" << endl;
+            }
+            vertex << "    normal = octDecode(" << ShaderBuilder::PackedNormalAttribute << ");" << endl;
+        }
+        else
+        {
+            if (hasTangents)
+            {
+                vertex << "    tangent = " << ShaderBuilder::TangentAttribute << ";" << endl;
+            }
+            vertex << "    normal = " << ShaderBuilder::NormalAttribute << ";" << endl;
         }
-        vertex << "    normal = " << ShaderBuilder::NormalAttribute << ";" << endl;
     }
     if (usesPosition)
     {
@@ -721,6 +791,7 @@ static void generateStandardShader(ostream& vertex, ostream& fragment, const Sha
 #else
     vertex << "    gl_Position = ftransform();" << endl;
 #endif
+    writeLogDepthVertex(vertex, shaderInfo);
 
     vertex << "}" << endl;
 
@@ -1015,6 +1086,7 @@ static void generateStandardShader(ostream& vertex, ostream& fragment, const Sha
     }
 
     fragment << "    gl_FragColor = vec4(" << colorSum << ", " << alphaSum << ");" << endl;
+    writeLogDepthFragment(fragment, shaderInfo);
 
     fragment << "}" << endl;
 }
@@ -1123,6 +1195,7 @@ static void generateParticulateShader(ostream& vertex, ostream& fragment, const
 #else
     vertex << "    gl_Position = ftransform();" << endl;
 #endif
+    writeLogDepthVertex(vertex, shaderInfo);
 
     vertex << "}" << endl;
 
@@ -1235,6 +1308,7 @@ static void generateParticulateShader(ostream& vertex, ostream& fragment, const
     }
 
     fragment << "    gl_FragColor = vec4(" << colorSum << ", " << alphaSum << ");" << endl;
+    writeLogDepthFragment(fragment, shaderInfo);
 
     fragment << "}" << endl;
 }
@@ -1333,6 +1407,12 @@ static bool LoadVertexLitShader(ostringstream& vertex, ostringstream& fragment,
         // No hand-tuned vertex color shaders
         return false;
     }
+
+    if (info.hasPackedNormals())
+    {
+        // Vertex lit shaders read unpacked normals
+        return false;
+    }
     
     if (info.textures() != ShaderInfo::DiffuseTexture)
     {
@@ -1572,6 +1652,11 @@ ShaderBuilder::generateShader(const ShaderInfo& shaderInfo) const
         declareVarying(vertex, fragment, "vec4", "vertexColor", LowPrec);
     }
 
+    if (shaderInfo.hasLogDepth())
+    {
+        declareLogDepth(vertex, fragment);
+    }
+
     // Try loading a vertex lit shader first. If that fails, use the
     // shader generator to produce a shader that does lighting at the
     // fragment level. Some shaders--such as those involving a normal
@@ -1661,6 +1746,11 @@ ShaderBuilder::generateShader(const ShaderInfo& shaderInfo) const
         shaderProgram->bindAttribute(ColorAttribute, ColorAttributeLocation);
     }
 #endif
+    if (shaderInfo.hasPackedNormals() && shaderInfo.reflectanceModel() != ShaderInfo::Emissive)
+    {
+        shaderProgram->bindAttribute(PackedNormalAttribute, PackedNormalAttributeLocation);
+    }
+
     if (shaderInfo.hasTexture(ShaderInfo::NormalTexture))
     {
         shaderProgram->bindAttribute(TangentAttribute, TangentAttributeLocation);
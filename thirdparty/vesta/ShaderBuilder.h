@@ -45,7 +45,9 @@ public:
     static const int TexCoordAttributeLocation  = 2;
     static const int ColorAttributeLocation     = 3;
     static const int TangentAttributeLocation   = 4;
+    static const int PackedNormalAttributeLocation = 5;
 #else
+    static const int PackedNormalAttributeLocation = 6;
     static const int TangentAttributeLocation = 7;
 #endif
 
@@ -54,6 +56,7 @@ public:
     static const char* TexCoordAttribute;
     static const char* ColorAttribute;
     static const char* TangentAttribute;
+    static const char* PackedNormalAttribute;
 
 private:
     GLShaderProgram* generateShader(const ShaderInfo& shaderInfo) const;
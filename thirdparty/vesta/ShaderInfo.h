@@ -195,6 +195,19 @@ public:
         m_data = (m_data & ~RingShadowMask) | (enable ? RingShadowMask : 0x0);
     }
 
+    /** Returns true if the shader writes a logarithmic depth value
+      * instead of the standard perspective depth.
+      */
+    bool hasLogDepth() const
+    {
+        return (m_data & LogDepthMask) != 0;
+    }
+
+    void setLogDepth(bool enable)
+    {
+        m_data = (m_data & ~LogDepthMask) | (enable ? LogDepthMask : 0x0);
+    }
+
     bool hasVertexColors() const
     {
         return (m_data & VertexColorMask) != 0;
@@ -265,6 +278,19 @@ public:
         m_data = (m_data & ~CompressedNormalMapMask) | (enable ? CompressedNormalMapMask : 0x0);
     }
 
+    /** Return true if vertex normals and tangents are stored in
+      * octahedral encoding and must be decoded by the vertex shader.
+      */
+    bool hasPackedNormals() const
+    {
+        return (m_data & PackedNormalMask) != 0;
+    }
+
+    void setPackedNormals(bool enable)
+    {
+        m_data = (m_data & ~PackedNormalMask) | (enable ? PackedNormalMask : 0x0);
+    }
+
     bool isViewDependent() const
     {
         // The shader depends on the viewer's position when atmospheric scattering
@@ -302,6 +328,8 @@ private:
         CompressedNormalMapMask   = 0x01000000,
         EclipseShadowCountMask    = 0x0e000000,
         RingShadowMask            = 0x10000000,
+        LogDepthMask              = 0x20000000,
+        PackedNormalMask          = 0x40000000,
     };
 
     enum
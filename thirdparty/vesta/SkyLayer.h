@@ -36,6 +36,15 @@ public:
       */
     virtual void render(RenderContext& rc) = 0;
 
+    /** Submit the screen rectangles of any labels drawn by this layer to the
+      * label placement service. This is called before the layer is drawn, with
+      * the same modelview and projection that render() will see. The default
+      * implementation does nothing.
+      */
+    virtual void submitLabels(RenderContext& /* rc */)
+    {
+    }
+
     /** Return true if the layer is visible, false if it is not. */
     bool isVisible() const
     {
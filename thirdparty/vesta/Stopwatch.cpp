@@ -0,0 +1,57 @@
+/*
+ * $Revision: 223 $ $Date: 2010-03-30 05:44:44 -0700 (Tue, 30 Mar 2010) $
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "Stopwatch.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+using namespace vesta;
+
+
+/** Get the current value of the monotonic clock in seconds. The zero point
+  * of the clock is arbitrary, so this is only useful for measuring intervals.
+  */
+double
+Stopwatch::currentTime()
+{
+#ifdef _WIN32
+    static double secondsPerTick = 0.0;
+    if (secondsPerTick == 0.0)
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        secondsPerTick = 1.0 / double(frequency.QuadPart);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return double(counter.QuadPart) * secondsPerTick;
+#elif defined(__APPLE__)
+    static double secondsPerTick = 0.0;
+    if (secondsPerTick == 0.0)
+    {
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        secondsPerTick = 1.0e-9 * double(timebase.numer) / double(timebase.denom);
+    }
+
+    return double(mach_absolute_time()) * secondsPerTick;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return double(ts.tv_sec) + 1.0e-9 * double(ts.tv_nsec);
+#endif
+}
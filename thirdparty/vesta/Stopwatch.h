@@ -0,0 +1,64 @@
+/*
+ * $Revision: 223 $ $Date: 2010-03-30 05:44:44 -0700 (Tue, 30 Mar 2010) $
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_STOPWATCH_H_
+#define _VESTA_STOPWATCH_H_
+
+
+namespace vesta
+{
+
+/** Stopwatch measures elapsed wall clock time using the highest resolution
+  * monotonic clock available on the platform. It's intended for timing
+  * short intervals such as the stages of rendering a frame.
+  */
+class Stopwatch
+{
+public:
+    /** Create a new stopwatch and start it.
+      */
+    Stopwatch() :
+        m_startTime(currentTime())
+    {
+    }
+
+    /** Reset the start time of the stopwatch to now.
+      */
+    void start()
+    {
+        m_startTime = currentTime();
+    }
+
+    /** Get the time in seconds since the stopwatch was started.
+      */
+    double elapsed() const
+    {
+        return currentTime() - m_startTime;
+    }
+
+    /** Get the time in seconds since the stopwatch was started, and restart it.
+      */
+    double lap()
+    {
+        double now = currentTime();
+        double t = now - m_startTime;
+        m_startTime = now;
+        return t;
+    }
+
+    static double currentTime();
+
+private:
+    double m_startTime;
+};
+
+}
+
+#endif // _VESTA_STOPWATCH_H_
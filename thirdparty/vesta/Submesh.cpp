@@ -10,6 +10,9 @@
 
 #include "Submesh.h"
 #include "Debug.h"
+#include "internal/ParallelFor.h"
+#include "internal/VertexCacheOptimizer.h"
+#include "internal/MeshSimplifier.h"
 #include <Eigen/LU>
 #include <Eigen/Geometry>
 #include <algorithm>
@@ -38,6 +41,8 @@ Submesh::~Submesh()
     {
         delete *iter;
     }
+
+    clearLevelsOfDetail();
 }
 
 
@@ -47,6 +52,8 @@ Submesh::~Submesh()
 void
 Submesh::addPrimitiveBatch(PrimitiveBatch* batch, unsigned int materialIndex)
 {
+    clearLevelsOfDetail();
+
     m_primitiveBatches.push_back(batch);
     m_materials.push_back(materialIndex);
 
@@ -120,13 +127,17 @@ Submesh::mergeSubmeshes(const std::vector<Submesh*>& submeshes)
 
     const VertexSpec& vertexSpec = submeshes.front()->vertices()->vertexSpec();
     const unsigned int vertexStride = submeshes.front()->vertices()->stride();
+    const float positionScale = submeshes.front()->vertices()->positionScale();
+    const Vector3f positionOffset = submeshes.front()->vertices()->positionOffset();
 
-    // Verify that the strides and vertex specs of all submeshes match
+    // Verify that the strides and vertex specs of all submeshes match. Quantized
+    // submeshes must also share the same position transformation.
     unsigned int vertexCount = 0;
     for (vector<Submesh*>::const_iterator iter = submeshes.begin(); iter != submeshes.end(); ++iter)
     {
         Submesh* s = *iter;
-        if (s->vertices()->vertexSpec() != vertexSpec || s->vertices()->stride() != vertexStride)
+        if (s->vertices()->vertexSpec() != vertexSpec || s->vertices()->stride() != vertexStride ||
+            s->vertices()->positionScale() != positionScale || s->vertices()->positionOffset() != positionOffset)
         {
             VESTA_WARNING("MergeSubmeshes attempted on incompatible submeshes.");
             return NULL;
@@ -145,6 +156,7 @@ Submesh::mergeSubmeshes(const std::vector<Submesh*>& submeshes)
     {
         vertexData = new char[vertexDataSize];
         vertexArray = new VertexArray(vertexData, vertexCount, vertexSpec, vertexStride);
+        vertexArray->setPositionTransform(positionScale, positionOffset);
         submesh = new Submesh(vertexArray);
     }
     catch (bad_alloc&)
@@ -217,98 +229,6 @@ Submesh::mergeSubmeshes(const std::vector<Submesh*>& submeshes)
 }
 
 
-// Predicate to define an order on vertices
-class VertexOrderingPredicate
-{
-public:
-    VertexOrderingPredicate(const VertexArray* vertexArray) :
-        m_vertexArray(vertexArray),
-        m_vertexSpec(vertexArray->vertexSpec())
-    {
-    }
-
-    bool operator()(unsigned int index0, unsigned int index1) const
-    {
-        const VertexAttribute::Component* vertex0 = m_vertexArray->vertex(index0);
-        const VertexAttribute::Component* vertex1 = m_vertexArray->vertex(index1);
-
-        for (unsigned int attributeIndex = 0; attributeIndex < m_vertexSpec.attributeCount(); ++attributeIndex)
-        {
-            unsigned int attributeOffset = m_vertexSpec.attributeOffset(attributeIndex);
-            const VertexAttribute::Component* attr0 = vertex0 + (attributeOffset >> 2);
-            const VertexAttribute::Component* attr1 = vertex1 + (attributeOffset >> 2);
-
-            switch (m_vertexSpec.attribute(attributeIndex).format())
-            {
-            case VertexAttribute::Float4:
-                if (attr0[3].f < attr1[3].f)
-                {
-                    return true;
-                }
-                else if (attr0[3].f > attr1[3].f)
-                {
-                    return false;
-                }
-                // intentional fallthrough
-
-            case VertexAttribute::Float3:
-                if (attr0[2].f < attr1[2].f)
-                {
-                    return true;
-                }
-                else if (attr0[2].f > attr1[2].f)
-                {
-                    return false;
-                }
-                // intentional fallthrough
-
-            case VertexAttribute::Float2:
-                if (attr0[1].f < attr1[1].f)
-                {
-                    return true;
-                }
-                else if (attr0[1].f > attr1[1].f)
-                {
-                    return false;
-                }
-                // intentional fallthrough
-
-            case VertexAttribute::Float1:
-                if (attr0[0].f < attr1[0].f)
-                {
-                    return true;
-                }
-                else if (attr0[0].f > attr1[0].f)
-                {
-                    return false;
-                }
-                break;
-
-            case VertexAttribute::UByte4:
-                if (attr0[0].u < attr1[0].u)
-                {
-                    return true;
-                }
-                else if (attr0[0].u > attr1[0].u)
-                {
-                    return false;
-                }
-                break;
-
-            default:
-                break;
-            }
-        }
-
-        return false;
-    }
-
-private:
-    const VertexArray* m_vertexArray;
-    const VertexSpec& m_vertexSpec;
-};
-
-
 // See if f0 is a distance of tolerance or less from f1. This simple
 // test is used instead of a constant precision test because for testing
 // vertex equality we want the same 'granularity' over all vertices
@@ -384,7 +304,17 @@ public:
                 }
                 break;
 
+            // Packed formats are compared exactly
+            case VertexAttribute::Short4:
+                if (attr0[1].u != attr1[1].u)
+                {
+                    return false;
+                }
+                // intentional fallthrough
+
             case VertexAttribute::UByte4:
+            case VertexAttribute::Short2:
+            case VertexAttribute::Half2:
                 if (attr0[0].u != attr1[0].u)
                 {
                     return false;
@@ -399,6 +329,11 @@ public:
         return true;
     }
 
+    float tolerance(unsigned int attributeIndex) const
+    {
+        return m_tolerances[attributeIndex];
+    }
+
     // Set the per-component tolerance for an attribute
     void setTolerance(VertexAttribute::Semantic semantic, float tolerance)
     {
@@ -418,7 +353,190 @@ private:
 };
 
 
-/** Remove duplicate vertices in this submesh.
+// Vertex welding
+
+// Meshes with fewer vertices than this are welded on a single thread
+static const unsigned int ParallelWeldThreshold = 65536;
+static const unsigned int MaxWeldPartitions = 64;
+static const v_uint32 EmptySlot = 0xffffffff;
+
+
+static inline v_uint32
+hashMix(v_uint32 h, v_uint32 value)
+{
+    // FNV-1a style combining step followed by a final avalanche in hashFinish
+    return (h ^ value) * 16777619u;
+}
+
+
+static inline v_uint32
+hashFinish(v_uint32 h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+
+// Get the bits of a float for hashing; positive and negative zero must
+// hash to the same value since they compare equal.
+static inline v_uint32
+floatHashBits(const VertexAttribute::Component& c)
+{
+    return c.f == 0.0f ? 0u : c.u;
+}
+
+
+namespace
+{
+
+struct WeldContext
+{
+    WeldContext(const VertexArray* v, const VertexEqualityPredicate& e) :
+        vertices(v),
+        equal(e),
+        partitionCount(1)
+    {
+    }
+
+    const VertexArray* vertices;
+    const VertexEqualityPredicate& equal;
+
+    unsigned int partitionCount;
+    vector<v_uint32> keys;
+    vector<unsigned int> partitionStart;
+    vector<v_uint32> partitionVertices;
+    vector<v_uint32> representative;
+};
+
+}
+
+
+// Compute the hash key for a vertex. Vertices that the equality predicate
+// considers equal must have the same key.
+static v_uint32
+vertexKey(const WeldContext& context, unsigned int vertexIndex)
+{
+    const VertexSpec& spec = context.vertices->vertexSpec();
+    const VertexAttribute::Component* vertex = context.vertices->vertex(vertexIndex);
+    v_uint32 h = 2166136261u;
+
+    for (unsigned int attributeIndex = 0; attributeIndex < spec.attributeCount(); ++attributeIndex)
+    {
+        // Attributes compared with a tolerance can't contribute to the hash
+        if (context.equal.tolerance(attributeIndex) > 0.0f)
+        {
+            continue;
+        }
+
+        const VertexAttribute::Component* attr = vertex + (spec.attributeOffset(attributeIndex) >> 2);
+        VertexAttribute::Format format = spec.attribute(attributeIndex).format();
+        if (format == VertexAttribute::UByte4 || format == VertexAttribute::Short2 || format == VertexAttribute::Half2)
+        {
+            h = hashMix(h, attr[0].u);
+        }
+        else if (format == VertexAttribute::Short4)
+        {
+            h = hashMix(hashMix(h, attr[0].u), attr[1].u);
+        }
+        else
+        {
+            unsigned int componentCount = VertexAttribute::formatSize(format) / 4;
+            for (unsigned int i = 0; i < componentCount; ++i)
+            {
+                h = hashMix(h, floatHashBits(attr[i]));
+            }
+        }
+    }
+
+    return hashFinish(h);
+}
+
+
+static void
+computeKeysTask(void* data, unsigned int taskIndex)
+{
+    WeldContext* context = reinterpret_cast<WeldContext*>(data);
+    unsigned int vertexCount = context->vertices->count();
+    unsigned int rangeSize = (vertexCount + MaxWeldPartitions - 1) / MaxWeldPartitions;
+    unsigned int begin = min(vertexCount, taskIndex * rangeSize);
+    unsigned int end = min(vertexCount, begin + rangeSize);
+
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        context->keys[i] = vertexKey(*context, i);
+    }
+}
+
+
+// Find the first earlier vertex matching each vertex in a partition. Every
+// vertex that might match a given vertex is in the same partition, so
+// partitions can be processed concurrently.
+static void
+weldPartitionTask(void* data, unsigned int partition)
+{
+    WeldContext* context = reinterpret_cast<WeldContext*>(data);
+    unsigned int begin = context->partitionStart[partition];
+    unsigned int end = context->partitionStart[partition + 1];
+    if (begin == end)
+    {
+        return;
+    }
+
+    // Open addressing hash table of unique vertices; keep it at most half full
+    unsigned int tableSize = 1;
+    while (tableSize < (end - begin) * 2)
+    {
+        tableSize <<= 1;
+    }
+    unsigned int mask = tableSize - 1;
+    vector<v_uint32> table(tableSize, EmptySlot);
+
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        v_uint32 v = context->partitionVertices[i];
+        v_uint32 key = context->keys[v];
+        v_uint32 match = EmptySlot;
+
+        for (unsigned int slot = (key >> 6) & mask; table[slot] != EmptySlot; slot = (slot + 1) & mask)
+        {
+            v_uint32 candidate = table[slot];
+            if (context->keys[candidate] == key && context->equal(candidate, v))
+            {
+                match = candidate;
+                break;
+            }
+        }
+
+        if (match == EmptySlot)
+        {
+            // New unique vertex
+            unsigned int slot = (key >> 6) & mask;
+            while (table[slot] != EmptySlot)
+            {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = v;
+            match = v;
+        }
+
+        context->representative[v] = match;
+    }
+}
+
+
+/** Remove duplicate vertices in this submesh. Vertices are matched using a hash
+  * table, so the expected cost is linear in the number of vertices. Large
+  * meshes are split into partitions that are processed on multiple threads.
+  * The order of the remaining vertices is unchanged.
+  *
+  * Attributes compared with a non-zero tolerance can't contribute to the hash,
+  * so tolerant welding of large meshes is much slower than exact welding.
+  * Tolerant welding is not transitive: each vertex is merged with the first
+  * earlier vertex within tolerance, if there is one.
   *
   * \return true if unquification was successful, false if an error occurred (should only happen
   * in a low memory situation.)
@@ -426,79 +544,135 @@ private:
 bool
 Submesh::uniquifyVertices(float positionTolerance, float normalTolerance, float texCoordTolerance)
 {
-    vector<unsigned int> vertexIndices;
-    vertexIndices.resize(m_vertices->count());
-    for (unsigned int i = 0; i < m_vertices->count(); ++i)
+    unsigned int vertexCount = m_vertices->count();
+    if (vertexCount == 0)
     {
-        vertexIndices[i] = i;
+        return true;
     }
 
-    // Order the vertices so that identical ones will be close to each other.
-    sort(vertexIndices.begin(), vertexIndices.end(), VertexOrderingPredicate(m_vertices));
-
     VertexEqualityPredicate equal(m_vertices);
     equal.setTolerance(VertexAttribute::Position,     positionTolerance);
     equal.setTolerance(VertexAttribute::Normal,       normalTolerance);
     equal.setTolerance(VertexAttribute::TextureCoord, texCoordTolerance);
     equal.setTolerance(VertexAttribute::Tangent,      normalTolerance);
 
-    // Count the number of unique vertices so that we know how much space to allocate
-    unsigned int uniqueVertexCount = 0;
-    for (unsigned int i = 0; i < m_vertices->count(); ++i)
+    WeldContext context(m_vertices, equal);
+
+    bool parallel = vertexCount >= ParallelWeldThreshold;
+    if (parallel)
+    {
+        context.partitionCount = min(MaxWeldPartitions, ProcessorCount() * 4);
+    }
+
+    context.keys.resize(vertexCount);
+    context.representative.resize(vertexCount);
+    if (parallel)
+    {
+        ParallelFor(MaxWeldPartitions, computeKeysTask, &context);
+    }
+    else
     {
-        if (i == 0 || !equal(vertexIndices[i - 1], vertexIndices[i]))
+        for (unsigned int i = 0; i < vertexCount; ++i)
         {
-            uniqueVertexCount++;
+            context.keys[i] = vertexKey(context, i);
         }
     }
 
-    // Don't continue if we can't shrink the amount of vertex data
-    if (uniqueVertexCount == m_vertices->count())
+    // Bucket the vertices by partition, keeping them in their original order
+    // within each partition.
+    context.partitionStart.assign(context.partitionCount + 1, 0);
+    for (unsigned int i = 0; i < vertexCount; ++i)
     {
-        return true;
+        context.partitionStart[(context.keys[i] >> 26) % context.partitionCount + 1]++;
+    }
+    for (unsigned int p = 0; p < context.partitionCount; ++p)
+    {
+        context.partitionStart[p + 1] += context.partitionStart[p];
+    }
+
+    context.partitionVertices.resize(vertexCount);
+    {
+        vector<unsigned int> fill(context.partitionStart.begin(), context.partitionStart.end() - 1);
+        for (unsigned int i = 0; i < vertexCount; ++i)
+        {
+            context.partitionVertices[fill[(context.keys[i] >> 26) % context.partitionCount]++] = i;
+        }
+    }
+
+    if (context.partitionCount > 1)
+    {
+        ParallelFor(context.partitionCount, weldPartitionTask, &context);
+    }
+    else
+    {
+        weldPartitionTask(&context, 0);
     }
 
     // Build the map that associates vertices in the old vertex array with unique indices.
-    // In the same loop, copy the unique vertex data from the old vertex array to the
-    // new one.
-    vector<v_uint32> vertexMap;
-    vertexMap.resize(m_vertices->count());
+    // A vertex's representative always precedes it, so it will already have been assigned
+    // a new index.
+    vector<v_uint32> vertexMap(vertexCount);
+    unsigned int uniqueVertexCount = 0;
+    for (unsigned int i = 0; i < vertexCount; ++i)
+    {
+        v_uint32 rep = context.representative[i];
+        vertexMap[i] = rep == i ? uniqueVertexCount++ : vertexMap[rep];
+    }
+
+    // Don't continue if we can't shrink the amount of vertex data
+    if (uniqueVertexCount == vertexCount)
+    {
+        return true;
+    }
 
+    // Copy the unique vertex data from the old vertex array to the new one
     unsigned int vertexStride = m_vertices->stride();
-    char* newVertexData = new char[uniqueVertexCount * m_vertices->stride()];
+    char* newVertexData = new char[uniqueVertexCount * vertexStride];
     const char* currentVertexData = reinterpret_cast<const char*>(m_vertices->data());
-
-    v_uint32 newVertexIndex = 0;
-    for (unsigned int i = 0; i < m_vertices->count(); ++i)
+    for (unsigned int i = 0; i < vertexCount; ++i)
     {
-        if (i == 0 || !equal(vertexIndices[i - 1], vertexIndices[i]))
+        if (context.representative[i] == i)
         {
-            if (i > 0)
-            {
-                newVertexIndex++;
-            }
-
-            assert(newVertexIndex < uniqueVertexCount);
-            const char* vertexStart = currentVertexData + vertexIndices[i] * vertexStride;
-            copy(vertexStart, vertexStart + vertexStride, newVertexData + newVertexIndex * vertexStride);
+            const char* vertexStart = currentVertexData + i * vertexStride;
+            copy(vertexStart, vertexStart + vertexStride, newVertexData + vertexMap[i] * vertexStride);
         }
-
-        vertexMap[vertexIndices[i]] = newVertexIndex;
     }
 
     VertexArray* newVertexArray = new VertexArray(newVertexData, uniqueVertexCount, m_vertices->vertexSpec(), m_vertices->stride());
+    newVertexArray->setPositionTransform(m_vertices->positionScale(), m_vertices->positionOffset());
+
+    if (!remapVertices(vertexMap, newVertexArray))
+    {
+        delete newVertexArray;
+        return false;
+    }
+
+    //VESTA_LOG("%d of %d vertices unique.", uniqueVertexCount, vertexCount);
+
+    return true;
+}
+
+
+// Replace the vertex array and update all primitive batches to use the new
+// vertex indices given in vertexMap.
+bool
+Submesh::remapVertices(const vector<v_uint32>& vertexMap, VertexArray* newVertices)
+{
+    unsigned int newVertexCount = newVertices->count();
+
+    // Simplified batches aren't remapped; they must be rebuilt afterward
+    clearLevelsOfDetail();
 
     // Remap all vertex indices
     for (vector<PrimitiveBatch*>::iterator iter = m_primitiveBatches.begin(); iter != m_primitiveBatches.end(); ++iter)
     {
         // Vertex remapping might require us to promote 16-bit indices to 32-bit,
         // even though the total number of vertices has been reduced.
-        if (uniqueVertexCount > PrimitiveBatch::MaxIndex16 && (*iter)->indexSize() == PrimitiveBatch::Index16)
+        if (newVertexCount > PrimitiveBatch::MaxIndex16 && (*iter)->indexSize() == PrimitiveBatch::Index16)
         {
             if (!(*iter)->promoteTo32Bit())
             {
                 VESTA_WARNING("Problem remapping vertex indices. Unable to promote 16-bit indices to 32-bit.");
-                delete newVertexArray;
                 return false;
             }
         }
@@ -508,20 +682,169 @@ Submesh::uniquifyVertices(float positionTolerance, float normalTolerance, float
             // This should never occur; the only problem case has been dealt with by promoting
             // 16-bit indices to 32-bit.
             VESTA_WARNING("Problem remapping vertex indices.");
-            delete newVertexArray;
             return false;
         }
     }
 
     delete m_vertices;
-    m_vertices = newVertexArray;
+    m_vertices = newVertices;
+
+    return true;
+}
+
+
+// Get the vertex indices of a batch as 32-bit values
+static void
+getBatchIndices(const PrimitiveBatch* batch, vector<v_uint32>& indices)
+{
+    unsigned int indexCount = batch->indexCount();
+    indices.resize(indexCount);
+
+    if (!batch->isIndexed())
+    {
+        for (unsigned int i = 0; i < indexCount; ++i)
+        {
+            indices[i] = batch->firstVertex() + i;
+        }
+    }
+    else if (batch->indexSize() == PrimitiveBatch::Index16)
+    {
+        const v_uint16* index16 = reinterpret_cast<const v_uint16*>(batch->indexData());
+        copy(index16, index16 + indexCount, indices.begin());
+    }
+    else
+    {
+        const v_uint32* index32 = reinterpret_cast<const v_uint32*>(batch->indexData());
+        copy(index32, index32 + indexCount, indices.begin());
+    }
+}
+
+
+/** Reorder triangles and vertices for efficient rendering. The triangles in
+  * each indexed triangle list are reordered to make better use of the GPU's
+  * post-transform vertex cache. Then the vertices are sorted in the order that
+  * they are first used, so that vertex fetches are mostly sequential.
+  *
+  * This should be called after uniquifyVertices and mergeMaterials, since it
+  * is most effective on large batches of shared vertices.
+  *
+  * \return true if the optimization was successful (it should only ever fail in
+  *         out of memory conditions.)
+  */
+bool
+Submesh::optimizeVertexCache()
+{
+    clearLevelsOfDetail();
+
+    unsigned int vertexCount = m_vertices->count();
+    vector<v_uint32> indices;
+    vector<v_uint32> optimizedIndices;
+
+    for (unsigned int batchIndex = 0; batchIndex < m_primitiveBatches.size(); ++batchIndex)
+    {
+        PrimitiveBatch* batch = m_primitiveBatches[batchIndex];
+        if (batch->primitiveType() != PrimitiveBatch::Triangles || !batch->isIndexed() || batch->primitiveCount() < 2)
+        {
+            continue;
+        }
+
+        getBatchIndices(batch, indices);
+        optimizedIndices.resize(indices.size());
+        OptimizeTriangleOrder(&indices[0], batch->primitiveCount(), vertexCount, &optimizedIndices[0]);
+
+        PrimitiveBatch* optimizedBatch = new PrimitiveBatch(PrimitiveBatch::Triangles, &optimizedIndices[0], batch->primitiveCount());
+        if (batch->indexSize() == PrimitiveBatch::Index16)
+        {
+            optimizedBatch->compressTo16Bit();
+        }
+
+        delete batch;
+        m_primitiveBatches[batchIndex] = optimizedBatch;
+    }
+
+    // Number vertices in order of first use. Any unused vertices go at the end.
+    const v_uint32 Unassigned = 0xffffffff;
+    vector<v_uint32> vertexMap(vertexCount, Unassigned);
+    v_uint32 nextVertex = 0;
+    for (unsigned int batchIndex = 0; batchIndex < m_primitiveBatches.size(); ++batchIndex)
+    {
+        getBatchIndices(m_primitiveBatches[batchIndex], indices);
+        for (unsigned int i = 0; i < indices.size(); ++i)
+        {
+            if (vertexMap[indices[i]] == Unassigned)
+            {
+                vertexMap[indices[i]] = nextVertex++;
+            }
+        }
+    }
 
-    //VESTA_LOG("%d of %d vertices unique.", uniqueVertexCount, vertexIndices.size());
+    bool identity = true;
+    for (unsigned int i = 0; i < vertexCount; ++i)
+    {
+        if (vertexMap[i] == Unassigned)
+        {
+            vertexMap[i] = nextVertex++;
+        }
+        identity = identity && vertexMap[i] == i;
+    }
+
+    if (identity)
+    {
+        return true;
+    }
+
+    unsigned int vertexStride = m_vertices->stride();
+    char* newVertexData = new char[vertexCount * vertexStride];
+    const char* currentVertexData = reinterpret_cast<const char*>(m_vertices->data());
+    for (unsigned int i = 0; i < vertexCount; ++i)
+    {
+        const char* vertexStart = currentVertexData + i * vertexStride;
+        copy(vertexStart, vertexStart + vertexStride, newVertexData + vertexMap[i] * vertexStride);
+    }
+
+    VertexArray* newVertexArray = new VertexArray(newVertexData, vertexCount, m_vertices->vertexSpec(), vertexStride);
+    newVertexArray->setPositionTransform(m_vertices->positionScale(), m_vertices->positionOffset());
+    if (!remapVertices(vertexMap, newVertexArray))
+    {
+        delete newVertexArray;
+        return false;
+    }
 
     return true;
 }
 
 
+/** Compute the average cache miss ratio (ACMR) of the indexed triangle lists
+  * in this submesh: the average number of vertices that must be transformed
+  * per triangle, with a simulated post-transform cache of the specified
+  * size. Other primitive types are ignored. Returns zero if the submesh has no
+  * indexed triangle lists.
+  */
+float
+Submesh::averageCacheMissRatio(unsigned int cacheSize) const
+{
+    vector<v_uint32> indices;
+    double missCount = 0.0;
+    unsigned int triangleCount = 0;
+
+    for (unsigned int batchIndex = 0; batchIndex < m_primitiveBatches.size(); ++batchIndex)
+    {
+        const PrimitiveBatch* batch = m_primitiveBatches[batchIndex];
+        if (batch->primitiveType() != PrimitiveBatch::Triangles || !batch->isIndexed() || batch->primitiveCount() == 0)
+        {
+            continue;
+        }
+
+        getBatchIndices(batch, indices);
+        float acmr = AverageCacheMissRatio(&indices[0], batch->primitiveCount(), m_vertices->count(), cacheSize);
+        missCount += double(acmr) * batch->primitiveCount();
+        triangleCount += batch->primitiveCount();
+    }
+
+    return triangleCount == 0 ? 0.0f : float(missCount / triangleCount);
+}
+
+
 /** Compress indices to 16-bit where possible. This can improve rendering performance
   * on some hardware, and some mobile GPUs can only use 16-bit vertex indices.
   */
@@ -536,6 +859,405 @@ Submesh::compressIndices()
             batch->compressTo16Bit();
         }
     }
+
+    for (vector<LevelOfDetail>::iterator level = m_levels.begin(); level != m_levels.end(); ++level)
+    {
+        for (vector<PrimitiveBatch*>::iterator iter = level->batches.begin(); iter != level->batches.end(); ++iter)
+        {
+            if (*iter && (*iter)->indexSize() == PrimitiveBatch::Index32)
+            {
+                (*iter)->compressTo16Bit();
+            }
+        }
+    }
+}
+
+
+// Batches with fewer triangles than this aren't worth simplifying
+static const unsigned int MinSimplifiedTriangleCount = 64;
+
+// A level of detail is only kept if it has at most this fraction of the
+// triangles in the previous level.
+static const float MaxLevelTriangleRatio = 0.75f;
+
+
+/** Build a chain of simplified versions of the indexed triangle lists in this
+  * submesh. Each level has roughly half as many triangles as the one before
+  * it, and the chain ends early when simplification stops making progress.
+  * Simplified batches reuse the vertices of the submesh, so the extra levels
+  * only cost index data. Vertices shared by batches with different materials
+  * are kept fixed so that no cracks open between the batches.
+  *
+  * This should be the last of the optimization steps; the other steps
+  * discard any levels of detail.
+  *
+  * \return true if at least one level of detail was created
+  */
+bool
+Submesh::buildLevelsOfDetail(unsigned int maxLevelCount)
+{
+    clearLevelsOfDetail();
+
+    unsigned int vertexCount = m_vertices->count();
+    unsigned int batchCount = m_primitiveBatches.size();
+    vector<float> positions(vertexCount * 3);
+    for (unsigned int i = 0; i < vertexCount; ++i)
+    {
+        Vector3f p = m_vertices->position(i);
+        positions[i * 3 + 0] = p.x();
+        positions[i * 3 + 1] = p.y();
+        positions[i * 3 + 2] = p.z();
+    }
+
+    // Lock all vertices used by more than one batch
+    const unsigned int Unused = 0xffffffff;
+    vector<unsigned int> vertexBatch(vertexCount, Unused);
+    vector<bool> locked(vertexCount, false);
+    vector<v_uint32> indices;
+    for (unsigned int batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+    {
+        getBatchIndices(m_primitiveBatches[batchIndex], indices);
+        for (unsigned int i = 0; i < indices.size(); ++i)
+        {
+            v_uint32 v = indices[i];
+            if (vertexBatch[v] == Unused)
+            {
+                vertexBatch[v] = batchIndex;
+            }
+            else if (vertexBatch[v] != batchIndex)
+            {
+                locked[v] = true;
+            }
+        }
+    }
+
+    vector<MeshSimplifier*> simplifiers(batchCount, (MeshSimplifier*) NULL);
+    unsigned int previousTriangleCount = 0;
+    for (unsigned int batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+    {
+        const PrimitiveBatch* batch = m_primitiveBatches[batchIndex];
+        if (batch->primitiveType() == PrimitiveBatch::Triangles && batch->primitiveCount() >= MinSimplifiedTriangleCount)
+        {
+            getBatchIndices(batch, indices);
+            simplifiers[batchIndex] = new MeshSimplifier(&positions[0], vertexCount, &indices[0], batch->primitiveCount(), locked);
+            previousTriangleCount += batch->primitiveCount();
+        }
+    }
+
+    float previousError = 0.0f;
+    vector<v_uint32> optimizedIndices;
+    for (unsigned int level = 1; level <= maxLevelCount && previousTriangleCount > 0; ++level)
+    {
+        unsigned int triangleCount = 0;
+        float error = previousError;
+        for (unsigned int batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+        {
+            MeshSimplifier* simplifier = simplifiers[batchIndex];
+            if (simplifier)
+            {
+                simplifier->simplify(simplifier->triangleCount() / 2);
+                triangleCount += simplifier->triangleCount();
+                error = max(error, simplifier->error());
+            }
+        }
+
+        if (triangleCount > previousTriangleCount * MaxLevelTriangleRatio)
+        {
+            break;
+        }
+
+        vector<PrimitiveBatch*> batches(batchCount, (PrimitiveBatch*) NULL);
+        for (unsigned int batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+        {
+            MeshSimplifier* simplifier = simplifiers[batchIndex];
+            if (!simplifier)
+            {
+                continue;
+            }
+
+            unsigned int simplifiedCount = simplifier->triangleCount();
+            if (simplifiedCount == 0)
+            {
+                batches[batchIndex] = new PrimitiveBatch(PrimitiveBatch::Triangles, 0);
+                continue;
+            }
+
+            optimizedIndices.resize(simplifiedCount * 3);
+            OptimizeTriangleOrder(&simplifier->indices()[0], simplifiedCount, vertexCount, &optimizedIndices[0]);
+            batches[batchIndex] = new PrimitiveBatch(PrimitiveBatch::Triangles, &optimizedIndices[0], simplifiedCount);
+            if (m_primitiveBatches[batchIndex]->indexSize() == PrimitiveBatch::Index16)
+            {
+                batches[batchIndex]->compressTo16Bit();
+            }
+        }
+
+        addLevelOfDetail(error, batches);
+        previousTriangleCount = triangleCount;
+        previousError = error;
+    }
+
+    for (unsigned int i = 0; i < simplifiers.size(); ++i)
+    {
+        delete simplifiers[i];
+    }
+
+    return !m_levels.empty();
+}
+
+
+/** Append a level of detail. The batches vector must have one entry for each
+  * primitive batch in the submesh; null entries are drawn using the full
+  * resolution batch. The submesh takes ownership of the batches.
+  */
+void
+Submesh::addLevelOfDetail(float error, const vector<PrimitiveBatch*>& batches)
+{
+    assert(batches.size() == m_primitiveBatches.size());
+
+    LevelOfDetail level;
+    level.error = error;
+    level.batches = batches;
+    m_levels.push_back(level);
+}
+
+
+void
+Submesh::clearLevelsOfDetail()
+{
+    for (vector<LevelOfDetail>::iterator level = m_levels.begin(); level != m_levels.end(); ++level)
+    {
+        for (vector<PrimitiveBatch*>::iterator iter = level->batches.begin(); iter != level->batches.end(); ++iter)
+        {
+            delete *iter;
+        }
+    }
+    m_levels.clear();
+}
+
+
+// Convert a float to an IEEE 754 half precision value, rounding to nearest.
+// Values too large for a half become infinity, and tiny values become
+// denormals or zero.
+static v_uint16
+floatToHalf(float f)
+{
+    VertexAttribute::Component c;
+    c.f = f;
+    v_uint32 bits = c.u;
+
+    v_uint16 sign = v_uint16((bits >> 16) & 0x8000);
+    int exponent = int((bits >> 23) & 0xff) - 127 + 15;
+    v_uint32 mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+    {
+        // Infinity or NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    else if (exponent >= 31)
+    {
+        return sign | 0x7c00;
+    }
+    else if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return sign;
+        }
+
+        // Denormal: shift in the implicit leading one
+        mantissa |= 0x800000;
+        unsigned int shift = 14 - exponent;
+        v_uint32 half = mantissa >> shift;
+        v_uint32 remainder = mantissa & ((1u << shift) - 1);
+        v_uint32 halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+        {
+            ++half;
+        }
+        return sign | v_uint16(half);
+    }
+    else
+    {
+        v_uint32 half = (v_uint32(exponent) << 10) | (mantissa >> 13);
+        v_uint32 remainder = mantissa & 0x1fff;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        {
+            // A carry out of the mantissa correctly bumps the exponent
+            ++half;
+        }
+        return sign | v_uint16(half);
+    }
+}
+
+
+// Convert a value in [-1, 1] to a 16-bit signed normalized integer
+static v_int16
+floatToSnorm16(float f)
+{
+    f = max(-1.0f, min(1.0f, f));
+    return v_int16(floor(f * 32767.0f + 0.5f));
+}
+
+
+// Encode a direction using the octahedral mapping: the unit sphere is
+// projected onto an octahedron, which is then unfolded into the [-1, 1]
+// square. The error of the 2x16-bit encoding is well under a thousandth of
+// a degree.
+static void
+octahedralEncode(const Vector3f& v, v_int16* encoded)
+{
+    float l1 = abs(v.x()) + abs(v.y()) + abs(v.z());
+    if (l1 == 0.0f)
+    {
+        encoded[0] = 0;
+        encoded[1] = 0;
+        return;
+    }
+
+    float x = v.x() / l1;
+    float y = v.y() / l1;
+    if (v.z() < 0.0f)
+    {
+        float fx = (1.0f - abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+
+    encoded[0] = floatToSnorm16(x);
+    encoded[1] = floatToSnorm16(y);
+}
+
+
+/** Convert vertex attributes to compact formats:
+  *   - Float3 positions become 16-bit integers (Short4) relative to the
+  *     bounding box of the submesh, with a uniform scale.
+  *   - Float3 normals and tangents become two 16-bit octahedral coordinates
+  *     (Short2).
+  *   - Float2 texture coordinates become half precision floats (Half2).
+  * Other attributes are copied unchanged. A vertex with position, normal, and
+  * texture coordinates shrinks from 32 to 16 bytes.
+  *
+  * The scale is the same along all axes so that the position transformation
+  * can be folded into the modelview matrix without distorting normals. The
+  * precision of positions is thus 1/65534 of the largest dimension of the
+  * submesh bounding box.
+  *
+  * Rendering quantized vertices requires GLSL shaders and half float vertex
+  * attributes. Vertex order is unchanged, so levels of detail are kept.
+  *
+  * @return false if the submesh doesn't have Float3 positions
+  */
+bool
+Submesh::quantizeVertices()
+{
+    const VertexSpec& spec = m_vertices->vertexSpec();
+    unsigned int positionIndex = spec.attributeIndex(VertexAttribute::Position);
+    if (positionIndex == VertexSpec::InvalidAttribute ||
+        spec.attribute(positionIndex).format() != VertexAttribute::Float3)
+    {
+        return false;
+    }
+
+    unsigned int attributeCount = spec.attributeCount();
+    vector<VertexAttribute> attributes(attributeCount);
+    for (unsigned int i = 0; i < attributeCount; ++i)
+    {
+        VertexAttribute attr = spec.attribute(i);
+        VertexAttribute::Format format = attr.format();
+        switch (attr.semantic())
+        {
+        case VertexAttribute::Position:
+            format = VertexAttribute::Short4;
+            break;
+        case VertexAttribute::Normal:
+        case VertexAttribute::Tangent:
+            format = format == VertexAttribute::Float3 ? VertexAttribute::Short2 : format;
+            break;
+        case VertexAttribute::TextureCoord:
+            format = format == VertexAttribute::Float2 ? VertexAttribute::Half2 : format;
+            break;
+        default:
+            break;
+        }
+        attributes[i] = VertexAttribute(attr.semantic(), format);
+    }
+
+    VertexSpec newSpec(attributeCount, &attributes[0]);
+
+    BoundingBox bbox = m_vertices->computeBoundingBox();
+    Vector3f center = (bbox.minPoint() + bbox.maxPoint()) * 0.5f;
+    float halfExtent = bbox.extents().maxCoeff() * 0.5f;
+    float scale = halfExtent > 0.0f ? halfExtent / 32767.0f : 1.0f;
+
+    unsigned int vertexCount = m_vertices->count();
+    unsigned int oldStride = m_vertices->stride();
+    unsigned int newStride = newSpec.size();
+
+    char* newVertexData = NULL;
+    try
+    {
+        newVertexData = new char[vertexCount * newStride];
+    }
+    catch (bad_alloc&)
+    {
+        VESTA_WARNING("Out of memory during vertex quantization.");
+        return false;
+    }
+
+    const char* oldVertexData = reinterpret_cast<const char*>(m_vertices->data());
+    for (unsigned int v = 0; v < vertexCount; ++v)
+    {
+        const char* oldVertex = oldVertexData + v * oldStride;
+        char* newVertex = newVertexData + v * newStride;
+
+        for (unsigned int i = 0; i < attributeCount; ++i)
+        {
+            const char* src = oldVertex + spec.attributeOffset(i);
+            char* dst = newVertex + newSpec.attributeOffset(i);
+            const float* f = reinterpret_cast<const float*>(src);
+
+            switch (newSpec.attribute(i).format())
+            {
+            case VertexAttribute::Short4:
+                {
+                    v_int16* q = reinterpret_cast<v_int16*>(dst);
+                    Vector3f p = (Vector3f::Map(f) - center) / scale;
+                    for (unsigned int k = 0; k < 3; ++k)
+                    {
+                        q[k] = v_int16(max(-32767.0f, min(32767.0f, floor(p[k] + 0.5f))));
+                    }
+                    q[3] = 0;
+                }
+                break;
+
+            case VertexAttribute::Short2:
+                octahedralEncode(Vector3f::Map(f), reinterpret_cast<v_int16*>(dst));
+                break;
+
+            case VertexAttribute::Half2:
+                reinterpret_cast<v_uint16*>(dst)[0] = floatToHalf(f[0]);
+                reinterpret_cast<v_uint16*>(dst)[1] = floatToHalf(f[1]);
+                break;
+
+            default:
+                copy(src, src + VertexAttribute::formatSize(newSpec.attribute(i).format()), dst);
+                break;
+            }
+        }
+    }
+
+    VertexArray* newVertexArray = new VertexArray(newVertexData, vertexCount, newSpec, newStride);
+    newVertexArray->setPositionTransform(scale, center);
+
+    delete m_vertices;
+    m_vertices = newVertexArray;
+
+    m_boundingBox = m_vertices->computeBoundingBox();
+    m_boundingSphereRadius = m_vertices->computeBoundingSphereRadius();
+
+    return true;
 }
 
 
@@ -856,6 +1578,8 @@ Submesh::mergeMaterials()
         return false;
     }
 
+    clearLevelsOfDetail();
+
     // Sort primitive batches by the materials assignmed to them
     vector<unsigned int> batchIndices;
     for (unsigned int i = 0; i < m_primitiveBatches.size(); ++i)
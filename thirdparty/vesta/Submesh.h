@@ -73,15 +73,63 @@ public:
     void compressIndices();
 
     bool mergeMaterials();
+    bool optimizeVertexCache();
+
+    float averageCacheMissRatio(unsigned int cacheSize = 16) const;
+
+    bool buildLevelsOfDetail(unsigned int maxLevelCount = DefaultLevelOfDetailCount);
+    bool quantizeVertices();
+    void addLevelOfDetail(float error, const std::vector<PrimitiveBatch*>& batches);
+
+    /** Get the number of levels of detail, including the full resolution
+      * level 0.
+      */
+    unsigned int levelOfDetailCount() const
+    {
+        return m_levels.size() + 1;
+    }
+
+    /** Get the geometric error of a level of detail, in the units of the
+      * vertex positions. This is the area weighted RMS distance measure of
+      * MeshSimplifier::error(), not a bound on the largest deviation from the
+      * full resolution surface. The error of level 0 is zero, and the error
+      * never decreases with increasing level.
+      */
+    float levelOfDetailError(unsigned int level) const
+    {
+        return level == 0 ? 0.0f : m_levels[level - 1].error;
+    }
+
+    /** Get the primitive batch that should be drawn in place of the batch at
+      * batchIndex for the specified level of detail. Batches that couldn't be
+      * simplified are shared with level 0.
+      */
+    const PrimitiveBatch* levelOfDetailBatch(unsigned int level, unsigned int batchIndex) const
+    {
+        const PrimitiveBatch* batch = level == 0 ? 0 : m_levels[level - 1].batches[batchIndex];
+        return batch ? batch : m_primitiveBatches[batchIndex];
+    }
 
     static const unsigned int DefaultMaterialIndex = 0xffffffff;
+    static const unsigned int DefaultLevelOfDetailCount = 4;
 
 private:
+    bool remapVertices(const std::vector<v_uint32>& vertexMap, VertexArray* newVertices);
+    void clearLevelsOfDetail();
+
+private:
+    struct LevelOfDetail
+    {
+        float error;
+        std::vector<PrimitiveBatch*> batches;
+    };
+
     VertexArray* m_vertices;
     std::vector<PrimitiveBatch*> m_primitiveBatches;
     std::vector<unsigned int> m_materials;
     BoundingBox m_boundingBox;
     float m_boundingSphereRadius;
+    std::vector<LevelOfDetail> m_levels;
 };
 
 }
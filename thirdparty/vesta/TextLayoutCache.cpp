@@ -0,0 +1,203 @@
+/*
+ * $Revision: 223 $ $Date: 2010-03-30 05:44:44 -0700 (Tue, 30 Mar 2010) $
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "TextLayoutCache.h"
+#include <algorithm>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Layout of vertices produced by TextureFont::renderStringToBuffer(): x, y, z, u, v
+static const unsigned int VertexSizeFloats = 5;
+static const unsigned int VerticesPerGlyph = 6;
+
+
+TextLayoutCache::TextLayoutCache(unsigned int capacity) :
+    m_capacity(max(1u, capacity)),
+    m_hits(0),
+    m_misses(0),
+    m_evictions(0)
+{
+}
+
+
+TextLayoutCache::~TextLayoutCache()
+{
+}
+
+
+/** Get the layout of a string of text, laying it out and adding it to the cache
+  * if necessary. The returned pointer remains valid until the next call to
+  * layout(), clear(), or setCapacity().
+  *
+  * \return the text layout, or NULL if font is NULL
+  */
+const TextLayout*
+TextLayoutCache::layout(const TextureFont* font, const string& text, TextureFont::Encoding encoding)
+{
+    if (!font)
+    {
+        return NULL;
+    }
+
+    LayoutKey key;
+    key.font = font;
+    key.encoding = encoding;
+    key.textHash = HashText(text);
+
+    pair<LayoutIndex::iterator, LayoutIndex::iterator> matches = m_index.equal_range(key);
+    for (LayoutIndex::iterator iter = matches.first; iter != matches.second; ++iter)
+    {
+        CacheEntry& entry = *iter->second;
+        if (entry.text == text)
+        {
+            // Move the entry to the front of the list; the least recently used
+            // layout is always at the back.
+            m_entries.splice(m_entries.begin(), m_entries, iter->second);
+
+            // Text laid out before the font's glyphs were loaded (or before
+            // they changed) has to be laid out again.
+            if (entry.fontGeneration != font->generation())
+            {
+                ++m_misses;
+                LayOut(entry, encoding);
+            }
+            else
+            {
+                ++m_hits;
+            }
+
+            return &entry.layout;
+        }
+    }
+
+    ++m_misses;
+
+    // Make room for the new entry
+    evict(m_capacity - 1);
+
+    m_entries.push_front(CacheEntry());
+    CacheEntry& entry = m_entries.front();
+    entry.key = key;
+    entry.text = text;
+    entry.font = const_cast<TextureFont*>(font);
+    LayOut(entry, encoding);
+
+    m_index.insert(make_pair(key, m_entries.begin()));
+
+    return &entry.layout;
+}
+
+
+/** Remove all layouts from the cache.
+  */
+void
+TextLayoutCache::clear()
+{
+    m_index.clear();
+    m_entries.clear();
+}
+
+
+/** Set the maximum number of layouts that will be cached. If the cache
+  * currently contains more layouts, the least recently used ones are
+  * discarded.
+  */
+void
+TextLayoutCache::setCapacity(unsigned int capacity)
+{
+    m_capacity = max(1u, capacity);
+    evict(m_capacity);
+}
+
+
+/** Reset the hit, miss, and eviction counters.
+  */
+void
+TextLayoutCache::resetStatistics()
+{
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+}
+
+
+// Discard least recently used layouts until no more than maxSize remain
+void
+TextLayoutCache::evict(unsigned int maxSize)
+{
+    while (m_index.size() > maxSize)
+    {
+        EntryList::iterator last = m_entries.end();
+        --last;
+
+        pair<LayoutIndex::iterator, LayoutIndex::iterator> matches = m_index.equal_range(last->key);
+        for (LayoutIndex::iterator iter = matches.first; iter != matches.second; ++iter)
+        {
+            if (iter->second == last)
+            {
+                m_index.erase(iter);
+                break;
+            }
+        }
+
+        m_entries.pop_back();
+        ++m_evictions;
+    }
+}
+
+
+// FNV-1a hash of the bytes of a string
+unsigned int
+TextLayoutCache::HashText(const string& text)
+{
+    unsigned int hash = 2166136261u;
+    for (string::const_iterator iter = text.begin(); iter != text.end(); ++iter)
+    {
+        hash ^= (unsigned char) *iter;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+// Build the glyph quads for the text of a cache entry
+void
+TextLayoutCache::LayOut(CacheEntry& entry, TextureFont::Encoding encoding)
+{
+    const TextureFont* font = entry.font.ptr();
+    const string& text = entry.text;
+    entry.fontGeneration = font->generation();
+
+    // No encoding produces more than one glyph per byte of text.
+    TextLayout& layout = entry.layout;
+    layout.vertices.resize(max(size_t(1), text.length()) * VerticesPerGlyph * VertexSizeFloats);
+    layout.vertexCount = 0;
+    Vector2f endPosition = font->renderStringToBuffer(text,
+                                                      Vector2f::Zero(),
+                                                      encoding,
+                                                      reinterpret_cast<char*>(&layout.vertices[0]),
+                                                      (unsigned int) (layout.vertices.size() * sizeof(float)),
+                                                      &layout.vertexCount);
+    layout.vertices.resize(layout.vertexCount * VertexSizeFloats);
+    layout.width = endPosition.x();
+    layout.ascent = 0.0f;
+    layout.descent = 0.0f;
+
+    for (unsigned int i = 0; i < layout.vertexCount; ++i)
+    {
+        float y = layout.vertices[i * VertexSizeFloats + 1];
+        layout.ascent = max(layout.ascent, y);
+        layout.descent = max(layout.descent, -y);
+    }
+}
@@ -0,0 +1,166 @@
+/*
+ * $Revision: 223 $ $Date: 2010-03-30 05:44:44 -0700 (Tue, 30 Mar 2010) $
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_TEXT_LAYOUT_CACHE_H_
+#define _VESTA_TEXT_LAYOUT_CACHE_H_
+
+#include "TextureFont.h"
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+
+
+namespace vesta
+{
+
+/** TextLayout holds the glyph quads for a string of text, laid out with the
+  * start of the baseline at the origin. Vertices are in the PositionTex format
+  * expected by RenderContext, with three vertices per triangle and two triangles
+  * per glyph.
+  */
+struct TextLayout
+{
+    std::vector<float> vertices;
+    unsigned int vertexCount;
+
+    /** Horizontal advance of the whole string in pixels */
+    float width;
+
+    /** Maximum height of any glyph above the baseline in pixels */
+    float ascent;
+
+    /** Maximum distance that any glyph extends below the baseline in pixels */
+    float descent;
+};
+
+
+/** TextLayoutCache stores laid out strings of text so that labels, which
+  * rarely change, don't have to decode their text and rebuild glyph quads
+  * every frame. Layouts are keyed by font, encoding, and string; a layout is
+  * rebuilt if the glyphs of its font have changed since it was made. The cache
+  * holds a bounded number of layouts and discards the least recently used
+  * ones when it fills up.
+  */
+class TextLayoutCache : public Object
+{
+public:
+    TextLayoutCache(unsigned int capacity = DefaultCapacity);
+    ~TextLayoutCache();
+
+    const TextLayout* layout(const TextureFont* font, const std::string& text, TextureFont::Encoding encoding);
+
+    void clear();
+
+    /** Get the maximum number of layouts that will be cached.
+      */
+    unsigned int capacity() const
+    {
+        return m_capacity;
+    }
+
+    void setCapacity(unsigned int capacity);
+
+    /** Get the number of layouts currently in the cache.
+      */
+    unsigned int size() const
+    {
+        return (unsigned int) m_index.size();
+    }
+
+    /** Get the number of lookups that found a cached layout.
+      */
+    unsigned int hits() const
+    {
+        return m_hits;
+    }
+
+    /** Get the number of lookups that required a string to be laid out.
+      */
+    unsigned int misses() const
+    {
+        return m_misses;
+    }
+
+    /** Get the number of layouts that were discarded to make room for others.
+      */
+    unsigned int evictions() const
+    {
+        return m_evictions;
+    }
+
+    /** Get the fraction of lookups that found a cached layout.
+      */
+    float hitRate() const
+    {
+        unsigned int lookups = m_hits + m_misses;
+        return lookups == 0 ? 0.0f : float(m_hits) / float(lookups);
+    }
+
+    void resetStatistics();
+
+    static const unsigned int DefaultCapacity = 2048;
+
+private:
+    // Layouts are indexed by a hash of the text rather than by the text
+    // itself, so that looking up a cached layout doesn't require a copy of
+    // the string. Strings with the same hash are told apart by the text
+    // stored in the cache entry.
+    struct LayoutKey
+    {
+        const TextureFont* font;
+        TextureFont::Encoding encoding;
+        unsigned int textHash;
+
+        bool operator<(const LayoutKey& other) const
+        {
+            if (font != other.font)
+                return font < other.font;
+            else if (encoding != other.encoding)
+                return encoding < other.encoding;
+            else
+                return textHash < other.textHash;
+        }
+    };
+
+    struct CacheEntry
+    {
+        LayoutKey key;
+        std::string text;
+
+        // Keep a reference to the font so that its address can't be reused
+        // by another font while the layout is cached.
+        counted_ptr<TextureFont> font;
+
+        // Generation of the font when the text was laid out
+        unsigned int fontGeneration;
+        TextLayout layout;
+    };
+
+    typedef std::list<CacheEntry> EntryList;
+    typedef std::multimap<LayoutKey, EntryList::iterator> LayoutIndex;
+
+    static unsigned int HashText(const std::string& text);
+    static void LayOut(CacheEntry& entry, TextureFont::Encoding encoding);
+    void evict(unsigned int maxSize);
+
+private:
+    unsigned int m_capacity;
+    EntryList m_entries;
+    LayoutIndex m_index;
+
+    unsigned int m_hits;
+    unsigned int m_misses;
+    unsigned int m_evictions;
+};
+
+}
+
+#endif // _VESTA_TEXT_LAYOUT_CACHE_H_
@@ -32,6 +32,7 @@ counted_ptr<TextureFont> TextureFont::ms_defaultFont;
  */
 TextureFont::TextureFont() :
     m_maxCharacterId(0),
+    m_generation(0),
     m_maxAscent(0.0f),
     m_maxDescent(0.0f)
 {
@@ -686,6 +687,9 @@ TextureFont::buildCharacterSet()
             m_characterSet[iter->characterId] = (unsigned int) (iter - m_glyphs.begin());
         }
     }
+
+    // Layouts made with the old character set are no longer valid
+    ++m_generation;
 }
 
 
@@ -82,6 +82,15 @@ public:
         return m_glyphTexture.ptr();
     }
 
+    /** Get a number that changes whenever the set of glyphs in the font
+      * changes. Text laid out with an earlier generation of the font is
+      * out of date.
+      */
+    unsigned int generation() const
+    {
+        return m_generation;
+    }
+
     bool loadTxf(const DataChunk* data);
 
     static TextureFont* LoadTxf(const DataChunk* data);
@@ -104,6 +113,7 @@ private:
     std::vector<Glyph> m_glyphs;
     std::vector<unsigned int> m_characterSet;
     unsigned int m_maxCharacterId;
+    unsigned int m_generation;
 
     static counted_ptr<TextureFont> ms_defaultFont;
 
@@ -239,7 +239,11 @@ TextureMap::TextureMap(const string& name, TextureMapLoader* loader) :
     m_memoryUsage(0),
     m_loader(loader),
     m_name(name),
-    m_lastUsed(0)
+    m_lastUsed(0),
+    m_lruPrev(NULL),
+    m_lruNext(NULL),
+    m_lruLinked(false),
+    m_trackedMemoryUsage(0)
 {
 }
 
@@ -251,7 +255,11 @@ TextureMap::TextureMap(const string& name, TextureMapLoader* loader, const Textu
     m_loader(loader),
     m_name(name),
     m_properties(properties),
-    m_lastUsed(0)
+    m_lastUsed(0),
+    m_lruPrev(NULL),
+    m_lruNext(NULL),
+    m_lruLinked(false),
+    m_trackedMemoryUsage(0)
 {
 }
 
@@ -267,7 +275,11 @@ TextureMap::TextureMap(unsigned int glTexId, const TextureProperties& properties
     m_memoryUsage(0),
     m_loader(0),
     m_properties(properties),
-    m_lastUsed(0)
+    m_lastUsed(0),
+    m_lruPrev(NULL),
+    m_lruNext(NULL),
+    m_lruLinked(false),
+    m_trackedMemoryUsage(0)
 {
 }
 
@@ -282,7 +294,11 @@ TextureMap::TextureMap(unsigned int glTexId) :
     m_id(glTexId),
     m_memoryUsage(0),
     m_loader(0),
-    m_lastUsed(0)
+    m_lastUsed(0),
+    m_lruPrev(NULL),
+    m_lruNext(NULL),
+    m_lruLinked(false),
+    m_trackedMemoryUsage(0)
 {
 }
 
@@ -293,6 +309,11 @@ TextureMap::~TextureMap()
     {
         glDeleteTextures(1, &m_id);
     }
+
+    if (m_loader)
+    {
+        m_loader->forgetTexture(this);
+    }
 }
 
 
@@ -310,7 +331,7 @@ TextureMap::makeResident()
         {
             m_loader->makeResident(this);
         }
-        m_lastUsed = m_loader->frameCount();
+        m_loader->markTextureUsed(this);
     }
 
     return isResident();
@@ -543,8 +564,8 @@ TextureMap::generateCompressed(const char compressedImageData[],
     }
     applyProperties(m_properties);
 
-    setStatus(Ready);
     m_memoryUsage = mipLevelOffset;
+    setStatus(Ready);
 
     return true;
 }
@@ -613,6 +634,22 @@ TextureMap::generateCompressedFit(const char compressedImageData[],
 }
 
 
+/** Set the texture loading status.
+  * @see TextureMap::status()
+  */
+void
+TextureMap::setStatus(Status status)
+{
+    m_status = status;
+
+    // Let the loader keep track of resident textures and their memory usage
+    if (m_loader)
+    {
+        m_loader->updateTextureResidency(this);
+    }
+}
+
+
 /** Release the graphics memory used by the texture and mark it as uninitialized.
   */
 void
@@ -13,6 +13,7 @@
 
 #include "Object.h"
 #include "IntegerTypes.h"
+#include "internal/AtomicInt.h"
 #include <string>
 
 
@@ -204,13 +205,7 @@ public:
         return m_status;
     }
 
-    /** Set the texture loading status.
-      * @see TextureMap::status()
-      */
-    void setStatus(Status status)
-    {
-        m_status = status;
-    }
+    void setStatus(Status status);
 
     /** Get the amount of graphics memory used by the texture in bytes. This
       * method returns 0 when the status is some value other than Ready. The
@@ -234,10 +229,13 @@ public:
       * values indicate more recently used textures, though the exact interpretation
       * is up to the texture loader. The texture loader uses the value of lastUsed()
       * to determine which textures to evict.
+      *
+      * The value is set by the renderer and may be read from other threads,
+      * e.g. to prioritize requests for tiles.
       */
     v_int64 lastUsed() const
     {
-        return m_lastUsed;
+        return m_lastUsed.load();
     }
 
     /** Set the last used value for this texture.
@@ -245,7 +243,7 @@ public:
      */
     void setLastUsed(v_int64 lastUsed)
     {
-        m_lastUsed = lastUsed;
+        m_lastUsed.store(lastUsed);
     }
 
     void evict();
@@ -269,7 +267,14 @@ private:
     TextureMapLoader* m_loader;
     const std::string m_name;
     TextureProperties m_properties;
-    v_int64 m_lastUsed;
+    AtomicInt64 m_lastUsed;
+
+    // Bookkeeping for the loader's list of resident textures. The list is
+    // ordered from most to least recently used.
+    TextureMap* m_lruPrev;
+    TextureMap* m_lruNext;
+    bool m_lruLinked;
+    unsigned int m_trackedMemoryUsage;
 };
 
 }
@@ -10,6 +10,7 @@
 
 #include "TextureMapLoader.h"
 #include "Debug.h"
+#include "Profiler.h"
 #include <vector>
 #include <algorithm>
 #include <sstream>
@@ -22,13 +23,23 @@ using namespace std;
 
 
 TextureMapLoader::TextureMapLoader() :
-    m_frameCount(0)
+    m_frameCount(0),
+    m_lruHead(NULL),
+    m_lruTail(NULL),
+    m_residentTextureCount(0),
+    m_textureMemoryUsed(0)
 {
 }
 
 
 TextureMapLoader::~TextureMapLoader()
 {
+    // Detach all textures from the loader; textures referenced elsewhere
+    // may outlive it.
+    for (TextureTable::iterator iter = m_textures.begin(); iter != m_textures.end(); ++iter)
+    {
+        iter->second->m_loader = NULL;
+    }
 }
 
 
@@ -106,6 +117,27 @@ TextureMapLoader::makeResident(TextureMap* texture)
 }
 
 
+/** Return the number of textures that have been requested but haven't
+  * yet finished loading. This requires a scan of all textures, so it's intended
+  * for situations (such as offline rendering) where it's necessary to wait
+  * until every texture used in a frame is available.
+  */
+unsigned int
+TextureMapLoader::loadingTextureCount() const
+{
+    unsigned int count = 0;
+    for (TextureTable::const_iterator iter = m_textures.begin(); iter != m_textures.end(); ++iter)
+    {
+        if (iter->second->status() == TextureMap::Loading)
+        {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+
 /** Update the frame count. The frame count is used to track texture usage in order
   * to determine which textures should be evicted first when trimming graphics memory
   * usage.
@@ -117,16 +149,6 @@ TextureMapLoader::incrementFrameCount()
 }
 
 
-class TextureAgePredicate
-{
-public:
-    bool operator() (const TextureMap* t0, const TextureMap* t1) const
-    {
-        return t0->lastUsed() < t1->lastUsed();
-    }
-};
-
-
 /** Evict textures in order to reduce texture memory usage. Textures
   * will be evicted until the total size of textures managed by this
   * texture loader is less than or equal to desired memory. Least recently
@@ -134,73 +156,176 @@ public:
   * greater than mostRecentAllowed will be evicted, even if it means that
   * the desired memory target can't be reached.
   *
+  * Resident textures are kept in a list ordered by last use, so the cost
+  * of eviction is proportional to the number of textures evicted rather
+  * than the total number of textures. Evicted textures that aren't referenced
+  * by anything except the loader are released.
+  *
   * Evict textures must be called from a thread in which a GL context
-  * is current (typically the display thread.) It can take some time to
-  * process all textures, so it shouldn't be called frequently (i.e.
-  * once a frame is too often.)
+  * is current (typically the display thread.)
   *
   * \return the total size of all textures remaining
   */
 v_uint64
 TextureMapLoader::evictTextures(v_uint64 desiredMemory, v_int64 mostRecentAllowed)
 {
+    VESTA_PROFILE_SCOPE("TextureMapLoader::evictTextures");
+
 #if DEBUG_EVICTION
-    // Show all textures managed by this loader
-    for (TextureTable::const_iterator iter = m_textures.begin(); iter != m_textures.end(); ++iter)
+    // Show all resident textures managed by this loader
+    for (TextureMap* t = m_lruHead; t != NULL; t = t->m_lruNext)
     {
-        VESTA_LOG("Texture: %s, mem: %.2f", iter->second.ptr()->name().c_str(), double(iter->second.ptr()->memoryUsage()) / (1024*1024));
+        VESTA_LOG("Texture: %s, mem: %.2f", t->name().c_str(), double(t->memoryUsage()) / (1024*1024));
     }
 #endif
 
-    v_uint64 textureMemory = textureMemoryUsed();
+    // Evict textures from the least recently used end of the list until we
+    // reach the memory target
+    TextureMap* t = m_lruTail;
+    while (t != NULL && t->lastUsed() <= mostRecentAllowed && m_textureMemoryUsed > desiredMemory)
+    {
+        TextureMap* next = t->m_lruPrev;
+
+#if DEBUG_EVICTION
+        VESTA_LOG("evict %s @ %d", t->name().c_str(), (int) t->lastUsed());
+#endif
+        // Evicting the texture removes it from the list
+        t->evict();
+        releaseTexture(t);
+
+        t = next;
+    }
+
+    VESTA_PROFILE_COUNTER("Texture memory (MB)", double(m_textureMemoryUsed) / (1024 * 1024));
+
+    return m_textureMemoryUsed;
+}
+
 
-    // Early out if the memory usage target is already met
-    if (textureMemory < desiredMemory)
+/** Remove a texture from the loader's table if it isn't resident, isn't
+  * being loaded, and isn't referenced by anything other than the loader.
+  * Objects that cache textures from the loader (such as tiled maps) should
+  * call this method after they drop their reference to a texture; otherwise,
+  * the loader would keep every texture that was ever requested.
+  *
+  * \return true if the texture was released
+  */
+bool
+TextureMapLoader::releaseTexture(TextureMap* texture)
+{
+    if (texture == NULL ||
+        texture->refCount() > 1 ||
+        texture->isResident() ||
+        texture->status() == TextureMap::Loading)
     {
-        return textureMemory;
+        return false;
     }
 
-    // Create a list of textures sorted such that least recently used textures are first.
-    vector<TextureMap*> sortedTextures;
-    for (TextureTable::const_iterator iter = m_textures.begin(); iter != m_textures.end(); ++iter)
+    TextureTable::iterator iter = m_textures.find(GenerateKey(texture->name(), texture->properties()));
+    if (iter == m_textures.end() || iter->second.ptr() != texture)
+    {
+        return false;
+    }
+
+    m_textures.erase(iter);
+
+    return true;
+}
+
+
+// Record that a texture was used in the current frame and move it to the
+// front of the resident texture list.
+void
+TextureMapLoader::markTextureUsed(TextureMap* texture)
+{
+    texture->setLastUsed(m_frameCount);
+    if (texture->m_lruLinked && texture != m_lruHead)
     {
-        sortedTextures.push_back(iter->second.ptr());
+        unlinkResidentTexture(texture);
+        linkResidentTexture(texture);
     }
-    sort(sortedTextures.begin(), sortedTextures.end(), TextureAgePredicate());
+}
+
 
-    // Evict textures until we reach the memory target
-    for (vector<TextureMap*>::const_iterator iter = sortedTextures.begin();
-         iter != sortedTextures.end() && (*iter)->lastUsed() <= mostRecentAllowed && textureMemory > desiredMemory;
-         ++iter)
+// Called whenever the status of a texture changes. Keeps the list of
+// resident textures and the total memory usage up to date.
+void
+TextureMapLoader::updateTextureResidency(TextureMap* texture)
+{
+    unsigned int memoryUsage = texture->memoryUsage();
+    m_textureMemoryUsed += memoryUsage;
+    m_textureMemoryUsed -= texture->m_trackedMemoryUsage;
+    texture->m_trackedMemoryUsage = memoryUsage;
+
+    if (texture->isResident() && !texture->m_lruLinked)
     {
-        TextureMap* t = *iter;
-        if (t->isResident())
-        {
-#if DEBUG_EVICTION
-            VESTA_LOG("evict %s @ %d", t->name().c_str(), (int) t->lastUsed());
-#endif
-            textureMemory -= t->memoryUsage();
-            t->evict();
-        }
+        linkResidentTexture(texture);
+    }
+    else if (!texture->isResident() && texture->m_lruLinked)
+    {
+        unlinkResidentTexture(texture);
     }
+}
+
 
-    return textureMemory;
+// Called when a texture is destroyed
+void
+TextureMapLoader::forgetTexture(TextureMap* texture)
+{
+    m_textureMemoryUsed -= texture->m_trackedMemoryUsage;
+    texture->m_trackedMemoryUsage = 0;
+
+    if (texture->m_lruLinked)
+    {
+        unlinkResidentTexture(texture);
+    }
 }
 
 
-/** Return the amount of texture memory used for all textures managed by
-  * this loader.
-  */
-v_uint64
-TextureMapLoader::textureMemoryUsed() const
+// Insert a texture at the head (most recently used end) of the resident list
+void
+TextureMapLoader::linkResidentTexture(TextureMap* texture)
 {
-    // TODO: we should track this rather than counting textures every time
+    texture->m_lruPrev = NULL;
+    texture->m_lruNext = m_lruHead;
+    if (m_lruHead)
+    {
+        m_lruHead->m_lruPrev = texture;
+    }
+    else
+    {
+        m_lruTail = texture;
+    }
+    m_lruHead = texture;
 
-    v_uint64 total = 0;
-    for (TextureTable::const_iterator iter = m_textures.begin(); iter != m_textures.end(); ++iter)
+    texture->m_lruLinked = true;
+    ++m_residentTextureCount;
+}
+
+
+void
+TextureMapLoader::unlinkResidentTexture(TextureMap* texture)
+{
+    if (texture->m_lruPrev)
+    {
+        texture->m_lruPrev->m_lruNext = texture->m_lruNext;
+    }
+    else
+    {
+        m_lruHead = texture->m_lruNext;
+    }
+
+    if (texture->m_lruNext)
+    {
+        texture->m_lruNext->m_lruPrev = texture->m_lruPrev;
+    }
+    else
     {
-        total += iter->second.ptr()->memoryUsage();
+        m_lruTail = texture->m_lruPrev;
     }
 
-    return total;
+    texture->m_lruPrev = NULL;
+    texture->m_lruNext = NULL;
+    texture->m_lruLinked = false;
+    --m_residentTextureCount;
 }
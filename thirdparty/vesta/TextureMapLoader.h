@@ -22,6 +22,8 @@ namespace vesta
 
 class TextureMapLoader : public Object
 {
+friend class TextureMap;
+
 public:
     TextureMapLoader();
     virtual ~TextureMapLoader();
@@ -37,7 +39,33 @@ public:
     virtual bool handleMakeResident(TextureMap* texture) = 0;
 
     v_uint64 evictTextures(v_uint64 desiredMemory, v_int64 mostRecentAllowed);
-    v_uint64 textureMemoryUsed() const;
+    bool releaseTexture(TextureMap* texture);
+
+    /** Return the amount of texture memory used for all textures managed by
+      * this loader. The total is updated whenever a texture is loaded or evicted,
+      * so this method is inexpensive.
+      */
+    v_uint64 textureMemoryUsed() const
+    {
+        return m_textureMemoryUsed;
+    }
+
+    /** Return the number of textures managed by this loader, including textures
+      * that aren't resident.
+      */
+    unsigned int textureCount() const
+    {
+        return (unsigned int) m_textures.size();
+    }
+
+    /** Return the number of resident textures managed by this loader.
+      */
+    unsigned int residentTextureCount() const
+    {
+        return m_residentTextureCount;
+    }
+
+    unsigned int loadingTextureCount() const;
 
     /** Get the current frame count for this texture loader. The frame count is
       * used to track texture usage so that least recently used textures can
@@ -57,10 +85,25 @@ public:
 protected:
     virtual std::string resolveResourceName(const std::string& resourceName);
 
+private:
+    // These are called by TextureMap
+    void markTextureUsed(TextureMap* texture);
+    void updateTextureResidency(TextureMap* texture);
+    void forgetTexture(TextureMap* texture);
+
+    void linkResidentTexture(TextureMap* texture);
+    void unlinkResidentTexture(TextureMap* texture);
+
 private:
     v_int64 m_frameCount;
     typedef std::map<std::string, counted_ptr<TextureMap> > TextureTable;
     TextureTable m_textures;
+
+    // Resident textures, most recently used first
+    TextureMap* m_lruHead;
+    TextureMap* m_lruTail;
+    unsigned int m_residentTextureCount;
+    v_uint64 m_textureMemoryUsed;
 };
 
 }
@@ -198,6 +198,15 @@ Universe::pickObject(PickContext* pc,
     double closest = numeric_limits<double>::infinity();
     PickResult closestResult;
 
+    // Gather the pickable entities and the bounding spheres of their geometry, then test
+    // the pick ray against all of the bounding spheres at once.
+    vector<Entity*> entities;
+    vector<Vector3d> positions;
+    vector<double> centerX;
+    vector<double> centerY;
+    vector<double> centerZ;
+    vector<double> radii;
+
     for (EntityTable::const_iterator iter = m_entities.begin(); iter != m_entities.end(); ++iter)
     {
         Entity* entity = iter->ptr();
@@ -207,60 +216,79 @@ Universe::pickObject(PickContext* pc,
             if (entity->isVisible() && entity->chronology()->includesTime(t))
             {
                 Vector3d position = entity->position(t);
+                entities.push_back(entity);
+                positions.push_back(position);
+                centerX.push_back(position.x());
+                centerY.push_back(position.y());
+                centerZ.push_back(position.z());
+
+                // Entities without geometry get an empty sphere, which is never hit
+                radii.push_back(entity->geometry() ? double(entity->geometry()->boundingSphereRadius()) : 0.0);
+            }
+        }
+    }
 
-                if (entity->geometry())
+    vector<double> intersectionDistances(entities.size());
+    if (!entities.empty())
+    {
+        TestRayBatchSphereIntersection(pc->pickOrigin(), pc->pickDirection(),
+                                       &centerX[0], &centerY[0], &centerZ[0], &radii[0],
+                                       (unsigned int) entities.size(),
+                                       &intersectionDistances[0]);
+    }
+
+    for (unsigned int i = 0; i < entities.size(); ++i)
+    {
+        Entity* entity = entities[i];
+        const Vector3d& position = positions[i];
+
+        if (entity->geometry())
+        {
+            Geometry* geometry = entity->geometry();
+            double intersectionDistance = intersectionDistances[i];
+            if (intersectionDistance >= 0.0)
+            {
+                if (intersectionDistance < closest)
                 {
-                    Geometry* geometry = entity->geometry();
-                    double intersectionDistance;
-                    if (TestRaySphereIntersection(pc->pickOrigin(),
-                                                  pc->pickDirection(),
-                                                  position,
-                                                  geometry->boundingSphereRadius(),
-                                                  &intersectionDistance))
+                    // Transform the pick ray into the local coordinate system of body
+                    Matrix3d invRotation = entity->orientation(t).conjugate().toRotationMatrix();
+                    Vector3d relativePickOrigin = invRotation * (pc->pickOrigin() - position);
+                    Vector3d relativePickDirection = invRotation * pc->pickDirection();
+
+                    double distance = intersectionDistance;
+                    if (geometry->rayPick(relativePickOrigin, relativePickDirection, t, &distance))
                     {
-                        if (intersectionDistance < closest)
+                        if (distance < closest)
                         {
-                            // Transform the pick ray into the local coordinate system of body
-                            Matrix3d invRotation = entity->orientation(t).conjugate().toRotationMatrix();
-                            Vector3d relativePickOrigin = invRotation * (pc->pickOrigin() - position);
-                            Vector3d relativePickDirection = invRotation * pc->pickDirection();
-
-                            double distance = intersectionDistance;
-                            if (geometry->rayPick(relativePickOrigin, relativePickDirection, t, &distance))
-                            {
-                                if (distance < closest)
-                                {
-                                    closest = distance;
-                                    closestResult.setHit(entity, distance, pc->pickOrigin() + pc->pickDirection() * distance);
-                                }
-                            }
+                            closest = distance;
+                            closestResult.setHit(entity, distance, pc->pickOrigin() + pc->pickDirection() * distance);
                         }
                     }
                 }
+            }
+        }
 
-                // Visualizers may act as 'pick proxies'
-                if (entity->hasVisualizers())
-                {
-                    Vector3d relativePickOrigin = pc->pickOrigin() - position;
+        // Visualizers may act as 'pick proxies'
+        if (entity->hasVisualizers())
+        {
+            Vector3d relativePickOrigin = pc->pickOrigin() - position;
 
-                    // Calculate the distance to the plane containing the center of the visualizer
-                    // and perpendicular to the pick direction.
-                    double distanceToPlane = -pc->pickDirection().dot(relativePickOrigin);
+            // Calculate the distance to the plane containing the center of the visualizer
+            // and perpendicular to the pick direction.
+            double distanceToPlane = -pc->pickDirection().dot(relativePickOrigin);
 
-                    if (distanceToPlane > 0.0 && distanceToPlane < closest)
+            if (distanceToPlane > 0.0 && distanceToPlane < closest)
+            {
+                for (Entity::VisualizerTable::const_iterator iter = entity->visualizers()->begin();
+                     iter != entity->visualizers()->end(); ++iter)
+                {
+                    const Visualizer* visualizer = iter->second.ptr();
+                    if (visualizer->isVisible() &&
+                        visualizer->rayPick(pc, relativePickOrigin, t))
                     {
-                        for (Entity::VisualizerTable::const_iterator iter = entity->visualizers()->begin();
-                             iter != entity->visualizers()->end(); ++iter)
-                        {
-                            const Visualizer* visualizer = iter->second.ptr();
-                            if (visualizer->isVisible() &&
-                                visualizer->rayPick(pc, relativePickOrigin, t))
-                            {
-                                closest = distanceToPlane;
-                                closestResult.setHit(entity, distanceToPlane, pc->pickOrigin() + pc->pickDirection() * distanceToPlane);
-                                break;
-                            }
-                        }
+                        closest = distanceToPlane;
+                        closestResult.setHit(entity, distanceToPlane, pc->pickOrigin() + pc->pickDirection() * distanceToPlane);
+                        break;
                     }
                 }
             }
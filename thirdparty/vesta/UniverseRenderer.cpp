@@ -23,8 +23,11 @@
 #include "TextureFont.h"
 #include "GlareOverlay.h"
 #include "LabelGeometry.h"
+#include "LabelPlacement.h"
 #include "glhelp/GLFramebuffer.h"
 #include "Units.h"
+#include "Stopwatch.h"
+#include "Profiler.h"
 #include "internal/EclipseShadowVolumeSet.h"
 #include <Eigen/Geometry>
 #include <algorithm>
@@ -70,6 +73,26 @@ static const Quaterniond CubeFaceCameraRotations[6] =
 };
 
 
+static void
+resetTimings(UniverseRenderer::RenderTimings& timings)
+{
+    timings.viewSetSetup = 0.0;
+    timings.visibleItemScan = 0.0;
+    timings.depthSplitting = 0.0;
+    timings.drawing = 0.0;
+    timings.labelPlacement = 0.0;
+    timings.viewCount = 0;
+    timings.entityCount = 0;
+    timings.visibleItemCount = 0;
+    timings.depthSpanCount = 0;
+    timings.depthPassCount = 0;
+    timings.drawCalls = 0;
+    timings.shaderSwitches = 0;
+    timings.uniformUploads = 0;
+    timings.redundantUniforms = 0;
+}
+
+
 /** Construct a new UniverseRenderer. The renderer may not be used for drawing
   * until its initializeGraphics method has been called. Initialization is not
   * performed in the constructor: a UniverseRenderer can be created at any time,
@@ -85,6 +108,9 @@ UniverseRenderer::UniverseRenderer() :
     m_visualizersEnabled(true),
     m_skyLayersEnabled(true),
     m_defaultSunEnabled(true),
+    m_depthStrategy(DepthSpans),
+    m_logDepthActive(false),
+    m_stateSortingEnabled(true),
     m_renderViewport(1, 1),
     m_viewIndependentInitializationRequired(true),
     m_lastProjection(PlanarProjection::Perspective, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 10.0f)
@@ -92,6 +118,7 @@ UniverseRenderer::UniverseRenderer() :
     m_sun = new LightSource();
     m_sun->setLightType(LightSource::Sun);
     m_eclipseShadows = new EclipseShadowVolumeSet();
+    resetTimings(m_viewSetTimings);
 }
 
 
@@ -150,6 +177,42 @@ UniverseRenderer::setEclipseShadowsEnabled(bool enable)
 }
 
 
+/** Set the strategy used to cover the range of distances in a view with the
+  * depth buffer. LogarithmicDepth draws everything in a single pass, avoiding
+  * the extra passes (and repeated shadow map rendering) needed when visible
+  * objects lie at widely separated distances. When logarithmic depth isn't
+  * supported by the render context, the renderer falls back to DepthSpans.
+  */
+void
+UniverseRenderer::setDepthStrategy(DepthStrategy strategy)
+{
+    m_depthStrategy = strategy;
+}
+
+
+/** Return true if the LogarithmicDepth strategy is available. This is only
+  * known once graphics have been initialized.
+  */
+bool
+UniverseRenderer::logarithmicDepthSupported() const
+{
+    return m_renderContext && m_renderContext->isLogarithmicDepthSupported();
+}
+
+
+/** Enable or disable sorting of opaque items by render state. When enabled,
+  * opaque items within a depth buffer span are grouped by shader and then by
+  * base texture, as reported by Geometry::renderStateKeys(), and drawn front
+  * to back within each group. When disabled, items are drawn strictly from
+  * back to front.
+  */
+void
+UniverseRenderer::setStateSortingEnabled(bool enable)
+{
+    m_stateSortingEnabled = enable;
+}
+
+
 /** Enable or disable the drawing of visualizers.
   */
 void
@@ -375,6 +438,13 @@ UniverseRenderer::beginViewSet(const Universe* universe, double tsec)
         return RenderViewSetAlreadyStarted;
     }
 
+    VESTA_PROFILE_SCOPE("UniverseRenderer::beginViewSet");
+
+    Stopwatch stopwatch;
+    resetTimings(m_viewSetTimings);
+    m_renderContext->resetStatistics();
+    m_renderContext->textLayoutCache()->resetStatistics();
+
     m_universe = universe;
     m_currentTime = tsec;
 
@@ -418,6 +488,8 @@ UniverseRenderer::beginViewSet(const Universe* universe, double tsec)
     // Set a flag indicating that we haven't rendered any views in this set yet
     m_viewIndependentInitializationRequired = true;
 
+    m_viewSetTimings.viewSetSetup = stopwatch.elapsed();
+
     return RenderOk;
 }
 
@@ -557,6 +629,11 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
         return RenderNoViewSet;
     }
 
+    VESTA_PROFILE_SCOPE("UniverseRenderer::renderView");
+
+    Stopwatch stopwatch;
+    double drawTime = 0.0;
+
     // Last used projection is required for glare rendering
     m_lastProjection = projection;
 
@@ -595,51 +672,14 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
     m_renderContext->setPixelSize((float) (2 * tan(fieldOfView / 2.0) / viewport.height()));
     m_renderContext->setViewportSize(viewport.width(), viewport.height());
 
-    m_renderContext->pushModelView();
-    m_renderContext->rotateModelView(cameraOrientation.conjugate().cast<float>());
-
-    // Draw sky layers grids
-    glDepthMask(GL_FALSE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_TEXTURE_2D);
-
-    m_renderContext->setProjection(projection.slice(0.1f, 1.0f));
-
-    if (m_skyLayersEnabled)
+    if (m_labelPlacement.isValid())
     {
-        vector<SkyLayer*> visibleLayers;
-        const Universe::SkyLayerTable* skyLayers = m_universe->layers();
-        for (Universe::SkyLayerTable::const_iterator iter = skyLayers->begin(); iter != skyLayers->end(); ++iter)
-        {
-            SkyLayer* layer = iter->second.ptr();
-            if (layer && layer->isVisible())
-            {
-                visibleLayers.push_back(layer);
-            }
-
-            sort(visibleLayers.begin(), visibleLayers.end(), skyLayerOrderPredicate);
-        }
-
-        for (vector<SkyLayer*>::const_iterator iter = visibleLayers.begin(); iter != visibleLayers.end(); ++iter)
-        {
-#ifndef VESTA_NO_FIXED_FUNCTION_3D
-            glDisable(GL_LIGHTING);
-#endif
-            (*iter)->render(*m_renderContext);
-        }
+        m_labelPlacement->beginView(viewport.width(), viewport.height());
+        m_renderContext->setLabelPlacement(m_labelPlacement.ptr());
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-
-#ifndef VESTA_NO_FIXED_FUNCTION_3D
-    // Fixed function state setup
-    glEnable(GL_NORMALIZE);
-    glEnable(GL_LIGHTING);
-#endif
-
-    m_renderContext->setActiveLightCount(1);
-    m_renderContext->setAmbientLight(m_ambientLight);
+    m_renderContext->pushModelView();
+    m_renderContext->rotateModelView(cameraOrientation.conjugate().cast<float>());
 
     m_viewFrustum = projection.frustum();
 
@@ -656,190 +696,134 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
 
     buildVisibleLightSourceList(cameraPosition);
 
-    // Simply scan through all entities in the universe.
-    // TODO: For better performance with many entities, we could maintain a
-    // bounding sphere hierarchy.
-    for (vector<Entity*>::const_iterator iter = entities.begin(); iter != entities.end(); ++iter)
     {
-        const Entity* entity = *iter;
+        VESTA_PROFILE_SCOPE("UniverseRenderer::visibleItemScan");
 
-        if (entity->isVisible(m_currentTime))
+        // Simply scan through all entities in the universe.
+        // TODO: For better performance with many entities, we could maintain a
+        // bounding sphere hierarchy.
+        for (vector<Entity*>::const_iterator iter = entities.begin(); iter != entities.end(); ++iter)
         {
-            Vector3d position = entity->position(m_currentTime);
+            const Entity* entity = *iter;
 
-            // Calculate the difference at double precision, then convert to single
-            // precision for the rest of the work.
-            Vector3d cameraRelativePosition = (position - cameraPosition);
-
-            // Cull objects based on size. If an object is less than one pixel in size,
-            // we don't draw its geometry. Visualizers have sizes that may be unrelated
-            // to the size of the object, so we don't cull them.
-            // TODO: Add a method to the visualizer class that specifies whether the size
-            // culling test (i.e. if the visualizer geometry has a fixed size on screen--such
-            // as a label--then it shouldn't be culled.)
-            bool sizeCull = false;
-            if (entity->geometry())
-            {
-                float projectedSize = (entity->geometry()->boundingSphereRadius() / float(cameraRelativePosition.norm())) / m_renderContext->pixelSize();
-                sizeCull = projectedSize < 0.5f;
-            }
-            else
+            if (entity->isVisible(m_currentTime))
             {
-                // Objects without geometry are always culled.
-                sizeCull = true;
-            }
-
-            // We need the camera space position of the object in order to depth
-            // sort the objects.
-            Vector3f cameraSpacePosition = toCameraSpace * cameraRelativePosition.cast<float>();
+                Vector3d position = entity->position(m_currentTime);
+
+                // Calculate the difference at double precision, then convert to single
+                // precision for the rest of the work.
+                Vector3d cameraRelativePosition = (position - cameraPosition);
+
+                // Cull objects based on size. If an object is less than one pixel in size,
+                // we don't draw its geometry. Visualizers have sizes that may be unrelated
+                // to the size of the object, so we don't cull them.
+                // TODO: Add a method to the visualizer class that specifies whether the size
+                // culling test (i.e. if the visualizer geometry has a fixed size on screen--such
+                // as a label--then it shouldn't be culled.)
+                bool sizeCull = false;
+                if (entity->geometry())
+                {
+                    float projectedSize = (entity->geometry()->boundingSphereRadius() / float(cameraRelativePosition.norm())) / m_renderContext->pixelSize();
+                    sizeCull = projectedSize < 0.5f;
+                }
+                else
+                {
+                    // Objects without geometry are always culled.
+                    sizeCull = true;
+                }
 
-            if (!sizeCull)
-            {
-                addVisibleItem(entity, entity->geometry(),
-                               position, cameraRelativePosition, cameraSpacePosition,
-                               entity->orientation(m_currentTime).cast<float>(),
-                               nearPlaneFovAdjustment);
-            }
+                // We need the camera space position of the object in order to depth
+                // sort the objects.
+                Vector3f cameraSpacePosition = toCameraSpace * cameraRelativePosition.cast<float>();
 
-            // Add an eclipse shadow volume for this body if it is ellipsoidal. We only
-            // need to do this for the first view in the set; subsequent views can reuse
-            // the shadow volume set because shadow volumes are not view dependent.
-            if (m_eclipseShadowsEnabled &&
-                m_viewIndependentInitializationRequired &&
-                entity->geometry() &&
-                entity->geometry()->isEllipsoidal() &&
-                entity->geometry()->isShadowCaster() &&
-                !entity->lightSource())
-            {
-                // Add the shadow volume (except when no sun light source is defined.)
-                if (!m_lightSources.empty() && m_lightSources.front().lightSource->lightType() == LightSource::Sun)
+                if (!sizeCull)
                 {
-                    m_eclipseShadows->addShadow(entity,
-                                                position,
-                                                entity->orientation(m_currentTime).cast<float>(),
-                                                m_lightSources.front().position,
-                                                m_lightSources.front().radius);
+                    addVisibleItem(entity, entity->geometry(),
+                                   position, cameraRelativePosition, cameraSpacePosition,
+                                   entity->orientation(m_currentTime).cast<float>(),
+                                   nearPlaneFovAdjustment);
                 }
-            }
 
-            if (entity->hasVisualizers() && m_visualizersEnabled)
-            {
-                for (Entity::VisualizerTable::const_iterator iter = entity->visualizers()->begin();
-                     iter != entity->visualizers()->end(); ++iter)
+                // Add an eclipse shadow volume for this body if it is ellipsoidal. We only
+                // need to do this for the first view in the set; subsequent views can reuse
+                // the shadow volume set because shadow volumes are not view dependent.
+                if (m_eclipseShadowsEnabled &&
+                    m_viewIndependentInitializationRequired &&
+                    entity->geometry() &&
+                    entity->geometry()->isEllipsoidal() &&
+                    entity->geometry()->isShadowCaster() &&
+                    !entity->lightSource())
                 {
-                    const Visualizer* visualizer = iter->second.ptr();
-                    if (visualizer->isVisible())
+                    // Add the shadow volume (except when no sun light source is defined.)
+                    if (!m_lightSources.empty() && m_lightSources.front().lightSource->lightType() == LightSource::Sun)
                     {
-                        Vector3d adjustedPosition = cameraRelativePosition;
-                        Vector3f adjustedCameraSpacePosition = cameraSpacePosition;
+                        m_eclipseShadows->addShadow(entity,
+                                                    position,
+                                                    entity->orientation(m_currentTime).cast<float>(),
+                                                    m_lightSources.front().position,
+                                                    m_lightSources.front().radius);
+                    }
+                }
 
-                        if (visualizer->depthAdjustment() == Visualizer::AdjustToFront)
+                if (entity->hasVisualizers() && m_visualizersEnabled)
+                {
+                    for (Entity::VisualizerTable::const_iterator iter = entity->visualizers()->begin();
+                         iter != entity->visualizers()->end(); ++iter)
+                    {
+                        const Visualizer* visualizer = iter->second.ptr();
+                        if (visualizer->isVisible())
                         {
-                            // Adjust the position of the visualizer so that it is drawn in
-                            // front of the object to which it is attached.
-                            if (entity->geometry())
+                            Vector3d adjustedPosition = cameraRelativePosition;
+                            Vector3f adjustedCameraSpacePosition = cameraSpacePosition;
+
+                            if (visualizer->depthAdjustment() == Visualizer::AdjustToFront)
                             {
-                                float z = -cameraSpacePosition.z() - entity->geometry()->boundingSphereRadius();
-                                float f = z / -cameraSpacePosition.z();
-                                adjustedPosition *= f;
-                                adjustedCameraSpacePosition *= f;
+                                // Adjust the position of the visualizer so that it is drawn in
+                                // front of the object to which it is attached.
+                                if (entity->geometry())
+                                {
+                                    float z = -cameraSpacePosition.z() - entity->geometry()->boundingSphereRadius();
+                                    float f = z / -cameraSpacePosition.z();
+                                    adjustedPosition *= f;
+                                    adjustedCameraSpacePosition *= f;
+                                }
                             }
-                        }
 
-                        addVisibleItem(entity, visualizer->geometry(),
-                                       position, adjustedPosition, adjustedCameraSpacePosition,
-                                       visualizer->orientation(entity, m_currentTime).cast<float>(),
-                                       nearPlaneFovAdjustment);
+                            addVisibleItem(entity, visualizer->geometry(),
+                                           position, adjustedPosition, adjustedCameraSpacePosition,
+                                           visualizer->orientation(entity, m_currentTime).cast<float>(),
+                                           nearPlaneFovAdjustment);
+                        }
                     }
                 }
             }
         }
     }
 
+    VESTA_PROFILE_COUNTER("Visible items", m_visibleItems.size() + m_splittableItems.size());
+
+    m_viewSetTimings.visibleItemScan += stopwatch.lap();
+    m_viewSetTimings.entityCount += (unsigned int) entities.size();
+    m_viewSetTimings.visibleItemCount += (unsigned int) (m_visibleItems.size() + m_splittableItems.size());
+
     // Depth sort all visible items
     sort(m_visibleItems.begin(), m_visibleItems.end(), visibleItemPredicate);
     sort(m_splittableItems.begin(), m_splittableItems.end(), visibleItemPredicate);
 
-    splitDepthBuffer();
-    coalesceDepthBuffer();
-
-    // Expand the non-empty depth buffer spans slightly so that small geometry
-    // (such as labels, which have very small extent in z) doesn't get clipped
-    // when positioned at the back of a span. The symptom of this problem is
-    // flickering geometry.
-    for (unsigned int i = 0; i < m_mergedDepthBufferSpans.size(); ++i)
+    // Logarithmic depth is only used for ordinary color rendering; camera distance
+    // output for shadow cube maps relies on the standard depth values.
+    m_logDepthActive = m_depthStrategy == LogarithmicDepth &&
+                       logarithmicDepthSupported() &&
+                       m_renderContext->rendererOutput() == RenderContext::FragmentColor;
+    if (m_logDepthActive)
     {
-        if (m_mergedDepthBufferSpans[i].itemCount > 0)
-        {
-            if (i == 0)
-            {
-                // This is the farthest span
-                m_mergedDepthBufferSpans[i].farDistance *= 1.05f;
-            }
-            else if (m_mergedDepthBufferSpans[i - 1].itemCount == 0)
-            {
-                // Expand this span if the more distant span is empty
-                float newFarDistance = m_mergedDepthBufferSpans[i].farDistance * 1.05f;
-                if (newFarDistance < m_mergedDepthBufferSpans[i - 1].farDistance)
-                {
-                    m_mergedDepthBufferSpans[i].farDistance = newFarDistance;
-                    m_mergedDepthBufferSpans[i - 1].nearDistance = newFarDistance;
-                }
-            }
-        }
+        buildSingleDepthSpan(projection);
     }
-
-
-    // If there is splittable geometry, we need to add extra depth spans
-    // at the front and back, otherwise it may be clipped.
-    if (!m_splittableItems.empty())
+    else
     {
-        // Use a different near/far ratio for these extra spans
-        const float MaxFarNearRatio = 10000.0f;
-
-        float furthestDistance = min(m_splittableItems.front().farDistance, projection.farDistance());
-
-        // Handle the case when the only visible geometry is splittable. This can happen
-        // in solar system views where just the planet orbits are visible. The only thing
-        // that we need to do is add the furthest span.
-        if (m_depthBufferSpans.empty())
-        {
-            DepthBufferSpan back;
-            back.backItemIndex = 0;
-            back.itemCount = 0;
-            back.farDistance = projection.farDistance();
-            back.nearDistance = max(projection.nearDistance(), back.farDistance / MaxFarNearRatio);
-            m_mergedDepthBufferSpans.push_back(back);
-        }
-        else if (furthestDistance > m_mergedDepthBufferSpans.front().farDistance)
-        {
-            DepthBufferSpan back;
-            back.backItemIndex = 0;
-            back.itemCount = 0;
-            back.farDistance = furthestDistance;
-            back.nearDistance = m_mergedDepthBufferSpans.front().farDistance;
-            m_mergedDepthBufferSpans.insert(m_mergedDepthBufferSpans.begin(), back);
-        }
-
-        while (m_mergedDepthBufferSpans.back().nearDistance > projection.nearDistance())
-        {
-            // Some potentially confusing naming here: spans are stored in
-            // reverse order, so that the foreground span is actually the
-            // *last* one in the list.
-            DepthBufferSpan front;
-            front.backItemIndex = 0;
-            front.itemCount = 0;
-            front.farDistance = m_mergedDepthBufferSpans.back().nearDistance;
-            front.nearDistance = std::max(projection.nearDistance(), front.farDistance / MaxFarNearRatio);
-            m_mergedDepthBufferSpans.push_back(front);
-        }
-
-        DepthBufferSpan back;
-        back.backItemIndex = 0;
-        back.itemCount = 0;
-        back.nearDistance = m_mergedDepthBufferSpans.front().farDistance;
-        back.farDistance = back.nearDistance * MaxFarNearRatio;
-        m_mergedDepthBufferSpans.insert(m_mergedDepthBufferSpans.begin(), back);
+        splitDepthBuffer();
+        coalesceDepthBuffer();
+        adjustDepthBufferSpans(projection);
     }
 
 #if DEBUG_DEPTH_SPANS
@@ -861,9 +845,68 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
 
     if (m_eclipseShadowsEnabled)
     {
-        m_eclipseShadows->frustumCull(projection.frustum());
+        m_eclipseShadows->frustumCull(projection, cameraPosition, cameraOrientation);
     }
 
+    m_viewSetTimings.depthSplitting += stopwatch.lap();
+    m_viewSetTimings.depthSpanCount += (unsigned int) m_mergedDepthBufferSpans.size();
+
+    // Resolve label placement before anything is drawn, so that labels are
+    // decluttered using their positions in this frame.
+    if (m_labelPlacement.isValid())
+    {
+        submitLabels(projection);
+        m_labelPlacement->endView();
+        m_viewSetTimings.labelPlacement += stopwatch.lap();
+    }
+
+    // Draw sky layers grids
+    glDepthMask(GL_FALSE);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_TEXTURE_2D);
+
+    m_renderContext->setProjection(projection.slice(0.1f, 1.0f));
+
+    if (m_skyLayersEnabled)
+    {
+        vector<SkyLayer*> visibleLayers;
+        const Universe::SkyLayerTable* skyLayers = m_universe->layers();
+        for (Universe::SkyLayerTable::const_iterator iter = skyLayers->begin(); iter != skyLayers->end(); ++iter)
+        {
+            SkyLayer* layer = iter->second.ptr();
+            if (layer && layer->isVisible())
+            {
+                visibleLayers.push_back(layer);
+            }
+
+            sort(visibleLayers.begin(), visibleLayers.end(), skyLayerOrderPredicate);
+        }
+
+        for (vector<SkyLayer*>::const_iterator iter = visibleLayers.begin(); iter != visibleLayers.end(); ++iter)
+        {
+#ifndef VESTA_NO_FIXED_FUNCTION_3D
+            glDisable(GL_LIGHTING);
+#endif
+            (*iter)->render(*m_renderContext);
+        }
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+
+    drawTime += stopwatch.lap();
+
+#ifndef VESTA_NO_FIXED_FUNCTION_3D
+    // Fixed function state setup
+    glEnable(GL_NORMALIZE);
+    glEnable(GL_LIGHTING);
+#endif
+
+    m_renderContext->setActiveLightCount(1);
+    m_renderContext->setAmbientLight(m_ambientLight);
+
+    unsigned int initialPassCount = m_viewSetTimings.depthPassCount;
+
     // Draw depth buffer spans from back to front
     unsigned int spanIndex = m_mergedDepthBufferSpans.size() - 1;
     float spanRange = 1.0f;
@@ -879,9 +922,34 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
         renderDepthBufferSpan(*iter, projection);
     }
 
+    VESTA_PROFILE_COUNTER("Depth passes", m_viewSetTimings.depthPassCount - initialPassCount);
+
+    RenderContext::RenderStatistics renderStats = m_renderContext->statistics();
+    m_viewSetTimings.drawCalls = renderStats.drawCalls;
+    m_viewSetTimings.shaderSwitches = renderStats.shaderSwitches;
+    m_viewSetTimings.uniformUploads = renderStats.uniformUploads;
+    m_viewSetTimings.redundantUniforms = renderStats.redundantUniforms;
+    VESTA_PROFILE_COUNTER("Draw calls", renderStats.drawCalls);
+    VESTA_PROFILE_COUNTER("Shader switches", renderStats.shaderSwitches);
+    VESTA_PROFILE_COUNTER("Uniform uploads", renderStats.uniformUploads);
+
+    const TextLayoutCache* textLayouts = m_renderContext->textLayoutCache();
+    VESTA_PROFILE_COUNTER("Text layouts built", textLayouts->misses());
+    VESTA_PROFILE_COUNTER("Text layout hit rate (%)", textLayouts->hitRate() * 100.0f);
+
     m_renderContext->popModelView();
     m_renderContext->unbindShader();
 
+    drawTime += stopwatch.lap();
+    m_viewSetTimings.drawing += drawTime;
+
+    if (m_labelPlacement.isValid())
+    {
+        m_renderContext->setLabelPlacement(NULL);
+    }
+
+    m_viewSetTimings.viewCount++;
+
     // Reset the front face
     glFrontFace(GL_CCW);
 
@@ -1012,7 +1080,21 @@ UniverseRenderer::renderLightGlare(GlareOverlay* glareOverlay)
             {
                 if (-glarePosition.z() <= iter->farDistance && -glarePosition.z() >= iter->nearDistance)
                 {
-                    setDepthRange(spanIndex * spanRange, (spanIndex + 1) * spanRange);
+                    if (m_logDepthActive)
+                    {
+                        // The occlusion test geometry is drawn without shaders, but it
+                        // lies in a plane at constant distance from the camera. Collapse
+                        // the depth range so that it gets the logarithmic depth value
+                        // for that distance.
+                        m_renderContext->setLogarithmicDepthRange(max(m_lastProjection.nearDistance(), iter->nearDistance),
+                                                                  min(m_lastProjection.farDistance(), iter->farDistance) * (1.0f + 1.0e-6f));
+                        float depth = m_renderContext->logarithmicDepthValue(-glarePosition.z());
+                        setDepthRange(depth, depth);
+                    }
+                    else
+                    {
+                        setDepthRange(spanIndex * spanRange, (spanIndex + 1) * spanRange);
+                    }
                     m_renderContext->setProjection(m_lastProjection.slice(iter->nearDistance, iter->farDistance));
                     glareOverlay->trackGlare(*m_renderContext, light.lightSource, glarePosition, light.radius);
                 }
@@ -1261,6 +1343,10 @@ UniverseRenderer::renderCubeMap(const LightingEnvironment* lighting,
                                                                                 static_cast<float>(nearDistance), 
 																				static_cast<float>(farDistance));
 
+    // Labels in cube map faces shouldn't take part in placement for the main view
+    counted_ptr<LabelPlacement> savedLabelPlacement = m_labelPlacement;
+    m_labelPlacement = NULL;
+
     for (int face = 0; face < 6; ++face)
     {
         Framebuffer* fb = cubeMap->face(CubeMapFramebuffer::Face(face));
@@ -1273,12 +1359,14 @@ UniverseRenderer::renderCubeMap(const LightingEnvironment* lighting,
             if (status != RenderOk)
             {
                 Framebuffer::unbind();
+                m_labelPlacement = savedLabelPlacement;
                 return status;
             }
         }
     }
 
     Framebuffer::unbind();
+    m_labelPlacement = savedLabelPlacement;
 
     return RenderOk;
 }
@@ -1298,6 +1386,9 @@ UniverseRenderer::renderShadowCubeMap(const LightingEnvironment* lighting, const
 
     m_renderContext->setRendererOutput(RenderContext::CameraDistance);
 
+    counted_ptr<LabelPlacement> savedLabelPlacement = m_labelPlacement;
+    m_labelPlacement = NULL;
+
     for (int face = 0; face < 6; ++face)
     {
         Framebuffer* fb = cubeMap->face(CubeMapFramebuffer::Face(face));
@@ -1316,6 +1407,7 @@ UniverseRenderer::renderShadowCubeMap(const LightingEnvironment* lighting, const
 
     Framebuffer::unbind();
     m_renderContext->setRendererOutput(RenderContext::FragmentColor);
+    m_labelPlacement = savedLabelPlacement;
 
     return status;
 }
@@ -1425,6 +1517,132 @@ UniverseRenderer::coalesceDepthBuffer()
 }
 
 
+// Adjust the merged depth buffer spans to prevent clipping of geometry at the
+// boundaries of spans, and add extra spans for splittable geometry.
+void
+UniverseRenderer::adjustDepthBufferSpans(const PlanarProjection& projection)
+{
+    // Expand the non-empty depth buffer spans slightly so that small geometry
+    // (such as labels, which have very small extent in z) doesn't get clipped
+    // when positioned at the back of a span. The symptom of this problem is
+    // flickering geometry.
+    for (unsigned int i = 0; i < m_mergedDepthBufferSpans.size(); ++i)
+    {
+        if (m_mergedDepthBufferSpans[i].itemCount > 0)
+        {
+            if (i == 0)
+            {
+                // This is the farthest span
+                m_mergedDepthBufferSpans[i].farDistance *= 1.05f;
+            }
+            else if (m_mergedDepthBufferSpans[i - 1].itemCount == 0)
+            {
+                // Expand this span if the more distant span is empty
+                float newFarDistance = m_mergedDepthBufferSpans[i].farDistance * 1.05f;
+                if (newFarDistance < m_mergedDepthBufferSpans[i - 1].farDistance)
+                {
+                    m_mergedDepthBufferSpans[i].farDistance = newFarDistance;
+                    m_mergedDepthBufferSpans[i - 1].nearDistance = newFarDistance;
+                }
+            }
+        }
+    }
+
+
+    // If there is splittable geometry, we need to add extra depth spans
+    // at the front and back, otherwise it may be clipped.
+    if (!m_splittableItems.empty())
+    {
+        // Use a different near/far ratio for these extra spans
+        const float MaxFarNearRatio = 10000.0f;
+
+        float furthestDistance = min(m_splittableItems.front().farDistance, projection.farDistance());
+
+        // Handle the case when the only visible geometry is splittable. This can happen
+        // in solar system views where just the planet orbits are visible. The only thing
+        // that we need to do is add the furthest span.
+        if (m_depthBufferSpans.empty())
+        {
+            DepthBufferSpan back;
+            back.backItemIndex = 0;
+            back.itemCount = 0;
+            back.farDistance = projection.farDistance();
+            back.nearDistance = max(projection.nearDistance(), back.farDistance / MaxFarNearRatio);
+            m_mergedDepthBufferSpans.push_back(back);
+        }
+        else if (furthestDistance > m_mergedDepthBufferSpans.front().farDistance)
+        {
+            DepthBufferSpan back;
+            back.backItemIndex = 0;
+            back.itemCount = 0;
+            back.farDistance = furthestDistance;
+            back.nearDistance = m_mergedDepthBufferSpans.front().farDistance;
+            m_mergedDepthBufferSpans.insert(m_mergedDepthBufferSpans.begin(), back);
+        }
+
+        while (m_mergedDepthBufferSpans.back().nearDistance > projection.nearDistance())
+        {
+            // Some potentially confusing naming here: spans are stored in
+            // reverse order, so that the foreground span is actually the
+            // *last* one in the list.
+            DepthBufferSpan front;
+            front.backItemIndex = 0;
+            front.itemCount = 0;
+            front.farDistance = m_mergedDepthBufferSpans.back().nearDistance;
+            front.nearDistance = std::max(projection.nearDistance(), front.farDistance / MaxFarNearRatio);
+            m_mergedDepthBufferSpans.push_back(front);
+        }
+
+        DepthBufferSpan back;
+        back.backItemIndex = 0;
+        back.itemCount = 0;
+        back.nearDistance = m_mergedDepthBufferSpans.front().farDistance;
+        back.farDistance = back.nearDistance * MaxFarNearRatio;
+        m_mergedDepthBufferSpans.insert(m_mergedDepthBufferSpans.begin(), back);
+    }
+}
+
+
+// Create a single depth buffer span containing all visible items. This is used
+// with logarithmic depth, where the depth buffer has adequate precision over
+// the entire range of distances.
+void
+UniverseRenderer::buildSingleDepthSpan(const PlanarProjection& projection)
+{
+    m_depthBufferSpans.clear();
+    m_mergedDepthBufferSpans.clear();
+
+    if (m_visibleItems.empty() && m_splittableItems.empty())
+    {
+        return;
+    }
+
+    float nearDistance = projection.farDistance();
+    float farDistance = projection.nearDistance();
+    for (VisibleItemVector::const_iterator iter = m_visibleItems.begin(); iter != m_visibleItems.end(); ++iter)
+    {
+        nearDistance = min(nearDistance, iter->nearDistance);
+        farDistance = max(farDistance, iter->farDistance);
+    }
+
+    for (VisibleItemVector::const_iterator iter = m_splittableItems.begin(); iter != m_splittableItems.end(); ++iter)
+    {
+        nearDistance = min(nearDistance, iter->nearDistance);
+        farDistance = max(farDistance, iter->farDistance);
+    }
+
+    // Expand the span slightly so that geometry with very small extent in z
+    // at the back of the span (such as labels) isn't clipped.
+    DepthBufferSpan span;
+    span.backItemIndex = m_visibleItems.empty() ? 0 : (unsigned int) m_visibleItems.size() - 1;
+    span.itemCount = (unsigned int) m_visibleItems.size();
+    span.nearDistance = max(projection.nearDistance(), nearDistance);
+    span.farDistance = min(projection.farDistance(), farDistance * 1.05f);
+
+    m_mergedDepthBufferSpans.push_back(span);
+}
+
+
 static void
 beginShadowRendering()
 {
@@ -1479,6 +1697,82 @@ finishShadowRendering(Framebuffer* renderSurface, bool colorMask[])
 
 
 
+// Comparison predicate for state sorting. Items are grouped by shader and then
+// by base texture (see Geometry::renderStateKeys()); within a group they're
+// drawn front to back.
+struct StateSortPredicate
+{
+    StateSortPredicate(const UniverseRenderer::VisibleItemVector& items) :
+        m_items(items)
+    {
+    }
+
+    bool operator()(unsigned int index0, unsigned int index1) const
+    {
+        const UniverseRenderer::VisibleItem& item0 = m_items[index0];
+        const UniverseRenderer::VisibleItem& item1 = m_items[index1];
+        if (item0.shaderKey != item1.shaderKey)
+        {
+            return item0.shaderKey < item1.shaderKey;
+        }
+        else if (item0.textureKey != item1.textureKey)
+        {
+            return item0.textureKey < item1.textureKey;
+        }
+        else
+        {
+            // Front to back to take advantage of early depth rejection
+            return item0.nearDistance < item1.nearDistance;
+        }
+    }
+
+    const UniverseRenderer::VisibleItemVector& m_items;
+};
+
+
+// Build the list of item indices for the opaque pass of a depth buffer span.
+// Items are initially in back to front order. Runs of opaque items are sorted
+// by render state; geometry that isn't opaque may depend on being drawn in
+// depth order, so it's left in place and separates the sorted runs.
+void
+UniverseRenderer::buildDrawOrder(const DepthBufferSpan& span)
+{
+    m_drawOrder.resize(span.itemCount);
+    for (unsigned int i = 0; i < span.itemCount; ++i)
+    {
+        m_drawOrder[i] = span.backItemIndex - i;
+    }
+
+    if (!m_stateSortingEnabled)
+    {
+        return;
+    }
+
+    unsigned int runStart = 0;
+    while (runStart < span.itemCount)
+    {
+        unsigned int runEnd = runStart;
+        while (runEnd < span.itemCount && m_visibleItems[m_drawOrder[runEnd]].geometry->isOpaque())
+        {
+            ++runEnd;
+        }
+
+        if (runEnd - runStart > 1)
+        {
+            for (unsigned int i = runStart; i < runEnd; ++i)
+            {
+                VisibleItem& item = m_visibleItems[m_drawOrder[i]];
+                item.geometry->renderStateKeys(&item.shaderKey, &item.textureKey);
+            }
+
+            stable_sort(m_drawOrder.begin() + runStart, m_drawOrder.begin() + runEnd, StateSortPredicate(m_visibleItems));
+        }
+
+        runStart = runEnd + 1;
+    }
+}
+
+
 // Render all of the items in a depth buffer span
 void UniverseRenderer::renderDepthBufferSpan(const DepthBufferSpan& span, const PlanarProjection& projection)
 {
@@ -1496,6 +1790,8 @@ void UniverseRenderer::renderDepthBufferSpan(const DepthBufferSpan& span, const
         return;
     }
 
+    m_viewSetTimings.depthPassCount++;
+
     bool shadowsOn = false;
     unsigned int omniShadowCount = 0;
     if (m_shadowsEnabled && !m_visibleLightSources.empty())
@@ -1530,16 +1826,27 @@ void UniverseRenderer::renderDepthBufferSpan(const DepthBufferSpan& span, const
     m_renderContext->setProjection(projection.slice(nearDistance, safeFarDistance));
     Frustum viewFrustum = m_renderContext->frustum();
 
+    // Logarithmic depth is enabled only after the shadow maps have been drawn,
+    // since they use a parallel projection.
+    if (m_logDepthActive)
+    {
+        m_renderContext->setLogarithmicDepthRange(nearDistance, safeFarDistance);
+        m_renderContext->setLogarithmicDepth(true);
+    }
+
+    buildDrawOrder(span);
+
     // Rendering of some translucent objects is order dependent. We can eliminate the
     // worst artifacts by drawing opaque items first and translucent items second.
     for (int pass = 0; pass < 2; ++pass)
     {
         m_renderContext->setPass(pass == 0 ? RenderContext::OpaquePass : RenderContext::TranslucentPass);
 
-        // Draw all items in the span
+        // Draw all items in the span. Opaque items are drawn in state sorted order,
+        // translucent items from back to front.
         for (unsigned int i = 0; i < span.itemCount; i++)
         {
-            const VisibleItem& item = m_visibleItems[span.backItemIndex - i];
+            const VisibleItem& item = m_visibleItems[pass == 0 ? m_drawOrder[i] : span.backItemIndex - i];
 
             if (pass == 0 || !item.geometry->isOpaque())
             {
@@ -1594,6 +1901,8 @@ void UniverseRenderer::renderDepthBufferSpan(const DepthBufferSpan& span, const
             }
         }
     }
+
+    m_renderContext->setLogarithmicDepth(false);
 }
 
 
@@ -1854,6 +2163,8 @@ UniverseRenderer::renderDepthBufferSpanOmniShadows(unsigned int shadowIndex,
 void
 UniverseRenderer::setupEclipseShadows(const VisibleItem &item)
 {
+    VESTA_PROFILE_SCOPE("UniverseRenderer::setupEclipseShadows");
+
     if (m_eclipseShadows->findIntersectingShadows(item.entity, item.position, item.boundingRadius))
     {
         // The object is affected by at least one shadow
@@ -1997,6 +2308,8 @@ UniverseRenderer::drawItem(const VisibleItem& item)
         return;
 
     }
+
+    VESTA_PROFILE_SCOPE("UniverseRenderer::drawItem");
     m_renderContext->setModelTranslation(m_renderContext->modelview().linear().cast<double>() * item.cameraRelativePosition);
 
     // Set up the light sources
@@ -2050,6 +2363,58 @@ UniverseRenderer::drawItem(const VisibleItem& item)
 }
 
 
+// Submit the labels of all sky layers and visible items to the label
+// placement service.
+void
+UniverseRenderer::submitLabels(const PlanarProjection& projection)
+{
+    // Sky layers are drawn with the same projection set here
+    if (m_skyLayersEnabled)
+    {
+        m_renderContext->setProjection(projection.slice(0.1f, 1.0f));
+
+        const Universe::SkyLayerTable* skyLayers = m_universe->layers();
+        for (Universe::SkyLayerTable::const_iterator iter = skyLayers->begin(); iter != skyLayers->end(); ++iter)
+        {
+            SkyLayer* layer = iter->second.ptr();
+            if (layer && layer->isVisible())
+            {
+                layer->submitLabels(*m_renderContext);
+            }
+        }
+    }
+
+    m_renderContext->setProjection(projection);
+    submitItemLabels(m_visibleItems, projection);
+    submitItemLabels(m_splittableItems, projection);
+}
+
+
+// Submit the labels of a list of visible items. The modelview transformation is
+// set up exactly as in drawItem(). Items that lie entirely in front of or behind
+// the view frustum are skipped, since renderDepthBufferSpan() never draws them.
+void
+UniverseRenderer::submitItemLabels(const VisibleItemVector& items, const PlanarProjection& projection)
+{
+    for (VisibleItemVector::const_iterator iter = items.begin(); iter != items.end(); ++iter)
+    {
+        const VisibleItem& item = *iter;
+        if (item.outsideFrustum ||
+            item.farDistance <= projection.nearDistance() ||
+            item.nearDistance >= projection.farDistance())
+        {
+            continue;
+        }
+
+        m_renderContext->pushModelView();
+        m_renderContext->translateModelView(item.cameraRelativePosition.cast<float>());
+        m_renderContext->rotateModelView(item.orientation);
+        item.geometry->submitLabels(*m_renderContext, m_currentTime);
+        m_renderContext->popModelView();
+    }
+}
+
+
 /** Set the color of 'fill light' in the scene. Ambient light is
   * a crude approximation to the light resulting from multiple
   * reflections off of diffuse surfaces. By default, the ambient
@@ -2206,3 +2571,19 @@ UniverseRenderer::createGlareOverlay()
 
     return overlay;
 }
+
+
+/** Set the label placement service used to declutter labels. When a label
+  * placement service is set, overlapping labels are resolved so that only the
+  * highest priority label is drawn. Setting it to null turns decluttering off.
+  *
+  * Label placement retains information between frames, so a separate LabelPlacement
+  * instance should be used for each view; when a view set contains several views
+  * (e.g. the two eyes of a stereo pair), set the placement for each view before
+  * calling renderView().
+  */
+void
+UniverseRenderer::setLabelPlacement(LabelPlacement* labelPlacement)
+{
+    m_labelPlacement = labelPlacement;
+}
@@ -31,6 +31,7 @@ class CubeMapFramebuffer;
 class EclipseShadowVolumeSet;
 class TextureFont;
 class GlareOverlay;
+class LabelPlacement;
 
 /** UniverseRenderer draws views of a VESTA Universe using a 3D rendering
   * library. Views are drawn as sets at a particular time. A typical usage
@@ -75,6 +76,19 @@ public:
         RendererBadParameter,
     };
 
+    /** Strategies for covering the huge range of distances in a view
+      * with a limited precision depth buffer.
+      */
+    enum DepthStrategy
+    {
+        /** Partition the visible items into spans with a limited far/near
+          * ratio and draw each span with its own slice of the depth range. */
+        DepthSpans,
+        /** Draw all items in a single pass with logarithmic depth values
+          * written by the shaders. Requires GLSL shaders. */
+        LogarithmicDepth,
+    };
+
     static const unsigned int MaxShadowMaps     = 3;
     static const unsigned int MaxOmniShadowMaps = 3;
 
@@ -137,6 +151,26 @@ public:
     void setShadowsEnabled(bool enable);
     void setEclipseShadowsEnabled(bool enable);
 
+    /** Get the requested depth strategy. The default is DepthSpans.
+      */
+    DepthStrategy depthStrategy() const
+    {
+        return m_depthStrategy;
+    }
+
+    void setDepthStrategy(DepthStrategy strategy);
+    bool logarithmicDepthSupported() const;
+
+    /** Return true if opaque items are sorted by render state before
+      * drawing. State sorting is on by default.
+      */
+    bool stateSortingEnabled() const
+    {
+        return m_stateSortingEnabled;
+    }
+
+    void setStateSortingEnabled(bool enable);
+
     bool shadowsSupported() const;
     bool omniShadowsSupported() const;
 
@@ -172,6 +206,56 @@ public:
 
     GlareOverlay* createGlareOverlay();
 
+    /** Get the label placement service used to declutter labels. This
+      * is null by default, in which case all visible labels are drawn.
+      */
+    LabelPlacement* labelPlacement() const
+    {
+        return m_labelPlacement.ptr();
+    }
+
+    void setLabelPlacement(LabelPlacement* labelPlacement);
+
+    /** RenderTimings records where the time went while drawing the current
+      * (or most recently completed) view set. Times are in seconds and are
+      * summed over all views in the set. Because OpenGL commands execute
+      * asynchronously, the drawing time measures only the CPU cost of
+      * issuing commands unless the caller waits for the GPU to finish.
+      */
+    struct RenderTimings
+    {
+        /** Time spent in beginViewSet() building the light source list */
+        double viewSetSetup;
+        /** Time spent evaluating entity states and culling */
+        double visibleItemScan;
+        /** Time spent depth sorting items and splitting the depth buffer */
+        double depthSplitting;
+        /** Time spent drawing sky layers and depth buffer spans */
+        double drawing;
+        /** Time spent submitting and resolving labels for placement */
+        double labelPlacement;
+
+        unsigned int viewCount;
+        unsigned int entityCount;
+        unsigned int visibleItemCount;
+        unsigned int depthSpanCount;
+        /** Number of depth buffer spans that were actually drawn */
+        unsigned int depthPassCount;
+
+        /** Render context statistics for the view set */
+        unsigned int drawCalls;
+        unsigned int shaderSwitches;
+        unsigned int uniformUploads;
+        unsigned int redundantUniforms;
+    };
+
+    /** Get the timings for the current or most recently completed view set.
+      */
+    const RenderTimings& viewSetTimings() const
+    {
+        return m_viewSetTimings;
+    }
+
 public:
     struct VisibleItem
     {
@@ -186,6 +270,8 @@ public:
         float farDistance;     // signed distance to the camera plane
         float boundingRadius;
         bool outsideFrustum;
+        unsigned int shaderKey;   // render state keys; only set for opaque items
+        unsigned int textureKey;  // being state sorted
     };
 
     struct LightSourceItem
@@ -228,6 +314,9 @@ private:
     void buildVisibleLightSourceList(const Eigen::Vector3d& cameraPosition);
     void splitDepthBuffer();
     void coalesceDepthBuffer();
+    void adjustDepthBufferSpans(const PlanarProjection& projection);
+    void buildSingleDepthSpan(const PlanarProjection& projection);
+    void buildDrawOrder(const DepthBufferSpan& span);
     void renderDepthBufferSpan(const DepthBufferSpan& span, const PlanarProjection& projection);
     bool renderDepthBufferSpanShadows(unsigned int shadowIndex,
                                       const DepthBufferSpan& span,
@@ -245,6 +334,8 @@ private:
                         const Eigen::Quaternionf& orientation,
                         float nearAdjust);
     void drawItem(const VisibleItem& item);
+    void submitLabels(const PlanarProjection& projection);
+    void submitItemLabels(const VisibleItemVector& items, const PlanarProjection& projection);
     Eigen::Matrix4f setupShadowRendering(const Framebuffer* shadowMap,
                                          const Eigen::Vector3f& lightDirection,
                                          float shadowGroupSize);
@@ -261,6 +352,7 @@ private:
     VisibleItemVector m_splittableItems;
     std::vector<DepthBufferSpan> m_depthBufferSpans;
     std::vector<DepthBufferSpan> m_mergedDepthBufferSpans;
+    std::vector<unsigned int> m_drawOrder;
     std::vector<LightSourceItem> m_lightSources;
     std::vector<VisibleLightSourceItem> m_visibleLightSources;
 
@@ -275,6 +367,9 @@ private:
     bool m_visualizersEnabled;
     bool m_skyLayersEnabled;
     bool m_defaultSunEnabled;
+    DepthStrategy m_depthStrategy;
+    bool m_logDepthActive;
+    bool m_stateSortingEnabled;
     float m_depthRangeFront;
     float m_depthRangeBack;
 
@@ -293,6 +388,10 @@ private:
 
     counted_ptr<TextureFont> m_defaultFont;
     PlanarProjection m_lastProjection;
+
+    counted_ptr<LabelPlacement> m_labelPlacement;
+
+    RenderTimings m_viewSetTimings;
 };
 
 }
@@ -34,7 +34,11 @@ VertexArray::VertexArray(void* data,
     m_data(data),
     m_count(count),
     m_vertexSpec(vertexSpec),
-    m_stride(stride)
+    m_stride(stride),
+    m_positionFormat(VertexAttribute::InvalidAttributeFormat),
+    m_positionOffsetBytes(0),
+    m_positionScale(1.0f),
+    m_positionOffset(Vector3f::Zero())
 {
     assert(stride == 0 || stride >= vertexSpec.size());
     assert(is4ByteAligned(stride));
@@ -43,6 +47,13 @@ VertexArray::VertexArray(void* data,
     {
         m_stride = vertexSpec.size();
     }
+
+    unsigned int positionIndex = vertexSpec.attributeIndex(VertexAttribute::Position);
+    if (positionIndex != VertexSpec::InvalidAttribute)
+    {
+        m_positionFormat = vertexSpec.attribute(positionIndex).format();
+        m_positionOffsetBytes = vertexSpec.attributeOffset(positionIndex);
+    }
 }
 
     
@@ -59,7 +70,19 @@ VertexArray::computeBoundingBox() const
 
     int positionIndex = m_vertexSpec.attributeIndex(VertexAttribute::Position);
     assert(positionIndex >= 0);
-    if (positionIndex >= 0)
+    if (hasQuantizedPositions())
+    {
+        if (m_count > 0)
+        {
+            bbox = BoundingBox(position(0), position(0));
+        }
+
+        for (unsigned int i = 1; i < m_count; ++i)
+        {
+            bbox.include(position(i));
+        }
+    }
+    else if (positionIndex >= 0)
     {
         const float* floatData = reinterpret_cast<float*>(m_data) + m_vertexSpec.attributeOffset(positionIndex) / 4;
         unsigned int step = m_stride / 4;
@@ -89,7 +112,14 @@ VertexArray::computeBoundingSphereRadius() const
 
     unsigned int positionIndex = m_vertexSpec.attributeIndex(VertexAttribute::Position);
     assert(positionIndex != VertexSpec::InvalidAttribute);
-    if (positionIndex != VertexSpec::InvalidAttribute)
+    if (hasQuantizedPositions())
+    {
+        for (unsigned int i = 0; i < m_count; ++i)
+        {
+            maxDistSquared = std::max(maxDistSquared, position(i).squaredNorm());
+        }
+    }
+    else if (positionIndex != VertexSpec::InvalidAttribute)
     {
         const float* floatData = reinterpret_cast<float*>(m_data) + m_vertexSpec.attributeOffset(positionIndex) / 4;
         unsigned int step = m_stride / 4;
@@ -106,17 +136,33 @@ VertexArray::computeBoundingSphereRadius() const
 
 
 /** Return the position of the vertex at the specified index. Index
-  * must be less than the vertex count.
+  * must be less than the vertex count. Quantized positions are decoded.
   */
 Vector3f
 VertexArray::position(unsigned int index) const
 {
-    int positionIndex = m_vertexSpec.attributeIndex(VertexAttribute::Position);
-    assert(positionIndex >= 0);
+    assert(m_positionFormat != VertexAttribute::InvalidAttributeFormat);
     assert(index < m_count);
 
-    const float* floatData = reinterpret_cast<float*>(m_data) + m_vertexSpec.attributeOffset(positionIndex) / 4;
-    unsigned int stride = m_stride / 4;
+    const char* vertexData = reinterpret_cast<const char*>(m_data) + m_stride * index + m_positionOffsetBytes;
+    if (hasQuantizedPositions())
+    {
+        const v_int16* p = reinterpret_cast<const v_int16*>(vertexData);
+        return m_positionOffset + m_positionScale * Vector3f(float(p[0]), float(p[1]), float(p[2]));
+    }
+    else
+    {
+        return Vector3f::Map(reinterpret_cast<const float*>(vertexData));
+    }
+}
+
 
-    return Vector3f::Map(floatData + stride * index);
+/** Set the transformation that converts quantized positions to model
+  * coordinates. It is ignored for arrays with float positions.
+  */
+void
+VertexArray::setPositionTransform(float scale, const Vector3f& offset)
+{
+    m_positionScale = scale;
+    m_positionOffset = offset;
 }
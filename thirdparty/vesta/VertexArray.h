@@ -52,6 +52,31 @@ public:
 
     Eigen::Vector3f position(unsigned int index) const;
 
+    /** Return true if vertex positions are stored as 16-bit integers
+      * (format Short4) rather than floats.
+      */
+    bool hasQuantizedPositions() const
+    {
+        return m_positionFormat == VertexAttribute::Short4;
+    }
+
+    /** Get the scale factor applied to quantized positions. The decoded
+      * position is positionOffset() + positionScale() * p. The transformation
+      * is the identity for arrays with float positions.
+      */
+    float positionScale() const
+    {
+        return m_positionScale;
+    }
+
+    /** Get the offset added to quantized positions after scaling. */
+    Eigen::Vector3f positionOffset() const
+    {
+        return m_positionOffset;
+    }
+
+    void setPositionTransform(float scale, const Eigen::Vector3f& offset);
+
     /** Get a pointer to the data for the specified vertex.
       */
     VertexAttribute::Component* vertex(unsigned int index) const
@@ -64,6 +89,10 @@ private:
     unsigned int m_count;
     VertexSpec m_vertexSpec;
     unsigned int m_stride;
+    VertexAttribute::Format m_positionFormat;
+    unsigned int m_positionOffsetBytes;
+    float m_positionScale;
+    Eigen::Vector3f m_positionOffset;
 };
 
 }
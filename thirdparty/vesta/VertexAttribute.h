@@ -38,6 +38,15 @@ public:
         Float3 = 2,
         Float4 = 3,
         UByte4 = 4,
+
+        // Quantized formats. Short4 positions are integers that are scaled
+        // and offset by the transformation stored in the VertexArray. Short2
+        // normals and tangents are unit vectors in octahedral encoding,
+        // normalized to [-1, 1]. Half2 is a pair of half precision floats.
+        Short4 = 5,
+        Short2 = 6,
+        Half2  = 7,
+
         InvalidAttributeFormat = -1,
     };
 
@@ -92,6 +101,9 @@ public:
         case Float3: return 12;
         case Float4: return 16;
         case UByte4: return 4;
+        case Short4: return 8;
+        case Short2: return 4;
+        case Half2:  return 4;
         default: return 0;
         }
     }
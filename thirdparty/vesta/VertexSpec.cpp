@@ -9,6 +9,7 @@
  */
 
 #include "VertexSpec.h"
+#include <algorithm>
 
 using namespace vesta;
 
@@ -171,6 +172,14 @@ VertexSpec::copyAttributeOffsets(unsigned int* attributeOffsets)
             m_attributeOffsets[i] = attributeOffsets[i];
         }
     }
+
+    // The size is the end of the last attribute, which isn't necessarily
+    // the last one in the list when explicit offsets are given.
+    m_size = 0;
+    for (unsigned int i = 0; i < m_attributeCount; ++i)
+    {
+        m_size = std::max(m_size, m_attributeOffsets[i] + VertexAttribute::formatSize(m_attributes[i].format()));
+    }
 }
 
 
@@ -356,13 +356,16 @@ WorldGeometry::render(RenderContext& rc, double clock) const
         simpleMaterial.setDiffuse(Spectrum(1.0f, 1.0f, 1.0f));
         for (unsigned int layerIndex = 0; layerIndex < m_mapLayers.size(); ++layerIndex)
         {
-            const MapLayer* layer = m_mapLayers[layerIndex].ptr();
+            MapLayer* layer = m_mapLayers[layerIndex].ptr();
             if (layer && layer->opacity() > 0.0f)
             {
+                layer->prepareToRender(clock);
+
                 TextureMap* texture = layer->texture();
                 if (texture)
                 {
                     simpleMaterial.setOpacity(layer->opacity());
+                    simpleMaterial.setBlendMode(layer->blendMode());
                     simpleMaterial.setBaseTexture(texture);
                     rc.bindMaterial(&simpleMaterial);
 
@@ -1210,6 +1213,20 @@ WorldGeometry::isOpaque() const
 }
 
 
+/** Get the render state keys for the globe surface. Tiled base maps bind a
+  * different texture for each tile, so they have no texture key.
+  */
+void
+WorldGeometry::renderStateKeys(unsigned int* shaderKey, unsigned int* textureKey) const
+{
+    // Compute the key of the material that render() binds, without copying it
+    *shaderKey = Material::ShaderStateKey(m_material->brdf(), !m_specularReflectance.isBlack(),
+                                          m_baseMap.isValid(), m_normalMap.isValid(), m_material->specularTexture() != NULL,
+                                          Material::DiffuseTextureAlpha);
+    *textureKey = m_baseMap.isValid() ? m_baseMap->id() : 0;
+}
+
+
 /** Set the shape of the world to be a perfect sphere with the specified
   * radius.
   */
@@ -51,6 +51,7 @@ public:
     virtual float nearPlaneDistance(const Eigen::Vector3f& cameraPosition) const;
 
     virtual bool isOpaque() const;
+    virtual void renderStateKeys(unsigned int* shaderKey, unsigned int* textureKey) const;
 
     /** Get the lengths of the axes of the globe in kilometers. Note that these are
       * diameters, not radii.
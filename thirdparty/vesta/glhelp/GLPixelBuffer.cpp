@@ -0,0 +1,81 @@
+// GLPixelBuffer.cpp
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// VESTA is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// VESTA is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// VESTA. If not, see <http://www.gnu.org/licenses/>.
+
+#include "GLPixelBuffer.h"
+
+using namespace vesta;
+
+
+/** Create a new pixel buffer large enough to hold size bytes of pixel
+  * data. The usage should be one of the read usages (GL_STREAM_READ is
+  * appropriate for buffers that are refilled every frame.)
+  */
+GLPixelBuffer::GLPixelBuffer(unsigned int size, GLenum usage) :
+    GLBufferObject(GL_PIXEL_PACK_BUFFER, size, usage, 0)
+{
+}
+
+
+GLPixelBuffer::~GLPixelBuffer()
+{
+}
+
+
+/** Queue a read of a rectangle of pixels from the current read buffer
+  * into this pixel buffer. The call does not wait for the transfer to
+  * complete; the data becomes available when the buffer is next mapped.
+  * Returns false if the buffer is invalid or currently mapped.
+  */
+bool
+GLPixelBuffer::readPixels(int x, int y, int width, int height, GLenum format, GLenum type)
+{
+    if (!isValid() || isMapped())
+    {
+        return false;
+    }
+
+#ifdef VESTA_OGLES2
+    return false;
+#else
+    bind();
+    glReadPixels(x, y, width, height, format, type, 0);
+    unbind();
+
+    return true;
+#endif
+}
+
+
+/** Return true if pixel buffer objects are supported by the current
+  * OpenGL context. Pixel buffers are a core feature of OpenGL 2.1; they
+  * aren't available with OpenGL ES 2.0.
+  */
+bool
+GLPixelBuffer::supported()
+{
+#ifdef VESTA_OGLES2
+    return false;
+#else
+    return GLBufferObject::supported() && (GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object);
+#endif
+}
@@ -0,0 +1,53 @@
+// GLPixelBuffer.h
+//
+// Copyright (C) 2012 Chris Laurel <claurel@gmail.com>
+//
+// VESTA is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// VESTA is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// VESTA. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _VESTA_GL_PIXEL_BUFFER_H_
+#define _VESTA_GL_PIXEL_BUFFER_H_
+
+#include "../OGLHeaders.h"
+#include "GLBufferObject.h"
+
+
+namespace vesta
+{
+
+/** GLPixelBuffer is a C++ wrapper for OpenGL pixel pack buffer objects. A
+ *  pixel buffer is the target of an asynchronous framebuffer read: readPixels()
+ *  returns as soon as the transfer has been queued, and the pixel data can be
+ *  retrieved later with mapReadOnly() without stalling the pipeline (provided
+ *  that the GPU has had time to finish the transfer.)
+ */
+class GLPixelBuffer : public GLBufferObject
+{
+public:
+    GLPixelBuffer(unsigned int size, GLenum usage = GL_STREAM_READ);
+    ~GLPixelBuffer();
+
+    bool readPixels(int x, int y, int width, int height, GLenum format, GLenum type);
+
+    static bool supported();
+};
+
+}
+
+#endif // _VESTA_GL_PIXEL_BUFFER_H_
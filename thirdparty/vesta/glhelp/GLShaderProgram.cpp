@@ -24,6 +24,8 @@
 #include "GLShaderProgram.h"
 #include "../Debug.h"
 #include "../Object.h"
+#include <algorithm>
+#include <cstring>
 
 using namespace vesta;
 using namespace std;
@@ -34,6 +36,10 @@ using namespace std;
 #endif
 
 
+unsigned int GLShaderProgram::s_uniformUploadCount = 0;
+unsigned int GLShaderProgram::s_redundantUniformCount = 0;
+
+
 GLShaderProgram::GLShaderProgram() :
     m_handle(0),
     m_isLinked(false)
@@ -121,6 +127,10 @@ GLShaderProgram::link()
         m_isLinked = true;
     }
 
+    // Uniform locations may change when a program is relinked
+    m_uniforms.clear();
+    m_uniformTable.clear();
+
     // Get the log of error and warning messages and store it with
     // this shader objects.
     GLint length = 0;
@@ -157,7 +167,8 @@ GLShaderProgram::bindAttribute(const char* name, int location)
 void
 GLShaderProgram::setSampler(const char* name, unsigned int samplerIndex)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    float value = float(samplerIndex);
+    GLint location = uniformLocation(name, &value, 1);
     if (location >= 0)
     {
         glUniform1i(location, samplerIndex);
@@ -170,7 +181,7 @@ GLShaderProgram::setSampler(const char* name, unsigned int samplerIndex)
 void
 GLShaderProgram::setConstant(const char* name, float value)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, &value, 1);
     if (location >= 0)
     {
         glUniform1f(location, value);
@@ -183,7 +194,7 @@ GLShaderProgram::setConstant(const char* name, float value)
 void
 GLShaderProgram::setConstant(const char* name, const Eigen::Vector2f& value)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, value.data(), 2);
     if (location >= 0)
     {
         glUniform2fv(location, 1, value.data());
@@ -196,7 +207,7 @@ GLShaderProgram::setConstant(const char* name, const Eigen::Vector2f& value)
 void
 GLShaderProgram::setConstant(const char* name, const Eigen::Vector3f& value)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, value.data(), 3);
     if (location >= 0)
     {
         glUniform3fv(location, 1, value.data());
@@ -209,7 +220,7 @@ GLShaderProgram::setConstant(const char* name, const Eigen::Vector3f& value)
 void
 GLShaderProgram::setConstant(const char* name, const Eigen::Vector4f& value)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, value.data(), 4);
     if (location >= 0)
     {
         glUniform4fv(location, 1, value.data());
@@ -222,7 +233,7 @@ GLShaderProgram::setConstant(const char* name, const Eigen::Vector4f& value)
 void
 GLShaderProgram::setConstant(const char* name, const Eigen::Matrix2f& value)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, value.data(), 4);
     if (location >= 0)
     {
         glUniformMatrix2fv(location, 1, GL_FALSE, value.data());
@@ -235,7 +246,7 @@ GLShaderProgram::setConstant(const char* name, const Eigen::Matrix2f& value)
 void
 GLShaderProgram::setConstant(const char* name, const Eigen::Matrix3f& value)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, value.data(), 9);
     if (location >= 0)
     {
         glUniformMatrix3fv(location, 1, GL_FALSE, value.data());
@@ -248,7 +259,7 @@ GLShaderProgram::setConstant(const char* name, const Eigen::Matrix3f& value)
 void
 GLShaderProgram::setConstant(const char* name, const Eigen::Matrix4f& value)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, value.data(), 16);
     if (location >= 0)
     {
         glUniformMatrix4fv(location, 1, GL_FALSE, value.data());
@@ -261,7 +272,7 @@ GLShaderProgram::setConstant(const char* name, const Eigen::Matrix4f& value)
 void
 GLShaderProgram::setConstant(const char* name, const Spectrum& color)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, color.data(), 3);
     if (location >= 0)
     {
         glUniform3fv(location, 1, color.data());
@@ -274,7 +285,7 @@ GLShaderProgram::setConstant(const char* name, const Spectrum& color)
 void
 GLShaderProgram::setConstantArray(const char* name, const float values[], unsigned int count)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, values, count);
     if (location >= 0)
     {
         glUniform1fv(location, count, values);
@@ -287,7 +298,7 @@ GLShaderProgram::setConstantArray(const char* name, const float values[], unsign
 void
 GLShaderProgram::setConstantArray(const char* name, const Eigen::Vector2f values[], unsigned int count)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, values[0].data(), count * 2);
     if (location >= 0)
     {
         glUniform2fv(location, count, values[0].data());
@@ -300,7 +311,7 @@ GLShaderProgram::setConstantArray(const char* name, const Eigen::Vector2f values
 void
 GLShaderProgram::setConstantArray(const char* name, const Eigen::Vector3f values[], unsigned int count)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, values[0].data(), count * 3);
     if (location >= 0)
     {
         glUniform3fv(location, count, values[0].data());
@@ -313,7 +324,7 @@ GLShaderProgram::setConstantArray(const char* name, const Eigen::Vector3f values
 void
 GLShaderProgram::setConstantArray(const char* name, const Eigen::Vector4f values[], unsigned int count)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, values[0].data(), count * 4);
     if (location >= 0)
     {
         glUniform4fv(location, count, values[0].data());
@@ -326,7 +337,7 @@ GLShaderProgram::setConstantArray(const char* name, const Eigen::Vector4f values
 void
 GLShaderProgram::setConstantArray(const char* name, const Eigen::Matrix4f values[], unsigned int count)
 {
-    GLint location = glGetUniformLocationARB(m_handle, name);
+    GLint location = uniformLocation(name, values[0].data(), count * 16);
     if (location >= 0)
     {
         glUniformMatrix4fv(location, count, GL_FALSE, values[0].data());
@@ -334,6 +345,109 @@ GLShaderProgram::setConstantArray(const char* name, const Eigen::Matrix4f values
 }
 
 
+/** Reset the counts of uploaded and redundant uniform values.
+  */
+void
+GLShaderProgram::resetUniformStatistics()
+{
+    s_uniformUploadCount = 0;
+    s_redundantUniformCount = 0;
+}
+
+
+// FNV-1a hash of a uniform name
+static unsigned int
+hashUniformName(const char* name)
+{
+    unsigned int hash = 2166136261u;
+    for (const char* c = name; *c; ++c)
+    {
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    }
+
+    return hash;
+}
+
+
+// Get the location of a uniform and record the value that's about to be set.
+// Returns -1 if the uniform doesn't exist in the program or if it already has
+// the specified value, in which case the caller shouldn't upload it again.
+GLint
+GLShaderProgram::uniformLocation(const char* name, const float* data, unsigned int floatCount)
+{
+    unsigned int hash = hashUniformName(name);
+
+    UniformCacheEntry* entry = NULL;
+    unsigned int mask = unsigned(m_uniformTable.size()) - 1;
+    unsigned int slot = hash & mask;
+    if (!m_uniformTable.empty())
+    {
+        for (; m_uniformTable[slot] >= 0; slot = (slot + 1) & mask)
+        {
+            UniformCacheEntry& e = m_uniforms[m_uniformTable[slot]];
+            if (e.hash == hash && strcmp(e.name.c_str(), name) == 0)
+            {
+                entry = &e;
+                break;
+            }
+        }
+    }
+
+    if (!entry)
+    {
+        UniformCacheEntry newEntry;
+        newEntry.name = name;
+        newEntry.hash = hash;
+        newEntry.location = glGetUniformLocationARB(m_handle, name);
+        newEntry.valueCount = 0;
+        m_uniforms.push_back(newEntry);
+        entry = &m_uniforms.back();
+
+        // Keep the table at most half full
+        if (m_uniforms.size() * 2 > m_uniformTable.size())
+        {
+            m_uniformTable.assign(max(size_t(16), m_uniformTable.size() * 2), -1);
+            mask = unsigned(m_uniformTable.size()) - 1;
+            for (unsigned int i = 0; i < m_uniforms.size(); ++i)
+            {
+                for (slot = m_uniforms[i].hash & mask; m_uniformTable[slot] >= 0; slot = (slot + 1) & mask)
+                {
+                }
+                m_uniformTable[slot] = int(i);
+            }
+        }
+        else
+        {
+            m_uniformTable[slot] = int(m_uniforms.size() - 1);
+        }
+    }
+
+    if (entry->location < 0)
+    {
+        return -1;
+    }
+
+    if (floatCount > 0 && entry->valueCount == floatCount && memcmp(entry->value, data, floatCount * sizeof(float)) == 0)
+    {
+        ++s_redundantUniformCount;
+        return -1;
+    }
+
+    if (floatCount <= MaxCachedUniformFloats)
+    {
+        memcpy(entry->value, data, floatCount * sizeof(float));
+        entry->valueCount = floatCount;
+    }
+    else
+    {
+        entry->valueCount = 0;
+    }
+    ++s_uniformUploadCount;
+
+    return entry->location;
+}
+
+
 /** Create a shader program using the specified vertex and fragment
   * shader source strings.
   *
@@ -27,6 +27,7 @@
 #include "GLShader.h"
 #include "../Spectrum.h"
 #include <string>
+#include <vector>
 
 
 namespace vesta
@@ -103,12 +104,57 @@ public:
     static GLShaderProgram* CreateShaderProgram(const std::string& vertexShaderSource,
                                                 const std::string& fragmentShaderSource);
 
+    /** Get the number of uniform values sent to OpenGL by all shader
+      * programs since the last call to resetUniformStatistics().
+      */
+    static unsigned int uniformUploadCount()
+    {
+        return s_uniformUploadCount;
+    }
+
+    /** Get the number of uniform updates that were skipped because the
+      * uniform already had the requested value.
+      */
+    static unsigned int redundantUniformCount()
+    {
+        return s_redundantUniformCount;
+    }
+
+    static void resetUniformStatistics();
+
+private:
+    // Uniform locations are looked up once per program and cached along
+    // with the last value set, so that redundant uploads can be skipped.
+    // Values larger than a 4x4 matrix (i.e. most arrays) aren't cached and
+    // are always uploaded.
+    enum { MaxCachedUniformFloats = 16 };
+
+    struct UniformCacheEntry
+    {
+        std::string name;
+        unsigned int hash;
+        GLint location;
+        unsigned int valueCount;
+        float value[MaxCachedUniformFloats];
+    };
+
+    GLint uniformLocation(const char* name, const float* data, unsigned int floatCount);
+
 private:
     GLhandleARB m_handle;
     counted_ptr<GLShader> m_vertexShader;
     counted_ptr<GLShader> m_fragmentShader;
     std::string m_log;
     bool m_isLinked;
+    std::vector<UniformCacheEntry> m_uniforms;
+
+    // Open addressed hash table of indices into m_uniforms (or -1 for an
+    // empty slot), keyed by a hash of the uniform name. Lookups don't need to
+    // build a string or scan all uniforms. The size is a power of two.
+    std::vector<int> m_uniformTable;
+
+    static unsigned int s_uniformUploadCount;
+    static unsigned int s_redundantUniformCount;
 };
 
 }
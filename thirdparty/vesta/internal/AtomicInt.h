@@ -20,6 +20,8 @@
 #error Unsupported compiler!
 #endif
 
+#include "../IntegerTypes.h"
+
 #if USE_MSVC_ATOMIC_INTRINSICS
 #include <intrin.h>
 #endif
@@ -76,6 +78,52 @@ private:
     volatile int m_value;
 };
 
+
+/**  Wrapper around a 64-bit integer that may be written by one thread while
+  *  it's read by another. Loads and stores are atomic, so a reader never sees
+  *  a partially written value, even on 32-bit targets. No memory ordering is
+  *  implied.
+  */
+class AtomicInt64
+{
+public:
+    AtomicInt64(v_int64 value) :
+        m_value(value)
+    {
+    }
+
+    /** Atomic load.
+      */
+    inline v_int64 load() const
+    {
+#if USE_GCC_ATOMIC_INTRINSICS
+        return __atomic_load_n(&m_value, __ATOMIC_RELAXED);
+#elif USE_MSVC_ATOMIC_INTRINSICS
+        return _InterlockedCompareExchange64(const_cast<volatile __int64*>(&m_value), 0, 0);
+#else
+        // NOT THREAD SAFE
+        return m_value;
+#endif
+    }
+
+    /** Atomic store.
+      */
+    inline void store(v_int64 value)
+    {
+#if USE_GCC_ATOMIC_INTRINSICS
+        __atomic_store_n(&m_value, value, __ATOMIC_RELAXED);
+#elif USE_MSVC_ATOMIC_INTRINSICS
+        _InterlockedExchange64(&m_value, value);
+#else
+        // NOT THREAD SAFE
+        m_value = value;
+#endif
+    }
+
+private:
+    volatile v_int64 m_value;
+};
+
 }
 
 #endif // _VESTA_ATOMIC_INT_H_
@@ -11,6 +11,7 @@
 #include "EclipseShadowVolumeSet.h"
 #include "../Entity.h"
 #include "../Geometry.h"
+#include "../Units.h"
 #include <cmath>
 #include <cassert>
 #include <algorithm>
@@ -47,10 +48,12 @@ using namespace std;
 //
 // Notes:
 //   - clear() should be called for each frame rendered.
-//   - There is currently no spatial hierarchy created for shadow volumes; the
-//     number of ellipsoidal bodies in a solar system is expected to be low. However,
-//     the class interface was designed so that it doesn't need to be changed if some
-//     structure to accelerate intersection testing is eventually added.
+//   - frustumCull() builds a spatial index of the remaining shadow volumes so
+//     that findIntersectingShadows() only tests nearby occluders. Every shadow cone
+//     lies within a small angle of its axis as seen from the light source, so the
+//     index is a grid of directions from the light; a shadow volume is entered in
+//     the grid cells covered by its cone, and an object is tested against the
+//     shadows in the cells covered by its bounding sphere.
 
 // Test whether the cone completely contains a sphere
 static bool
@@ -107,8 +110,28 @@ coneContainsSphere(const Vector3d& apex,
 
 
 
+// Cell size limits for the shadow volume index
+static const double MinIndexCellSize = PI / 8192.0;
+static const double MaxIndexCellSize = PI / 8.0;
+
+// Cones or spheres covering more index cells than this are tested linearly
+static const unsigned int MaxCellsPerCap = 64;
+
+// With only a few shadows, building the index costs more than it saves
+static const unsigned int MinIndexedShadows = 16;
+
+
 EclipseShadowVolumeSet::EclipseShadowVolumeSet() :
-    m_insideUmbra(false)
+    m_insideUmbra(false),
+    m_lightPosition(Vector3d::Zero()),
+    m_singleLight(true),
+    m_indexEnabled(true),
+    m_indexValid(false),
+    m_cellSize(MaxIndexCellSize),
+    m_maxConeAngle(0.0),
+    m_latitudeCells(0),
+    m_longitudeCells(0),
+    m_queryStamp(0)
 {
 }
 
@@ -127,31 +150,210 @@ EclipseShadowVolumeSet::clear()
     m_allShadows.clear();
     m_frustumShadows.clear();
     m_intersectingShadows.clear();
+    m_singleLight = true;
+    m_indexValid = false;
+}
+
+
+// Test whether a truncated cone lies entirely on the negative side of a plane.
+// The truncated cone is the convex hull of its two end caps, so it suffices to
+// find the point of each cap that is farthest along the plane normal.
+static bool
+coneOutsidePlane(const Vector3d& apex,
+                 const Vector3d& direction,
+                 double front,
+                 double back,
+                 double tanConeAngle,
+                 const Vector3d& planeNormal,
+                 double planeOffset)
+{
+    double NdD = planeNormal.dot(direction);
+    double capExtent = tanConeAngle * sqrt(max(0.0, 1.0 - NdD * NdD));
+    double NdA = planeNormal.dot(apex);
+
+    double frontMax = NdA + front * (NdD + capExtent);
+    double backMax = NdA + back * (NdD + capExtent);
+
+    return max(frontMax, backMax) < planeOffset;
 }
 
 
 /** Generate the list of shadow volumes to test against by
   * filtering out shadows that don't intersect the view
-  * frustum.
+  * frustum, and build the index used to accelerate
+  * findIntersectingShadows().
+  *
+  * Shadow volumes are only culled against the side planes
+  * of perspective projections. The near and far planes are
+  * not used because objects outside them may still be drawn
+  * in another depth buffer span.
   *
   * \returns true if there were any shadows intersecting the frustum
   */
 bool
-EclipseShadowVolumeSet::frustumCull(const Frustum& /* frustum */)
+EclipseShadowVolumeSet::frustumCull(const PlanarProjection& projection,
+                                    const Vector3d& cameraPosition,
+                                    const Quaterniond& cameraOrientation)
 {
     m_frustumShadows.clear();
 
-    for (unsigned int i = 0; i < m_allShadows.size(); ++i)
+    if (projection.type() != PlanarProjection::Perspective)
     {
-        // This step isn't implemented yet. For now, we'll just copy every
-        // shadow into the frustum intersection list
-        m_frustumShadows.push_back(&m_allShadows.at(i));
+        for (unsigned int i = 0; i < m_allShadows.size(); ++i)
+        {
+            m_frustumShadows.push_back(&m_allShadows.at(i));
+        }
+    }
+    else
+    {
+        // Convert the side planes of the frustum to world coordinates. The planes
+        // pass through the camera position, and points inside the frustum lie on
+        // the positive side of each plane.
+        Frustum frustum = projection.frustum();
+        Matrix3d toWorld = cameraOrientation.toRotationMatrix();
+        Vector3d planeNormals[4];
+        double planeOffsets[4];
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            planeNormals[i] = toWorld * frustum.planeNormals[i];
+            planeOffsets[i] = planeNormals[i].dot(cameraPosition);
+        }
+
+        for (unsigned int i = 0; i < m_allShadows.size(); ++i)
+        {
+            const ConicShadowVolume& cone = m_allShadows[i];
+            double tanConeAngle = cone.sinAngle / cone.cosAngle;
+
+            bool outside = false;
+            for (unsigned int j = 0; j < 4 && !outside; ++j)
+            {
+                outside = coneOutsidePlane(cone.apex, cone.direction, cone.front, cone.back, tanConeAngle,
+                                           planeNormals[j], planeOffsets[j]);
+            }
+
+            if (!outside)
+            {
+                m_frustumShadows.push_back(&m_allShadows.at(i));
+            }
+        }
     }
 
+    buildIndex();
+
     return !m_frustumShadows.empty();
 }
 
 
+// Compute the cells of the index grid covered by a spherical cap of directions
+// as seen from the light source. Returns false if the cap is too large to be
+// indexed efficiently.
+bool
+EclipseShadowVolumeSet::capCells(const Vector3d& direction, double angularRadius, vector<unsigned int>& cells) const
+{
+    cells.clear();
+
+    double lat = asin(max(-1.0, min(1.0, direction.z())));
+    double lon = atan2(direction.y(), direction.x());
+
+    // Caps containing a pole cover every longitude
+    double minLat = lat - angularRadius;
+    double maxLat = lat + angularRadius;
+    if (maxLat >= PI / 2.0 - m_cellSize || minLat <= -PI / 2.0 + m_cellSize)
+    {
+        return false;
+    }
+
+    // Largest longitude difference between the center and any point on the cap
+    double lonExtent = asin(min(1.0, sin(angularRadius) / cos(lat)));
+
+    int firstRow = (int) floor((minLat + PI / 2.0) / m_cellSize);
+    int lastRow = (int) floor((maxLat + PI / 2.0) / m_cellSize);
+    int firstColumn = (int) floor((lon - lonExtent + PI) / m_cellSize);
+    int lastColumn = (int) floor((lon + lonExtent + PI) / m_cellSize);
+
+    unsigned int rowCount = (unsigned int) (lastRow - firstRow + 1);
+    unsigned int columnCount = (unsigned int) (lastColumn - firstColumn + 1);
+    if (columnCount > m_longitudeCells || rowCount * columnCount > MaxCellsPerCap)
+    {
+        return false;
+    }
+
+    int longitudeCells = (int) m_longitudeCells;
+    for (int row = max(0, firstRow); row <= min(lastRow, (int) m_latitudeCells - 1); ++row)
+    {
+        for (int column = firstColumn; column <= lastColumn; ++column)
+        {
+            int wrappedColumn = ((column % longitudeCells) + longitudeCells) % longitudeCells;
+            cells.push_back((unsigned int) row * m_longitudeCells + (unsigned int) wrappedColumn);
+        }
+    }
+
+    return true;
+}
+
+
+// Enter all frustum shadows into the spatial index.
+void
+EclipseShadowVolumeSet::buildIndex()
+{
+    m_index.clear();
+    m_unindexedShadows.clear();
+    m_indexValid = false;
+
+    // The index requires all shadows to be cast by the same light source
+    if (!m_indexEnabled || !m_singleLight || m_frustumShadows.size() < MinIndexedShadows)
+    {
+        return;
+    }
+
+    // Choose a cell size a few times larger than the typical cone angle, so
+    // that most shadow volumes only occupy a few cells.
+    vector<double> coneAngles;
+    coneAngles.reserve(m_frustumShadows.size());
+    for (unsigned int i = 0; i < m_frustumShadows.size(); ++i)
+    {
+        coneAngles.push_back(atan2(m_frustumShadows[i]->sinAngle, m_frustumShadows[i]->cosAngle));
+    }
+    nth_element(coneAngles.begin(), coneAngles.begin() + coneAngles.size() / 2, coneAngles.end());
+    double medianAngle = coneAngles[coneAngles.size() / 2];
+    m_maxConeAngle = *max_element(coneAngles.begin(), coneAngles.end());
+
+    // The cell size is adjusted so that the columns exactly span 360 degrees of
+    // longitude; otherwise the cells wouldn't line up where the longitude wraps.
+    double cellSize = max(MinIndexCellSize, min(MaxIndexCellSize, medianAngle * 4.0));
+    m_longitudeCells = (unsigned int) ceil(2.0 * PI / cellSize);
+    m_cellSize = 2.0 * PI / m_longitudeCells;
+    m_latitudeCells = (unsigned int) ceil(PI / m_cellSize);
+
+    // Each shadow cone lies within the cone angle of its axis as seen from the
+    // light source.
+    for (unsigned int i = 0; i < m_frustumShadows.size(); ++i)
+    {
+        const ConicShadowVolume* cone = m_frustumShadows[i];
+        if (capCells(cone->direction, atan2(cone->sinAngle, cone->cosAngle), m_queryCells))
+        {
+            for (unsigned int j = 0; j < m_queryCells.size(); ++j)
+            {
+                IndexEntry entry;
+                entry.cell = m_queryCells[j];
+                entry.shadow = i;
+                m_index.push_back(entry);
+            }
+        }
+        else
+        {
+            m_unindexedShadows.push_back(i);
+        }
+    }
+
+    sort(m_index.begin(), m_index.end());
+
+    m_candidateStamps.assign(m_frustumShadows.size(), 0);
+    m_queryStamp = 0;
+    m_indexValid = true;
+}
+
+
 /** Find all shadows intersecting a given sphere. The list of
   * intersecting shadows is available via the intersectingShadows()
   * method. Calling this method will also set the insideUmbra flag
@@ -166,9 +368,70 @@ EclipseShadowVolumeSet::findIntersectingShadows(const Entity* entity, const Vect
     m_intersectingShadows.clear();
     m_insideUmbra = false;
 
-    for (vector<ConicShadowVolume*>::const_iterator iter = m_frustumShadows.begin(); iter != m_frustumShadows.end(); ++iter)
+    // Look up the shadows in the index cells covered by the sphere. The candidates
+    // are visited in their original order so that the result doesn't depend on
+    // whether the index is used.
+    //
+    // The sphere test used below accepts spheres within a distance r of the cone
+    // surface. Seen from the light, the center of such a sphere may be farther from
+    // the cone than the apparent radius asin(r / D) of the sphere, because the cone
+    // surface isn't viewed edge on. If the center is at most an angle phi from the
+    // cone axis, the extra distance is bounded by widening the sphere to an angular
+    // radius atan(r / (D cos(phi) cos(theta))), where theta is the cone angle.
+    // Spheres too large for this bound to hold are tested against every shadow.
+    m_candidates.clear();
+    bool useIndex = false;
+    Vector3d lightToSphere = sphereCenter - m_lightPosition;
+    double lightDistance = lightToSphere.norm();
+    if (m_indexValid && lightDistance > 4.0 * sphereRadius)
+    {
+        double sinApparentRadius = sphereRadius / lightDistance;
+        double maxAxisAngle = m_maxConeAngle + 2.0 * asin(sinApparentRadius);
+        if (maxAxisAngle < PI / 3.0)
+        {
+            double angularRadius = atan(sinApparentRadius / (cos(maxAxisAngle) * cos(m_maxConeAngle)));
+            useIndex = capCells(lightToSphere / lightDistance, angularRadius, m_queryCells);
+        }
+    }
+
+    if (useIndex)
+    {
+        if (++m_queryStamp == 0)
+        {
+            fill(m_candidateStamps.begin(), m_candidateStamps.end(), 0u);
+            m_queryStamp = 1;
+        }
+
+        for (unsigned int i = 0; i < m_queryCells.size(); ++i)
+        {
+            IndexEntry key;
+            key.cell = m_queryCells[i];
+            key.shadow = 0;
+            for (vector<IndexEntry>::const_iterator iter = lower_bound(m_index.begin(), m_index.end(), key);
+                 iter != m_index.end() && iter->cell == key.cell; ++iter)
+            {
+                if (m_candidateStamps[iter->shadow] != m_queryStamp)
+                {
+                    m_candidateStamps[iter->shadow] = m_queryStamp;
+                    m_candidates.push_back(iter->shadow);
+                }
+            }
+        }
+
+        m_candidates.insert(m_candidates.end(), m_unindexedShadows.begin(), m_unindexedShadows.end());
+        sort(m_candidates.begin(), m_candidates.end());
+    }
+    else
     {
-        ConicShadowVolume* cone = *iter;
+        for (unsigned int i = 0; i < m_frustumShadows.size(); ++i)
+        {
+            m_candidates.push_back(i);
+        }
+    }
+
+    for (vector<unsigned int>::const_iterator iter = m_candidates.begin(); iter != m_candidates.end(); ++iter)
+    {
+        ConicShadowVolume* cone = m_frustumShadows[*iter];
         if (entity != cone->occluder && coneIntersectsSphere(*cone, sphereCenter, sphereRadius))
         {
             bool planarOccluder = cone->occluder->geometry()->ellipsoid().isDegenerate();
@@ -321,6 +584,15 @@ EclipseShadowVolumeSet::addShadow(const Entity* occluder,
     cone.orientation = occluderOrientation;
     cone.ellipseComputed = false;
 
+    if (m_allShadows.empty())
+    {
+        m_lightPosition = lightPosition;
+    }
+    else if (lightPosition != m_lightPosition)
+    {
+        m_singleLight = false;
+    }
+
     m_allShadows.push_back(cone);
 }
 
@@ -377,22 +649,3 @@ EclipseShadowVolumeSet::coneIntersectsSphere(const ConicShadowVolume& cone, cons
     return true;
 }
 
-
-#if 0
-// For use when frustum culling shadow volumes
-static bool cullConePlane(const Vector3d& coneApex, const Vector3d& coneDirection, double cosConeAngle, double coneH,
-                          const Hyperplane<double, 3>& plane)
-{
-    double NdC = plane.normal().dot(coneApex);
-    double NdD = plane.normal().dot(coneDirection);
-    double root = sqrt(1.0 - NdD * NdD);
-    if (root > cosConeAngle && NdD < 0)
-    {
-        return NdC < plane.offset();
-    }
-
-    // double r =  h * NdD + coneH * tanConeAngle * root;
-    // return NdC + r < plane.offset();
-    return true;
-}
-#endif
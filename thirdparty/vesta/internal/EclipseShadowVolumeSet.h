@@ -11,7 +11,7 @@
 #ifndef _VESTA_ECLIPSE_SHADOW_VOLUME_SET_H_
 #define _VESTA_ECLIPSE_SHADOW_VOLUME_SET_H_
 
-#include "../Frustum.h"
+#include "../PlanarProjection.h"
 #include "../Object.h"
 #include "../GeneralEllipse.h"
 #include <Eigen/Core>
@@ -50,9 +50,41 @@ public:
                    const Eigen::Quaternionf& occluderOrientation,
                    const Eigen::Vector3d& lightPosition,
                    double lightRadius);
-    bool frustumCull(const Frustum& frustum);
+    bool frustumCull(const PlanarProjection& projection,
+                     const Eigen::Vector3d& cameraPosition,
+                     const Eigen::Quaterniond& cameraOrientation);
     bool findIntersectingShadows(const Entity* entity, const Eigen::Vector3d& sphereCenter, double sphereRadius);
 
+    /** Get the total number of shadow volumes in the set. */
+    unsigned int shadowCount() const
+    {
+        return (unsigned int) m_allShadows.size();
+    }
+
+    /** Get the number of shadow volumes that passed the last frustum cull. */
+    unsigned int frustumShadowCount() const
+    {
+        return (unsigned int) m_frustumShadows.size();
+    }
+
+    /** Returns true if findIntersectingShadows uses the spatial index to
+      * find candidate shadow volumes.
+      */
+    bool isIndexEnabled() const
+    {
+        return m_indexEnabled;
+    }
+
+    /** Enable or disable use of the spatial index. When disabled, every
+      * shadow volume in the frustum is tested against each object. This
+      * is intended for testing and benchmarking; the results are the same
+      * either way.
+      */
+    void setIndexEnabled(bool enable)
+    {
+        m_indexEnabled = enable;
+    }
+
     const EclipseShadowVector& intersectingShadows() const
     {
         return m_intersectingShadows;
@@ -89,6 +121,19 @@ private:
     };
 
     static bool coneIntersectsSphere(const ConicShadowVolume& cone, const Eigen::Vector3d& center, double r);
+    void buildIndex();
+    bool capCells(const Eigen::Vector3d& direction, double angularRadius, std::vector<unsigned int>& cells) const;
+
+    struct IndexEntry
+    {
+        unsigned int cell;
+        unsigned int shadow;
+
+        bool operator<(const IndexEntry& other) const
+        {
+            return cell < other.cell || (cell == other.cell && shadow < other.shadow);
+        }
+    };
 
 private:
     typedef std::vector<ConicShadowVolume, Eigen::aligned_allocator<ConicShadowVolume> > ShadowVolumeVector;
@@ -97,6 +142,28 @@ private:
     std::vector<ConicShadowVolume*> m_frustumShadows;
     EclipseShadowVector m_intersectingShadows;
     bool m_insideUmbra;
+
+    // Position of the light source shared by all shadow volumes
+    Eigen::Vector3d m_lightPosition;
+    bool m_singleLight;
+
+    // Spatial index of the frustum shadows. Cells are a latitude/longitude
+    // grid of directions as seen from the light source; each shadow volume
+    // is entered in the cells covered by its cone.
+    bool m_indexEnabled;
+    bool m_indexValid;
+    double m_cellSize;
+    double m_maxConeAngle;
+    unsigned int m_latitudeCells;
+    unsigned int m_longitudeCells;
+    std::vector<IndexEntry> m_index;
+    std::vector<unsigned int> m_unindexedShadows;
+
+    // Scratch storage for index queries
+    std::vector<unsigned int> m_queryCells;
+    std::vector<unsigned int> m_candidates;
+    std::vector<unsigned int> m_candidateStamps;
+    unsigned int m_queryStamp;
 };
 
 }
@@ -0,0 +1,407 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace vesta;
+using namespace std;
+
+
+// A collapse is rejected if it would turn the normal of any remaining
+// triangle by more than about 75 degrees.
+static const double MinNormalCosine = 0.25;
+
+
+namespace
+{
+
+struct Collapse
+{
+    float cost;
+    v_uint32 from;
+    v_uint32 to;
+
+    bool operator<(const Collapse& other) const
+    {
+        return cost < other.cost;
+    }
+};
+
+
+// Order vertex indices by position so that coincident vertices are adjacent
+struct PositionOrderingPredicate
+{
+    PositionOrderingPredicate(const float* positions) :
+        m_positions(positions)
+    {
+    }
+
+    bool operator()(v_uint32 i0, v_uint32 i1) const
+    {
+        const float* p0 = m_positions + i0 * 3;
+        const float* p1 = m_positions + i1 * 3;
+        if (p0[0] != p1[0])
+            return p0[0] < p1[0];
+        else if (p0[1] != p1[1])
+            return p0[1] < p1[1];
+        else
+            return p0[2] < p1[2];
+    }
+
+    const float* m_positions;
+};
+
+}
+
+
+static inline void
+cross(const float* p0, const float* p1, const float* p2, double n[3])
+{
+    double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+
+/** Create a simplifier for a triangle list. The positions array contains
+  * three floats per vertex; it must remain valid for the lifetime of the
+  * simplifier. Vertices marked in lockedVertices will never be moved.
+  */
+MeshSimplifier::MeshSimplifier(const float* positions,
+                               unsigned int vertexCount,
+                               const v_uint32* indices,
+                               unsigned int triangleCount,
+                               const std::vector<bool>& lockedVertices) :
+    m_positions(positions),
+    m_vertexCount(vertexCount),
+    m_indices(indices, indices + triangleCount * 3),
+    m_locked(lockedVertices),
+    m_maxCost(0.0f)
+{
+    m_locked.resize(vertexCount, false);
+
+    // Accumulate the area weighted quadrics of the planes of all triangles
+    // that share each vertex.
+    Quadric zero = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    m_quadrics.resize(vertexCount, zero);
+    for (unsigned int i = 0; i < m_indices.size(); i += 3)
+    {
+        const float* p0 = m_positions + m_indices[i] * 3;
+        double n[3];
+        cross(p0, m_positions + m_indices[i + 1] * 3, m_positions + m_indices[i + 2] * 3, n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0)
+        {
+            continue;
+        }
+
+        double a = n[0] / length;
+        double b = n[1] / length;
+        double c = n[2] / length;
+        double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+        double area = 0.5 * length;
+
+        Quadric q = { a * a * area, a * b * area, a * c * area, a * d * area,
+                      b * b * area, b * c * area, b * d * area,
+                      c * c * area, c * d * area,
+                      d * d * area,
+                      area };
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            m_quadrics[m_indices[i + j]].add(q);
+        }
+    }
+
+    lockTopologicalFeatures();
+}
+
+
+float
+MeshSimplifier::error() const
+{
+    return sqrt(m_maxCost);
+}
+
+
+// Lock vertices on open borders, non-manifold edges, and attribute seams.
+// Moving any of these would open cracks or distort texture mapping.
+void
+MeshSimplifier::lockTopologicalFeatures()
+{
+    vector<v_uint64> edges;
+    edges.reserve(m_indices.size());
+    for (unsigned int i = 0; i < m_indices.size(); i += 3)
+    {
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            v_uint32 v0 = m_indices[i + j];
+            v_uint32 v1 = m_indices[i + (j + 1) % 3];
+            edges.push_back((v_uint64(min(v0, v1)) << 32) | max(v0, v1));
+        }
+    }
+    sort(edges.begin(), edges.end());
+
+    // Edges used by exactly two triangles are interior edges of a manifold
+    // surface.
+    for (unsigned int i = 0; i < edges.size(); )
+    {
+        unsigned int j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i])
+        {
+            ++j;
+        }
+
+        if (j - i != 2)
+        {
+            m_locked[v_uint32(edges[i] >> 32)] = true;
+            m_locked[v_uint32(edges[i] & 0xffffffff)] = true;
+        }
+        i = j;
+    }
+
+    vector<v_uint32> order(m_vertexCount);
+    for (unsigned int i = 0; i < m_vertexCount; ++i)
+    {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), PositionOrderingPredicate(m_positions));
+
+    PositionOrderingPredicate positionLess(m_positions);
+    for (unsigned int i = 1; i < m_vertexCount; ++i)
+    {
+        if (!positionLess(order[i - 1], order[i]))
+        {
+            m_locked[order[i - 1]] = true;
+            m_locked[order[i]] = true;
+        }
+    }
+}
+
+
+// Compute the cost of moving vertex from onto vertex to: the mean squared
+// distance of the new position from the planes of the original triangles
+// around both vertices.
+float
+MeshSimplifier::collapseCost(v_uint32 from, v_uint32 to) const
+{
+    Quadric q = m_quadrics[from];
+    q.add(m_quadrics[to]);
+    if (q.weight <= 0.0)
+    {
+        return 0.0f;
+    }
+
+    const float* p = m_positions + to * 3;
+    double x = p[0];
+    double y = p[1];
+    double z = p[2];
+    double e = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z +
+               2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z) +
+               2.0 * (q.ad * x + q.bd * y + q.cd * z) +
+               q.d2;
+
+    return float(max(0.0, e / q.weight));
+}
+
+
+// Return true if moving vertex from onto vertex to would flip or severely
+// distort any triangle that remains afterward. The number of triangles that
+// the collapse removes is returned in removedTriangleCount.
+bool
+MeshSimplifier::flipsTriangles(v_uint32 from, v_uint32 to, unsigned int* removedTriangleCount) const
+{
+    unsigned int removedCount = 0;
+    const float* newPosition = m_positions + to * 3;
+
+    for (v_uint32 i = m_adjacencyOffsets[from]; i < m_adjacencyOffsets[from + 1]; ++i)
+    {
+        const v_uint32* tri = &m_indices[m_adjacentTriangles[i] * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+        {
+            ++removedCount;
+            continue;
+        }
+
+        const float* p[3];
+        const float* q[3];
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            p[j] = m_positions + tri[j] * 3;
+            q[j] = tri[j] == from ? newPosition : p[j];
+        }
+
+        double n0[3];
+        double n1[3];
+        cross(p[0], p[1], p[2], n0);
+        cross(q[0], q[1], q[2], n1);
+        if (n0[0] == 0.0 && n0[1] == 0.0 && n0[2] == 0.0)
+        {
+            // Already degenerate; there's no orientation to preserve
+            continue;
+        }
+
+        double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        double length0 = sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+        double length1 = sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+        if (dot <= MinNormalCosine * length0 * length1)
+        {
+            return true;
+        }
+    }
+
+    *removedTriangleCount = removedCount;
+    return false;
+}
+
+
+// Build the list of triangles that use each vertex
+void
+MeshSimplifier::buildAdjacency()
+{
+    m_adjacencyOffsets.assign(m_vertexCount + 1, 0);
+    for (unsigned int i = 0; i < m_indices.size(); ++i)
+    {
+        m_adjacencyOffsets[m_indices[i] + 1]++;
+    }
+
+    for (unsigned int i = 0; i < m_vertexCount; ++i)
+    {
+        m_adjacencyOffsets[i + 1] += m_adjacencyOffsets[i];
+    }
+
+    m_adjacentTriangles.resize(m_indices.size());
+    vector<v_uint32> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+    for (unsigned int i = 0; i < m_indices.size(); ++i)
+    {
+        m_adjacentTriangles[fill[m_indices[i]]++] = i / 3;
+    }
+}
+
+
+/** Collapse edges until the triangle count is no greater than
+  * targetTriangleCount, or until no more edges can be collapsed.
+  *
+  * Each pass sorts the candidate collapses by cost and applies the cheapest
+  * ones that don't touch the neighborhood of a collapse already made in the
+  * same pass. This is much faster than maintaining a priority queue and
+  * gives nearly the same result.
+  *
+  * \return true if the target triangle count was reached
+  */
+bool
+MeshSimplifier::simplify(unsigned int targetTriangleCount)
+{
+    vector<Collapse> collapses;
+    vector<bool> touched;
+    vector<v_uint32> collapseTarget;
+
+    while (triangleCount() > targetTriangleCount)
+    {
+        buildAdjacency();
+
+        // Consider each edge in the cheaper of the directions allowed by the
+        // vertex locks. Interior edges appear twice, which is harmless.
+        collapses.clear();
+        for (unsigned int i = 0; i < m_indices.size(); i += 3)
+        {
+            for (unsigned int j = 0; j < 3; ++j)
+            {
+                v_uint32 v0 = m_indices[i + j];
+                v_uint32 v1 = m_indices[i + (j + 1) % 3];
+                if (v0 > v1 || (m_locked[v0] && m_locked[v1]))
+                {
+                    continue;
+                }
+
+                Collapse c;
+                c.from = v0;
+                c.to = v1;
+                c.cost = m_locked[v0] ? numeric_limits<float>::max() : collapseCost(v0, v1);
+                if (!m_locked[v1])
+                {
+                    float reverseCost = collapseCost(v1, v0);
+                    if (reverseCost < c.cost)
+                    {
+                        c.from = v1;
+                        c.to = v0;
+                        c.cost = reverseCost;
+                    }
+                }
+                collapses.push_back(c);
+            }
+        }
+
+        if (collapses.empty())
+        {
+            break;
+        }
+        sort(collapses.begin(), collapses.end());
+
+        touched.assign(m_vertexCount, false);
+        collapseTarget.resize(m_vertexCount);
+        for (unsigned int i = 0; i < m_vertexCount; ++i)
+        {
+            collapseTarget[i] = i;
+        }
+
+        unsigned int excessTriangles = triangleCount() - targetTriangleCount;
+        unsigned int removedTriangles = 0;
+        unsigned int collapseCount = 0;
+        for (unsigned int i = 0; i < collapses.size() && removedTriangles < excessTriangles; ++i)
+        {
+            const Collapse& c = collapses[i];
+            unsigned int removedCount = 0;
+            if (touched[c.from] || touched[c.to] || flipsTriangles(c.from, c.to, &removedCount))
+            {
+                continue;
+            }
+
+            collapseTarget[c.from] = c.to;
+            m_quadrics[c.to].add(m_quadrics[c.from]);
+            m_maxCost = max(m_maxCost, c.cost);
+            removedTriangles += removedCount;
+            ++collapseCount;
+
+            for (v_uint32 j = m_adjacencyOffsets[c.from]; j < m_adjacencyOffsets[c.from + 1]; ++j)
+            {
+                const v_uint32* tri = &m_indices[m_adjacentTriangles[j] * 3];
+                touched[tri[0]] = true;
+                touched[tri[1]] = true;
+                touched[tri[2]] = true;
+            }
+        }
+
+        if (collapseCount == 0)
+        {
+            break;
+        }
+
+        // Apply the collapses and remove triangles that became degenerate
+        unsigned int outputIndex = 0;
+        for (unsigned int i = 0; i < m_indices.size(); i += 3)
+        {
+            v_uint32 v0 = collapseTarget[m_indices[i]];
+            v_uint32 v1 = collapseTarget[m_indices[i + 1]];
+            v_uint32 v2 = collapseTarget[m_indices[i + 2]];
+            if (v0 != v1 && v1 != v2 && v2 != v0)
+            {
+                m_indices[outputIndex++] = v0;
+                m_indices[outputIndex++] = v1;
+                m_indices[outputIndex++] = v2;
+            }
+        }
+        m_indices.resize(outputIndex);
+    }
+
+    return triangleCount() <= targetTriangleCount;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_MESH_SIMPLIFIER_H_
+#define _VESTA_MESH_SIMPLIFIER_H_
+
+#include "../IntegerTypes.h"
+#include <vector>
+
+namespace vesta
+{
+
+/** MeshSimplifier reduces the number of triangles in an indexed triangle list
+  * by repeatedly collapsing edges, choosing the collapses that introduce the
+  * least quadric error. Collapses move one vertex onto another existing
+  * vertex (half-edge collapse), so the simplified triangles index the
+  * original vertex array and no new vertices are created.
+  *
+  * Vertices on open borders, non-manifold edges, and attribute seams (several
+  * vertices sharing one position) never move, nor do any vertices that the
+  * caller locks. This keeps the outline of the mesh and the texture mapping
+  * intact, at the cost of limiting how far some meshes can be simplified.
+  *
+  * simplify() may be called repeatedly with decreasing targets to produce a
+  * chain of levels of detail; error quadrics are carried over from one call
+  * to the next, so error() is always measured against the original mesh.
+  */
+class MeshSimplifier
+{
+public:
+    MeshSimplifier(const float* positions,
+                   unsigned int vertexCount,
+                   const v_uint32* indices,
+                   unsigned int triangleCount,
+                   const std::vector<bool>& lockedVertices);
+
+    bool simplify(unsigned int targetTriangleCount);
+
+    /** Get the current simplified triangle list. */
+    const std::vector<v_uint32>& indices() const
+    {
+        return m_indices;
+    }
+
+    unsigned int triangleCount() const
+    {
+        return m_indices.size() / 3;
+    }
+
+    /** Get the error of the simplified mesh, in the units of the vertex
+      * positions. This is the largest cost of any collapse so far: the root
+      * mean square distance, weighted by triangle area, of the moved vertex
+      * from the planes of the original triangles around the collapsed edge.
+      * It is not a bound on the largest distance between the surfaces;
+      * individual points may deviate by more.
+      */
+    float error() const;
+
+private:
+    struct Quadric
+    {
+        double a2, ab, ac, ad;
+        double b2, bc, bd;
+        double c2, cd;
+        double d2;
+        double weight;
+
+        void add(const Quadric& q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+            weight += q.weight;
+        }
+    };
+
+private:
+    void lockTopologicalFeatures();
+    float collapseCost(v_uint32 from, v_uint32 to) const;
+    bool flipsTriangles(v_uint32 from, v_uint32 to, unsigned int* removedTriangleCount) const;
+    void buildAdjacency();
+
+private:
+    const float* m_positions;
+    unsigned int m_vertexCount;
+    std::vector<v_uint32> m_indices;
+    std::vector<bool> m_locked;
+    std::vector<Quadric> m_quadrics;
+    std::vector<v_uint32> m_adjacencyOffsets;
+    std::vector<v_uint32> m_adjacentTriangles;
+    float m_maxCost;
+};
+
+}
+
+#endif // _VESTA_MESH_SIMPLIFIER_H_
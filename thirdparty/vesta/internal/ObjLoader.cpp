@@ -13,8 +13,14 @@
 #include "../Submesh.h"
 #include "../TextureMapLoader.h"
 #include "../Debug.h"
+#include "../IntegerTypes.h"
 #include <sstream>
+#include <fstream>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 using namespace vesta;
 using namespace Eigen;
@@ -327,11 +333,45 @@ ObjLoader::convertTriangleIndices(ObjTriangle& tri)
 }
 
 
+// Prepare to load a new model
+void
+ObjLoader::reset()
+{
+    // Delete any partially loaded mesh
+    if (m_mesh)
+    {
+        delete m_mesh;
+    }
+    m_mesh = new MeshGeometry();
+
+    m_lineNumber = 1;
+    m_errorMessage = "";
+
+    m_materialGroupStart = 0;
+    m_firstGroupFace = true;
+
+    m_positions.clear();
+    m_normals.clear();
+    m_texCoords.clear();
+
+    m_triangles.clear();
+    m_materialGroups.clear();
+    m_currentVertexType = InvalidVertex;
+
+    // Clear the material table and a default, anonymous material
+    m_materialTable.clear();
+    m_materials.clear();
+    useMaterial("");
+    m_materialLibrary = "";
+}
+
+
 void
 ObjLoader::reportError(const string& message)
 {
-    ostringstream str(m_errorMessage);
+    ostringstream str;
     str << message << " (line: " << m_lineNumber << ")";
+    m_errorMessage = str.str();
     VESTA_LOG("%s", m_errorMessage.c_str());
 }
 
@@ -483,30 +523,7 @@ ObjLoader::useMaterial(const string& materialName)
 MeshGeometry*
 ObjLoader::loadModel(istream& in)
 {
-    // Delete any partially loaded mesh
-    if (m_mesh)
-    {
-        delete m_mesh;
-    }
-    m_mesh = new MeshGeometry();
-
-    m_lineNumber = 1;
-    m_errorMessage = "";
-
-    m_materialGroupStart = 0;
-    m_firstGroupFace = true;
-
-    m_positions.clear();
-    m_normals.clear();
-    m_texCoords.clear();
-
-    m_materialGroups.clear();
-
-    // Clear the material table and a default, anonymous material
-    m_materialTable.clear();
-    m_materials.clear();
-    useMaterial("");
-    m_materialLibrary = "";
+    reset();
 
     vector<string> tokens;
 
@@ -712,6 +729,807 @@ ObjLoader::loadModel(istream& in)
 
 
 
+// The chunked parser below is used for loading large OBJ files. It works
+// directly on a block of text in memory (typically a memory-mapped file)
+// and avoids the string allocations and sscanf calls of the stream parser.
+
+// Powers of ten that are exactly representable as doubles
+static const double ExactPowersOfTen[] =
+{
+    1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+    1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+    1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22
+};
+static const int MaxExactPowerOfTen = 22;
+
+static const unsigned int MaxObjLineTokens = 8;
+
+struct ObjToken
+{
+    const char* begin;
+    const char* end;
+};
+
+
+static inline bool
+isObjWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+static inline bool
+isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+
+// Compare a token with a null-terminated string
+static inline bool
+tokenEquals(const ObjToken& token, const char* s)
+{
+    const char* p = token.begin;
+    while (p != token.end && *s != '\0' && *p == *s)
+    {
+        ++p;
+        ++s;
+    }
+
+    return p == token.end && *s == '\0';
+}
+
+
+// Split a line into whitespace separated tokens. Only the first
+// MaxObjLineTokens are stored, but all tokens are counted.
+static unsigned int
+tokenizeLine(const char* begin, const char* end, ObjToken tokens[])
+{
+    unsigned int tokenCount = 0;
+    const char* p = begin;
+
+    for (;;)
+    {
+        while (p != end && isObjWhitespace(*p))
+        {
+            ++p;
+        }
+
+        if (p == end)
+        {
+            break;
+        }
+
+        const char* tokenStart = p;
+        while (p != end && !isObjWhitespace(*p))
+        {
+            ++p;
+        }
+
+        if (tokenCount < MaxObjLineTokens)
+        {
+            tokens[tokenCount].begin = tokenStart;
+            tokens[tokenCount].end = p;
+        }
+        ++tokenCount;
+    }
+
+    return tokenCount;
+}
+
+
+// Parse a floating point number at the start of a token. As with sscanf's %f
+// conversion, trailing characters after the number are ignored. Decimal
+// numbers with up to 19 significant digits are converted directly; anything
+// else (e.g. inf or nan) is handed off to strtod.
+//
+// The direct conversion rounds twice, once to double and once to float, and
+// digits past the 19th are dropped. A value that lies within a double's
+// precision of the midpoint between two floats can thus round the other way
+// than sscanf would: 1.0000000596046448 gives 1.0 here, but sscanf rounds it
+// up to the next float. Such values are off by one ulp, and they almost never
+// occur in real data.
+static bool
+parseFloat(const ObjToken& token, float& f)
+{
+    const char* p = token.begin;
+    const char* end = token.end;
+
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    v_uint64 mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool haveDigits = false;
+
+    while (p != end && isDigit(*p))
+    {
+        if (significantDigits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0)
+            {
+                ++significantDigits;
+            }
+        }
+        else
+        {
+            ++exponent;
+        }
+        haveDigits = true;
+        ++p;
+    }
+
+    if (p != end && *p == '.')
+    {
+        ++p;
+        while (p != end && isDigit(*p))
+        {
+            if (significantDigits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                {
+                    ++significantDigits;
+                }
+                --exponent;
+            }
+            haveDigits = true;
+            ++p;
+        }
+    }
+
+    if (!haveDigits)
+    {
+        // Not a plain decimal number; use the slow path. The token isn't
+        // null-terminated, so it must be copied first.
+        char buffer[64];
+        size_t length = std::min(size_t(token.end - token.begin), sizeof(buffer) - 1);
+        memcpy(buffer, token.begin, length);
+        buffer[length] = '\0';
+
+        char* numberEnd = NULL;
+        double value = strtod(buffer, &numberEnd);
+        if (numberEnd == buffer)
+        {
+            return false;
+        }
+
+        f = float(value);
+        return true;
+    }
+
+    if (p != end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q != end && (*q == '-' || *q == '+'))
+        {
+            negativeExponent = *q == '-';
+            ++q;
+        }
+
+        if (q != end && isDigit(*q))
+        {
+            int e = 0;
+            while (q != end && isDigit(*q))
+            {
+                if (e < 10000)
+                {
+                    e = e * 10 + (*q - '0');
+                }
+                ++q;
+            }
+            exponent += negativeExponent ? -e : e;
+        }
+    }
+
+    double value = double(mantissa);
+    if (exponent < 0 && exponent >= -MaxExactPowerOfTen)
+    {
+        value /= ExactPowersOfTen[-exponent];
+    }
+    else if (exponent > 0 && exponent <= MaxExactPowerOfTen)
+    {
+        value *= ExactPowersOfTen[exponent];
+    }
+    else if (exponent != 0)
+    {
+        value *= pow(10.0, exponent);
+    }
+
+    f = float(negative ? -value : value);
+
+    return true;
+}
+
+
+// Parse a signed integer; on return, p points to the first character after
+// the integer.
+static bool
+parseInteger(const char*& p, const char* end, int& i)
+{
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    if (p == end || !isDigit(*p))
+    {
+        return false;
+    }
+
+    int value = 0;
+    while (p != end && isDigit(*p))
+    {
+        // Clamp rather than overflow; out of range indices are caught later
+        if (value < 100000000)
+        {
+            value = value * 10 + (*p - '0');
+        }
+        ++p;
+    }
+
+    i = negative ? -value : value;
+
+    return true;
+}
+
+
+// Parse a face vertex in one of the four forms described for getVertexType().
+// Returns the type of vertex, or InvalidVertex if the token is malformed.
+static ObjLoader::ObjVertexType
+parseFaceVertex(const ObjToken& token, ObjLoader::ObjVertex& vertex)
+{
+    const char* p = token.begin;
+    const char* end = token.end;
+
+    vertex = ObjLoader::ObjVertex();
+
+    if (!parseInteger(p, end, vertex.positionIndex))
+    {
+        return ObjLoader::InvalidVertex;
+    }
+
+    if (p == end)
+    {
+        return ObjLoader::PositionVertex;
+    }
+    else if (*p != '/')
+    {
+        return ObjLoader::InvalidVertex;
+    }
+
+    ++p;
+    if (p != end && *p == '/')
+    {
+        ++p;
+        if (!parseInteger(p, end, vertex.normalIndex) || p != end)
+        {
+            return ObjLoader::InvalidVertex;
+        }
+        return ObjLoader::PositionNormalVertex;
+    }
+
+    if (!parseInteger(p, end, vertex.texCoordIndex))
+    {
+        return ObjLoader::InvalidVertex;
+    }
+
+    if (p == end)
+    {
+        return ObjLoader::PositionTexVertex;
+    }
+    else if (*p != '/')
+    {
+        return ObjLoader::InvalidVertex;
+    }
+
+    ++p;
+    if (!parseInteger(p, end, vertex.normalIndex) || p != end)
+    {
+        return ObjLoader::InvalidVertex;
+    }
+
+    return ObjLoader::PositionTexNormalVertex;
+}
+
+
+// Convert an index from a face in a chunk to the form described in the
+// ObjChunk documentation. vertexCount is the number of vertices of that kind
+// that precede the face within the chunk.
+static inline int
+chunkIndex(int objIndex, unsigned int vertexCount)
+{
+    if (objIndex >= 0)
+    {
+        // Positive indices are absolute. Zero is invalid and is left alone;
+        // loadChunks() will reject it.
+        return objIndex;
+    }
+    else if (objIndex < ObjLoader::RelativeIndexBias)
+    {
+        // Too far back to be valid; zero will be rejected
+        return 0;
+    }
+    else
+    {
+        return int(vertexCount) + objIndex + ObjLoader::RelativeIndexBias;
+    }
+}
+
+
+// Convert an index stored by parseChunk() to a zero-based mesh index.
+// Returns -1 if the index is invalid.
+static inline int
+resolveChunkIndex(int chunkIndex, unsigned int offset, unsigned int maxIndex)
+{
+    int index;
+    if (chunkIndex > 0)
+    {
+        index = chunkIndex - 1;
+    }
+    else
+    {
+        index = int(offset) + (chunkIndex - ObjLoader::RelativeIndexBias);
+    }
+
+    return (index < 0 || index >= int(maxIndex)) ? -1 : index;
+}
+
+
+/** Split a block of OBJ text into at most chunkCount ranges of roughly equal
+  * size. Ranges always begin at the start of a line. On return, boundaries
+  * contains the start of each range followed by the end of the data.
+  */
+void
+ObjLoader::splitChunks(const char* data, size_t size, unsigned int chunkCount, vector<const char*>& boundaries)
+{
+    boundaries.clear();
+    boundaries.push_back(data);
+
+    const char* end = data + size;
+    size_t chunkSize = size / max(1u, chunkCount);
+
+    for (unsigned int i = 1; i < chunkCount; ++i)
+    {
+        const char* p = max(data + i * chunkSize, boundaries.back());
+        if (p >= end)
+        {
+            break;
+        }
+
+        const char* newline = reinterpret_cast<const char*>(memchr(p, '\n', end - p));
+        if (!newline)
+        {
+            break;
+        }
+
+        if (newline + 1 < end)
+        {
+            boundaries.push_back(newline + 1);
+        }
+    }
+
+    boundaries.push_back(end);
+}
+
+
+/** Parse the lines of OBJ text in the range [begin, end). The range must start
+  * at the beginning of a line. This method doesn't modify any shared state, so
+  * different chunks of a file may be parsed concurrently. Returns false if the
+  * chunk contained an error, in which case chunk.errorMessage and
+  * chunk.errorLine are set.
+  */
+bool
+ObjLoader::parseChunk(const char* begin, const char* end, ObjChunk& chunk)
+{
+    ObjToken tokens[MaxObjLineTokens];
+    ObjVertexType currentVertexType = InvalidVertex;
+
+    const char* lineStart = begin;
+    while (lineStart < end)
+    {
+        const char* lineEnd = reinterpret_cast<const char*>(memchr(lineStart, '\n', end - lineStart));
+        if (!lineEnd)
+        {
+            lineEnd = end;
+        }
+
+        // Strip comments
+        const char* contentEnd = reinterpret_cast<const char*>(memchr(lineStart, '#', lineEnd - lineStart));
+        if (!contentEnd)
+        {
+            contentEnd = lineEnd;
+        }
+
+        unsigned int tokenCount = tokenizeLine(lineStart, contentEnd, tokens);
+        const char* error = NULL;
+
+        if (tokenCount == 0)
+        {
+            // Blank line
+        }
+        else if (tokenEquals(tokens[0], "v"))
+        {
+            Vector3f position;
+            if (tokenCount != 4)
+            {
+                error = "Vertex position must have three components";
+            }
+            else if (!parseFloat(tokens[1], position.x()) ||
+                     !parseFloat(tokens[2], position.y()) ||
+                     !parseFloat(tokens[3], position.z()))
+            {
+                error = "Bad vertex position";
+            }
+            else
+            {
+                chunk.positions.push_back(position);
+            }
+        }
+        else if (tokenEquals(tokens[0], "vn"))
+        {
+            Vector3f normal;
+            if (tokenCount != 4)
+            {
+                error = "Vertex normal must have three components";
+            }
+            else if (!parseFloat(tokens[1], normal.x()) ||
+                     !parseFloat(tokens[2], normal.y()) ||
+                     !parseFloat(tokens[3], normal.z()))
+            {
+                error = "Bad vertex normal";
+            }
+            else
+            {
+                chunk.normals.push_back(normal);
+            }
+        }
+        else if (tokenEquals(tokens[0], "vt"))
+        {
+            Vector2f texCoord;
+            if (tokenCount != 3)
+            {
+                error = "Texture coordinate must have two components";
+            }
+            else if (!parseFloat(tokens[1], texCoord.x()) ||
+                     !parseFloat(tokens[2], texCoord.y()))
+            {
+                error = "Bad texture coordinate";
+            }
+            else
+            {
+                chunk.texCoords.push_back(texCoord);
+            }
+        }
+        else if (tokenEquals(tokens[0], "f"))
+        {
+            if (tokenCount < 4)
+            {
+                error = "Face has less than three vertices.";
+            }
+            else if (tokenCount > 4)
+            {
+                error = "Face has too many vertices";
+            }
+            else
+            {
+                ObjTriangle triangle;
+                ObjVertexType vertexType = parseFaceVertex(tokens[1], triangle.vertices[0]);
+                if (vertexType == InvalidVertex ||
+                    parseFaceVertex(tokens[2], triangle.vertices[1]) != vertexType ||
+                    parseFaceVertex(tokens[3], triangle.vertices[2]) != vertexType)
+                {
+                    error = "Bad vertex data for face";
+                }
+                else
+                {
+                    if (vertexType != currentVertexType)
+                    {
+                        ObjChunkEvent event;
+                        event.type = ObjChunkEvent::ChangeVertexType;
+                        event.triangleIndex = chunk.triangles.size();
+                        event.vertexType = vertexType;
+                        chunk.events.push_back(event);
+                        currentVertexType = vertexType;
+                    }
+
+                    for (unsigned int i = 0; i < 3; ++i)
+                    {
+                        ObjVertex& v = triangle.vertices[i];
+                        v.positionIndex = chunkIndex(v.positionIndex, chunk.positions.size());
+                        v.normalIndex = chunkIndex(v.normalIndex, chunk.normals.size());
+                        v.texCoordIndex = chunkIndex(v.texCoordIndex, chunk.texCoords.size());
+                    }
+
+                    chunk.triangles.push_back(triangle);
+                    chunk.triangleLines.push_back(chunk.lineCount);
+                }
+            }
+        }
+        else if (tokenEquals(tokens[0], "g"))
+        {
+            ObjChunkEvent event;
+            event.type = ObjChunkEvent::Group;
+            event.triangleIndex = chunk.triangles.size();
+            event.vertexType = InvalidVertex;
+            chunk.events.push_back(event);
+        }
+        else if (tokenEquals(tokens[0], "usemtl"))
+        {
+            if (tokenCount == 2)
+            {
+                ObjChunkEvent event;
+                event.type = ObjChunkEvent::UseMaterial;
+                event.triangleIndex = chunk.triangles.size();
+                event.vertexType = InvalidVertex;
+                event.materialName = string(tokens[1].begin, tokens[1].end);
+                chunk.events.push_back(event);
+            }
+        }
+        else if (tokenEquals(tokens[0], "mtllib"))
+        {
+            if (tokenCount == 2)
+            {
+                chunk.materialLibrary = string(tokens[1].begin, tokens[1].end);
+            }
+        }
+        else if (tokenEquals(tokens[0], "o") || tokenEquals(tokens[0], "s"))
+        {
+            // object and smooth group keywords ignored
+        }
+        else
+        {
+            ++chunk.unknownKeywordCount;
+        }
+
+        if (error)
+        {
+            chunk.errorMessage = error;
+            chunk.errorLine = chunk.lineCount;
+            return false;
+        }
+
+        ++chunk.lineCount;
+        lineStart = lineEnd + 1;
+    }
+
+    return true;
+}
+
+
+// Convert the indices of a triangle from a chunk to zero-based VESTA indices.
+bool
+ObjLoader::resolveChunkIndices(ObjTriangle& tri,
+                               unsigned int positionOffset,
+                               unsigned int normalOffset,
+                               unsigned int texCoordOffset)
+{
+    bool hasTexCoords = m_currentVertexType == PositionTexVertex || m_currentVertexType == PositionTexNormalVertex;
+    bool hasNormals = m_currentVertexType == PositionNormalVertex || m_currentVertexType == PositionTexNormalVertex;
+
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        ObjVertex& v = tri.vertices[i];
+
+        v.positionIndex = resolveChunkIndex(v.positionIndex, positionOffset, m_positions.size());
+        v.texCoordIndex = hasTexCoords ? resolveChunkIndex(v.texCoordIndex, texCoordOffset, m_texCoords.size()) : 0;
+        v.normalIndex = hasNormals ? resolveChunkIndex(v.normalIndex, normalOffset, m_normals.size()) : 0;
+
+        if (v.positionIndex < 0 || v.texCoordIndex < 0 || v.normalIndex < 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/** Build a mesh from a list of chunks produced by parseChunk(). The chunks
+  * must be in file order. The result is the same as if the whole file had
+  * been loaded with loadModel(), except that faces may refer to vertices
+  * that are defined later in the file.
+  */
+MeshGeometry*
+ObjLoader::loadChunks(const vector<ObjChunk*>& chunks)
+{
+    reset();
+
+    // Check for errors and concatenate the vertex data
+    unsigned int unknownKeywordCount = 0;
+    size_t positionCount = 0;
+    size_t normalCount = 0;
+    size_t texCoordCount = 0;
+    for (unsigned int i = 0; i < chunks.size(); ++i)
+    {
+        const ObjChunk* chunk = chunks[i];
+        if (!chunk->errorMessage.empty())
+        {
+            m_lineNumber += chunk->errorLine;
+            reportError(chunk->errorMessage);
+            return NULL;
+        }
+
+        m_lineNumber += chunk->lineCount;
+        unknownKeywordCount += chunk->unknownKeywordCount;
+        positionCount += chunk->positions.size();
+        normalCount += chunk->normals.size();
+        texCoordCount += chunk->texCoords.size();
+
+        if (!chunk->materialLibrary.empty())
+        {
+            m_materialLibrary = chunk->materialLibrary;
+        }
+    }
+
+    if (unknownKeywordCount > 0)
+    {
+        VESTA_LOG("Ignored %u lines with unknown keywords in OBJ file", unknownKeywordCount);
+    }
+
+    m_positions.reserve(positionCount);
+    m_normals.reserve(normalCount);
+    m_texCoords.reserve(texCoordCount);
+    for (unsigned int i = 0; i < chunks.size(); ++i)
+    {
+        m_positions.insert(m_positions.end(), chunks[i]->positions.begin(), chunks[i]->positions.end());
+        m_normals.insert(m_normals.end(), chunks[i]->normals.begin(), chunks[i]->normals.end());
+        m_texCoords.insert(m_texCoords.end(), chunks[i]->texCoords.begin(), chunks[i]->texCoords.end());
+    }
+
+    // Replay the faces and grouping directives in order
+    unsigned int positionOffset = 0;
+    unsigned int normalOffset = 0;
+    unsigned int texCoordOffset = 0;
+    m_lineNumber = 1;
+    for (unsigned int i = 0; i < chunks.size(); ++i)
+    {
+        const ObjChunk* chunk = chunks[i];
+        unsigned int eventIndex = 0;
+
+        for (unsigned int triIndex = 0; triIndex <= chunk->triangles.size(); ++triIndex)
+        {
+            while (eventIndex < chunk->events.size() && chunk->events[eventIndex].triangleIndex == triIndex)
+            {
+                const ObjChunkEvent& event = chunk->events[eventIndex];
+                switch (event.type)
+                {
+                case ObjChunkEvent::UseMaterial:
+                    finishMaterialGroup();
+                    useMaterial(event.materialName);
+                    break;
+                case ObjChunkEvent::Group:
+                    finishMaterialGroup();
+                    break;
+                case ObjChunkEvent::ChangeVertexType:
+                    if (event.vertexType != m_currentVertexType)
+                    {
+                        finishVertexGroup();
+                        m_currentVertexType = event.vertexType;
+                    }
+                    break;
+                }
+                ++eventIndex;
+            }
+
+            if (triIndex < chunk->triangles.size())
+            {
+                ObjTriangle triangle = chunk->triangles[triIndex];
+                if (!resolveChunkIndices(triangle, positionOffset, normalOffset, texCoordOffset))
+                {
+                    m_lineNumber += chunk->triangleLines[triIndex];
+                    reportError("Bad indexes in face");
+                    return NULL;
+                }
+
+                m_triangles.push_back(triangle);
+            }
+        }
+
+        positionOffset += chunk->positions.size();
+        normalOffset += chunk->normals.size();
+        texCoordOffset += chunk->texCoords.size();
+        m_lineNumber += chunk->lineCount;
+    }
+
+    finishVertexGroup();
+
+    // Create default materials
+    for (unsigned int i = 0; i < m_materials.size(); ++i)
+    {
+        Material* material = new Material();
+        material->setDiffuse(Spectrum::Flat(1.0f));
+        m_mesh->addMaterial(material);
+    }
+
+    MeshGeometry* loadedMesh = m_mesh;
+    m_mesh = NULL;
+
+    return loadedMesh;
+}
+
+
+/** Load a mesh in Wavefront OBJ format from a block of memory. This is
+  * faster than loading from a stream, but otherwise equivalent. The text
+  * is parsed as a single chunk; callers that want to parse large files on
+  * multiple threads should use splitChunks(), parseChunk(), and loadChunks()
+  * instead.
+  */
+MeshGeometry*
+ObjLoader::loadModel(const char* data, size_t size)
+{
+    ObjChunk chunk;
+    parseChunk(data, data + size, chunk);
+
+    vector<ObjChunk*> chunks;
+    chunks.push_back(&chunk);
+
+    return loadChunks(chunks);
+}
+
+
+/** Apply materials from the material library referenced by the most recently
+  * loaded model. pathName is the directory containing the model file (with
+  * a trailing separator.) Materials that can't be found keep their defaults.
+  */
+void
+ObjLoader::applyMaterialLibrary(MeshGeometry* mesh, TextureMapLoader* textureLoader, const string& pathName) const
+{
+    if (m_materialLibrary.empty())
+    {
+        return;
+    }
+
+    string materialLibraryFileName = pathName + m_materialLibrary;
+    ifstream matStream(materialLibraryFileName.c_str(), ios::in);
+    if (!matStream.good())
+    {
+        VESTA_LOG("Can't find material library file '%s' for OBJ format mesh", materialLibraryFileName.c_str());
+        return;
+    }
+
+    ObjMaterialLibraryLoader matLoader(textureLoader);
+    ObjMaterialLibrary* materialLibrary = matLoader.loadMaterials(matStream);
+    if (!materialLibrary)
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < m_materials.size(); ++i)
+    {
+        string materialName = m_materials[i];
+        if (!materialName.empty())
+        {
+            Material* material = materialLibrary->material(materialName);
+            if (material)
+            {
+                Material* meshMaterial = mesh->material(i);
+                if (meshMaterial)
+                {
+                    *meshMaterial = *material;
+                }
+            }
+            else
+            {
+                VESTA_LOG("Missing material in OBJ file: '%s'", materialName.c_str());
+            }
+        }
+    }
+
+    delete materialLibrary;
+}
+
+
+
 ObjMaterial::ObjMaterial() :
     illuminationModel(BlinnPhongModel),
     dissolve(1.0f),
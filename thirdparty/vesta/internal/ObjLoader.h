@@ -17,6 +17,7 @@
 #include <vector>
 #include <map>
 #include <cstdio>
+#include <cstddef>
 #include <Eigen/Core>
 
 
@@ -32,6 +33,14 @@ public:
     ~ObjLoader();
 
     MeshGeometry* loadModel(std::istream& in);
+    MeshGeometry* loadModel(const char* data, std::size_t size);
+
+    struct ObjChunk;
+    static void splitChunks(const char* data, std::size_t size, unsigned int chunkCount, std::vector<const char*>& boundaries);
+    static bool parseChunk(const char* begin, const char* end, ObjChunk& chunk);
+    MeshGeometry* loadChunks(const std::vector<ObjChunk*>& chunks);
+
+    void applyMaterialLibrary(MeshGeometry* mesh, TextureMapLoader* textureLoader, const std::string& pathName) const;
 
     /** Get the name of the most recently used material library.
       */
@@ -91,12 +100,72 @@ public:
         PositionTexNormalVertex,
     };
 
+    /** A directive that affects how the faces following it are grouped.
+      * Events are stored with the index of the first triangle that they
+      * apply to.
+      */
+    struct ObjChunkEvent
+    {
+        enum EventType
+        {
+            UseMaterial,
+            Group,
+            ChangeVertexType
+        };
+
+        EventType type;
+        unsigned int triangleIndex;
+        ObjVertexType vertexType;
+        std::string materialName;
+    };
+
+    /** The result of parsing a range of lines from an OBJ file. Chunks are
+      * parsed independently (and possibly concurrently) by parseChunk(), then
+      * combined in file order by loadChunks().
+      *
+      * Face indices can't be resolved until the number of vertices in all
+      * preceding chunks is known. Positive (absolute) indices are stored
+      * unchanged. Negative (relative) indices are stored as a position
+      * within the chunk's own vertex lists, offset by RelativeIndexBias so
+      * that they are always less than or equal to zero. The line of each
+      * triangle (counted from the start of the chunk) is kept so that index
+      * errors found while resolving can be reported at the right line.
+      */
+    struct ObjChunk
+    {
+        ObjChunk() :
+            lineCount(0),
+            unknownKeywordCount(0),
+            errorLine(0)
+        {
+        }
+
+        std::vector<Eigen::Vector3f> positions;
+        std::vector<Eigen::Vector3f> normals;
+        std::vector<Eigen::Vector2f> texCoords;
+        std::vector<ObjTriangle> triangles;
+        std::vector<unsigned int> triangleLines;
+        std::vector<ObjChunkEvent> events;
+        std::string materialLibrary;
+        unsigned int lineCount;
+        unsigned int unknownKeywordCount;
+        unsigned int errorLine;
+        std::string errorMessage;
+    };
+
+    static const int RelativeIndexBias = -(1 << 30);
+
 private:
+    void reset();
     void reportError(const std::string& message);
     void finishVertexGroup();
     void finishMaterialGroup();
     int convertVertexIndex(int objIndex, int maxIndex);
     bool convertTriangleIndices(ObjTriangle& tri);
+    bool resolveChunkIndices(ObjTriangle& tri,
+                             unsigned int positionOffset,
+                             unsigned int normalOffset,
+                             unsigned int texCoordOffset);
     unsigned int useMaterial(const std::string& materialName);
 
 private:
@@ -0,0 +1,167 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "ParallelFor.h"
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+using namespace vesta;
+using namespace std;
+
+
+namespace
+{
+
+struct ParallelForState
+{
+    ParallelForState(unsigned int n, ParallelTaskFunction f, void* c) :
+        taskCount(n),
+        task(f),
+        context(c),
+        nextTask(0)
+    {
+    }
+
+    unsigned int taskCount;
+    ParallelTaskFunction task;
+    void* context;
+#ifdef _WIN32
+    volatile LONG nextTask;
+#else
+    volatile int nextTask;
+#endif
+};
+
+}
+
+
+// Atomically claim the next task; returns its index
+static inline unsigned int
+claimTask(ParallelForState* state)
+{
+#ifdef _WIN32
+    return (unsigned int) (InterlockedIncrement(&state->nextTask) - 1);
+#else
+    return (unsigned int) (__sync_add_and_fetch(&state->nextTask, 1) - 1);
+#endif
+}
+
+
+// Each thread repeatedly claims the next unstarted task until none are left
+static void
+runTasks(ParallelForState* state)
+{
+    for (;;)
+    {
+        unsigned int taskIndex = claimTask(state);
+        if (taskIndex >= state->taskCount)
+        {
+            break;
+        }
+
+        state->task(state->context, taskIndex);
+    }
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI
+threadMain(LPVOID arg)
+{
+    runTasks(reinterpret_cast<ParallelForState*>(arg));
+    return 0;
+}
+#else
+static void*
+threadMain(void* arg)
+{
+    runTasks(reinterpret_cast<ParallelForState*>(arg));
+    return NULL;
+}
+#endif
+
+
+/** Get the number of processors available to run threads.
+  */
+unsigned int
+vesta::ProcessorCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (unsigned int) info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int) count : 1;
+#endif
+}
+
+
+/** Call task(context, i) for every i in [0, taskCount), distributing the calls
+  * among up to one thread per processor. The calling thread participates, and
+  * ParallelFor doesn't return until all tasks have completed. Tasks may run in
+  * any order and must not depend on each other.
+  *
+  * If threads can't be created, the remaining tasks are run on the calling
+  * thread.
+  */
+void
+vesta::ParallelFor(unsigned int taskCount, ParallelTaskFunction task, void* context)
+{
+    ParallelForState state(taskCount, task, context);
+
+    unsigned int threadCount = ProcessorCount();
+    if (threadCount > taskCount)
+    {
+        threadCount = taskCount;
+    }
+
+    // The calling thread is one of the workers
+#ifdef _WIN32
+    vector<HANDLE> threads;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        HANDLE thread = CreateThread(NULL, 0, threadMain, &state, 0, NULL);
+        if (thread)
+        {
+            threads.push_back(thread);
+        }
+    }
+
+    runTasks(&state);
+
+    for (unsigned int i = 0; i < threads.size(); ++i)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+#else
+    vector<pthread_t> threads;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, threadMain, &state) == 0)
+        {
+            threads.push_back(thread);
+        }
+    }
+
+    runTasks(&state);
+
+    for (unsigned int i = 0; i < threads.size(); ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+#endif
+}
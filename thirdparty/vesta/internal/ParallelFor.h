@@ -0,0 +1,25 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_PARALLEL_FOR_H_
+#define _VESTA_PARALLEL_FOR_H_
+
+namespace vesta
+{
+
+/** Function called by ParallelFor for each task. context is the pointer
+  * passed to ParallelFor, and taskIndex is in the range [0, taskCount).
+  */
+typedef void (*ParallelTaskFunction)(void* context, unsigned int taskIndex);
+
+unsigned int ProcessorCount();
+void ParallelFor(unsigned int taskCount, ParallelTaskFunction task, void* context);
+
+}
+
+#endif // _VESTA_PARALLEL_FOR_H_
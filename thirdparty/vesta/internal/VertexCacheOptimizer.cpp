@@ -0,0 +1,297 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "VertexCacheOptimizer.h"
+#include <vector>
+#include <cmath>
+
+using namespace vesta;
+using namespace std;
+
+
+// Parameters of the scoring function from Tom Forsyth's "Linear-Speed Vertex
+// Cache Optimisation". The modeled cache is LRU; its size is larger than the
+// post-transform cache of most hardware, which works well in practice.
+static const int ModeledCacheSize = 32;
+static const float CacheDecayPower = 1.5f;
+static const float LastTriangleScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+// Scores depend only on cache position and remaining valence, so they can be
+// tabulated. Vertices with higher valences use the last entry.
+static const unsigned int MaxTabulatedValence = 32;
+
+
+namespace
+{
+
+struct ScoreTables
+{
+    ScoreTables()
+    {
+        for (int i = 0; i < ModeledCacheSize; ++i)
+        {
+            if (i < 3)
+            {
+                // The three vertices of the most recent triangle get a fixed
+                // score, so that the algorithm doesn't favor strips.
+                cacheScore[i] = LastTriangleScore;
+            }
+            else
+            {
+                float scale = 1.0f / (ModeledCacheSize - 3);
+                cacheScore[i] = pow(1.0f - (i - 3) * scale, CacheDecayPower);
+            }
+        }
+
+        valenceScore[0] = 0.0f;
+        for (unsigned int i = 1; i <= MaxTabulatedValence; ++i)
+        {
+            valenceScore[i] = ValenceBoostScale * pow(float(i), -ValenceBoostPower);
+        }
+    }
+
+    float score(int cachePosition, unsigned int remainingValence) const
+    {
+        if (remainingValence == 0)
+        {
+            // No triangles left that use this vertex
+            return -1.0f;
+        }
+
+        float s = cachePosition < 0 ? 0.0f : cacheScore[cachePosition];
+        return s + valenceScore[remainingValence < MaxTabulatedValence ? remainingValence : MaxTabulatedValence];
+    }
+
+    float cacheScore[ModeledCacheSize];
+    float valenceScore[MaxTabulatedValence + 1];
+};
+
+}
+
+
+/** Reorder the triangles in an indexed triangle list so that vertices are
+  * reused while they're still in the GPU's post-transform cache. This is an
+  * implementation of Tom Forsyth's linear-speed algorithm: triangles are
+  * added greedily, choosing the triangle with the highest score among those
+  * using vertices in a simulated cache.
+  *
+  * optimizedIndices must have room for triangleCount * 3 indices and may not
+  * be the same array as indices. Every index must be less than vertexCount.
+  */
+void
+vesta::OptimizeTriangleOrder(const v_uint32* indices,
+                             unsigned int triangleCount,
+                             unsigned int vertexCount,
+                             v_uint32* optimizedIndices)
+{
+    static const ScoreTables scores;
+
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Build the vertex to triangle adjacency lists
+    vector<unsigned int> valence(vertexCount, 0);
+    for (unsigned int i = 0; i < triangleCount * 3; ++i)
+    {
+        valence[indices[i]]++;
+    }
+
+    vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; ++v)
+    {
+        adjacencyStart[v + 1] = adjacencyStart[v] + valence[v];
+    }
+
+    vector<unsigned int> adjacency(triangleCount * 3);
+    vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (unsigned int t = 0; t < triangleCount; ++t)
+    {
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            unsigned int v = indices[t * 3 + j];
+            adjacency[fill[v]++] = t;
+        }
+    }
+
+    // valence now tracks the number of triangles not yet added that use each vertex
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; ++v)
+    {
+        vertexScore[v] = scores.score(-1, valence[v]);
+    }
+
+    vector<float> triangleScore(triangleCount);
+    for (unsigned int t = 0; t < triangleCount; ++t)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    vector<bool> triangleAdded(triangleCount, false);
+
+    // The cache has room for the modeled cache plus the three vertices of
+    // a new triangle, which may push entries out.
+    v_uint32 cache[ModeledCacheSize + 3];
+    int cacheCount = 0;
+
+    unsigned int outputTriangle = 0;
+    unsigned int scanPosition = 0;
+    int bestTriangle = -1;
+
+    while (outputTriangle < triangleCount)
+    {
+        if (bestTriangle < 0)
+        {
+            // No candidates in the cache; pick the best of the next few
+            // remaining triangles. Scanning starts at the first triangle not
+            // yet added and is limited in length, which keeps the overall
+            // cost linear.
+            while (scanPosition < triangleCount && triangleAdded[scanPosition])
+            {
+                ++scanPosition;
+            }
+
+            float bestScore = -1.0f;
+            for (unsigned int t = scanPosition; t < triangleCount && t < scanPosition + 256; ++t)
+            {
+                if (!triangleAdded[t] && triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    bestTriangle = int(t);
+                }
+            }
+        }
+
+        // Emit the triangle
+        unsigned int t = (unsigned int) bestTriangle;
+        triangleAdded[t] = true;
+        const v_uint32* tri = indices + t * 3;
+        optimizedIndices[outputTriangle * 3]     = tri[0];
+        optimizedIndices[outputTriangle * 3 + 1] = tri[1];
+        optimizedIndices[outputTriangle * 3 + 2] = tri[2];
+        ++outputTriangle;
+
+        // Remove the triangle from the adjacency lists of its vertices
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            unsigned int v = tri[j];
+            unsigned int* begin = &adjacency[adjacencyStart[v]];
+            unsigned int* end = begin + valence[v];
+            for (unsigned int* p = begin; p != end; ++p)
+            {
+                if (*p == t)
+                {
+                    *p = *(end - 1);
+                    break;
+                }
+            }
+            valence[v]--;
+        }
+
+        // Move the triangle's vertices to the front of the LRU cache
+        v_uint32 newCache[ModeledCacheSize + 3];
+        int newCacheCount = 0;
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            // Degenerate triangles may repeat a vertex
+            if (j == 0 || (tri[j] != tri[0] && (j == 1 || tri[j] != tri[1])))
+            {
+                newCache[newCacheCount++] = tri[j];
+            }
+        }
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            v_uint32 v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+            {
+                newCache[newCacheCount++] = v;
+            }
+        }
+
+        // Update the scores of everything that was in the cache, including
+        // vertices that were just pushed out, and of their triangles.
+        for (int i = 0; i < newCacheCount; ++i)
+        {
+            v_uint32 v = newCache[i];
+            cachePosition[v] = i < ModeledCacheSize ? i : -1;
+            float newScore = scores.score(cachePosition[v], valence[v]);
+            float delta = newScore - vertexScore[v];
+            vertexScore[v] = newScore;
+
+            const unsigned int* adj = &adjacency[0] + adjacencyStart[v];
+            for (unsigned int k = 0; k < valence[v]; ++k)
+            {
+                triangleScore[adj[k]] += delta;
+            }
+        }
+
+        cacheCount = newCacheCount < ModeledCacheSize ? newCacheCount : ModeledCacheSize;
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            cache[i] = newCache[i];
+        }
+
+        // The next triangle is the best one that uses a cached vertex
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            v_uint32 v = cache[i];
+            const unsigned int* adj = &adjacency[0] + adjacencyStart[v];
+            for (unsigned int k = 0; k < valence[v]; ++k)
+            {
+                unsigned int candidate = adj[k];
+                if (triangleScore[candidate] > bestScore)
+                {
+                    bestScore = triangleScore[candidate];
+                    bestTriangle = int(candidate);
+                }
+            }
+        }
+    }
+}
+
+
+/** Compute the average cache miss ratio (ACMR) for an indexed triangle list:
+  * the average number of vertices transformed per triangle, using a simulated
+  * FIFO post-transform cache of the specified size. The result ranges from
+  * 3 (no reuse at all) down to about 0.5 for an ideal ordering of a large
+  * regular mesh.
+  */
+float
+vesta::AverageCacheMissRatio(const v_uint32* indices,
+                             unsigned int triangleCount,
+                             unsigned int vertexCount,
+                             unsigned int cacheSize)
+{
+    if (triangleCount == 0 || cacheSize == 0)
+    {
+        return 0.0f;
+    }
+
+    // Each vertex records the time at which it entered the cache; it's still
+    // cached if fewer than cacheSize misses have occurred since then.
+    vector<unsigned int> insertionTime(vertexCount, 0);
+    unsigned int missCount = 0;
+
+    for (unsigned int i = 0; i < triangleCount * 3; ++i)
+    {
+        v_uint32 v = indices[i];
+        if (insertionTime[v] == 0 || missCount - insertionTime[v] >= cacheSize)
+        {
+            ++missCount;
+            insertionTime[v] = missCount;
+        }
+    }
+
+    return float(missCount) / float(triangleCount);
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_VERTEX_CACHE_OPTIMIZER_H_
+#define _VESTA_VERTEX_CACHE_OPTIMIZER_H_
+
+#include "../IntegerTypes.h"
+
+namespace vesta
+{
+
+/** Size of the FIFO cache simulated when computing the average cache miss
+  * ratio. Sixteen entries is conservative for current hardware.
+  */
+static const unsigned int DefaultSimulatedCacheSize = 16;
+
+void OptimizeTriangleOrder(const v_uint32* indices,
+                           unsigned int triangleCount,
+                           unsigned int vertexCount,
+                           v_uint32* optimizedIndices);
+
+float AverageCacheMissRatio(const v_uint32* indices,
+                            unsigned int triangleCount,
+                            unsigned int vertexCount,
+                            unsigned int cacheSize = DefaultSimulatedCacheSize);
+
+}
+
+#endif // _VESTA_VERTEX_CACHE_OPTIMIZER_H_
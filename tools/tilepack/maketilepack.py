@@ -0,0 +1,146 @@
+#!/usr/bin/python
+
+# Convert a directory of texture tiles into a tile pack: a single file that
+# holds an index of all tiles followed by the encoded tile data. Cosmographia
+# memory maps tile packs, so that checking whether a tile exists doesn't
+# require a file system query and loading a tile doesn't require opening a
+# file.
+#
+# Tiles are located with a name template using the same syntax as NameTemplate
+# tiled maps in Cosmographia catalog files: %level, %column, and %row are
+# replaced with the tile address, and row 0 is the northernmost row of tiles.
+#
+# The file format is documented in src/main/vext/TilePackTiledMap.h
+
+import os
+import struct
+import sys
+import time
+from optparse import OptionParser
+
+HEADER_FORMAT = '<4sIIIII8s'
+INDEX_ENTRY_FORMAT = '<IIIIQ'
+VERSION = 1
+
+
+def tileFileName(template, level, column, row):
+    # Replace %level first so that it isn't confused with a shorter pattern
+    name = template.replace('%level', str(level))
+    name = name.replace('%column', str(column))
+    return name.replace('%row', str(row))
+
+
+def findTiles(directory, template, levelCount):
+    tiles = []
+    for level in range(levelCount):
+        rowCount = 1 << level
+        for column in range(2 * rowCount):
+            for row in range(rowCount):
+                fileName = os.path.join(directory, tileFileName(template, level, column, row))
+                if os.path.exists(fileName):
+                    # Tile packs number rows from the south, like Cosmographia's tiled maps
+                    tiles.append((level, column, rowCount - 1 - row, fileName))
+    return tiles
+
+
+def writeTilePack(out, tiles, tileSize, levelCount, tileFormat):
+    tiles.sort()
+    header = struct.pack(HEADER_FORMAT, b'CTPK', VERSION, tileSize, levelCount, len(tiles), 0,
+                         tileFormat.encode('ascii')[:8])
+    offset = len(header) + len(tiles) * struct.calcsize(INDEX_ENTRY_FORMAT)
+
+    index = []
+    for (level, column, row, fileName) in tiles:
+        length = os.path.getsize(fileName)
+        index.append(struct.pack(INDEX_ENTRY_FORMAT, level, column, row, length, offset))
+        offset += length
+
+    out.write(header)
+    out.write(b''.join(index))
+    for (level, column, row, fileName) in tiles:
+        f = open(fileName, 'rb')
+        out.write(f.read())
+        f.close()
+
+
+# Compare the cost of checking for and reading every tile address in the map
+# with loose files and with a tile pack. This approximates the work done on the
+# GUI thread (existence checks) and on the loader thread (reading tile data).
+def benchmark(directory, template, levelCount, packFileName):
+    import mmap
+
+    addresses = []
+    for level in range(levelCount):
+        rowCount = 1 << level
+        for column in range(2 * rowCount):
+            for row in range(rowCount):
+                addresses.append((level, column, row))
+
+    start = time.time()
+    looseBytes = 0
+    for (level, column, row) in addresses:
+        fileName = os.path.join(directory, tileFileName(template, level, column, row))
+        if os.path.exists(fileName):
+            f = open(fileName, 'rb')
+            looseBytes += len(f.read())
+            f.close()
+    looseTime = time.time() - start
+
+    start = time.time()
+    packBytes = 0
+    packFile = open(packFileName, 'rb')
+    data = mmap.mmap(packFile.fileno(), 0, access=mmap.ACCESS_READ)
+    headerSize = struct.calcsize(HEADER_FORMAT)
+    entrySize = struct.calcsize(INDEX_ENTRY_FORMAT)
+    tileCount = struct.unpack_from(HEADER_FORMAT, data, 0)[4]
+    index = {}
+    for i in range(tileCount):
+        (level, column, row, length, offset) = struct.unpack_from(INDEX_ENTRY_FORMAT, data, headerSize + i * entrySize)
+        index[(level, column, row)] = (offset, length)
+    for (level, column, row) in addresses:
+        entry = index.get((level, column, (1 << level) - 1 - row))
+        if entry:
+            packBytes += len(data[entry[0]:entry[0] + entry[1]])
+    packTime = time.time() - start
+    data.close()
+    packFile.close()
+
+    print('%d tile addresses, %d tiles' % (len(addresses), tileCount))
+    print('loose files: %.3f s (%d bytes)' % (looseTime, looseBytes))
+    print('tile pack:   %.3f s (%d bytes)' % (packTime, packBytes))
+
+
+parser = OptionParser(usage='usage: %prog [options] tile-directory')
+parser.add_option('-o', '--out', dest='outfile',
+                  help='Write tile pack to FILE', metavar='FILE')
+parser.add_option('-t', '--template', dest='template', default='level%level/tile_%column_%row.png',
+                  help='Tile name template relative to the tile directory [default: %default]')
+parser.add_option('-l', '--levels', dest='levelCount', type='int', default=8,
+                  help='Number of levels in the tiled map [default: %default]')
+parser.add_option('-s', '--tile-size', dest='tileSize', type='int', default=512,
+                  help='Tile size in pixels [default: %default]')
+parser.add_option('-b', '--benchmark', dest='benchmark', action='store_true', default=False,
+                  help='After writing the tile pack, compare reading tiles from loose files and from the pack')
+
+(options, args) = parser.parse_args()
+
+if len(args) != 1 or not options.outfile:
+    parser.print_help()
+    sys.exit(1)
+
+tileDirectory = args[0]
+tileFormat = os.path.splitext(options.template)[1].lstrip('.').lower()
+
+tiles = findTiles(tileDirectory, options.template, options.levelCount)
+if not tiles:
+    sys.stderr.write('No tiles found matching %s\n' % os.path.join(tileDirectory, options.template))
+    sys.exit(1)
+
+out = open(options.outfile, 'wb')
+writeTilePack(out, tiles, options.tileSize, options.levelCount, tileFormat)
+out.close()
+
+print('Wrote %d tiles to %s' % (len(tiles), options.outfile))
+
+if options.benchmark:
+    benchmark(tileDirectory, options.template, options.levelCount, options.outfile)